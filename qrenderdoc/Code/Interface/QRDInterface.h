@@ -1430,6 +1430,10 @@ called.
 
   DOCUMENT(R"(Retrieve the :class:`~renderdoc.SDFile` for the currently open capture.
 
+.. note::
+  The structured data may be loaded lazily, so use :meth:`~renderdoc.SDFile.GetChunk` to access a
+  chunk's contents. See :meth:`~renderdoc.ReplayController.GetStructuredFile`.
+
 :return: The structured file.
 :rtype: ~renderdoc.SDFile
 )");
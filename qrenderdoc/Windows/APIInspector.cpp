@@ -149,7 +149,7 @@ void APIInspector::fillAPIView()
 
       if(ev.chunkIndex < file.chunks.size())
       {
-        SDChunk *chunk = file.chunks[ev.chunkIndex];
+        SDChunk *chunk = file.GetChunk(ev.chunkIndex);
 
         root->setText(1, chunk->name);
 
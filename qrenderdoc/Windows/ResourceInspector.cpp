@@ -305,7 +305,7 @@ void ResourceInspector::Inspect(ResourceId id)
 
       if(chunk < file.chunks.size())
       {
-        SDChunk *chunkObj = file.chunks[chunk];
+        SDChunk *chunkObj = file.GetChunk(chunk);
 
         root->setText(0, chunkObj->name);
 
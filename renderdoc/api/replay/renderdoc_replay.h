@@ -1009,6 +1009,12 @@ See :meth:`BuildTargetShader`.
 
   DOCUMENT(R"(Fetch the structured data representation of the capture loaded.
 
+.. note::
+  Captures opened from disk may have their structured data loaded lazily, currently only for Vulkan
+  captures. Chunks are listed with only their metadata until fetched through
+  :meth:`SDFile.GetChunk`, so always use that to access a chunk's contents rather than indexing
+  :data:`SDFile.chunks` directly.
+
 :return: The structured file.
 :rtype: SDFile
 )");
@@ -83,6 +83,13 @@ version of RenderDoc that addes a new section type. They should be considered eq
   lossless.
 
   The name for this section will be "renderdoc/internal/exthumb".
+
+.. data:: CallstackDictionary
+
+  This section contains the unique callstacks collected during capture, which chunks in the frame
+  capture refer to by index.
+
+  The name for this section will be "renderdoc/internal/callstacks".
 )");
 enum class SectionType : uint32_t
 {
@@ -95,6 +102,7 @@ enum class SectionType : uint32_t
   ResourceRenames,
   AMDRGPProfile,
   ExtendedThumbnail,
+  CallstackDictionary,
   Count,
 };
 
@@ -3398,6 +3406,12 @@ DOCUMENT(R"(A set of flags describing the properties of a section in a renderdoc
 .. data:: ZstdCompressed
 
   This section is compressed with Zstd on disk.
+
+.. data:: LZ4IndependentBlocks
+
+  Used with :data:`LZ4Compressed`, this section's LZ4 blocks were compressed independently of each
+  other so they can be compressed and decompressed in parallel. Readers that don't know about this
+  flag can still decompress the section as normal LZ4.
 )");
 enum class SectionFlags : uint32_t
 {
@@ -3405,6 +3419,7 @@ enum class SectionFlags : uint32_t
   ASCIIStored = 0x1,
   LZ4Compressed = 0x2,
   ZstdCompressed = 0x4,
+  LZ4IndependentBlocks = 0x8,
 };
 
 BITMASK_OPERATORS(SectionFlags);
@@ -25,6 +25,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <new>
 #include "stringise.h"
 
 DOCUMENT(R"(The basic irreducible type of an object. Every other more complex type is built on these.
@@ -336,6 +337,58 @@ struct SDObjectData
 
 DECLARE_REFLECTION_STRUCT(SDObjectData);
 
+#if !defined(SWIG)
+// A simple bump allocator that an SDFile uses to store the objects created when exporting
+// structured data. Objects are constructed in place in large blocks instead of each being a
+// separate heap allocation, so siblings created together end up contiguous in memory. The memory
+// is only released when the arena is destroyed - objects are destroyed in place by their owner.
+struct SDObjectArena
+{
+  SDObjectArena() = default;
+  ~SDObjectArena()
+  {
+    for(size_t i = 0; i < blocks.size(); i++)
+      RENDERDOC_FreeArrayMem(blocks[i]);
+  }
+
+  void *Allocate(size_t size)
+  {
+    // keep every allocation pointer-aligned
+    size = (size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+
+    if(size > remaining)
+    {
+      size_t blockSize = size > BlockSize ? size : BlockSize;
+      cur = (char *)RENDERDOC_AllocArrayMem(blockSize);
+      remaining = blockSize;
+      blocks.push_back(cur);
+    }
+
+    void *ret = cur;
+    cur += size;
+    remaining -= size;
+    return ret;
+  }
+
+  void Swap(SDObjectArena &other)
+  {
+    blocks.swap(other.blocks);
+    std::swap(cur, other.cur);
+    std::swap(remaining, other.remaining);
+  }
+
+private:
+  static const size_t BlockSize = 1024 * 1024;
+
+  rdcarray<char *> blocks;
+  char *cur = NULL;
+  size_t remaining = 0;
+
+  SDObjectArena(const SDObjectArena &) = delete;
+  SDObjectArena &operator=(const SDObjectArena &) = delete;
+};
+#endif
+
 DOCUMENT("Defines a single structured object.");
 struct SDObject
 {
@@ -348,7 +401,7 @@ struct SDObject
   ~SDObject()
   {
     for(size_t i = 0; i < data.children.size(); i++)
-      delete data.children[i];
+      Destroy(data.children[i]);
 
     data.children.clear();
   }
@@ -543,9 +596,23 @@ Invalid if the object is not actually a :class:`ResourceId`.
 #endif
 
 protected:
+  friend struct SDFile;
+
   SDObject() {}
   SDObject(const SDObject &other) = delete;
   SDObject &operator=(const SDObject &other) = delete;
+
+  // objects allocated from an SDFile's arena are destroyed in place, as the arena owns the memory
+  template <typename T>
+  static void Destroy(T *obj)
+  {
+    if(obj && obj->m_InArena)
+      obj->~T();
+    else
+      delete obj;
+  }
+
+  bool m_InArena = false;
 };
 
 DECLARE_REFLECTION_STRUCT(SDObject);
@@ -798,9 +865,27 @@ struct SDChunk : public SDObject
   }
 
 protected:
+  friend struct SDFile;
+
   SDChunk() : SDObject() {}
   SDChunk(const SDChunk &other) = delete;
   SDChunk &operator=(const SDChunk &other) = delete;
+
+#if !defined(SWIG)
+  // for lazily loaded chunks, where the chunk starts in the source stream. Only the metadata is
+  // present until the chunk is loaded by SDFile::GetChunk()
+  uint64_t m_LazyOffset = ~0ULL;
+  bool m_Loaded = false;
+
+  // the slots in the file's buffers that belong to this chunk once it has been loaded, which are
+  // emptied when it's unloaded and refilled if it's loaded again.
+  uint64_t m_BufferBase = ~0ULL;
+  uint64_t m_NumBuffers = 0;
+
+  // position in the file's list of loaded chunks, from least to most recently used
+  SDChunk *m_PrevLoaded = NULL;
+  SDChunk *m_NextLoaded = NULL;
+#endif
 };
 
 DECLARE_REFLECTION_STRUCT(SDChunk);
@@ -859,20 +944,47 @@ struct StructuredBufferList : public rdcarray<bytebuf *>
 
 DECLARE_REFLECTION_STRUCT(StructuredBufferList);
 
-DOCUMENT("Contains the structured information in a file. Owns the buffers and chunks.");
+#if !defined(SWIG)
+struct SDFile;
+
+// Interface for filling in the contents of lazily loaded chunks in an SDFile. LoadChunk is given
+// the stream offset recorded for the chunk, and must add heap-allocated children to the chunk. Any
+// buffers it references are appended to chunkBuffers, and buffer objects index into that list.
+// The file moves them into the chunk's own slots in its buffers afterwards.
+struct SDChunkLoader
+{
+  virtual ~SDChunkLoader() {}
+  virtual bool LoadChunk(SDChunk &chunk, uint64_t offset, StructuredBufferList &chunkBuffers) = 0;
+};
+#endif
+
+DOCUMENT(R"(Contains the structured information in a file. Owns the buffers and chunks.
+
+Files can be loaded lazily, in which case the chunks initially only contain their metadata. Use
+:meth:`GetChunk` to access a chunk with its contents loaded.
+)");
 struct SDFile
 {
   SDFile() {}
   ~SDFile()
   {
     for(SDChunk *chunk : chunks)
-      delete chunk;
+      SDObject::Destroy(chunk);
 
     for(bytebuf *buf : buffers)
       delete buf;
+
+#if !defined(SWIG)
+    delete loader;
+#endif
   }
 
-  DOCUMENT("A ``list`` of :class:`SDChunk` objects with the chunks in order.");
+  DOCUMENT(R"(A ``list`` of :class:`SDChunk` objects with the chunks in order.
+
+.. note::
+  If the file was loaded lazily, the chunks in this list may only contain their metadata with no
+  children. Use :meth:`GetChunk` to access a chunk's contents.
+)");
   StructuredChunkList chunks;
 
   DOCUMENT("A ``list`` of serialised buffers stored as ``bytes`` objects");
@@ -886,9 +998,230 @@ struct SDFile
     chunks.swap(other.chunks);
     buffers.swap(other.buffers);
     std::swap(version, other.version);
+#if !defined(SWIG)
+    arena.Swap(other.arena);
+    std::swap(lruHead, other.lruHead);
+    std::swap(lruTail, other.lruTail);
+    std::swap(numLoaded, other.numLoaded);
+    std::swap(loader, other.loader);
+    std::swap(maxLoaded, other.maxLoaded);
+#endif
+  }
+
+  DOCUMENT(R"(Fetch a chunk, loading its contents first if the file was loaded lazily.
+
+Only a limited number of lazily loaded chunks are kept in memory at once. The least recently used
+chunk's contents are released when another one needs to be loaded, so a chunk's children should not
+be held on to while fetching other chunks.
+
+:param int index: The index of the chunk to fetch.
+:return: The chunk.
+:rtype: SDChunk
+)");
+  inline SDChunk *GetChunk(size_t index) const
+  {
+    SDChunk *chunk = chunks[index];
+#if !defined(SWIG)
+    if(chunk->m_LazyOffset != ~0ULL)
+      const_cast<SDFile *>(this)->LoadChunk(chunk);
+#endif
+    return chunk;
+  }
+
+#if !defined(SWIG)
+  // create an object or chunk stored in this file's arena. It must only be added to this file's
+  // chunks or as a child of another of its objects, never deleted directly.
+  SDObject *NewObject(const char *objName, const char *typeName)
+  {
+    SDObject *ret = new(arena.Allocate(sizeof(SDObject))) SDObject(objName, typeName);
+    ret->m_InArena = true;
+    return ret;
+  }
+
+  SDChunk *NewChunk(const char *chunkName)
+  {
+    SDChunk *ret = new(arena.Allocate(sizeof(SDChunk))) SDChunk(chunkName);
+    ret->m_InArena = true;
+    return ret;
+  }
+
+  // create a chunk whose contents will be loaded on demand from the given stream offset
+  SDChunk *NewLazyChunk(const char *chunkName, uint64_t offset)
+  {
+    SDChunk *ret = NewChunk(chunkName);
+    ret->m_LazyOffset = offset;
+    return ret;
   }
 
+  // set the loader used for lazy chunks, which the file takes ownership of. At most maxChunks
+  // lazy chunks have their contents in memory at once, or unlimited if it's 0.
+  void SetChunkLoader(SDChunkLoader *chunkLoader, size_t maxChunks)
+  {
+    delete loader;
+    loader = chunkLoader;
+    maxLoaded = maxChunks;
+  }
+
+  bool IsLazy() const { return loader != NULL; }
+
+  // for loading lazy chunks without going through GetChunk(), e.g. several at once in parallel.
+  // Returns the offset to load the chunk from, or ~0ULL if it isn't lazy or is already loaded.
+  uint64_t GetLazyOffset(size_t index) const
+  {
+    return chunks[index]->m_Loaded ? ~0ULL : chunks[index]->m_LazyOffset;
+  }
+
+  // once every lazy chunk has been loaded externally, turn this into an ordinary file
+  void FinishLazyLoad()
+  {
+    for(SDChunk *chunk : chunks)
+    {
+      chunk->m_LazyOffset = ~0ULL;
+      chunk->m_Loaded = false;
+      chunk->m_PrevLoaded = chunk->m_NextLoaded = NULL;
+    }
+
+    lruHead = lruTail = NULL;
+    numLoaded = 0;
+    SetChunkLoader(NULL, 0);
+  }
+
+  // moves the buffers a loader produced for a chunk into the chunk's slots in this file, taking
+  // ownership of them, and rebases the chunk's buffer indices to match. A chunk keeps the same
+  // slots each time it's loaded, so reloading doesn't grow the file.
+  void StoreChunkBuffers(SDChunk &chunk, bytebuf *const *chunkBuffers, size_t count)
+  {
+    if(count == 0)
+      return;
+
+    if(chunk.m_BufferBase != ~0ULL && chunk.m_NumBuffers == count)
+    {
+      for(size_t i = 0; i < count; i++)
+      {
+        buffers[size_t(chunk.m_BufferBase + i)]->swap(*chunkBuffers[i]);
+        delete chunkBuffers[i];
+      }
+    }
+    else
+    {
+      chunk.m_BufferBase = buffers.size();
+      chunk.m_NumBuffers = count;
+      buffers.append(chunkBuffers, count);
+    }
+
+    for(size_t i = 0; i < chunk.data.children.size(); i++)
+      RebaseBuffers(chunk.data.children[i], chunk.m_BufferBase);
+  }
+#endif
+
 protected:
+#if !defined(SWIG)
+  static void RebaseBuffers(SDObject *obj, uint64_t base)
+  {
+    if(obj->type.basetype == SDBasic::Buffer)
+      obj->data.basic.u += base;
+
+    for(size_t i = 0; i < obj->data.children.size(); i++)
+      RebaseBuffers(obj->data.children[i], base);
+  }
+
+  void UnlinkLoaded(SDChunk *chunk)
+  {
+    if(chunk->m_PrevLoaded)
+      chunk->m_PrevLoaded->m_NextLoaded = chunk->m_NextLoaded;
+    else
+      lruHead = chunk->m_NextLoaded;
+
+    if(chunk->m_NextLoaded)
+      chunk->m_NextLoaded->m_PrevLoaded = chunk->m_PrevLoaded;
+    else
+      lruTail = chunk->m_PrevLoaded;
+
+    chunk->m_PrevLoaded = chunk->m_NextLoaded = NULL;
+    numLoaded--;
+  }
+
+  void LinkLoaded(SDChunk *chunk)
+  {
+    chunk->m_PrevLoaded = lruTail;
+    chunk->m_NextLoaded = NULL;
+
+    if(lruTail)
+      lruTail->m_NextLoaded = chunk;
+    else
+      lruHead = chunk;
+
+    lruTail = chunk;
+    numLoaded++;
+  }
+
+  void UnloadChunk(SDChunk *chunk)
+  {
+    UnlinkLoaded(chunk);
+
+    for(size_t i = 0; i < chunk->data.children.size(); i++)
+      SDObject::Destroy(chunk->data.children[i]);
+    chunk->data.children.clear();
+    chunk->data.basic.numChildren = 0;
+    chunk->m_Loaded = false;
+
+    // free the contents but keep the slots, so they can be reused if the chunk is loaded again
+    for(uint64_t i = 0; i < chunk->m_NumBuffers; i++)
+    {
+      bytebuf empty;
+      buffers[size_t(chunk->m_BufferBase + i)]->swap(empty);
+    }
+  }
+
+  void LoadChunk(SDChunk *chunk)
+  {
+    if(chunk->m_Loaded)
+    {
+      // move to the back of the list as the most recently used
+      if(chunk != lruTail)
+      {
+        UnlinkLoaded(chunk);
+        LinkLoaded(chunk);
+      }
+      return;
+    }
+
+    if(!loader)
+      return;
+
+    while(maxLoaded > 0 && numLoaded >= maxLoaded)
+      UnloadChunk(lruHead);
+
+    StructuredBufferList chunkBuffers;
+
+    if(loader->LoadChunk(*chunk, chunk->m_LazyOffset, chunkBuffers))
+    {
+      StoreChunkBuffers(*chunk, chunkBuffers.data(), chunkBuffers.size());
+      chunkBuffers.clear();
+
+      chunk->m_Loaded = true;
+      LinkLoaded(chunk);
+    }
+    else
+    {
+      for(bytebuf *buf : chunkBuffers)
+        delete buf;
+
+      // don't keep retrying a chunk that can't be loaded, leave it with just its metadata
+      chunk->m_LazyOffset = ~0ULL;
+    }
+  }
+
+  SDObjectArena arena;
+
+  SDChunkLoader *loader = NULL;
+  // loaded lazy chunks, linked through the chunks themselves from least to most recently used
+  SDChunk *lruHead = NULL;
+  SDChunk *lruTail = NULL;
+  size_t numLoaded = 0;
+  size_t maxLoaded = 0;
+#endif
+
   SDFile(const SDFile &) = delete;
   SDFile &operator=(const SDFile &) = delete;
 };
@@ -82,6 +82,7 @@ float SRGB8_lookuptable[256] = {
 void rdcassert(const char *msg, const char *file, unsigned int line, const char *func)
 {
   rdclog_int(LogType::Error, RDCLOG_PROJECT, file, line, "Assertion failed: %s", msg);
+  rdclog_flush();
 }
 
 #if 0
@@ -223,6 +224,85 @@ bool FindDiffRange(void *a, void *b, size_t bufSize, size_t &diffStart, size_t &
   return diffStart < bufSize;
 }
 
+// compares a and b between begin and end byte-exactly, adding the differing ranges.
+static void AddDiffRanges(const byte *a, const byte *b, size_t begin, size_t end, size_t mergeGap,
+                          rdcarray<rdcpair<size_t, size_t>> &ranges)
+{
+  size_t i = begin;
+
+  while(i < end)
+  {
+    // skip identical data a word at a time, then byte by byte to find the exact start
+    while(i + sizeof(uint64_t) <= end)
+    {
+      uint64_t aword, bword;
+      memcpy(&aword, a + i, sizeof(aword));
+      memcpy(&bword, b + i, sizeof(bword));
+      if(aword != bword)
+        break;
+      i += sizeof(uint64_t);
+    }
+
+    while(i < end && a[i] == b[i])
+      i++;
+
+    if(i == end)
+      break;
+
+    size_t start = i;
+
+    // extend over differing data a word at a time while every byte in the word differs, i.e. the
+    // xor of the words contains no zero byte
+    while(i + sizeof(uint64_t) <= end)
+    {
+      uint64_t aword, bword;
+      memcpy(&aword, a + i, sizeof(aword));
+      memcpy(&bword, b + i, sizeof(bword));
+      uint64_t x = aword ^ bword;
+      if((x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL)
+        break;
+      i += sizeof(uint64_t);
+    }
+
+    while(i < end && a[i] != b[i])
+      i++;
+
+    if(!ranges.empty() && start - ranges.back().second <= mergeGap)
+      ranges.back().second = i;
+    else
+      ranges.push_back(make_rdcpair(start, i));
+  }
+}
+
+bool FindDiffRanges(const void *a, const void *b, size_t bufSize, size_t mergeGap,
+                    rdcarray<rdcpair<size_t, size_t>> &ranges)
+{
+  const byte *abyte = (const byte *)a;
+  const byte *bbyte = (const byte *)b;
+
+  ranges.clear();
+
+  // compare a page at a time. memcmp is vectorised by the C runtime for the CPU we're running on,
+  // so identical pages - normally the vast majority - are skipped at close to memory bandwidth and
+  // only pages that differ are scanned for exact ranges.
+  //
+  // This deliberately doesn't use intrinsics like Vec16NotEqual's SSE path above. That path was
+  // disabled because comparing as floats is wrong for some bit patterns, and an explicit SIMD
+  // version would need its own SSE2/AVX2/NEON variants plus CPU dispatch to match what memcmp
+  // already selects at runtime, for no gain on the pages that are identical.
+  const size_t blockSize = 4096;
+
+  for(size_t offs = 0; offs < bufSize; offs += blockSize)
+  {
+    size_t len = RDCMIN(blockSize, bufSize - offs);
+
+    if(memcmp(abyte + offs, bbyte + offs, len) != 0)
+      AddDiffRanges(abyte, bbyte, offs, offs + len, mergeGap, ranges);
+  }
+
+  return !ranges.empty();
+}
+
 uint32_t CalcNumMips(int w, int h, int d)
 {
   int mipLevels = 1;
@@ -296,6 +376,328 @@ uint64_t Log2Floor(uint64_t value)
 static string logfile;
 static bool logfileOpened = false;
 
+static bool log_output_enabled = false;
+
+// reads an atomic value with a full barrier, pairing with the CmpExch32 writes below
+static int32_t AtomicLoad32(volatile int32_t *val)
+{
+  return Atomic::CmpExch32(val, 0, 0);
+}
+
+// A bounded queue of formatted log lines. Any number of threads can push without locking, while
+// a single consumer at a time pops them in order. Each slot carries a sequence number that says
+// whether it's free for the producer claiming that position or holds a line for the consumer.
+class LogQueue
+{
+public:
+  static const uint32_t NumSlots = 1024;
+  static const size_t InlineSize = 256;
+
+  LogQueue()
+  {
+    for(uint32_t i = 0; i < NumSlots; i++)
+    {
+      m_Slots[i].seq = (int32_t)i;
+      m_Slots[i].heap = NULL;
+    }
+  }
+
+  // copies the line into the queue. Returns false without blocking if the queue is full.
+  bool Push(LogType type, const char *fullMsg, size_t length, size_t prefixLength)
+  {
+    uint32_t pos = (uint32_t)AtomicLoad32(&m_Head);
+    Slot *slot = NULL;
+
+    for(;;)
+    {
+      slot = &m_Slots[pos % NumSlots];
+      int32_t diff = int32_t((uint32_t)AtomicLoad32(&slot->seq) - pos);
+
+      if(diff == 0)
+      {
+        uint32_t prev = (uint32_t)Atomic::CmpExch32(&m_Head, (int32_t)pos, int32_t(pos + 1));
+        if(prev == pos)
+          break;
+        pos = prev;
+      }
+      else if(diff < 0)
+      {
+        // the consumer hasn't freed this slot from the previous lap yet
+        return false;
+      }
+      else
+      {
+        pos = (uint32_t)AtomicLoad32(&m_Head);
+      }
+    }
+
+    slot->type = type;
+    slot->length = (uint32_t)length;
+    slot->prefixLength = (uint32_t)prefixLength;
+
+    char *dst = slot->text;
+    if(length + 1 > InlineSize)
+      dst = slot->heap = new char[length + 1];
+    memcpy(dst, fullMsg, length);
+    dst[length] = 0;
+
+    Atomic::CmpExch32(&slot->seq, (int32_t)pos, int32_t(pos + 1));
+
+    return true;
+  }
+
+  // calls callback(type, fullMsg, length, msg) for each queued line, in order, until the queue is
+  // empty or the next line is still being written. Must only be called by one thread at a time.
+  template <typename Callback>
+  uint32_t Pop(Callback callback)
+  {
+    uint32_t count = 0;
+
+    for(;;)
+    {
+      Slot &slot = m_Slots[m_Tail % NumSlots];
+
+      if((uint32_t)AtomicLoad32(&slot.seq) != m_Tail + 1)
+        break;
+
+      const char *text = slot.heap ? slot.heap : slot.text;
+      callback(slot.type, text, (size_t)slot.length, text + slot.prefixLength);
+
+      SAFE_DELETE_ARRAY(slot.heap);
+
+      // hand the slot back to producers for the next lap
+      Atomic::CmpExch32(&slot.seq, int32_t(m_Tail + 1), int32_t(m_Tail + NumSlots));
+
+      m_Tail++;
+      count++;
+    }
+
+    return count;
+  }
+
+  bool Empty() { return (uint32_t)AtomicLoad32(&m_Slots[m_Tail % NumSlots].seq) != m_Tail + 1; }
+private:
+  struct Slot
+  {
+    volatile int32_t seq;
+    LogType type;
+    uint32_t length;
+    uint32_t prefixLength;
+    char *heap;
+    char text[InlineSize];
+  };
+
+  Slot m_Slots[NumSlots];
+
+  // the next position a producer will claim
+  volatile int32_t m_Head = 0;
+  // the next position to pop, only touched by the consumer
+  uint32_t m_Tail = 0;
+};
+
+// Log lines are queued and written by a background thread, so that logging doesn't block the
+// calling thread on the log file or debug output. rdclog_flush() writes anything queued
+// synchronously, which is done for errors, asserts and fatal errors so that nothing is lost if the
+// process is about to go down, and rdclog_crashflush() does the same from a crash handler.
+struct LogWriter
+{
+  LogQueue queue;
+
+  // held while popping lines and writing them out, so that output isn't interleaved
+  Threading::CriticalSection outputLock;
+
+  // lines dropped because the queue was full
+  volatile int32_t dropped = 0;
+
+  // the writer thread is waiting to be woken
+  volatile int32_t idle = 0;
+  volatile int32_t shutdown = 0;
+  Threading::Semaphore wake;
+
+  volatile int32_t threadStarted = 0;
+  Threading::ThreadHandle thread = 0;
+
+  // lines are accumulated here and written out together
+  std::string fileBatch, stdoutBatch;
+
+  // set while the lines are being written out. Anything logged while writing - e.g. an error from
+  // the file write - comes back in on the same thread through the recursive lock, and must not
+  // touch the batches mid-write.
+  bool writing = false;
+
+  // returns false without writing anything if called from within a write on this thread
+  bool WriteQueued();
+  void ThreadEntry();
+  void EnsureThread();
+};
+
+// never destroyed, as logging can happen during and after static destruction
+static LogWriter *volatile logWriter = NULL;
+
+// the process that logWriter belongs to, or its negative while a writer is being created for it
+static volatile int32_t logWriterPID = 0;
+
+static LogWriter &GetLogWriter()
+{
+  int32_t pid = (int32_t)Process::GetCurrentPID();
+
+  // on first use, and the first time in a forked child, create a writer. Only the forking thread is
+  // copied into a child, so a lock or queue slot that any other thread held at the time would never
+  // be released - the child starts over rather than using (or freeing) the parent's writer, and
+  // leaves the lines the parent queued for the parent to write.
+  while(AtomicLoad32(&logWriterPID) != pid)
+  {
+    int32_t cur = AtomicLoad32(&logWriterPID);
+
+    if(cur != -pid && Atomic::CmpExch32(&logWriterPID, cur, -pid) == cur)
+    {
+      logWriter = new LogWriter;
+      Atomic::CmpExch32(&logWriterPID, -pid, pid);
+    }
+    else
+    {
+      Threading::Sleep(0);
+    }
+  }
+
+  return *logWriter;
+}
+
+bool LogWriter::WriteQueued()
+{
+  SCOPED_LOCK(outputLock);
+
+  if(writing)
+    return false;
+
+  writing = true;
+
+  // if the batch gets large, write it out early to keep the memory bounded
+  const size_t maxBatchSize = 64 * 1024;
+
+  auto writeBatch = [this]() {
+#if ENABLED(OUTPUT_LOG_TO_DEBUG_OUT)
+    if(!fileBatch.empty())
+      OSUtility::WriteOutput(OSUtility::Output_DebugMon, fileBatch.c_str());
+#endif
+#if ENABLED(OUTPUT_LOG_TO_STDOUT)
+    if(!stdoutBatch.empty())
+      OSUtility::WriteOutput(OSUtility::Output_StdOut, stdoutBatch.c_str());
+#endif
+#if ENABLED(OUTPUT_LOG_TO_STDERR)
+    if(!stdoutBatch.empty())
+      OSUtility::WriteOutput(OSUtility::Output_StdErr, stdoutBatch.c_str());
+#endif
+#if ENABLED(OUTPUT_LOG_TO_DISK)
+    if(logfileOpened && !fileBatch.empty())
+      FileIO::logfile_append(fileBatch.c_str(), fileBatch.size());
+#endif
+
+    fileBatch.clear();
+    stdoutBatch.clear();
+  };
+
+  for(;;)
+  {
+    uint32_t count = queue.Pop([&](LogType type, const char *fullMsg, size_t length,
+                                   const char *msg) {
+      fileBatch.append(fullMsg, length);
+
+      // don't output debug messages to stdout/stderr
+      if(type != LogType::Debug && log_output_enabled)
+        stdoutBatch.append(msg);
+
+      if(fileBatch.size() >= maxBatchSize)
+        writeBatch();
+    });
+
+    int32_t numDropped = dropped;
+    if(numDropped > 0)
+    {
+      while(Atomic::CmpExch32(&dropped, numDropped, 0) != numDropped)
+        numDropped = dropped;
+
+      std::string msg =
+          StringFormat::Fmt("Log queue was full, %d messages were dropped", numDropped);
+#if ENABLED(RDOC_WIN32)
+      msg += "\r";
+#endif
+      msg += "\n";
+
+      fileBatch += msg;
+      if(log_output_enabled)
+        stdoutBatch += msg;
+    }
+
+    if(count == 0)
+      break;
+  }
+
+  writeBatch();
+
+  writing = false;
+
+  return true;
+}
+
+void LogWriter::ThreadEntry()
+{
+  while(AtomicLoad32(&shutdown) == 0)
+  {
+    WriteQueued();
+
+    // mark ourselves as idle before checking the queue, so that any line pushed after the check
+    // will see we need waking.
+    Atomic::CmpExch32(&idle, 0, 1);
+
+    if(queue.Empty() && AtomicLoad32(&shutdown) == 0)
+      wake.WaitForWake();
+
+    Atomic::CmpExch32(&idle, 1, 0);
+  }
+}
+
+void LogWriter::EnsureThread()
+{
+  // claimed before creating the thread, in case creating it logs anything
+  if(AtomicLoad32(&threadStarted) == 0 && Atomic::CmpExch32(&threadStarted, 0, 1) == 0)
+    thread = Threading::CreateThread([this]() { ThreadEntry(); });
+}
+
+static struct LogShutdown
+{
+  // at exit write anything still queued, then stop the writer thread. The wait for it is bounded,
+  // as it may be stuck writing or already have been killed - on windows threads are killed before
+  // static destructors run, but then the join returns immediately.
+  ~LogShutdown()
+  {
+    LogWriter &writer = GetLogWriter();
+
+    // if another thread was killed while writing, the lock will never be released
+    if(writer.outputLock.Trylock())
+    {
+      writer.WriteQueued();
+      writer.outputLock.Unlock();
+    }
+
+    Atomic::CmpExch32(&writer.shutdown, 0, 1);
+    writer.wake.Wake(1);
+
+    if(writer.thread && Threading::JoinThread(writer.thread, 500))
+    {
+      Threading::CloseThread(writer.thread);
+      writer.thread = 0;
+
+      // write anything logged while the thread was stopping
+      if(writer.outputLock.Trylock())
+      {
+        writer.WriteQueued();
+        writer.outputLock.Unlock();
+      }
+    }
+  }
+} logShutdown;
+
 const char *rdclog_getfilename()
 {
   return logfile.c_str();
@@ -303,6 +705,11 @@ const char *rdclog_getfilename()
 
 void rdclog_filename(const char *filename)
 {
+  // anything already logged goes to the old file before it's closed
+  rdclog_flush();
+
+  SCOPED_LOCK(GetLogWriter().outputLock);
+
   string previous = logfile;
 
   logfile = "";
@@ -330,8 +737,6 @@ void rdclog_filename(const char *filename)
   }
 }
 
-static bool log_output_enabled = false;
-
 void rdclog_enableoutput()
 {
   log_output_enabled = true;
@@ -339,44 +744,91 @@ void rdclog_enableoutput()
 
 void rdclog_closelog(const char *filename)
 {
+  rdclog_flush();
+
+  SCOPED_LOCK(GetLogWriter().outputLock);
+
   log_output_enabled = false;
   FileIO::logfile_close(filename);
 }
 
 void rdclog_flush()
 {
+  GetLogWriter().WriteQueued();
+}
+
+void rdclog_crashflush()
+{
+  LogWriter &writer = GetLogWriter();
+
+  // the writer thread may be in the middle of writing and will release the lock shortly, but the
+  // thread holding it might also be stopped for good by the crash. Only wait so long.
+  for(int i = 0; i < 100; i++)
+  {
+    if(writer.outputLock.Trylock())
+    {
+      writer.WriteQueued();
+      writer.outputLock.Unlock();
+      return;
+    }
+
+    Threading::Sleep(1);
+  }
 }
 
 void rdclogprint_int(LogType type, const char *fullMsg, const char *msg)
 {
-  static Threading::CriticalSection lock;
+  LogWriter &writer = GetLogWriter();
 
-  SCOPED_LOCK(lock);
+  writer.EnsureThread();
 
-#if ENABLED(OUTPUT_LOG_TO_DEBUG_OUT)
-  OSUtility::WriteOutput(OSUtility::Output_DebugMon, fullMsg);
-#endif
-#if ENABLED(OUTPUT_LOG_TO_STDOUT)
-  // don't output debug messages to stdout/stderr
-  if(type != LogType::Debug && log_output_enabled)
-    OSUtility::WriteOutput(OSUtility::Output_StdOut, msg);
-#endif
-#if ENABLED(OUTPUT_LOG_TO_STDERR)
-  // don't output debug messages to stdout/stderr
-  if(type != LogType::Debug && log_output_enabled)
-    OSUtility::WriteOutput(OSUtility::Output_StdErr, msg);
-#endif
-#if ENABLED(OUTPUT_LOG_TO_DISK)
-  if(logfileOpened)
+  size_t length = strlen(fullMsg);
+
+  // msg is always a suffix of fullMsg
+  size_t prefixLength = length - RDCMIN(length, strlen(msg));
+
+  if(!writer.queue.Push(type, fullMsg, length, prefixLength))
   {
-    // strlen used as byte length - str is UTF-8 so this is NOT number of characters
-    FileIO::logfile_append(fullMsg, strlen(fullMsg));
+    if(type == LogType::Error || type == LogType::Fatal)
+    {
+      // never drop errors - write out the queue ourselves until there's room. If this error came
+      // from within a write on this thread, the queue can't be written, so drop it after all.
+      do
+      {
+        if(!writer.WriteQueued())
+        {
+          Atomic::Inc32(&writer.dropped);
+          return;
+        }
+      } while(!writer.queue.Push(type, fullMsg, length, prefixLength));
+    }
+    else
+    {
+      // if nothing is writing right now, write out the queue ourselves rather than waiting for the
+      // writer thread. Otherwise drop the line rather than block.
+      bool pushed = false;
+
+      if(writer.outputLock.Trylock())
+      {
+        writer.WriteQueued();
+        writer.outputLock.Unlock();
+
+        pushed = writer.queue.Push(type, fullMsg, length, prefixLength);
+      }
+
+      if(!pushed)
+      {
+        Atomic::Inc32(&writer.dropped);
+        return;
+      }
+    }
   }
-#endif
+
+  if(AtomicLoad32(&writer.idle) == 1 && Atomic::CmpExch32(&writer.idle, 1, 0) == 1)
+    writer.wake.Wake(1);
 }
 
 const int rdclog_outBufSize = 4 * 1024;
-static char rdclog_outputBuffer[rdclog_outBufSize + 3];
 
 static void write_newline(char *output)
 {
@@ -413,9 +865,8 @@ void rdclog_int(LogType type, const char *project, const char *file, unsigned in
       "Debug  ", "Log    ", "Warning", "Error  ", "Fatal  ",
   };
 
-  static Threading::CriticalSection lock;
-
-  SCOPED_LOCK(lock);
+  // each thread formats into its own buffer, the line is copied into the log queue when printed
+  char rdclog_outputBuffer[rdclog_outBufSize + 3];
 
   rdclog_outputBuffer[rdclog_outBufSize] = rdclog_outputBuffer[0] = 0;
 
@@ -524,3 +975,335 @@ void rdclog_int(LogType type, const char *project, const char *file, unsigned in
 
   SAFE_DELETE_ARRAY(oversizedBuffer);
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "3rdparty/catch/catch.hpp"
+#include "common/timing.h"
+
+TEST_CASE("Find multiple diff ranges", "[diff]")
+{
+  const size_t size = 64 * 1024 + 13;
+
+  byte *a = AllocAlignedBuffer(size);
+  byte *b = AllocAlignedBuffer(size);
+
+  for(size_t i = 0; i < size; i++)
+    a[i] = b[i] = byte((i * 31) & 0xff);
+
+  rdcarray<rdcpair<size_t, size_t>> ranges;
+
+  SECTION("Identical buffers")
+  {
+    CHECK_FALSE(FindDiffRanges(a, b, size, 0, ranges));
+    CHECK(ranges.empty());
+  }
+
+  SECTION("Sparse writes at each end")
+  {
+    b[3]++;
+    b[size - 1]++;
+
+    REQUIRE(FindDiffRanges(a, b, size, 0, ranges));
+    REQUIRE(ranges.size() == 2);
+    CHECK(ranges[0].first == 3);
+    CHECK(ranges[0].second == 4);
+    CHECK(ranges[1].first == size - 1);
+    CHECK(ranges[1].second == size);
+
+    // the single range covers both
+    size_t start = 0, end = 0;
+    REQUIRE(FindDiffRange(a, b, size, start, end));
+    CHECK(start == 3);
+    CHECK(end == size);
+
+    // with a big enough gap they merge
+    REQUIRE(FindDiffRanges(a, b, size, size, ranges));
+    REQUIRE(ranges.size() == 1);
+    CHECK(ranges[0].first == 3);
+    CHECK(ranges[0].second == size);
+  }
+
+  SECTION("Ranges are byte exact and merged within the gap")
+  {
+    // a run crossing a page boundary
+    for(size_t i = 4090; i < 4110; i++)
+      b[i] ^= 0xff;
+
+    // two writes 8 bytes apart, which merge with a gap of 8
+    b[10000]++;
+    b[10009]++;
+
+    // and one further away that doesn't
+    b[10100]++;
+
+    REQUIRE(FindDiffRanges(a, b, size, 8, ranges));
+    REQUIRE(ranges.size() == 3);
+    CHECK(ranges[0].first == 4090);
+    CHECK(ranges[0].second == 4110);
+    CHECK(ranges[1].first == 10000);
+    CHECK(ranges[1].second == 10010);
+    CHECK(ranges[2].first == 10100);
+    CHECK(ranges[2].second == 10101);
+
+    REQUIRE(FindDiffRanges(a, b, size, 0, ranges));
+    REQUIRE(ranges.size() == 4);
+    CHECK(ranges[1].first == 10000);
+    CHECK(ranges[1].second == 10001);
+    CHECK(ranges[2].first == 10009);
+    CHECK(ranges[2].second == 10010);
+  }
+
+  SECTION("Every byte differs")
+  {
+    for(size_t i = 0; i < size; i++)
+      b[i] = ~a[i];
+
+    REQUIRE(FindDiffRanges(a, b, size, 0, ranges));
+    REQUIRE(ranges.size() == 1);
+    CHECK(ranges[0].first == 0);
+    CHECK(ranges[0].second == size);
+  }
+
+  FreeAlignedBuffer(a);
+  FreeAlignedBuffer(b);
+};
+
+TEST_CASE("Log queue", "[log]")
+{
+  // the queue is large, so don't put it on the stack
+  LogQueue *queue = new LogQueue;
+
+  struct Line
+  {
+    LogType type;
+    std::string full, msg;
+  };
+  std::vector<Line> lines;
+
+  auto collect = [&lines](LogType type, const char *fullMsg, size_t length, const char *msg) {
+    lines.push_back({type, std::string(fullMsg, length), msg});
+  };
+
+  SECTION("Lines are popped in order")
+  {
+    std::string longLine(LogQueue::InlineSize * 3, 'x');
+
+    CHECK(queue->Push(LogType::Comment, "prefix - hello\n", 15, 9));
+    CHECK(queue->Push(LogType::Warning, longLine.c_str(), longLine.size(), 0));
+    CHECK(queue->Push(LogType::Debug, "", 0, 0));
+
+    CHECK_FALSE(queue->Empty());
+    CHECK(queue->Pop(collect) == 3);
+    CHECK(queue->Empty());
+    CHECK(queue->Pop(collect) == 0);
+
+    REQUIRE(lines.size() == 3);
+    CHECK(bool(lines[0].type == LogType::Comment));
+    CHECK(lines[0].full == "prefix - hello\n");
+    CHECK(lines[0].msg == "hello\n");
+    CHECK(bool(lines[1].type == LogType::Warning));
+    CHECK(lines[1].full == longLine);
+    CHECK(lines[1].msg == longLine);
+    CHECK(bool(lines[2].type == LogType::Debug));
+    CHECK(lines[2].full.empty());
+  }
+
+  SECTION("Full queue doesn't block")
+  {
+    for(uint32_t i = 0; i < LogQueue::NumSlots; i++)
+      CHECK(queue->Push(LogType::Comment, "a", 1, 0));
+
+    CHECK_FALSE(queue->Push(LogType::Comment, "b", 1, 0));
+
+    CHECK(queue->Pop(collect) == uint32_t(LogQueue::NumSlots));
+
+    // the slots can be re-used after popping, across several laps
+    for(uint32_t i = 0; i < LogQueue::NumSlots * 3; i++)
+    {
+      std::string str = StringFormat::Fmt("%u", i);
+      CHECK(queue->Push(LogType::Comment, str.c_str(), str.size(), 0));
+      CHECK(queue->Pop(collect) == 1);
+      CHECK(lines.back().full == str);
+    }
+  }
+
+  SECTION("Concurrent producers")
+  {
+    const int numThreads = 4;
+    const int linesPerThread = 20000;
+
+    std::vector<Threading::ThreadHandle> threads;
+    volatile int32_t done = 0;
+
+    for(int t = 0; t < numThreads; t++)
+    {
+      threads.push_back(Threading::CreateThread([queue, t, &done]() {
+        for(int i = 0; i < linesPerThread; i++)
+        {
+          std::string str = StringFormat::Fmt("%d %d", t, i);
+          // spin while the queue is full, the consumer will catch up
+          while(!queue->Push(LogType::Comment, str.c_str(), str.size(), 0))
+            Threading::Sleep(0);
+        }
+
+        Atomic::Inc32(&done);
+      }));
+    }
+
+    while(AtomicLoad32(&done) < numThreads || !queue->Empty())
+      queue->Pop(collect);
+
+    for(Threading::ThreadHandle th : threads)
+    {
+      Threading::JoinThread(th);
+      Threading::CloseThread(th);
+    }
+
+    REQUIRE(lines.size() == size_t(numThreads * linesPerThread));
+
+    // every line arrives exactly once, and each thread's lines are in order
+    int next[numThreads] = {};
+    for(const Line &l : lines)
+    {
+      int t = -1, i = -1;
+      sscanf(l.full.c_str(), "%d %d", &t, &i);
+
+      REQUIRE(t >= 0);
+      REQUIRE(t < numThreads);
+      CHECK(i == next[t]);
+      next[t] = i + 1;
+    }
+  }
+
+  delete queue;
+}
+
+#if ENABLED(RDOC_POSIX)
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+TEST_CASE("Log writer in a forked child", "[log]")
+{
+  LogWriter &writer = GetLogWriter();
+
+  // hold the parent's output lock on another thread across the fork, as if it was mid-write
+  volatile int32_t locked = 0, release = 0;
+
+  Threading::ThreadHandle th = Threading::CreateThread([&writer, &locked, &release]() {
+    writer.outputLock.Lock();
+    Atomic::Inc32(&locked);
+
+    while(AtomicLoad32(&release) == 0)
+      Threading::Sleep(1);
+
+    writer.outputLock.Unlock();
+  });
+
+  while(AtomicLoad32(&locked) == 0)
+    Threading::Sleep(1);
+
+  pid_t child = fork();
+
+  if(child == 0)
+  {
+    // the child gets its own writer, so neither of these waits on the lock that will never be
+    // released here
+    RDCLOG("Logging from forked child");
+    rdclog_flush();
+
+    _exit(&GetLogWriter() != &writer ? 0 : 1);
+  }
+
+  REQUIRE(child > 0);
+
+  int status = -1;
+  bool exited = false;
+  for(int i = 0; i < 1000 && !exited; i++)
+  {
+    exited = (waitpid(child, &status, WNOHANG) == child);
+    if(!exited)
+      Threading::Sleep(10);
+  }
+
+  if(!exited)
+  {
+    kill(child, SIGKILL);
+    waitpid(child, &status, 0);
+  }
+
+  Atomic::Inc32(&release);
+  Threading::JoinThread(th);
+  Threading::CloseThread(th);
+
+  CHECK(exited);
+  CHECK(WIFEXITED(status));
+  CHECK(WEXITSTATUS(status) == 0);
+}
+
+#endif
+
+TEST_CASE("Benchmark diff ranges on mapped buffers", "[.][benchmark][diff]")
+{
+  const size_t size = 256 * 1024 * 1024;
+
+  byte *a = AllocAlignedBuffer(size);
+  byte *b = AllocAlignedBuffer(size);
+
+  for(size_t i = 0; i < size; i++)
+    a[i] = b[i] = byte((i * 31) & 0xff);
+
+  rdcarray<rdcpair<size_t, size_t>> ranges;
+  size_t start = 0, end = 0;
+
+  struct Pattern
+  {
+    const char *name;
+    size_t stride;
+    size_t length;
+  };
+
+  // a write at each end, scattered small writes, and one dense write over a sixteenth
+  const Pattern patterns[] = {
+      {"identical", 0, 0},
+      {"each end", size - 64, 64},
+      {"scattered 64B per MB", 1024 * 1024, 64},
+      {"dense 16MB", size, 16 * 1024 * 1024},
+  };
+
+  for(const Pattern &p : patterns)
+  {
+    memcpy(b, a, size);
+
+    if(p.stride > 0)
+      for(size_t offs = 0; offs + p.length <= size; offs += p.stride)
+        memset(b + offs, 0, p.length);
+
+    PerformanceTimer timer;
+
+    FindDiffRange(a, b, size, start, end);
+
+    double singleMS = timer.GetMilliseconds();
+
+    timer.Restart();
+
+    FindDiffRanges(a, b, size, 4096, ranges);
+
+    double multiMS = timer.GetMilliseconds();
+
+    uint64_t multiBytes = 0;
+    for(const rdcpair<size_t, size_t> &r : ranges)
+      multiBytes += r.second - r.first;
+
+    RDCLOG("%s: single range %.1f ms covering %llu bytes, %u ranges %.1f ms covering %llu bytes",
+           p.name, singleMS, end > start ? uint64_t(end - start) : 0ULL, (uint32_t)ranges.size(),
+           multiMS, multiBytes);
+  }
+
+  FreeAlignedBuffer(a);
+  FreeAlignedBuffer(b);
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -156,6 +156,10 @@ inline T AlignUpPtr(T x, A a)
   (((uint32_t)(d) << 24) | ((uint32_t)(c) << 16) | ((uint32_t)(b) << 8) | (uint32_t)(a))
 
 bool FindDiffRange(void *a, void *b, size_t bufSize, size_t &diffStart, size_t &diffEnd);
+// finds every [start, end) byte range where a and b differ. Ranges separated by no more than
+// mergeGap identical bytes are merged into one. Returns true if any differences were found.
+bool FindDiffRanges(const void *a, const void *b, size_t bufSize, size_t mergeGap,
+                    rdcarray<rdcpair<size_t, size_t>> &ranges);
 uint32_t CalcNumMips(int Width, int Height, int Depth);
 
 byte *AllocAlignedBuffer(uint64_t size, uint64_t alignment = 64);
@@ -286,6 +290,9 @@ struct BucketForRecord<T, BucketRecordType::Pow2>
 #else
 // perform any operations necessary to flush the log
 void rdclog_flush();
+// as above, but safe to call from a crash handler - it gives up rather than waiting indefinitely
+// for another thread that's writing the log
+void rdclog_crashflush();
 
 // actual low-level print to log output streams defined (useful for if we need to print
 // fatal error messages from within the more complex log function).
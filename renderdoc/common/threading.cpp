@@ -0,0 +1,126 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "common.h"
+#include "threading.h"
+
+namespace Threading
+{
+struct ThreadPool::Job
+{
+  std::function<void()> callback;
+  Semaphore complete;
+};
+
+ThreadPool::ThreadPool(uint32_t numThreads)
+{
+  m_Threads.reserve(numThreads);
+  for(uint32_t i = 0; i < numThreads; i++)
+  {
+    ThreadHandle thread = CreateThread([this]() { WorkerThread(); });
+    if(thread == 0)
+    {
+      RDCERR("Couldn't create worker thread %u of %u", i, numThreads);
+      break;
+    }
+    m_Threads.push_back(thread);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  // workers finish off anything still queued before they see the shutdown flag
+  Atomic::Inc32(&m_Shutdown);
+  m_QueueSignal.Wake((uint32_t)m_Threads.size());
+
+  for(ThreadHandle t : m_Threads)
+  {
+    JoinThread(t);
+    CloseThread(t);
+  }
+}
+
+ThreadPool::Job *ThreadPool::AddJob(std::function<void()> callback)
+{
+  Job *job = new Job;
+
+  // with no worker threads, run the job immediately so that waiting on it is a no-op.
+  if(m_Threads.empty())
+  {
+    callback();
+    job->complete.Wake(1);
+    return job;
+  }
+
+  job->callback = callback;
+
+  {
+    SCOPED_LOCK(m_QueueLock);
+    m_Queue.push_back(job);
+  }
+
+  m_QueueSignal.Wake(1);
+
+  return job;
+}
+
+void ThreadPool::WaitForJob(Job *job)
+{
+  if(!job)
+    return;
+
+  job->complete.WaitForWake();
+  delete job;
+}
+
+void ThreadPool::WorkerThread()
+{
+  for(;;)
+  {
+    m_QueueSignal.WaitForWake();
+
+    Job *job = NULL;
+
+    {
+      SCOPED_LOCK(m_QueueLock);
+      if(!m_Queue.empty())
+      {
+        job = m_Queue.front();
+        m_Queue.pop_front();
+      }
+    }
+
+    // each wake corresponds to one job, or to the shutdown, so an empty queue means we're done.
+    if(job == NULL)
+    {
+      if(Atomic::CmpExch32(&m_Shutdown, 0, 0) != 0)
+        return;
+      continue;
+    }
+
+    job->callback();
+    job->complete.Wake(1);
+  }
+}
+};
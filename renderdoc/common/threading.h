@@ -25,6 +25,8 @@
 
 #pragma once
 
+#include <deque>
+#include <vector>
 #include "os/os_specific.h"
 
 namespace Threading
@@ -89,6 +91,39 @@ public:
 private:
   SpinLock *m_Spin;
 };
+
+// A fixed set of worker threads that execute independent jobs in the order they were added. Each
+// job returned from AddJob must be passed to WaitForJob exactly once, which blocks until it has
+// run and then releases it.
+// Jobs must not wait on other jobs from the same pool, as every worker could end up blocked.
+class ThreadPool
+{
+public:
+  struct Job;
+
+  // with 0 threads, jobs are executed immediately on the thread that adds them
+  ThreadPool(uint32_t numThreads);
+  ~ThreadPool();
+
+  uint32_t NumThreads() const { return (uint32_t)m_Threads.size(); }
+  Job *AddJob(std::function<void()> callback);
+  void WaitForJob(Job *job);
+
+  // no copying
+  ThreadPool &operator=(const ThreadPool &other) = delete;
+  ThreadPool(const ThreadPool &other) = delete;
+
+private:
+  void WorkerThread();
+
+  std::vector<ThreadHandle> m_Threads;
+
+  CriticalSection m_QueueLock;
+  std::deque<Job *> m_Queue;
+  Semaphore m_QueueSignal;
+
+  volatile int32_t m_Shutdown = 0;
+};
 };
 
 #define SCOPED_LOCK(cs) Threading::ScopedLock CONCAT(scopedlock, __LINE__)(&cs);
@@ -23,10 +23,12 @@
  ******************************************************************************/
 
 #include "common/threading.h"
+#include "common/wrapped_pool.h"
 #include "os/os_specific.h"
 
 #if ENABLED(ENABLE_UNIT_TESTS)
 
+#include <algorithm>
 #include "3rdparty/catch/catch.hpp"
 
 static int value = 0;
@@ -71,4 +73,249 @@ TEST_CASE("Test spin lock", "[threading]")
   CHECK(finalValue == value);
 }
 
+TEST_CASE("Test thread pool", "[threading]")
+{
+  SECTION("Jobs all run and can be waited on in any order")
+  {
+    Threading::ThreadPool pool(4);
+
+    CHECK(pool.NumThreads() == 4);
+
+    std::vector<int32_t> results;
+    results.resize(1000);
+
+    std::vector<Threading::ThreadPool::Job *> jobs;
+
+    for(int32_t i = 0; i < 1000; i++)
+      jobs.push_back(pool.AddJob([&results, i]() { results[i] = i * 3; }));
+
+    // wait on the back half first
+    for(size_t i = 500; i < 1000; i++)
+      pool.WaitForJob(jobs[i]);
+    for(size_t i = 0; i < 500; i++)
+      pool.WaitForJob(jobs[i]);
+
+    for(int32_t i = 0; i < 1000; i++)
+      CHECK(results[i] == i * 3);
+  };
+
+  SECTION("Pool with no threads runs jobs immediately")
+  {
+    Threading::ThreadPool pool(0);
+
+    CHECK(pool.NumThreads() == 0);
+
+    int result = 0;
+    Threading::ThreadPool::Job *job = pool.AddJob([&result]() { result = 5; });
+    CHECK(result == 5);
+    pool.WaitForJob(job);
+  };
+
+  SECTION("Jobs run concurrently")
+  {
+    Threading::ThreadPool pool(4);
+
+    volatile int32_t running = 0;
+    volatile int32_t maxRunning = 0;
+
+    std::vector<Threading::ThreadPool::Job *> jobs;
+
+    for(int i = 0; i < 16; i++)
+    {
+      jobs.push_back(pool.AddJob([&running, &maxRunning]() {
+        int32_t cur = Atomic::Inc32(&running);
+        int32_t prevMax = maxRunning;
+        while(cur > prevMax)
+        {
+          Atomic::CmpExch32(&maxRunning, prevMax, cur);
+          prevMax = maxRunning;
+        }
+        Threading::Sleep(20);
+        Atomic::Dec32(&running);
+      }));
+    }
+
+    for(Threading::ThreadPool::Job *job : jobs)
+      pool.WaitForJob(job);
+
+    CHECK(maxRunning > 1);
+    CHECK(maxRunning <= 4);
+  };
+}
+
+struct PoolTestObject
+{
+  uint64_t owner;
+  uint64_t index;
+
+  static int32_t NumAdditionalPools() { return m_Pool.m_NumAdditionalPools; }
+  static size_t NumThreadCaches() { return m_Pool.m_ThreadCaches.size(); }
+  // a tiny pool so the stress tests spill into plenty of additional pools
+  ALLOCATE_WITH_WRAPPED_POOL(PoolTestObject, 64);
+};
+
+WRAPPED_POOL_INST(PoolTestObject);
+
+TEST_CASE("Test wrapping pool", "[threading][pool]")
+{
+  const int numThreads = 8;
+  const int numObjects = 1500;
+
+  SECTION("Concurrent allocations are unique and owned")
+  {
+    std::vector<Threading::ThreadHandle> threads;
+    std::vector<std::vector<PoolTestObject *>> objects;
+    std::vector<int> failures;
+
+    threads.resize(numThreads);
+    objects.resize(numThreads);
+    failures.resize(numThreads);
+
+    for(int i = 0; i < numThreads; i++)
+    {
+      threads[i] = Threading::CreateThread([&objects, &failures, i, numObjects]() {
+        std::vector<PoolTestObject *> &objs = objects[i];
+
+        for(int round = 0; round < 3; round++)
+        {
+          for(int j = 0; j < numObjects; j++)
+          {
+            PoolTestObject *obj = new PoolTestObject;
+            obj->owner = i;
+            obj->index = objs.size();
+            objs.push_back(obj);
+
+            if(!PoolTestObject::IsAlloc(obj))
+              failures[i]++;
+          }
+
+          // free every other object, so the next round reuses slots from this thread's cache as
+          // well as from the shared pools
+          std::vector<PoolTestObject *> kept;
+          for(size_t j = 0; j < objs.size(); j++)
+          {
+            if(j & 1)
+            {
+              delete objs[j];
+            }
+            else
+            {
+              if(objs[j]->owner != (uint64_t)i || objs[j]->index != j)
+                failures[i]++;
+              objs[j]->index = kept.size();
+              kept.push_back(objs[j]);
+            }
+          }
+          objs.swap(kept);
+        }
+      });
+    }
+
+    for(Threading::ThreadHandle t : threads)
+    {
+      Threading::JoinThread(t);
+      Threading::CloseThread(t);
+    }
+
+    std::vector<PoolTestObject *> all;
+
+    for(int i = 0; i < numThreads; i++)
+    {
+      CHECK(failures[i] == 0);
+
+      for(size_t j = 0; j < objects[i].size(); j++)
+      {
+        CHECK(objects[i][j]->owner == (uint64_t)i);
+        CHECK(objects[i][j]->index == j);
+        all.push_back(objects[i][j]);
+      }
+    }
+
+    std::sort(all.begin(), all.end());
+    CHECK((std::adjacent_find(all.begin(), all.end()) == all.end()));
+
+    for(PoolTestObject *obj : all)
+      delete obj;
+  };
+
+  SECTION("Objects can be freed on a different thread")
+  {
+    std::vector<std::vector<PoolTestObject *>> objects;
+    objects.resize(numThreads);
+
+    std::vector<Threading::ThreadHandle> threads;
+    threads.resize(numThreads);
+
+    int32_t poolsBefore = 0;
+    size_t cachesBefore = PoolTestObject::NumThreadCaches();
+
+    for(int round = 0; round < 2; round++)
+    {
+      for(int i = 0; i < numThreads; i++)
+      {
+        threads[i] = Threading::CreateThread([&objects, i, numObjects]() {
+          for(int j = 0; j < numObjects; j++)
+            objects[i].push_back(new PoolTestObject);
+        });
+      }
+
+      for(Threading::ThreadHandle t : threads)
+      {
+        Threading::JoinThread(t);
+        Threading::CloseThread(t);
+      }
+
+      std::vector<PoolTestObject *> all;
+      for(int i = 0; i < numThreads; i++)
+        all.insert(all.end(), objects[i].begin(), objects[i].end());
+
+      std::sort(all.begin(), all.end());
+      CHECK((std::adjacent_find(all.begin(), all.end()) == all.end()));
+
+      if(round == 0)
+        poolsBefore = PoolTestObject::NumAdditionalPools();
+
+      // each thread frees the objects that a different thread allocated
+      for(int i = 0; i < numThreads; i++)
+      {
+        threads[i] = Threading::CreateThread([&objects, i, numThreads]() {
+          for(PoolTestObject *obj : objects[(i + 1) % numThreads])
+            delete obj;
+        });
+      }
+
+      for(Threading::ThreadHandle t : threads)
+      {
+        Threading::JoinThread(t);
+        Threading::CloseThread(t);
+      }
+
+      for(int i = 0; i < numThreads; i++)
+        objects[i].clear();
+    }
+
+    // exiting threads return their cached slots, so the second round reuses all of the freed slots
+    // and no thread's cache is left behind
+    CHECK(PoolTestObject::NumAdditionalPools() == poolsBefore);
+    CHECK(PoolTestObject::NumThreadCaches() == cachesBefore);
+  };
+
+  SECTION("Pointers outside the pool aren't owned")
+  {
+    PoolTestObject local;
+    PoolTestObject *heap = (PoolTestObject *)malloc(sizeof(PoolTestObject));
+
+    CHECK_FALSE(PoolTestObject::IsAlloc(&local));
+    CHECK_FALSE(PoolTestObject::IsAlloc(heap));
+    CHECK_FALSE(PoolTestObject::IsAlloc(NULL));
+
+    free(heap);
+
+    PoolTestObject *obj = new PoolTestObject;
+    CHECK(PoolTestObject::IsAlloc(obj));
+    CHECK(PoolTestObject::IsAlloc(&obj->index));
+    delete obj;
+  };
+}
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
\ No newline at end of file
@@ -27,6 +27,7 @@
 
 #include <stdint.h>
 #include <string.h>
+#include <algorithm>
 #include "common.h"
 #include "threading.h"
 
@@ -48,65 +49,38 @@ public:
   typedef C Type;
 };
 
-// allocate each class in its own pool so we can identify the type by the pointer
+// allocate each class in its own pool so we can identify the type by the pointer.
+//
+// Each thread keeps a small cache of free slots so that Allocate and Deallocate only take the lock
+// when the cache needs refilling or flushing, and returns them when it exits. Ownership is checked in O(1) without locking: the
+// immediate pool is a single range check, and any additional pools are found through a hash table
+// keyed on the address divided by the (power of two rounded) pool size.
 template <typename WrapType, int PoolCount = 8192, int MaxPoolByteSize = 1024 * 1024, bool DebugClear = true>
 class WrappingPool
 {
 public:
   void *Allocate()
   {
-    SCOPED_LOCK(m_Lock);
+    ThreadCache *cache = GetThreadCache();
 
-    // try and allocate from immediate pool
-    void *ret = m_ImmediatePool.Allocate();
-    if(ret != NULL)
-      return ret;
+    if(cache->count == 0)
+      Refill(cache);
 
-    // fall back to additional pools, if there are any
-    for(size_t i = 0; i < m_AdditionalPools.size(); i++)
-    {
-      ret = m_AdditionalPools[i]->Allocate();
-      if(ret != NULL)
-        return ret;
-    }
-
-// warn when we need to allocate an additional pool
-#if ENABLED(INCLUDE_TYPE_NAMES)
-    RDCWARN("Ran out of free slots in %s pool!", GetTypeName<WrapType>::Name());
-#else
-    RDCWARN("Ran out of free slots in pool 0x%p!", &m_ImmediatePool.items[0]);
-#endif
+    void *ret = cache->items[--cache->count];
 
-    // allocate a new additional pool and use that to allocate from
-    m_AdditionalPools.push_back(new ItemPool());
-
-#if ENABLED(INCLUDE_TYPE_NAMES)
-    RDCDEBUG("WrappingPool[%d]<%s>: %p -> %p", (uint32_t)m_AdditionalPools.size() - 1,
-             GetTypeName<WrapType>::Name(), &m_AdditionalPools.back()->items[0],
-             &m_AdditionalPools.back()->items[AllocCount - 1]);
+#if ENABLED(RDOC_DEVEL)
+    memset(ret, 0xb0, AllocByteSize);
 #endif
 
-    return m_AdditionalPools.back()->Allocate();
+    return ret;
   }
 
-  bool IsAlloc(const void *p)
+  bool IsAlloc(const void *p) const
   {
-    // we can check the immediate pool without locking
     if(m_ImmediatePool.IsAlloc(p))
       return true;
 
-    // if we have additional pools, lock and check them.
-    // TODO: Check for additional pools in a lock-free manner,
-    // to prevent the cost of locking if there are no more pools.
-    {
-      SCOPED_LOCK(m_Lock);
-
-      for(size_t i = 0; i < m_AdditionalPools.size(); i++)
-        if(m_AdditionalPools[i]->IsAlloc(p))
-          return true;
-    }
-
-    return false;
+    return FindAdditionalPool(p) != NULL;
   }
 
   void Deallocate(void *p)
@@ -114,35 +88,30 @@ public:
     if(p == NULL)
       return;
 
-    SCOPED_LOCK(m_Lock);
-
-    // try immediate pool
-    if(m_ImmediatePool.IsAlloc(p))
-    {
-      m_ImmediatePool.Deallocate(p);
-      return;
-    }
-    else if(!m_AdditionalPools.empty())
+    if(!IsAlloc(p))
     {
-      // fall back and try additional pools
-      for(size_t i = 0; i < m_AdditionalPools.size(); i++)
-      {
-        if(m_AdditionalPools[i]->IsAlloc(p))
-        {
-          m_AdditionalPools[i]->Deallocate(p);
-          return;
-        }
-      }
-    }
-
 // this is an error - deleting an object that we don't recognise
 #if ENABLED(INCLUDE_TYPE_NAMES)
-    RDCERR("Resource being deleted through wrong pool - 0x%p not a member of %s", p,
-           GetTypeName<WrapType>::Name());
+      RDCERR("Resource being deleted through wrong pool - 0x%p not a member of %s", p,
+             GetTypeName<WrapType>::Name());
 #else
-    RDCERR("Resource being deleted through wrong pool - 0x%p not a member of 0x%p", p,
-           &m_ImmediatePool.items[0]);
+      RDCERR("Resource being deleted through wrong pool - 0x%p not a member of 0x%p", p,
+             &m_ImmediatePool.items[0]);
 #endif
+      return;
+    }
+
+#if ENABLED(RDOC_DEVEL)
+    if(DebugClear)
+      memset(p, 0xfe, AllocByteSize);
+#endif
+
+    ThreadCache *cache = GetThreadCache();
+
+    if(cache->count == ThreadCacheSize)
+      Flush(cache, ThreadCacheSize / 2);
+
+    cache->items[cache->count++] = p;
   }
 
   static const size_t AllocCount = PoolCount;
@@ -152,6 +121,12 @@ public:
 private:
   WrappingPool()
   {
+    m_CacheSlot = Threading::AllocateTLSSlot(&ThreadExit);
+
+    // granules are the smallest power of two that is at least as large as a pool
+    while((size_t(1) << m_GranuleShift) < AllocCount * AllocByteSize)
+      m_GranuleShift++;
+
 #if ENABLED(INCLUDE_TYPE_NAMES)
     // hack - print in kB because float printing relies on statics that might not be initialised
     // yet in loading order. Ugly :(
@@ -162,13 +137,36 @@ private:
   }
   ~WrappingPool()
   {
-    for(size_t i = 0; i < m_AdditionalPools.size(); i++)
+    // detach the caches from every thread first, so threads that are still running don't use them
+    // or hand them to ThreadExit once they're deleted
+    Threading::FreeTLSSlot(m_CacheSlot);
+
+    for(size_t i = 0; i < m_ThreadCaches.size(); i++)
+      delete m_ThreadCaches[i];
+
+    m_ThreadCaches.clear();
+
+    for(int32_t i = 0; i < m_NumAdditionalPools; i++)
       delete m_AdditionalPools[i];
 
-    m_AdditionalPools.clear();
+    delete[] m_AdditionalPools;
+    delete[] m_PoolLookup;
   }
 
-  Threading::CriticalSection m_Lock;
+  // how many free slots each thread can hold on to
+  static const int ThreadCacheSize = 64;
+
+  // the most additional pools we can track in the lookup table, and the table size - each pool is
+  // inserted twice since it can straddle two granules, and we keep the load factor at or under 50%.
+  static const int32_t MaxAdditionalPools = 1024;
+  static const uint32_t LookupSize = MaxAdditionalPools * 4;
+
+  struct ThreadCache
+  {
+    WrappingPool *owner = NULL;
+    void *items[ThreadCacheSize];
+    int count = 0;
+  };
 
   struct ItemPool
   {
@@ -194,36 +192,17 @@ private:
         return NULL;
       }
       --freeStackHead;
-      void *ret = items + freeStack[freeStackHead];
-
-#if ENABLED(RDOC_DEVEL)
-      memset(ret, 0xb0, AllocByteSize);
-#endif
-
-      return ret;
+      return items + freeStack[freeStackHead];
     }
 
     void Deallocate(void *p)
     {
       RDCASSERT(IsAlloc(p));
 
-#if ENABLED(RDOC_DEVEL)
-      if(!IsAlloc(p))
-      {
-        RDCERR("Resource being deleted through wrong pool - 0x%p not a memory of 0x%p", p, &items[0]);
-        return;
-      }
-#endif
-
       int idx = (int)((WrapType *)p - &items[0]);
 
       freeStack[freeStackHead] = idx;
       ++freeStackHead;
-
-#if ENABLED(RDOC_DEVEL)
-      if(DebugClear)
-        memset(p, 0xfe, AllocByteSize);
-#endif
     }
 
     bool IsAlloc(const void *p) const { return p >= &items[0] && p < &items[PoolCount]; }
@@ -232,8 +211,191 @@ private:
     int freeStackHead;
   };
 
+  ThreadCache *GetThreadCache()
+  {
+    ThreadCache *cache = (ThreadCache *)Threading::GetTLSValue(m_CacheSlot);
+
+    if(cache == NULL)
+    {
+      cache = new ThreadCache();
+      cache->owner = this;
+      Threading::SetTLSValue(m_CacheSlot, cache);
+
+      SCOPED_LOCK(m_Lock);
+      m_ThreadCaches.push_back(cache);
+    }
+
+    return cache;
+  }
+
+  // return an exiting thread's cached slots to the pools, and drop its cache
+  static void ThreadExit(void *value)
+  {
+    ThreadCache *cache = (ThreadCache *)value;
+    WrappingPool *pool = cache->owner;
+
+    if(cache->count > 0)
+      pool->Flush(cache, cache->count);
+
+    {
+      SCOPED_LOCK(pool->m_Lock);
+      pool->m_ThreadCaches.erase(
+          std::find(pool->m_ThreadCaches.begin(), pool->m_ThreadCaches.end(), cache));
+    }
+
+    delete cache;
+  }
+
+  // pool index 0 is the immediate pool, the rest index into m_AdditionalPools
+  ItemPool *GetPool(int32_t idx)
+  {
+    return idx == 0 ? &m_ImmediatePool : m_AdditionalPools[idx - 1];
+  }
+
+  // grab up to half a cache worth of free slots, starting from the first pool that might have any
+  void Refill(ThreadCache *cache)
+  {
+    SCOPED_LOCK(m_Lock);
+
+    for(; m_FirstFreePool <= m_NumAdditionalPools; m_FirstFreePool++)
+    {
+      ItemPool *pool = GetPool(m_FirstFreePool);
+
+      while(cache->count < ThreadCacheSize / 2)
+      {
+        void *p = pool->Allocate();
+        if(p == NULL)
+          break;
+        cache->items[cache->count++] = p;
+      }
+
+      if(cache->count == ThreadCacheSize / 2)
+        return;
+    }
+
+    if(cache->count > 0)
+      return;
+
+// warn when we need to allocate an additional pool
+#if ENABLED(INCLUDE_TYPE_NAMES)
+    RDCWARN("Ran out of free slots in %s pool!", GetTypeName<WrapType>::Name());
+#else
+    RDCWARN("Ran out of free slots in pool 0x%p!", &m_ImmediatePool.items[0]);
+#endif
+
+    ItemPool *pool = AddPool();
+
+    while(cache->count < ThreadCacheSize / 2)
+      cache->items[cache->count++] = pool->Allocate();
+  }
+
+  // return the oldest count slots in the cache to their pools
+  void Flush(ThreadCache *cache, int count)
+  {
+    SCOPED_LOCK(m_Lock);
+
+    for(int i = 0; i < count; i++)
+    {
+      void *p = cache->items[i];
+
+      int32_t idx = 0;
+      if(!m_ImmediatePool.IsAlloc(p))
+        idx = FindAdditionalPoolIndex(p) + 1;
+
+      GetPool(idx)->Deallocate(p);
+
+      if(idx < m_FirstFreePool)
+        m_FirstFreePool = idx;
+    }
+
+    cache->count -= count;
+    memmove(cache->items, cache->items + count, cache->count * sizeof(void *));
+  }
+
+  // must be called with the lock held
+  ItemPool *AddPool()
+  {
+    if(m_NumAdditionalPools == MaxAdditionalPools)
+      RDCFATAL("WrappingPool has run out of additional pools");
+
+    if(m_PoolLookup == NULL)
+    {
+      m_AdditionalPools = new ItemPool *[MaxAdditionalPools];
+      m_PoolLookup = new int32_t[LookupSize];
+      memset((void *)m_PoolLookup, 0, sizeof(int32_t) * LookupSize);
+    }
+
+    int32_t idx = m_NumAdditionalPools;
+    ItemPool *pool = m_AdditionalPools[idx] = new ItemPool();
+
+    // each pool covers at most two granules, insert it under both. The compare-exchange publishes
+    // the pool pointer before the entry that refers to it becomes visible to lock-free readers.
+    uintptr_t first = GetGranule(&pool->items[0]);
+    uintptr_t last = GetGranule(&pool->items[AllocCount - 1]);
+
+    for(uintptr_t granule = first; granule <= last; granule++)
+    {
+      uint32_t slot = HashGranule(granule);
+      while(Atomic::CmpExch32(&m_PoolLookup[slot], 0, idx + 1) != 0)
+        slot = (slot + 1) % LookupSize;
+    }
+
+    Atomic::Inc32(&m_NumAdditionalPools);
+
+#if ENABLED(INCLUDE_TYPE_NAMES)
+    RDCDEBUG("WrappingPool[%d]<%s>: %p -> %p", idx, GetTypeName<WrapType>::Name(),
+             &pool->items[0], &pool->items[AllocCount - 1]);
+#endif
+
+    return pool;
+  }
+
+  int32_t FindAdditionalPoolIndex(const void *p) const
+  {
+    if(m_NumAdditionalPools == 0)
+      return -1;
+
+    uint32_t slot = HashGranule(GetGranule(p));
+
+    // pools are never removed, so we can probe without locking until we hit an empty entry
+    for(int32_t entry = m_PoolLookup[slot]; entry != 0; entry = m_PoolLookup[slot])
+    {
+      if(m_AdditionalPools[entry - 1]->IsAlloc(p))
+        return entry - 1;
+
+      slot = (slot + 1) % LookupSize;
+    }
+
+    return -1;
+  }
+
+  ItemPool *FindAdditionalPool(const void *p) const
+  {
+    int32_t idx = FindAdditionalPoolIndex(p);
+    return idx >= 0 ? m_AdditionalPools[idx] : NULL;
+  }
+
+  uintptr_t GetGranule(const void *p) const { return uintptr_t(p) >> m_GranuleShift; }
+
+  static uint32_t HashGranule(uintptr_t granule)
+  {
+    return uint32_t((uint64_t(granule) * 0x9E3779B97F4A7C15ULL) >> 32) % LookupSize;
+  }
+
+  Threading::CriticalSection m_Lock;
+
+  uint64_t m_CacheSlot = 0;
+  std::vector<ThreadCache *> m_ThreadCaches;
+
   ItemPool m_ImmediatePool;
-  std::vector<ItemPool *> m_AdditionalPools;
+
+  // only modified with the lock held. m_NumAdditionalPools is incremented once a pool is fully
+  // registered in the lookup table, so readers never see a partially added pool.
+  ItemPool **m_AdditionalPools = NULL;
+  volatile int32_t *m_PoolLookup = NULL;
+  volatile int32_t m_NumAdditionalPools = 0;
+  int32_t m_FirstFreePool = 0;
+  uint32_t m_GranuleShift = 0;
 
   friend typename FriendMaker<WrapType>::Type;
 };
@@ -0,0 +1,677 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "capture_transfer.h"
+#include <algorithm>
+#include "serialise/rdcfile.h"
+#include "zstd/zstd.h"
+
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, CaptureTransferState &el)
+{
+  SERIALISE_MEMBER(size);
+  SERIALISE_MEMBER(hash);
+}
+
+INSTANTIATE_SERIALISE_TYPE(CaptureTransferState);
+
+namespace
+{
+enum BlockType : uint32_t
+{
+  Block_End = 0,
+  // uint64_t length, then the bytes
+  Block_Raw,
+  // uint32_t uncompressed length, uint32_t compressed length, then the compressed bytes
+  Block_Zstd,
+};
+
+// data that isn't already compressed is compressed in blocks of this size, and this is also how
+// much is read from the file at once
+static const uint64_t TransferBlockSize = 1024 * 1024;
+
+// raw data is sent in pieces this large between progress updates
+static const uint64_t RawProgressSize = 16 * 1024 * 1024;
+
+// hashes the first length bytes of the file. This isn't cryptographic, it only needs to tell apart
+// a partial or stale copy from the real thing.
+uint64_t HashFilePrefix(FILE *f, uint64_t length)
+{
+  uint64_t hash = length ^ 0xcbf29ce484222325ULL;
+
+  std::vector<byte> buf((size_t)RDCMIN(length, TransferBlockSize));
+
+  FileIO::fseek64(f, 0, SEEK_SET);
+
+  while(length > 0)
+  {
+    size_t count = (size_t)RDCMIN(length, TransferBlockSize);
+
+    if(FileIO::fread(buf.data(), 1, count, f) != count)
+      return 0;
+
+    // whole words first, then the last few bytes. Only the final block can have a remainder since
+    // the block size is a multiple of the word size.
+    size_t words = count / sizeof(uint64_t);
+    for(size_t i = 0; i < words; i++)
+    {
+      uint64_t word;
+      memcpy(&word, buf.data() + i * sizeof(uint64_t), sizeof(word));
+      hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+      hash ^= hash >> 32;
+    }
+
+    for(size_t i = words * sizeof(uint64_t); i < count; i++)
+      hash = (hash ^ buf[i]) * 0x100000001b3ULL;
+
+    length -= count;
+  }
+
+  return hash;
+}
+
+struct TransferRange
+{
+  uint64_t offset;
+  uint64_t length;
+  bool compressible;
+};
+
+// splits [0, fileSize) into ranges that are already compressed in the capture (which gain nothing
+// from compressing again) and everything else.
+std::vector<TransferRange> GetTransferRanges(const char *path, uint64_t fileSize)
+{
+  std::vector<TransferRange> compressed;
+
+  {
+    RDCFile rdc;
+    rdc.Open(path);
+
+    if(rdc.ErrorCode() == ContainerError::NoError)
+    {
+      for(int i = 0; i < rdc.NumSections(); i++)
+      {
+        const SectionProperties &props = rdc.GetSectionProperties(i);
+
+        if(props.flags & (SectionFlags::LZ4Compressed | SectionFlags::ZstdCompressed))
+        {
+          TransferRange range;
+          rdc.GetSectionDiskRange(i, range.offset, range.length);
+          range.compressible = false;
+
+          if(range.length > 0 && range.offset + range.length <= fileSize)
+            compressed.push_back(range);
+        }
+      }
+    }
+  }
+
+  std::sort(compressed.begin(), compressed.end(),
+            [](const TransferRange &a, const TransferRange &b) { return a.offset < b.offset; });
+
+  std::vector<TransferRange> ret;
+
+  uint64_t cur = 0;
+  for(const TransferRange &range : compressed)
+  {
+    // ignore anything overlapping, it would be a corrupt file anyway
+    if(range.offset < cur)
+      continue;
+
+    if(range.offset > cur)
+      ret.push_back({cur, range.offset - cur, true});
+
+    ret.push_back(range);
+    cur = range.offset + range.length;
+  }
+
+  if(cur < fileSize)
+    ret.push_back({cur, fileSize - cur, true});
+
+  return ret;
+}
+
+void WriteRawBlockHeader(StreamWriter *writer, uint64_t length)
+{
+  uint32_t type = Block_Raw;
+  writer->Write(type);
+  writer->Write(length);
+}
+};
+
+CaptureTransferState CaptureTransfer::GetLocalState(const char *path)
+{
+  CaptureTransferState ret;
+
+  FILE *f = FileIO::fopen(path, "rb");
+
+  if(f)
+  {
+    FileIO::fseek64(f, 0, SEEK_END);
+    ret.size = FileIO::ftell64(f);
+    ret.hash = HashFilePrefix(f, ret.size);
+
+    FileIO::fclose(f);
+  }
+
+  return ret;
+}
+
+bool CaptureTransfer::Send(WriteSerialiser &ser, const char *path,
+                           const CaptureTransferState &remote, RENDERDOC_ProgressCallback progress,
+                           CaptureTransferStats *stats)
+{
+  StreamWriter *writer = ser.GetWriter();
+
+  FILE *f = FileIO::fopen(path, "rb");
+
+  uint64_t fileSize = 0;
+  uint64_t offset = 0;
+
+  if(f)
+  {
+    FileIO::fseek64(f, 0, SEEK_END);
+    fileSize = FileIO::ftell64(f);
+
+    // if the receiver already has the start of this file, carry on from there
+    if(remote.size > 0 && remote.size <= fileSize && HashFilePrefix(f, remote.size) == remote.hash)
+      offset = remote.size;
+  }
+  else
+  {
+    RDCERR("Can't open '%s' to send", path);
+  }
+
+  SERIALISE_ELEMENT(fileSize);
+  SERIALISE_ELEMENT(offset);
+
+  if(offset > 0)
+    RDCLOG("Receiver already has %llu of %llu bytes of '%s'", offset, fileSize, path);
+
+  CaptureTransferStats localStats;
+  localStats.fileSize = fileSize;
+  localStats.skipped = offset;
+
+  const uint64_t total = fileSize - offset;
+  uint64_t sent = 0;
+
+  std::vector<byte> buf;
+  std::vector<byte> compBuf;
+
+  if(f && total > 0)
+  {
+    std::vector<TransferRange> ranges = GetTransferRanges(path, fileSize);
+
+    for(TransferRange range : ranges)
+    {
+      if(range.offset + range.length <= offset)
+        continue;
+
+      // clip to what the receiver doesn't have
+      if(range.offset < offset)
+      {
+        range.length -= offset - range.offset;
+        range.offset = offset;
+      }
+
+      if(!range.compressible)
+      {
+        WriteRawBlockHeader(writer, range.length);
+
+        for(uint64_t cur = 0; cur < range.length && !writer->IsErrored();)
+        {
+          uint64_t length = RDCMIN(range.length - cur, RawProgressSize);
+
+          // after a partial write the receiver can't find the next block, so give up entirely
+          if(!writer->WriteFromFile(f, range.offset + cur, length))
+          {
+            RDCERR("Error sending from '%s'", path);
+            FileIO::fclose(f);
+            f = NULL;
+            break;
+          }
+
+          cur += length;
+          sent += length;
+
+          if(progress)
+            progress(float(sent) / float(total));
+        }
+
+        if(!f)
+          break;
+
+        localStats.rawBytes += range.length;
+
+        continue;
+      }
+
+      buf.resize((size_t)TransferBlockSize);
+      compBuf.resize(ZSTD_compressBound((size_t)TransferBlockSize));
+
+      FileIO::fseek64(f, range.offset, SEEK_SET);
+
+      for(uint64_t cur = 0; cur < range.length && !writer->IsErrored();)
+      {
+        uint32_t length = (uint32_t)RDCMIN(range.length - cur, TransferBlockSize);
+
+        if(FileIO::fread(buf.data(), 1, length, f) != length)
+        {
+          RDCERR("Error reading from '%s'", path);
+          FileIO::fclose(f);
+          f = NULL;
+          break;
+        }
+
+        size_t compSize = ZSTD_compress(compBuf.data(), compBuf.size(), buf.data(), length, 1);
+
+        if(!ZSTD_isError(compSize) && compSize < length)
+        {
+          uint32_t type = Block_Zstd;
+          uint32_t compLength = (uint32_t)compSize;
+          writer->Write(type);
+          writer->Write(length);
+          writer->Write(compLength);
+          writer->Write(compBuf.data(), compLength);
+
+          localStats.compressedBytes += length;
+          localStats.compressedWireBytes += compLength;
+        }
+        else
+        {
+          WriteRawBlockHeader(writer, length);
+          writer->Write(buf.data(), length);
+
+          localStats.rawBytes += length;
+        }
+
+        cur += length;
+        sent += length;
+
+        if(progress)
+          progress(float(sent) / float(total));
+      }
+
+      if(!f)
+        break;
+    }
+  }
+
+  // the receiver checks how much it got against the file size, so an early end is an error
+  uint32_t type = Block_End;
+  writer->Write(type);
+  writer->Flush();
+
+  if(progress)
+    progress(1.0f);
+
+  if(f)
+    FileIO::fclose(f);
+
+  if(stats)
+    *stats = localStats;
+
+  return f != NULL && sent == total && !writer->IsErrored();
+}
+
+bool CaptureTransfer::Receive(ReadSerialiser &ser, const char *path,
+                              RENDERDOC_ProgressCallback progress)
+{
+  StreamReader *reader = ser.GetReader();
+
+  uint64_t fileSize = 0;
+  uint64_t offset = 0;
+
+  SERIALISE_ELEMENT(fileSize);
+  SERIALISE_ELEMENT(offset);
+
+  if(ser.IsErrored())
+    return false;
+
+  FILE *f = NULL;
+
+  if(offset > 0)
+  {
+    // we already have the start of the file, append the rest
+    f = FileIO::fopen(path, "r+b");
+
+    if(f)
+    {
+      FileIO::ftruncateat(f, offset);
+      FileIO::fseek64(f, offset, SEEK_SET);
+    }
+  }
+  else
+  {
+    f = FileIO::fopen(path, "wb");
+  }
+
+  // if we can't write the file, still read everything so the stream stays in sync
+  if(!f)
+    RDCERR("Can't open '%s' to receive capture", path);
+
+  const uint64_t total = fileSize - offset;
+  uint64_t received = 0;
+  bool success = (f != NULL);
+  // set if the stream contains something invalid, after which we can't keep reading it
+  bool corrupt = false;
+
+  std::vector<byte> buf((size_t)TransferBlockSize);
+  std::vector<byte> compBuf(ZSTD_compressBound((size_t)TransferBlockSize));
+
+  while(!reader->IsErrored())
+  {
+    uint32_t type = Block_End;
+    reader->Read(type);
+
+    if(type == Block_End || reader->IsErrored())
+      break;
+
+    if(type == Block_Raw)
+    {
+      uint64_t length = 0;
+      reader->Read(length);
+
+      if(length > total - received)
+      {
+        RDCERR("Invalid capture transfer block of %llu bytes at %llu of %llu", length, received,
+               total);
+        corrupt = true;
+        break;
+      }
+
+      while(length > 0 && !reader->IsErrored())
+      {
+        uint64_t count = RDCMIN(length, TransferBlockSize);
+
+        reader->Read(buf.data(), count);
+
+        if(f && FileIO::fwrite(buf.data(), 1, (size_t)count, f) != count)
+          success = false;
+
+        length -= count;
+        received += count;
+
+        if(progress)
+          progress(float(received) / float(total));
+      }
+    }
+    else if(type == Block_Zstd)
+    {
+      uint32_t length = 0, compLength = 0;
+      reader->Read(length);
+      reader->Read(compLength);
+
+      if(length > TransferBlockSize || length > total - received || compLength > compBuf.size())
+      {
+        RDCERR("Invalid compressed capture transfer block of %u (%u) bytes", length, compLength);
+        corrupt = true;
+        break;
+      }
+
+      reader->Read(compBuf.data(), compLength);
+
+      if(reader->IsErrored())
+        break;
+
+      size_t size = ZSTD_decompress(buf.data(), length, compBuf.data(), compLength);
+
+      if(ZSTD_isError(size) || size != length)
+      {
+        RDCERR("Failed to decompress capture transfer block");
+        success = false;
+      }
+      else if(f && FileIO::fwrite(buf.data(), 1, length, f) != length)
+      {
+        success = false;
+      }
+
+      received += length;
+
+      if(progress)
+        progress(float(received) / float(total));
+    }
+    else
+    {
+      RDCERR("Unknown capture transfer block %u", type);
+      corrupt = true;
+      break;
+    }
+  }
+
+  if(f)
+    FileIO::fclose(f);
+
+  if(progress)
+    progress(1.0f);
+
+  if(corrupt || reader->IsErrored())
+    return false;
+
+  if(received != total)
+  {
+    RDCERR("Capture transfer ended early, received %llu of %llu bytes", received, total);
+    return false;
+  }
+
+  return success;
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#undef None
+
+#include "3rdparty/catch/catch.hpp"
+
+TEST_CASE("Test capture transfer over loopback", "[capture][network]")
+{
+  std::string source = FileIO::GetTempFolderFilename() + "rdoc_capture_transfer_src.rdc";
+  std::string dest = FileIO::GetTempFolderFilename() + "rdoc_capture_transfer_dst.rdc";
+
+  // one section that's compressed in the file, and one that isn't but compresses well
+  std::vector<byte> compressedContents(3 * 1024 * 1024 + 17);
+  std::vector<byte> plainContents(2 * 1024 * 1024 + 5);
+
+  uint32_t seed = 1234;
+  for(byte &b : compressedContents)
+  {
+    seed = seed * 1103515245 + 12345;
+    b = byte((seed >> 16) & 0x3);
+  }
+
+  for(size_t i = 0; i < plainContents.size(); i++)
+    plainContents[i] = byte((i / 64) & 0xff);
+
+  {
+    RDCFile rdc;
+    rdc.SetData(RDCDriver::Vulkan, "Vulkan", 0, NULL);
+    rdc.Create(source.c_str());
+
+    REQUIRE((rdc.ErrorCode() == ContainerError::NoError));
+
+    SectionProperties props;
+    props.type = SectionType::FrameCapture;
+    props.name = ToStr(props.type);
+    props.version = 1;
+    props.flags = SectionFlags::ZstdCompressed;
+
+    StreamWriter *w = rdc.WriteSection(props);
+    w->Write(compressedContents.data(), compressedContents.size());
+    w->Finish();
+    delete w;
+
+    props.type = SectionType::Notes;
+    props.name = ToStr(props.type);
+    props.flags = SectionFlags::NoFlags;
+
+    w = rdc.WriteSection(props);
+    w->Write(plainContents.data(), plainContents.size());
+    w->Finish();
+    delete w;
+  }
+
+  std::vector<byte> sourceData;
+  REQUIRE(FileIO::slurp(source.c_str(), sourceData));
+
+  uint16_t port = 8335;
+  Network::Socket *server = NULL;
+
+  for(uint16_t probe = 0; probe < 20; probe++)
+  {
+    server = Network::CreateServerSocket("localhost", port, 2);
+
+    if(server)
+      break;
+
+    port++;
+  }
+
+  REQUIRE(server);
+
+  Network::Socket *sender = Network::CreateClientSocket("localhost", port, 10);
+
+  REQUIRE(sender);
+
+  Network::Socket *receiver = server->AcceptClient(250);
+
+  REQUIRE(receiver);
+
+  CaptureTransferStats stats;
+
+  // transfers the source file to the destination, the same way as the real connections do: the
+  // receiver describes its local state and the sender answers in a chunk
+  auto transfer = [&]() {
+    CaptureTransferState state = CaptureTransfer::GetLocalState(dest.c_str());
+
+    WriteSerialiser writer(new StreamWriter(sender, Ownership::Nothing), Ownership::Stream);
+    ReadSerialiser reader(new StreamReader(receiver, Ownership::Nothing), Ownership::Stream);
+
+    writer.SetStreamingMode(true);
+    reader.SetStreamingMode(true);
+
+    bool sent = false;
+
+    // sends block on the receiver, so do them on a thread
+    Threading::ThreadHandle sendThread = Threading::CreateThread([&]() {
+      WriteSerialiser &ser = writer;
+      SCOPED_SERIALISE_CHUNK(1);
+      sent = CaptureTransfer::Send(ser, source.c_str(), state, RENDERDOC_ProgressCallback(),
+                                   &stats);
+    });
+
+    float lastProgress = 0.0f;
+    bool monotonic = true;
+
+    reader.ReadChunk<uint32_t>();
+    bool received = CaptureTransfer::Receive(reader, dest.c_str(), [&](float p) {
+      monotonic &= (p >= lastProgress);
+      lastProgress = p;
+    });
+    reader.EndChunk();
+
+    Threading::JoinThread(sendThread);
+    Threading::CloseThread(sendThread);
+
+    CHECK(sent);
+    CHECK(received);
+    CHECK(monotonic);
+    CHECK(lastProgress == 1.0f);
+  };
+
+  auto checkDest = [&]() {
+    std::vector<byte> destData;
+    REQUIRE(FileIO::slurp(dest.c_str(), destData));
+    REQUIRE(destData.size() == sourceData.size());
+    CHECK((destData == sourceData));
+  };
+
+  FileIO::Delete(dest.c_str());
+
+  SECTION("Full copy")
+  {
+    transfer();
+    checkDest();
+
+    CHECK(stats.fileSize == sourceData.size());
+    CHECK(stats.skipped == 0);
+    // the compressed section goes as-is, the plain section compresses
+    CHECK(stats.rawBytes >= compressedContents.size() / 4);
+    CHECK(stats.compressedBytes >= plainContents.size());
+    CHECK(stats.compressedWireBytes < stats.compressedBytes / 10);
+    CHECK(stats.rawBytes + stats.compressedBytes == sourceData.size());
+  };
+
+  SECTION("Resume a partial copy")
+  {
+    const size_t half = sourceData.size() / 2;
+
+    FILE *f = FileIO::fopen(dest.c_str(), "wb");
+    REQUIRE(f);
+    FileIO::fwrite(sourceData.data(), 1, half, f);
+    FileIO::fclose(f);
+
+    transfer();
+    checkDest();
+
+    CHECK(stats.skipped == half);
+    CHECK(stats.rawBytes + stats.compressedBytes == sourceData.size() - half);
+  };
+
+  SECTION("Skip an identical copy")
+  {
+    transfer();
+    transfer();
+    checkDest();
+
+    CHECK(stats.skipped == sourceData.size());
+    CHECK(stats.rawBytes + stats.compressedBytes == 0);
+  };
+
+  SECTION("Replace a different file")
+  {
+    std::vector<byte> other = sourceData;
+    other.resize(other.size() / 3);
+    other[100] ^= 0xff;
+
+    FILE *f = FileIO::fopen(dest.c_str(), "wb");
+    REQUIRE(f);
+    FileIO::fwrite(other.data(), 1, other.size(), f);
+    FileIO::fclose(f);
+
+    transfer();
+    checkDest();
+
+    CHECK(stats.skipped == 0);
+    CHECK(stats.rawBytes + stats.compressedBytes == sourceData.size());
+  };
+
+  SAFE_DELETE(receiver);
+  SAFE_DELETE(sender);
+  SAFE_DELETE(server);
+
+  FileIO::Delete(source.c_str());
+  FileIO::Delete(dest.c_str());
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
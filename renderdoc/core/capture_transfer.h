@@ -0,0 +1,64 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include "serialise/serialiser.h"
+
+// What the receiving side already has at the destination path - possibly nothing, a partial copy
+// from an interrupted transfer, or a complete copy of the same capture.
+struct CaptureTransferState
+{
+  uint64_t size = 0;
+  uint64_t hash = 0;
+};
+
+DECLARE_REFLECTION_STRUCT(CaptureTransferState);
+
+struct CaptureTransferStats
+{
+  uint64_t fileSize = 0;
+  // bytes the receiver already had, which weren't sent
+  uint64_t skipped = 0;
+  // bytes sent as-is, mostly sections that are already compressed in the capture
+  uint64_t rawBytes = 0;
+  // bytes that were compressed on the fly, and what they compressed to
+  uint64_t compressedBytes = 0;
+  uint64_t compressedWireBytes = 0;
+};
+
+// Copies capture files over target control and remote server connections. The receiver first
+// describes what it already has at the destination so the sender can skip a matching prefix, which
+// resumes an interrupted copy or skips the copy entirely if the file is already there. Sections
+// that are stored compressed in the capture are sent straight from the file to the socket,
+// everything else is compressed on the way.
+namespace CaptureTransfer
+{
+CaptureTransferState GetLocalState(const char *path);
+
+bool Send(WriteSerialiser &ser, const char *path, const CaptureTransferState &remote,
+          RENDERDOC_ProgressCallback progress, CaptureTransferStats *stats = NULL);
+bool Receive(ReadSerialiser &ser, const char *path, RENDERDOC_ProgressCallback progress);
+};
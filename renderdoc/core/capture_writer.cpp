@@ -0,0 +1,273 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "capture_writer.h"
+#include "serialise/serialiser.h"
+
+const uint64_t CaptureContents::BlockSize;
+
+CaptureContents::CaptureContents(const SectionProperties &props)
+    : Compressor(NULL, Ownership::Nothing), m_Props(props)
+{
+}
+
+CaptureContents::~CaptureContents()
+{
+  for(byte *block : m_Blocks)
+    FreeAlignedBuffer(block);
+
+  for(const Item &item : m_Items)
+    delete item.chunk;
+}
+
+bool CaptureContents::Write(const void *data, uint64_t numBytes)
+{
+  if(numBytes == 0)
+    return true;
+
+  // extend the last run of bytes if the previous write was one too
+  if(m_Items.empty() || m_Items.back().chunk)
+    m_Items.push_back({NULL, 0});
+
+  m_Items.back().size += numBytes;
+  m_Size += numBytes;
+
+  const byte *src = (const byte *)data;
+
+  while(numBytes > 0)
+  {
+    uint64_t blockOffset = m_BlockBytes % BlockSize;
+
+    if(blockOffset == 0)
+      m_Blocks.push_back(AllocAlignedBuffer(BlockSize));
+
+    uint64_t copySize = RDCMIN(numBytes, BlockSize - blockOffset);
+
+    memcpy(m_Blocks.back() + blockOffset, src, (size_t)copySize);
+
+    m_BlockBytes += copySize;
+    src += copySize;
+    numBytes -= copySize;
+  }
+
+  return true;
+}
+
+void CaptureContents::AddChunk(Chunk *chunk)
+{
+  // callstacks referenced by the capture are gathered when it's queued for writing, before this is
+  // written out
+  chunk->MarkCallstackReferenced();
+
+  m_Items.push_back({chunk->Duplicate(), 0});
+  m_Size += chunk->GetLength();
+}
+
+bool CaptureContents::WriteTo(RDCFile *rdc, std::function<void(float)> progress)
+{
+  StreamWriter *writer = rdc->WriteSection(m_Props);
+
+  bool success = !writer->IsErrored();
+
+  uint64_t written = 0;
+  // position in the blocks of the next run of bytes
+  size_t block = 0;
+  uint64_t blockOffset = 0;
+  // report progress at most every block's worth of data
+  uint64_t nextProgress = BlockSize;
+
+  for(Item &item : m_Items)
+  {
+    if(item.chunk)
+    {
+      // skip writing anything more after a failure, but still free everything
+      if(success)
+        success &= writer->Write(item.chunk->GetData(), item.chunk->GetLength());
+      written += item.chunk->GetLength();
+
+      SAFE_DELETE(item.chunk);
+    }
+    else
+    {
+      uint64_t remaining = item.size;
+
+      while(remaining > 0)
+      {
+        uint64_t size = RDCMIN(remaining, BlockSize - blockOffset);
+
+        if(success)
+          success &= writer->Write(m_Blocks[block] + blockOffset, size);
+        written += size;
+        remaining -= size;
+        blockOffset += size;
+
+        // free each block as soon as it's been compressed
+        if(blockOffset == BlockSize)
+        {
+          FreeAlignedBuffer(m_Blocks[block]);
+          m_Blocks[block] = NULL;
+          block++;
+          blockOffset = 0;
+        }
+      }
+    }
+
+    if(progress && written >= nextProgress)
+    {
+      progress(float(written) / float(m_Size));
+      nextProgress = written + BlockSize;
+    }
+  }
+
+  m_Items.clear();
+
+  for(byte *b : m_Blocks)
+    FreeAlignedBuffer(b);
+  m_Blocks.clear();
+  m_BlockBytes = 0;
+
+  success &= writer->Finish() && !writer->IsErrored();
+
+  delete writer;
+
+  if(progress)
+    progress(1.0f);
+
+  return success;
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#undef None
+
+#include "3rdparty/catch/catch.hpp"
+
+TEST_CASE("Test capture contents buffering", "[capture]")
+{
+  SectionProperties props;
+  props.type = SectionType::FrameCapture;
+  props.version = 1;
+
+  SECTION("Uncompressed")
+  {
+    props.flags = SectionFlags::NoFlags;
+  }
+  SECTION("LZ4")
+  {
+    props.flags = SectionFlags::LZ4Compressed | SectionFlags::LZ4IndependentBlocks;
+  }
+  SECTION("zstd")
+  {
+    props.flags = SectionFlags::ZstdCompressed;
+  }
+
+  std::vector<byte> expected;
+
+  CaptureContents *contents = new CaptureContents(props);
+
+  {
+    WriteSerialiser ser(new StreamWriter(contents, Ownership::Nothing), Ownership::Stream);
+
+    // enough to fill more than one block
+    std::vector<byte> big((size_t)CaptureContents::BlockSize + 1000);
+    uint32_t seed = 1234;
+    for(size_t i = 0; i < big.size(); i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      big[i] = byte(seed >> 16);
+    }
+
+    ser.GetWriter()->Write(big.data(), 100);
+    ser.GetWriter()->Write(big.data(), big.size());
+    expected.insert(expected.end(), big.begin(), big.begin() + 100);
+    expected.insert(expected.end(), big.begin(), big.end());
+
+    // recorded chunks are handed over in between serialised data, or written through the
+    // serialiser. Handed over chunks can be freed straight away, their storage is kept alive.
+    WriteSerialiser chunkSer(new StreamWriter(StreamWriter::DefaultScratchSize), Ownership::Stream);
+
+    for(uint32_t c = 0; c < 5; c++)
+    {
+      chunkSer.GetWriter()->Write(big.data() + c, 333 + c);
+      Chunk *chunk = new Chunk(chunkSer, 1, true);
+
+      expected.insert(expected.end(), chunk->GetData(), chunk->GetData() + chunk->GetLength());
+      if(c == 2)
+        chunk->Write(ser);
+      else
+        contents->AddChunk(chunk);
+      delete chunk;
+
+      uint32_t val = 0xf00d0000 | c;
+      ser.GetWriter()->Write(val);
+      expected.insert(expected.end(), (byte *)&val, (byte *)&val + sizeof(val));
+    }
+  }
+
+  CHECK(contents->GetSize() == expected.size());
+
+  std::string filename = FileIO::GetTempFolderFilename() + "capture_contents_test.rdc";
+
+  RDCFile *rdc = new RDCFile;
+  rdc->SetData(RDCDriver::Unknown, "", 0, NULL);
+  rdc->Create(filename.c_str());
+  REQUIRE((rdc->ErrorCode() == ContainerError::NoError));
+
+  float lastProgress = 0.0f;
+  bool monotonic = true;
+
+  CHECK(contents->WriteTo(rdc, [&lastProgress, &monotonic](float p) {
+    monotonic &= (p >= lastProgress);
+    lastProgress = p;
+  }));
+
+  CHECK(monotonic);
+  CHECK(lastProgress == 1.0f);
+
+  delete contents;
+  delete rdc;
+
+  rdc = new RDCFile;
+  rdc->Open(filename.c_str());
+  REQUIRE((rdc->ErrorCode() == ContainerError::NoError));
+
+  int idx = rdc->SectionIndex(SectionType::FrameCapture);
+  REQUIRE(idx >= 0);
+  CHECK((rdc->GetSectionProperties(idx).flags == props.flags));
+  CHECK(rdc->GetSectionProperties(idx).uncompressedSize == expected.size());
+
+  StreamReader *reader = rdc->ReadSection(idx);
+
+  std::vector<byte> actual(expected.size());
+  CHECK(reader->Read(actual.data(), actual.size()));
+  CHECK(reader->AtEnd());
+  CHECK(actual == expected);
+
+  delete reader;
+  delete rdc;
+
+  FileIO::Delete(filename.c_str());
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -0,0 +1,77 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "serialise/rdcfile.h"
+#include "serialise/streamio.h"
+
+class Chunk;
+
+// Holds a capture's frame contents in memory on their way to disk. The capturing thread serialises
+// into this (through a StreamWriter) and hands over recorded chunks, then a background thread
+// compresses everything and writes it into the capture file, so the application only stalls for
+// as long as it takes to gather the contents.
+//
+// Serialised data is copied into large blocks as-is. Recorded chunks aren't copied at all, a
+// duplicate sharing the chunk's storage is kept until it's written.
+class CaptureContents : public Compressor
+{
+public:
+  // props describes the section this will be written to, and its flags pick the compression
+  CaptureContents(const SectionProperties &props);
+  ~CaptureContents();
+
+  bool Write(const void *data, uint64_t numBytes);
+  bool Finish() { return true; }
+
+  // adds a recorded chunk after what has been written so far. Its contents must not change
+  // afterwards, so chunks that are updated in place - like those holding a resource record's
+  // backing data - must be written through the serialiser instead.
+  void AddChunk(Chunk *chunk);
+
+  uint64_t GetSize() const { return m_Size; }
+  // compresses and writes the section into rdc calling progress as it goes. The contents are freed
+  // as they are written, so this can only be called once.
+  bool WriteTo(RDCFile *rdc, std::function<void(float)> progress);
+
+  static const uint64_t BlockSize = 16 * 1024 * 1024;
+
+private:
+  // the contents in order, each either a chunk or the next run of bytes in the blocks
+  struct Item
+  {
+    Chunk *chunk;
+    uint64_t size;
+  };
+
+  SectionProperties m_Props;
+  std::vector<Item> m_Items;
+  // every block is full apart from the last
+  std::vector<byte *> m_Blocks;
+  uint64_t m_BlockBytes = 0;
+  uint64_t m_Size = 0;
+};
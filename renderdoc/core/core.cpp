@@ -28,6 +28,7 @@
 #include <algorithm>
 #include "api/replay/version.h"
 #include "common/common.h"
+#include "core/capture_writer.h"
 #include "hooks/hooks.h"
 #include "maths/formatpacking.h"
 #include "replay/replay_driver.h"
@@ -234,6 +235,8 @@ RenderDoc::RenderDoc()
 
   m_ExHandler = NULL;
 
+  m_Callstacks = new CallstackDictionary;
+
   m_Overlay = eRENDERDOC_Overlay_Default;
 
   m_VulkanCheck = NULL;
@@ -353,6 +356,17 @@ RenderDoc::~RenderDoc()
   for(auto it = m_ShutdownFunctions.begin(); it != m_ShutdownFunctions.end(); ++it)
     (*it)();
 
+  // make sure any captures still being written make it to disk.
+#if ENABLED(RDOC_WIN32)
+  // On windows the process may already have terminated the writer thread by the time we're
+  // unloaded, and we can't join threads during module unload anyway, so write anything it hasn't
+  // started on this thread instead. The pool is leaked for the same reason.
+  WritePendingCaptures();
+#else
+  FlushCaptureWriting();
+  SAFE_DELETE(m_CaptureWriter);
+#endif
+
   for(size_t i = 0; i < m_Captures.size(); i++)
   {
     if(m_Captures[i].retrieved)
@@ -366,6 +380,8 @@ RenderDoc::~RenderDoc()
     }
   }
 
+  SAFE_DELETE(m_Callstacks);
+
   RDCSTOPLOGGING(m_LoggingFilename.c_str());
 
   if(m_RemoteThread)
@@ -405,6 +421,8 @@ void RenderDoc::Shutdown()
     Threading::CloseThread(m_RemoteThread);
     m_RemoteThread = 0;
   }
+
+  FlushCaptureWriting();
 }
 
 void RenderDoc::ProcessGlobalEnvironment(GlobalEnvironment env, const std::vector<std::string> &args)
@@ -496,6 +514,11 @@ void RenderDoc::StartFrameCapture(void *dev, void *wnd)
   IFrameCapturer *frameCap = MatchFrameCapturer(dev, wnd);
   if(frameCap)
   {
+    // references are only cleared when no capture is in progress, so overlapping captures each
+    // write a superset of the callstacks they need
+    if(m_CapturesActive == 0)
+      m_Callstacks->ClearReferenced();
+
     frameCap->StartFrameCapture(dev, wnd);
     m_CapturesActive++;
   }
@@ -1011,6 +1034,201 @@ StructuredProcessor RenderDoc::GetStructuredProcessor(RDCDriver driver)
   return it->second;
 }
 
+StructuredChunkLoader::StructuredChunkLoader(RDCFile *rdc, int sectionIndex, ChunkLookup lookup,
+                                             bool includeBuffers)
+    : m_RDC(rdc), m_SectionIndex(sectionIndex), m_Lookup(lookup), m_IncludeBuffers(includeBuffers)
+{
+  m_OwnedRDC = rdc->Reopen();
+  if(m_OwnedRDC)
+    m_RDC = m_OwnedRDC;
+}
+
+StructuredChunkLoader::~StructuredChunkLoader()
+{
+  SAFE_DELETE(m_Reader);
+  SAFE_DELETE(m_OwnedRDC);
+}
+
+bool StructuredChunkLoader::LoadChunk(SDChunk &chunk, uint64_t offset,
+                                      StructuredBufferList &chunkBuffers)
+{
+  // we can only seek forwards cheaply in general, so re-open the section to go backwards.
+  if(m_Reader && (m_Reader->IsErrored() || offset < m_Reader->GetOffset()))
+    SAFE_DELETE(m_Reader);
+
+  if(!m_Reader)
+  {
+    // chunks are small and loaders may be running on every core already, so don't decompress
+    // ahead on more than one thread
+    m_Reader = m_RDC->ReadSection(m_SectionIndex, 1);
+
+    if(m_Reader->IsErrored())
+    {
+      SAFE_DELETE(m_Reader);
+      return false;
+    }
+  }
+
+  m_Reader->SetOffset(offset);
+
+  if(m_Reader->IsErrored() || m_Reader->GetOffset() != offset)
+  {
+    RDCERR("Couldn't seek to lazy chunk at %llu", offset);
+    return false;
+  }
+
+  ReadSerialiser ser(m_Reader, Ownership::Nothing);
+
+  ser.ConfigureStructuredExport(m_Lookup, m_IncludeBuffers);
+
+  uint32_t chunkID = ser.ReadChunk<uint32_t>();
+
+  bool success = ProcessChunk(ser, chunkID);
+
+  ser.EndChunk();
+
+  SDFile &loaded = ser.GetStructuredFile();
+
+  if(!success || m_Reader->IsErrored() || loaded.chunks.size() != 1 ||
+     chunkID != chunk.metadata.chunkID)
+  {
+    RDCERR("Failed to load lazy chunk %u at %llu", chunk.metadata.chunkID, offset);
+    return false;
+  }
+
+  // the loaded objects live in the serialiser's file, so copy them onto the heap where they can be
+  // released individually when the chunk is unloaded again. The chunk was exported on its own, so
+  // its buffer indices are already relative to its own buffers.
+  SDChunk *src = loaded.chunks[0];
+
+  chunk.data.children.reserve(src->data.children.size());
+  for(size_t i = 0; i < src->data.children.size(); i++)
+    chunk.data.children.push_back(src->data.children[i]->Duplicate());
+  chunk.data.basic.numChildren = chunk.data.children.size();
+
+  chunkBuffers.append(loaded.buffers.data(), loaded.buffers.size());
+  loaded.buffers.clear();
+
+  return true;
+}
+
+void LoadLazyChunksParallel(SDFile &file, std::function<SDChunkLoader *()> makeLoader,
+                            uint32_t numThreads)
+{
+  struct ChunkRange
+  {
+    size_t begin = 0, end = 0;
+    SDChunkLoader *loader = NULL;
+    // the buffers for this range, moved into the file once every range is done. Each loaded chunk
+    // owns a run of them starting at its entry in bufferStart.
+    StructuredBufferList buffers;
+    rdcarray<SDChunk *> loaded;
+    rdcarray<size_t> bufferStart;
+    bool success = true;
+  };
+
+  const size_t numChunks = file.chunks.size();
+
+  if(numChunks == 0)
+  {
+    file.FinishLazyLoad();
+    return;
+  }
+
+  uint32_t numRanges = (uint32_t)RDCMIN((size_t)RDCMAX(numThreads, 1U), numChunks);
+
+  // balance the ranges by size rather than by count, as chunk sizes vary enormously. Count each
+  // chunk as at least one byte so that streamed chunks with no length still get distributed.
+  uint64_t totalSize = 0;
+  for(size_t i = 0; i < numChunks; i++)
+    totalSize += file.chunks[i]->metadata.length + 1;
+
+  ChunkRange *ranges = new ChunkRange[numRanges];
+
+  {
+    uint64_t size = 0;
+    uint32_t r = 0;
+    for(size_t i = 0; i < numChunks; i++)
+    {
+      size += file.chunks[i]->metadata.length + 1;
+
+      if(r + 1 < numRanges && size >= totalSize * (r + 1) / numRanges)
+      {
+        ranges[r].end = i + 1;
+        ranges[r + 1].begin = i + 1;
+        r++;
+      }
+    }
+    ranges[numRanges - 1].end = numChunks;
+  }
+
+  // create the loaders up front on this thread, they may not be safe to construct concurrently
+  for(uint32_t r = 0; r < numRanges; r++)
+    ranges[r].loader = makeLoader();
+
+  {
+    Threading::ThreadPool pool(numRanges > 1 ? numRanges : 0);
+
+    std::vector<Threading::ThreadPool::Job *> jobs;
+    jobs.reserve(numRanges);
+
+    for(uint32_t r = 0; r < numRanges; r++)
+    {
+      ChunkRange &range = ranges[r];
+      jobs.push_back(pool.AddJob([&file, &range]() {
+        for(size_t i = range.begin; i < range.end; i++)
+        {
+          uint64_t offset = file.GetLazyOffset(i);
+          if(offset == ~0ULL)
+            continue;
+
+          size_t start = range.buffers.size();
+
+          if(range.loader->LoadChunk(*file.chunks[i], offset, range.buffers))
+          {
+            range.loaded.push_back(file.chunks[i]);
+            range.bufferStart.push_back(start);
+          }
+          else
+          {
+            for(size_t b = start; b < range.buffers.size(); b++)
+              delete range.buffers[b];
+            range.buffers.resize(start);
+            range.success = false;
+          }
+        }
+      }));
+    }
+
+    for(Threading::ThreadPool::Job *job : jobs)
+      pool.WaitForJob(job);
+  }
+
+  for(uint32_t r = 0; r < numRanges; r++)
+  {
+    ChunkRange &range = ranges[r];
+
+    if(!range.success)
+      RDCERR("Failed to load some chunks between %zu and %zu", range.begin, range.end);
+
+    for(size_t c = 0; c < range.loaded.size(); c++)
+    {
+      size_t start = range.bufferStart[c];
+      size_t end = c + 1 < range.loaded.size() ? range.bufferStart[c + 1] : range.buffers.size();
+
+      // each chunk's buffer indices are relative to its own buffers
+      file.StoreChunkBuffers(*range.loaded[c], range.buffers.data() + start, end - start);
+    }
+    range.buffers.clear();
+
+    delete range.loader;
+  }
+
+  delete[] ranges;
+
+  file.FinishLazyLoad();
+}
+
 CaptureExporter RenderDoc::GetCaptureExporter(const char *filetype)
 {
   if(!filetype)
@@ -1273,10 +1491,150 @@ void RenderDoc::SetCaptureFileTemplate(const char *pathtemplate)
   FileIO::CreateParentDirectory(m_CaptureFileTemplate);
 }
 
+struct RenderDoc::PendingCapture
+{
+  RDCFile *rdc = NULL;
+  uint32_t frameNumber = 0;
+  std::string path;
+
+  // if set, the contents are written as the frame capture section first
+  CaptureContents *contents = NULL;
+
+  // callstack sections are gathered up front, since the dictionary keeps growing while the
+  // application runs
+  std::vector<byte> resolveDB;
+  std::vector<byte> callstacks;
+};
+
+RenderDoc::PendingCapture *RenderDoc::PrepareCapture(RDCFile *rdc, uint32_t frameNumber)
+{
+  PendingCapture *capture = new PendingCapture;
+
+  capture->rdc = rdc;
+  capture->frameNumber = frameNumber;
+  capture->path = m_CurrentLogFile;
+
+  if(rdc && m_Options.captureCallstacks)
+  {
+    size_t sz = 0;
+    Callstack::GetLoadedModules(NULL, sz);
+
+    capture->resolveDB.resize(sz);
+    Callstack::GetLoadedModules(capture->resolveDB.data(), sz);
+
+    StreamWriter w(StreamWriter::DefaultScratchSize);
+    m_Callstacks->Write(&w, true);
+
+    capture->callstacks.assign(w.GetData(), w.GetData() + w.GetOffset());
+  }
+
+  return capture;
+}
+
 void RenderDoc::FinishCaptureWriting(RDCFile *rdc, uint32_t frameNumber)
 {
   RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, 0.0f);
 
+  WriteCapture(PrepareCapture(rdc, frameNumber));
+
+  RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, 1.0f);
+}
+
+void RenderDoc::QueueCaptureWriting(RDCFile *rdc, uint32_t frameNumber, CaptureContents *contents)
+{
+  PendingCapture *capture = PrepareCapture(rdc, frameNumber);
+
+  capture->contents = contents;
+
+  SCOPED_LOCK(m_CaptureWriterLock);
+
+  if(!m_CaptureWriter)
+    m_CaptureWriter = new Threading::ThreadPool(1);
+
+  m_PendingCaptures.push_back(capture);
+
+  m_CaptureWriterJobs.push_back(m_CaptureWriter->AddJob([this]() {
+    PendingCapture *capture = NULL;
+
+    {
+      SCOPED_LOCK(m_CaptureWriterLock);
+
+      // shutdown may have written it already
+      if(m_PendingCaptures.empty())
+        return;
+
+      capture = m_PendingCaptures.front();
+      m_PendingCaptures.pop_front();
+      m_CaptureInFlight = true;
+    }
+
+    RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, 0.0f);
+
+    WriteCapture(capture);
+
+    RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, 1.0f);
+
+    {
+      SCOPED_LOCK(m_CaptureWriterLock);
+      m_CaptureInFlight = false;
+    }
+  }));
+}
+
+void RenderDoc::FlushCaptureWriting()
+{
+  std::vector<Threading::ThreadPool::Job *> jobs;
+
+  {
+    SCOPED_LOCK(m_CaptureWriterLock);
+    jobs.swap(m_CaptureWriterJobs);
+  }
+
+  for(Threading::ThreadPool::Job *job : jobs)
+    m_CaptureWriter->WaitForJob(job);
+}
+
+void RenderDoc::WritePendingCaptures()
+{
+  std::deque<PendingCapture *> captures;
+  bool inFlight = false;
+
+  {
+    SCOPED_LOCK(m_CaptureWriterLock);
+    captures.swap(m_PendingCaptures);
+    inFlight = m_CaptureInFlight;
+  }
+
+  if(inFlight)
+    RDCWARN("A capture was still being written at shutdown and may be incomplete");
+
+  for(PendingCapture *capture : captures)
+    WriteCapture(capture);
+}
+
+void RenderDoc::WriteCapture(PendingCapture *capture)
+{
+  RDCFile *rdc = capture->rdc;
+
+  if(capture->contents)
+  {
+    PerformanceTimer timer;
+
+    uint64_t size = capture->contents->GetSize();
+
+    // the contents are almost all of the file, the rest is negligible
+    if(rdc)
+      capture->contents->WriteTo(rdc, [](float progress) {
+        RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, progress * 0.99f);
+      });
+
+    SAFE_DELETE(capture->contents);
+
+    if(rdc)
+      RDCLOG("Compressed and wrote %.2f MB of frame contents in %.1f ms in the background",
+             double(size) / (1024.0 * 1024.0), timer.GetMilliseconds());
+  }
+
   if(rdc)
   {
     // add the resolve database if we were capturing callstacks.
@@ -1287,13 +1645,17 @@ void RenderDoc::FinishCaptureWriting(RDCFile *rdc, uint32_t frameNumber)
       props.version = 1;
       StreamWriter *w = rdc->WriteSection(props);
 
-      size_t sz = 0;
-      Callstack::GetLoadedModules(NULL, sz);
+      w->Write(capture->resolveDB.data(), capture->resolveDB.size());
 
-      byte *buf = new byte[sz];
-      Callstack::GetLoadedModules(buf, sz);
+      w->Finish();
 
-      w->Write(buf, sz);
+      delete w;
+
+      props.type = SectionType::CallstackDictionary;
+      props.version = CallstackDictionary::SectionVersion;
+      w = rdc->WriteSection(props);
+
+      w->Write(capture->callstacks.data(), capture->callstacks.size());
 
       w->Finish();
 
@@ -1324,9 +1686,10 @@ void RenderDoc::FinishCaptureWriting(RDCFile *rdc, uint32_t frameNumber)
       delete w;
     }
 
-    RDCLOG("Written to disk: %s", m_CurrentLogFile.c_str());
+    RDCLOG("Written to disk: %s", capture->path.c_str());
 
-    CaptureData cap(m_CurrentLogFile, Timing::GetUnixTimestamp(), rdc->GetDriver(), frameNumber);
+    CaptureData cap(capture->path, Timing::GetUnixTimestamp(), rdc->GetDriver(),
+                    capture->frameNumber);
     {
       SCOPED_LOCK(m_CaptureLock);
       m_Captures.push_back(cap);
@@ -1336,10 +1699,10 @@ void RenderDoc::FinishCaptureWriting(RDCFile *rdc, uint32_t frameNumber)
   }
   else
   {
-    RDCLOG("Discarded capture, Frame %u", frameNumber);
+    RDCLOG("Discarded capture, Frame %u", capture->frameNumber);
   }
 
-  RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, 1.0f);
+  delete capture;
 }
 
 void RenderDoc::AddDeviceFrameCapturer(void *dev, IFrameCapturer *cap)
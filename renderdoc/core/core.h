@@ -26,6 +26,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <deque>
 #include <map>
 #include <set>
 #include <string>
@@ -322,12 +323,17 @@ class IRemoteDriver;
 class IReplayDriver;
 
 class StreamReader;
+class StreamWriter;
 class RDCFile;
+class CaptureContents;
+class CallstackDictionary;
 
 typedef ReplayStatus (*RemoteDriverProvider)(RDCFile *rdc, IRemoteDriver **driver);
 typedef ReplayStatus (*ReplayDriverProvider)(RDCFile *rdc, IReplayDriver **driver);
 
-typedef void (*StructuredProcessor)(RDCFile *rdc, SDFile &structData);
+// if lazy is set the processor may return a lazily loaded file, with a loader that reads chunks
+// from rdc on demand - rdc must then outlive structData.
+typedef void (*StructuredProcessor)(RDCFile *rdc, SDFile &structData, bool lazy);
 
 typedef ReplayStatus (*CaptureImporter)(const char *filename, StreamReader &reader, RDCFile *rdc,
                                         SDFile &structData, RENDERDOC_ProgressCallback progress);
@@ -373,13 +379,26 @@ public:
   template <typename ProgressType>
   void SetProgressCallback(RENDERDOC_ProgressCallback progress)
   {
+    SCOPED_LOCK(m_ProgressLock);
     m_ProgressCallbacks[TypeName<ProgressType>()] = progress;
   }
 
   template <typename ProgressType>
   void SetProgress(ProgressType section, float delta)
   {
-    RENDERDOC_ProgressCallback cb = m_ProgressCallbacks[TypeName<ProgressType>()];
+    RENDERDOC_ProgressCallback cb;
+
+    // captures are written on a background thread, so take a copy under the lock and call it
+    // outside, in case the callback itself changes the callbacks
+    {
+      SCOPED_LOCK(m_ProgressLock);
+      auto it = m_ProgressCallbacks.find(TypeName<ProgressType>());
+      if(it == m_ProgressCallbacks.end())
+        return;
+
+      cb = it->second;
+    }
+
     if(!cb || section < ProgressType::First || section >= ProgressType::Count)
       return;
 
@@ -429,6 +448,8 @@ public:
 
   void SetCaptureOptions(const CaptureOptions &opts);
   const CaptureOptions &GetCaptureOptions() const { return m_Options; }
+  // the callstacks collected while capturing, shared by all captures made in this process
+  CallstackDictionary &GetCallstackDictionary() { return *m_Callstacks; }
   void RecreateCrashHandler();
   void UnloadCrashHandler();
   ICrashHandler *GetCrashHandler() const { return m_ExHandler; }
@@ -436,6 +457,12 @@ public:
   void EncodePixelsPNG(const RDCThumb &in, RDCThumb &out);
   RDCFile *CreateRDC(RDCDriver driver, uint32_t frameNum, const FramePixels &fp);
   void FinishCaptureWriting(RDCFile *rdc, uint32_t frameNumber);
+  // as FinishCaptureWriting, but first the frame's contents are compressed and written as the rdc's
+  // frame capture section. All of that happens on a background thread, in the order captures are
+  // queued. Takes ownership of everything passed in.
+  void QueueCaptureWriting(RDCFile *rdc, uint32_t frameNumber, CaptureContents *contents);
+  // waits for any captures queued for writing to be finished
+  void FlushCaptureWriting();
 
   void AddChildProcess(uint32_t pid, uint32_t ident)
   {
@@ -604,6 +631,7 @@ private:
   string m_CaptureFileTemplate;
   string m_CurrentLogFile;
   CaptureOptions m_Options;
+  CallstackDictionary *m_Callstacks;
   uint32_t m_Overlay;
 
   set<uint32_t> m_QueuedFrameCaptures;
@@ -615,11 +643,25 @@ private:
   Threading::CriticalSection m_DriverLock;
   std::map<RDCDriver, uint64_t> m_ActiveDrivers;
 
+  Threading::CriticalSection m_ProgressLock;
   std::map<std::string, RENDERDOC_ProgressCallback> m_ProgressCallbacks;
 
   Threading::CriticalSection m_CaptureLock;
   vector<CaptureData> m_Captures;
 
+  struct PendingCapture;
+  PendingCapture *PrepareCapture(RDCFile *rdc, uint32_t frameNumber);
+  void WriteCapture(PendingCapture *capture);
+  void WritePendingCaptures();
+
+  // a single worker, so captures are written in order. Each job takes the oldest pending capture,
+  // so that any the worker never got to can still be written without it
+  Threading::CriticalSection m_CaptureWriterLock;
+  Threading::ThreadPool *m_CaptureWriter = NULL;
+  std::vector<Threading::ThreadPool::Job *> m_CaptureWriterJobs;
+  std::deque<PendingCapture *> m_PendingCaptures;
+  bool m_CaptureInFlight = false;
+
   Threading::CriticalSection m_ChildLock;
   vector<pair<uint32_t, uint32_t> > m_Children;
 
@@ -90,8 +90,8 @@ public:
     RDCLOG("Connecting to server %ls", m_PipeName.c_str());
 
     m_ExHandler = new google_breakpad::ExceptionHandler(
-        dumpFolder.c_str(), NULL, NULL, NULL, google_breakpad::ExceptionHandler::HANDLER_ALL,
-        dumpType, m_PipeName.c_str(), &custom);
+        dumpFolder.c_str(), &FlushLogBeforeDump, NULL, NULL,
+        google_breakpad::ExceptionHandler::HANDLER_ALL, dumpType, m_PipeName.c_str(), &custom);
 
     if(!m_ExHandler->IsOutOfProcess())
     {
@@ -104,8 +104,8 @@ public:
       CreateCrashHandlingServer();
 
       m_ExHandler = new google_breakpad::ExceptionHandler(
-          dumpFolder.c_str(), NULL, NULL, NULL, google_breakpad::ExceptionHandler::HANDLER_ALL,
-          dumpType, m_PipeName.c_str(), &custom);
+          dumpFolder.c_str(), &FlushLogBeforeDump, NULL, NULL,
+          google_breakpad::ExceptionHandler::HANDLER_ALL, dumpType, m_PipeName.c_str(), &custom);
 
       if(!m_ExHandler->IsOutOfProcess())
         RDCERR("Couldn't launch and connect to new breakpad server");
@@ -117,6 +117,15 @@ public:
       m_ExHandler->RegisterAppMemory((void *)mem[i].ptr, mem[i].length);
   }
 
+  // log lines are written out in the background, so write out anything still queued before the
+  // dump is taken - the crash report picks up the log file from disk.
+  static bool FlushLogBeforeDump(void *context, EXCEPTION_POINTERS *exinfo,
+                                 MDRawAssertionInfo *assertion)
+  {
+    rdclog_crashflush();
+    return true;
+  }
+
   void CreateCrashHandlingServer()
   {
     PROCESS_INFORMATION pi;
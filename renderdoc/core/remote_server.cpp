@@ -23,11 +23,13 @@
  * THE SOFTWARE.
  ******************************************************************************/
 
+#include <algorithm>
 #include <sstream>
 #include <utility>
 #include "android/android.h"
 #include "api/replay/renderdoc_replay.h"
 #include "api/replay/version.h"
+#include "core/capture_transfer.h"
 #include "core/core.h"
 #include "os/os_specific.h"
 #include "replay/replay_controller.h"
@@ -36,8 +38,15 @@
 #include "strings/string_utils.h"
 #include "replay_proxy.h"
 
+// changes to the protocol within a release, so that builds from either side of a change don't
+// try to talk to each other:
+// 1 - capture copies are resumable and compressed, and start with each side's transfer state
+// 2 - the reply to opening a capture carries the server's proxy data cache budget
+static const uint32_t RemoteServerProtocolRevision = 2;
+
 static const uint32_t RemoteServerProtocolVersion =
-    uint32_t(RENDERDOC_VERSION_MAJOR * 1000) | RENDERDOC_VERSION_MINOR;
+    (uint32_t(RENDERDOC_VERSION_MAJOR * 1000) | RENDERDOC_VERSION_MINOR) * 100 +
+    RemoteServerProtocolRevision;
 
 enum RemoteServerPacket
 {
@@ -78,10 +87,104 @@ RDCCOMPILE_ASSERT((int)eRemoteServer_RemoteServerCount < (int)eReplayProxy_First
 #define WRITE_DATA_SCOPE() WriteSerialiser &ser = writer;
 #define READ_DATA_SCOPE() ReadSerialiser &ser = reader;
 
+// captures copied to us, by the size and hash of the file they were copied from. If a client sends
+// the same capture again we can skip the copy, or resume it if the last one was interrupted. Several
+// sessions can be using the same copy at once, so each holds a reference and the file is only
+// deleted once the last one is done with it.
+struct ReceivedCopy
+{
+  std::string path;
+  int32_t refs = 0;
+  // set while a session is writing into the file
+  bool receiving = false;
+};
+
+static Threading::CriticalSection receivedCopiesLock;
+static std::map<std::pair<uint64_t, uint64_t>, ReceivedCopy> receivedCopies;
+static uint32_t receivedCopySerial = 0;
+
+// must be called with receivedCopiesLock held
+static std::string NewReceivedCopyPath()
+{
+  std::string path, dummy, dummy2;
+  FileIO::GetDefaultFiles("remotecopy", path, dummy, dummy2);
+
+  // the default name only changes every minute, so make sure each copy gets its own file
+  if(path.size() > 4 && path.substr(path.size() - 4) == ".rdc")
+    path.erase(path.size() - 4);
+
+  return path + StringFormat::Fmt("_%u.rdc", receivedCopySerial++);
+}
+
+// returns the path to receive the capture into, with a reference held on it for the caller which
+// must be released with ReleaseReceivedCopy once it's done receiving or replaying it.
+static std::string AcquireReceivedCopy(const CaptureTransferState &source)
+{
+  SCOPED_LOCK(receivedCopiesLock);
+
+  ReceivedCopy &copy = receivedCopies[std::make_pair(source.size, source.hash)];
+
+  // don't write into a file that another session is still receiving, take a private copy instead.
+  // That won't be found in the list, so it's deleted as soon as it's released.
+  if(copy.receiving)
+    return NewReceivedCopyPath();
+
+  if(copy.path.empty())
+    copy.path = NewReceivedCopyPath();
+
+  copy.refs++;
+  copy.receiving = true;
+
+  return copy.path;
+}
+
+// marks that the caller is done writing into a copy, but still holds its reference
+static void FinishReceivingCopy(const std::string &path)
+{
+  SCOPED_LOCK(receivedCopiesLock);
+
+  for(auto it = receivedCopies.begin(); it != receivedCopies.end(); ++it)
+  {
+    if(it->second.path == path)
+    {
+      it->second.receiving = false;
+      return;
+    }
+  }
+}
+
+// drops the caller's reference. When it's the last the file is deleted unless keepPartial is set,
+// in which case it's kept around for a later session to resume the copy into
+static void ReleaseReceivedCopy(const std::string &path, bool keepPartial)
+{
+  SCOPED_LOCK(receivedCopiesLock);
+
+  for(auto it = receivedCopies.begin(); it != receivedCopies.end(); ++it)
+  {
+    if(it->second.path == path)
+    {
+      it->second.receiving = false;
+
+      if(--it->second.refs > 0 || keepPartial)
+        return;
+
+      receivedCopies.erase(it);
+      break;
+    }
+  }
+
+  FileIO::Delete(path.c_str());
+}
+
 struct ClientThread
 {
   ClientThread()
-      : socket(NULL), allowExecution(false), killThread(false), killServer(false), thread(0)
+      : socket(NULL),
+        allowExecution(false),
+        killThread(false),
+        killServer(false),
+        cacheBudget(0),
+        thread(0)
   {
   }
 
@@ -91,9 +194,38 @@ struct ClientThread
   bool killThread;
   bool killServer;
 
+  // how much resource data the session's replay proxy may cache, or 0 for the default
+  uint64_t cacheBudget;
+
   Threading::ThreadHandle thread;
 };
 
+// loading a capture reports progress through the global progress callback, so sessions take turns
+// to load. Once loaded, captures replay concurrently.
+static Threading::CriticalSection captureLoadLock;
+
+// there's only one preview window, which belongs to whichever session claimed it first
+static Threading::CriticalSection previewLock;
+static ClientThread *previewOwner = NULL;
+
+static bool ClaimPreviewWindow(ClientThread *threadData)
+{
+  SCOPED_LOCK(previewLock);
+
+  if(previewOwner == NULL)
+    previewOwner = threadData;
+
+  return previewOwner == threadData;
+}
+
+static void ReleasePreviewWindow(ClientThread *threadData)
+{
+  SCOPED_LOCK(previewLock);
+
+  if(previewOwner == threadData)
+    previewOwner = NULL;
+}
+
 static void InactiveRemoteClientThread(ClientThread *threadData)
 {
   uint32_t ip = threadData->socket->GetRemoteIP();
@@ -200,6 +332,8 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
   }
 
   std::vector<std::string> tempFiles;
+  // received copies this session holds a reference on
+  std::vector<std::string> heldCopies;
   IRemoteDriver *remoteDriver = NULL;
   IReplayDriver *replayDriver = NULL;
   ReplayProxy *proxy = NULL;
@@ -293,10 +427,12 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     else if(type == eRemoteServer_CopyCaptureFromRemote)
     {
       std::string path;
+      CaptureTransferState state;
 
       {
         READ_DATA_SCOPE();
         SERIALISE_ELEMENT(path);
+        SERIALISE_ELEMENT(state);
       }
 
       reader.EndChunk();
@@ -305,41 +441,70 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
         WRITE_DATA_SCOPE();
         SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureFromRemote);
 
-        StreamReader fileStream(FileIO::fopen(path.c_str(), "rb"));
-        ser.SerialiseStream(path, fileStream);
+        CaptureTransfer::Send(ser, path.c_str(), state, RENDERDOC_ProgressCallback());
       }
     }
     else if(type == eRemoteServer_CopyCaptureToRemote)
     {
-      std::string path;
-      std::string dummy, dummy2;
-      FileIO::GetDefaultFiles("remotecopy", path, dummy, dummy2);
+      CaptureTransferState source;
+
+      {
+        READ_DATA_SCOPE();
+        SERIALISE_ELEMENT(source);
+      }
+
+      reader.EndChunk();
+
+      // if we've been sent this capture before we reuse the same file, so that the client only
+      // sends what we don't have yet.
+      std::string path = AcquireReceivedCopy(source);
 
       RDCLOG("Copying file to local path '%s'.", path.c_str());
 
       FileIO::CreateParentDirectory(path);
 
       {
-        READ_DATA_SCOPE();
+        WRITE_DATA_SCOPE();
+        SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
+        CaptureTransferState state = CaptureTransfer::GetLocalState(path.c_str());
+        SERIALISE_ELEMENT(state);
+      }
 
-        StreamWriter streamWriter(FileIO::fopen(path.c_str(), "wb"), Ownership::Stream);
+      bool success = false;
+
+      type = reader.ReadChunk<RemoteServerPacket>();
 
-        ser.SerialiseStream(path.c_str(), streamWriter, NULL);
+      if(type == eRemoteServer_CopyCaptureToRemote)
+      {
+        READ_DATA_SCOPE();
+        success = CaptureTransfer::Receive(ser, path.c_str(), NULL);
       }
 
       reader.EndChunk();
 
+      // keep what we received so far, if the client reconnects and sends the same capture again
+      // we'll pick up from here.
       if(reader.IsErrored())
       {
-        FileIO::Delete(path.c_str());
-
         RDCERR("Network error receiving file");
+        ReleaseReceivedCopy(path, true);
         break;
       }
 
-      RDCLOG("File received.");
+      if(success)
+      {
+        RDCLOG("File received.");
 
-      tempFiles.push_back(path);
+        FinishReceivingCopy(path);
+        heldCopies.push_back(path);
+      }
+      else
+      {
+        RDCERR("Failed to receive file");
+
+        ReleaseReceivedCopy(path, false);
+        path.clear();
+      }
 
       {
         WRITE_DATA_SCOPE();
@@ -415,8 +580,7 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
           bool kill = false;
           float progress = 0.0f;
 
-          RenderDoc::Inst().SetProgressCallback<LoadProgress>([&progress](float p) { progress = p; });
-
+          // the ticker starts before we wait for our turn to load, so the client knows we're alive
           Threading::ThreadHandle ticker = Threading::CreateThread([&writer, &kill, &progress]() {
             while(!kill)
             {
@@ -429,36 +593,44 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
             }
           });
 
-          // if we have a replay driver, try to create it so we can display a local preview e.g.
-          if(RenderDoc::Inst().HasReplayDriver(rdc->GetDriver()))
           {
-            status = RenderDoc::Inst().CreateReplayDriver(rdc, &replayDriver);
-            if(replayDriver)
-              remoteDriver = replayDriver;
-          }
-          else
-          {
-            status = RenderDoc::Inst().CreateRemoteDriver(rdc, &remoteDriver);
-          }
+            SCOPED_LOCK(captureLoadLock);
 
-          if(status != ReplayStatus::Succeeded || remoteDriver == NULL)
-          {
-            RDCERR("Failed to create remote driver for driver '%s'", rdc->GetDriverName().c_str());
-          }
-          else
-          {
-            status = remoteDriver->ReadLogInitialisation(rdc, false);
+            RenderDoc::Inst().SetProgressCallback<LoadProgress>(
+                [&progress](float p) { progress = p; });
+
+            // if we have a replay driver, try to create it so we can display a local preview e.g.
+            if(RenderDoc::Inst().HasReplayDriver(rdc->GetDriver()))
+            {
+              status = RenderDoc::Inst().CreateReplayDriver(rdc, &replayDriver);
+              if(replayDriver)
+                remoteDriver = replayDriver;
+            }
+            else
+            {
+              status = RenderDoc::Inst().CreateRemoteDriver(rdc, &remoteDriver);
+            }
 
-            if(status != ReplayStatus::Succeeded)
+            if(status != ReplayStatus::Succeeded || remoteDriver == NULL)
+            {
+              RDCERR("Failed to create remote driver for driver '%s'",
+                     rdc->GetDriverName().c_str());
+            }
+            else
             {
-              RDCERR("Failed to initialise remote driver.");
+              status = remoteDriver->ReadLogInitialisation(rdc, false);
+
+              if(status != ReplayStatus::Succeeded)
+              {
+                RDCERR("Failed to initialise remote driver.");
 
-              remoteDriver->Shutdown();
-              remoteDriver = NULL;
+                remoteDriver->Shutdown();
+                remoteDriver = NULL;
+              }
             }
-          }
 
-          RenderDoc::Inst().SetProgressCallback<LoadProgress>(RENDERDOC_ProgressCallback());
+            RenderDoc::Inst().SetProgressCallback<LoadProgress>(RENDERDOC_ProgressCallback());
+          }
 
           kill = true;
           Threading::JoinThread(ticker);
@@ -466,7 +638,11 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
 
           if(status == ReplayStatus::Succeeded && remoteDriver)
           {
-            proxy = new ReplayProxy(reader, writer, remoteDriver, replayDriver, previewWindow);
+            proxy = new ReplayProxy(reader, writer, remoteDriver, replayDriver,
+                                    ClaimPreviewWindow(threadData) ? previewWindow : NULL);
+
+            if(threadData->cacheBudget > 0)
+              proxy->SetDataCacheBudget(threadData->cacheBudget);
           }
         }
         else
@@ -481,6 +657,10 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
         WRITE_DATA_SCOPE();
         SCOPED_SERIALISE_CHUNK(eRemoteServer_LogOpened);
         SERIALISE_ELEMENT(status);
+
+        // the client's proxy should use the same cache budget as ours
+        uint64_t cacheBudget = threadData->cacheBudget;
+        SERIALISE_ELEMENT(cacheBudget);
       }
     }
     else if(type == eRemoteServer_HasCallstacks)
@@ -563,12 +743,11 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
 
       if(resolver)
       {
-        StackFrames.reserve(StackAddresses.size());
-        for(uint64_t frame : StackAddresses)
-        {
-          Callstack::AddressDetails info = resolver->GetAddr(frame);
+        rdcarray<Callstack::AddressDetails> details = resolver->GetAddrs(StackAddresses);
+
+        StackFrames.reserve(details.size());
+        for(Callstack::AddressDetails &info : details)
           StackFrames.push_back(info.formattedString());
-        }
       }
       else
       {
@@ -723,6 +902,7 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
       reader.EndChunk();
 
       SAFE_DELETE(proxy);
+      ReleasePreviewWindow(threadData);
 
       if(remoteDriver)
         remoteDriver->Shutdown();
@@ -779,6 +959,7 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
   }
 
   SAFE_DELETE(proxy);
+  ReleasePreviewWindow(threadData);
 
   if(remoteDriver)
     remoteDriver->Shutdown();
@@ -787,9 +968,14 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
   SAFE_DELETE(rdc);
   SAFE_DELETE(resolver);
 
+  // other sessions may still be using the copies we received, so only drop our references
+  for(const std::string &path : heldCopies)
+    ReleaseReceivedCopy(path, false);
+
   for(size_t i = 0; i < tempFiles.size(); i++)
   {
-    FileIO::Delete(tempFiles[i].c_str());
+    if(std::find(heldCopies.begin(), heldCopies.end(), tempFiles[i]) == heldCopies.end())
+      FileIO::Delete(tempFiles[i].c_str());
   }
 
   RDCLOG("Closing active connection from %u.%u.%u.%u.", Network::GetIPOctet(ip, 0),
@@ -811,6 +997,8 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
 
   std::vector<std::pair<uint32_t, uint32_t> > listenRanges;
   bool allowExecution = true;
+  uint32_t maxClients = 1;
+  uint64_t sessionMemory = 0;
 
   FILE *f = FileIO::fopen(FileIO::GetAppFolderFilename("remoteserver.conf").c_str(), "r");
 
@@ -850,6 +1038,28 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
 
       continue;
     }
+    else if(line.substr(0, sizeof("maxclients") - 1) == "maxclients")
+    {
+      int num = atoi(line.substr(sizeof("maxclients") - 1).c_str());
+
+      if(num > 0)
+        maxClients = (uint32_t)num;
+      else
+        RDCLOG("Couldn't parse client count from: %s", line.c_str());
+
+      continue;
+    }
+    else if(line.substr(0, sizeof("sessionmemory") - 1) == "sessionmemory")
+    {
+      int num = atoi(line.substr(sizeof("sessionmemory") - 1).c_str());
+
+      if(num > 0)
+        sessionMemory = uint64_t(num) * 1024 * 1024;
+      else
+        RDCLOG("Couldn't parse session memory from: %s", line.c_str());
+
+      continue;
+    }
 
     RDCLOG("Malformed line '%s'. See documentation for file format.", line.c_str());
   }
@@ -887,9 +1097,14 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
   else
     RDCLOG("Blocking execution commands");
 
+  RDCLOG("Allowing %u concurrent connection(s)", maxClients);
+
+  if(sessionMemory > 0)
+    RDCLOG("Caching up to %llu MB of resource data per connection", sessionMemory / (1024 * 1024));
+
   RDCLOG("Replay host ready for requests...");
 
-  ClientThread *activeClientData = NULL;
+  std::vector<ClientThread *> actives;
 
   std::vector<ClientThread *> inactives;
 
@@ -897,7 +1112,11 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
   {
     Network::Socket *client = sock->AcceptClient(0);
 
-    if(activeClientData && activeClientData->killServer)
+    bool killServer = false;
+    for(ClientThread *active : actives)
+      killServer |= active->killServer;
+
+    if(killServer)
       break;
 
     // reap any dead inactive threads
@@ -913,14 +1132,17 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
       }
     }
 
-    // reap our active connection possibly
-    if(activeClientData && activeClientData->socket == NULL)
+    // reap any finished active connections
+    for(size_t i = 0; i < actives.size(); i++)
     {
-      Threading::JoinThread(activeClientData->thread);
-      Threading::CloseThread(activeClientData->thread);
-
-      delete activeClientData;
-      activeClientData = NULL;
+      if(actives[i]->socket == NULL)
+      {
+        Threading::JoinThread(actives[i]->thread);
+        Threading::CloseThread(actives[i]->thread);
+        delete actives[i];
+        actives.erase(actives.begin() + i);
+        break;
+      }
     }
 
     if(client == NULL)
@@ -964,17 +1186,19 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
       continue;
     }
 
-    if(activeClientData == NULL)
+    if(actives.size() < maxClients)
     {
-      activeClientData = new ClientThread();
-      activeClientData->socket = client;
-      activeClientData->allowExecution = allowExecution;
+      ClientThread *active = new ClientThread();
+      active->socket = client;
+      active->allowExecution = allowExecution;
+      active->cacheBudget = sessionMemory;
 
-      activeClientData->thread = Threading::CreateThread([activeClientData, previewWindow]() {
-        ActiveRemoteClientThread(activeClientData, previewWindow);
-      });
+      active->thread = Threading::CreateThread(
+          [active, previewWindow]() { ActiveRemoteClientThread(active, previewWindow); });
 
-      RDCLOG("Making active connection");
+      actives.push_back(active);
+
+      RDCLOG("Making active connection (%zu of %u)", actives.size(), maxClients);
     }
     else
     {
@@ -991,14 +1215,14 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
     }
   }
 
-  if(activeClientData && activeClientData->socket != NULL)
-  {
-    activeClientData->killThread = true;
-
-    Threading::JoinThread(activeClientData->thread);
-    Threading::CloseThread(activeClientData->thread);
+  for(ClientThread *active : actives)
+    active->killThread = true;
 
-    delete activeClientData;
+  for(ClientThread *active : actives)
+  {
+    Threading::JoinThread(active->thread);
+    Threading::CloseThread(active->thread);
+    delete active;
   }
 
   // shut down client threads
@@ -1009,6 +1233,16 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
     delete inactives[i];
   }
 
+  // anything left over is from copies that were interrupted and never resumed
+  {
+    SCOPED_LOCK(receivedCopiesLock);
+
+    for(auto it = receivedCopies.begin(); it != receivedCopies.end(); ++it)
+      FileIO::Delete(it->second.path.c_str());
+
+    receivedCopies.clear();
+  }
+
   SAFE_DELETE(sock);
 }
 
@@ -1303,6 +1537,10 @@ public:
       WRITE_DATA_SCOPE();
       SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureFromRemote);
       SERIALISE_ELEMENT(path);
+
+      // if we already have some or all of the capture at this path, only the rest is sent
+      CaptureTransferState state = CaptureTransfer::GetLocalState(localpath);
+      SERIALISE_ELEMENT(state);
     }
 
     {
@@ -1311,9 +1549,8 @@ public:
 
       if(type == eRemoteServer_CopyCaptureFromRemote)
       {
-        StreamWriter streamWriter(FileIO::fopen(localpath, "wb"), Ownership::Stream);
-
-        ser.SerialiseStream(localpath, streamWriter, progress);
+        if(!CaptureTransfer::Receive(ser, localpath, progress))
+          RDCERR("Failed to copy capture to '%s'", localpath);
 
         if(ser.IsErrored())
         {
@@ -1335,9 +1572,35 @@ public:
     {
       WRITE_DATA_SCOPE();
       SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
+      CaptureTransferState source = CaptureTransfer::GetLocalState(filename);
+      SERIALISE_ELEMENT(source);
+    }
+
+    // the server tells us what it already has of this capture
+    CaptureTransferState state;
+
+    {
+      READ_DATA_SCOPE();
+      RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
 
-      StreamReader fileStream(FileIO::fopen(filename, "rb"));
-      ser.SerialiseStream(filename, fileStream, progress);
+      if(type == eRemoteServer_CopyCaptureToRemote)
+      {
+        SERIALISE_ELEMENT(state);
+      }
+      else
+      {
+        RDCERR("Unexpected response to capture copy request");
+        ser.EndChunk();
+        return "";
+      }
+
+      ser.EndChunk();
+    }
+
+    {
+      WRITE_DATA_SCOPE();
+      SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
+      CaptureTransfer::Send(ser, filename, state, progress);
     }
 
     std::string path;
@@ -1429,9 +1692,11 @@ public:
     }
 
     ReplayStatus status = ReplayStatus::Succeeded;
+    uint64_t cacheBudget = 0;
     {
       READ_DATA_SCOPE();
       SERIALISE_ELEMENT(status);
+      SERIALISE_ELEMENT(cacheBudget);
       ser.EndChunk();
     }
 
@@ -1462,6 +1727,10 @@ public:
     ReplayController *rend = new ReplayController();
 
     ReplayProxy *proxy = new ReplayProxy(reader, writer, proxyDriver);
+
+    if(cacheBudget > 0)
+      proxy->SetDataCacheBudget(cacheBudget);
+
     status = rend->SetDevice(proxy);
 
     if(status != ReplayStatus::Succeeded)
@@ -24,6 +24,8 @@
  ******************************************************************************/
 
 #include "replay_proxy.h"
+#include <algorithm>
+#include <unordered_map>
 #include "3rdparty/lz4/lz4.h"
 #include "serialise/lz4io.h"
 
@@ -197,6 +199,21 @@ ReplayProxy::~ReplayProxy()
 
   for(auto it = m_ShaderReflectionCache.begin(); it != m_ShaderReflectionCache.end(); ++it)
     delete it->second;
+
+  CacheStatistics stats = GetCacheStatistics();
+
+  auto logStats = [](const char *name, const ProxyDataCacheStats &cache) {
+    if(cache.hits + cache.misses > 0)
+      RDCLOG("%s cache: %llu hits, %llu misses, %llu evictions, %llu bytes", name, cache.hits,
+             cache.misses, cache.evictions, cache.bytes);
+  };
+
+  logStats("Proxy texture data", stats.textureData);
+  logStats("Proxy buffer data", stats.bufferData);
+  logStats("Proxy event data", stats.eventData);
+
+  if(stats.prefetched > 0)
+    RDCLOG("Prefetched %llu texture subresources, %llu used", stats.prefetched, stats.prefetchHits);
 }
 
 #pragma region Proxied Functions
@@ -850,15 +867,25 @@ void ReplayProxy::Proxied_GetTextureData(ParamSerialiser &paramser, ReturnSerial
   const ReplayProxyPacket expectedPacket = eReplayProxy_GetTextureData;
   ReplayProxyPacket packet = eReplayProxy_GetTextureData;
 
+  TextureCacheEntry entry = {tex, arrayIdx, mip};
+
+  // the client's cached copy, which the data is delta'd against if we still have the same
+  uint64_t refHash = 0;
+  if(paramser.IsWriting())
+    refHash = HashDeltaReference(m_ProxyTextureData.Peek(entry));
+
   {
     BEGIN_PARAMS();
     SERIALISE_ELEMENT(tex);
     SERIALISE_ELEMENT(arrayIdx);
     SERIALISE_ELEMENT(mip);
     SERIALISE_ELEMENT(params);
+    SERIALISE_ELEMENT(refHash);
     END_PARAMS();
   }
 
+  entry = {tex, arrayIdx, mip};
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -1332,6 +1359,10 @@ void ReplayProxy::Proxied_ReplaceResource(ParamSerialiser &paramser, ReturnSeria
       m_Remote->ReplaceResource(from, to);
   }
 
+  // contents at any event could now be different
+  if(retser.IsReading())
+    m_EventData.Clear();
+
   SERIALISE_RETURN_VOID();
 }
 
@@ -1359,6 +1390,10 @@ void ReplayProxy::Proxied_RemoveReplacement(ParamSerialiser &paramser, ReturnSer
       m_Remote->RemoveReplacement(id);
   }
 
+  // contents at any event could now be different
+  if(retser.IsReading())
+    m_EventData.Clear();
+
   SERIALISE_RETURN_VOID();
 }
 
@@ -1662,6 +1697,10 @@ void ReplayProxy::Proxied_ReplayLog(ParamSerialiser &paramser, ReturnSerialiser
   {
     m_TextureProxyCache.clear();
     m_BufferProxyCache.clear();
+    m_PrefetchedTextures.clear();
+
+    // partway through an event the contents don't match what we'd cache for it
+    m_EventDataCacheable = (replayType != eReplay_WithoutDraw);
   }
 
   m_EventID = endEventID;
@@ -1708,7 +1747,8 @@ void ReplayProxy::Proxied_FetchStructuredFile(ParamSerialiser &paramser, ReturnS
       if(retser.IsReading())
         file->chunks[c] = new SDChunk("");
 
-      ser.Serialise("chunk", *file->chunks[c]);
+      // the remote file may be lazily loaded, fetch each chunk's contents as it's sent
+      ser.Serialise("chunk", retser.IsReading() ? *file->chunks[c] : *file->GetChunk(c));
     }
 
     uint64_t bufferCount = file->buffers.size();
@@ -1740,33 +1780,163 @@ void ReplayProxy::FetchStructuredFile()
   PROXY_FUNCTION(FetchStructuredFile);
 }
 
-struct DeltaSection
+// a range of the new data that's copied from elsewhere in the reference data, for data that has
+// moved. Anything not covered by a copy or a literal is unchanged at the same offset.
+struct DeltaCopy
 {
-  uint64_t offs = 0;
-  bytebuf contents;
+  uint64_t offs;
+  uint64_t refOffs;
+  uint64_t length;
 };
 
-DECLARE_REFLECTION_STRUCT(DeltaSection);
+DECLARE_REFLECTION_STRUCT(DeltaCopy);
 
 template <typename SerialiserType>
-void DoSerialise(SerialiserType &ser, DeltaSection &el)
+void DoSerialise(SerialiserType &ser, DeltaCopy &el)
 {
   SERIALISE_MEMBER(offs);
-  SERIALISE_MEMBER(contents);
+  SERIALISE_MEMBER(refOffs);
+  SERIALISE_MEMBER(length);
+}
+
+// a range of the new data that's sent as-is. The bytes themselves follow all of the ranges
+struct DeltaLiteral
+{
+  uint64_t offs;
+  uint64_t length;
+};
+
+DECLARE_REFLECTION_STRUCT(DeltaLiteral);
+
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, DeltaLiteral &el)
+{
+  SERIALISE_MEMBER(offs);
+  SERIALISE_MEMBER(length);
+}
+
+// differing ranges closer together than this are sent as one literal, since each range costs about
+// this much to describe anyway.
+static const size_t DeltaMergeGap = 32;
+
+// differing ranges smaller than this are always sent as literals. Larger ones are split into
+// content-defined chunks and each chunk is looked up in the reference data, in case it moved.
+static const size_t DeltaMinSearchSize = 512;
+
+// content-defined chunks are cut where a rolling hash of the last 64 bytes has its top 8 bits
+// clear, giving chunks of ~320 bytes on average. Since the cut points only depend on the contents
+// the chunking of data that has been shifted re-synchronises with the reference after a chunk or
+// two.
+static const size_t DeltaMinChunkSize = 64;
+static const size_t DeltaMaxChunkSize = 4096;
+
+static const uint64_t *DeltaGearTable()
+{
+  struct GearTable
+  {
+    GearTable()
+    {
+      // splitmix64, any fixed random values will do. Only the sending side chunks data
+      uint64_t state = 0x6a09e667f3bcc908ULL;
+      for(uint64_t &g : values)
+      {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        g = z ^ (z >> 31);
+      }
+    }
+
+    uint64_t values[256];
+  };
+
+  static GearTable table;
+  return table.values;
+}
+
+// returns the end of the content-defined chunk starting at begin, no further than end
+static size_t NextDeltaChunk(const byte *data, size_t begin, size_t end)
+{
+  const uint64_t *gear = DeltaGearTable();
+
+  end = RDCMIN(end, begin + DeltaMaxChunkSize);
+
+  // each byte is shifted out of the hash after 64 more, so once we've hashed the minimum chunk size
+  // the hash doesn't depend on where we started.
+  uint64_t hash = 0;
+  for(size_t i = begin; i < end; i++)
+  {
+    hash = (hash << 1) + gear[data[i]];
+
+    if(i - begin >= DeltaMinChunkSize - 1 && (hash >> 56) == 0)
+      return i + 1;
+  }
+
+  return end;
+}
+
+// a plain hash of a chunk's contents, to look it up in the reference data. Matches are always
+// verified so this only needs to be fast and well distributed.
+static uint64_t HashDeltaChunk(const byte *data, size_t length)
+{
+  uint64_t hash = length * 0x9e3779b97f4a7c15ULL;
+
+  size_t i = 0;
+  for(; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t))
+  {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 32;
+  }
+
+  for(; i < length; i++)
+    hash = (hash ^ data[i]) * 0x100000001b3ULL;
+
+  return hash ^ (hash >> 29);
+}
+
+uint64_t ReplayProxy::HashDeltaReference(const bytebuf *referenceData)
+{
+  // 0 means there's no reference, which the hash of empty data already is
+  if(referenceData == NULL || referenceData->empty())
+    return 0;
+
+  return HashDeltaChunk(referenceData->data(), referenceData->size());
 }
 
 template <typename SerialiserType>
-void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &referenceData, bytebuf &newData)
+bool ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &referenceData,
+                                     bytebuf &newData, uint64_t receiverRefHash)
 {
   char empty[128] = {};
 
-  // we use a list so that we don't have to reserve and pushing new sections will never cause
-  // previous ones to be reallocated and move around lots of data.
-  std::list<DeltaSection> deltas;
+  uint64_t newSize = 0;
+  rdcarray<DeltaCopy> copies;
+  rdcarray<DeltaLiteral> literals;
+
+  // the reference the data was delta'd against, or 0 if it's sent in full
+  uint64_t refHash = 0;
 
   // lz4 compress
   if(xferser.IsReading())
   {
+    xferser.Serialise("refHash", refHash);
+
+    bool matched = true;
+
+    if(refHash == 0)
+    {
+      // anything we had is replaced
+      referenceData.clear();
+    }
+    else if(refHash != receiverRefHash)
+    {
+      // we still have to read everything to stay in sync, but the result is meaningless
+      RDCERR("Delta sent against reference %llx but ours is %llx", refHash, receiverRefHash);
+      matched = false;
+    }
+
     uint64_t uncompSize = 0;
     xferser.Serialise("uncompSize", uncompSize);
 
@@ -1774,192 +1944,247 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
     {
       // fast path - no changes.
       RDCDEBUG("Unchanged");
-      return;
+
+      if(!matched)
+        referenceData.clear();
+
+      return matched;
     }
-    else
+
+    ReadSerialiser ser(
+        new StreamReader(new LZ4Decompressor(xferser.GetReader(), Ownership::Nothing), uncompSize,
+                         Ownership::Stream),
+        Ownership::Stream);
+
+    SERIALISE_ELEMENT(newSize);
+    SERIALISE_ELEMENT(copies);
+    SERIALISE_ELEMENT(literals);
+
+    // copies read from the reference data as it was before any of this delta is applied. Most
+    // read from ranges that nothing writes to, so those can be applied in place. Only the sources
+    // that are written over or truncated away are saved first.
+    const uint64_t prevSize = referenceData.size();
+
+    // everything the delta writes, sorted by offset. The copies and literals are each in order and
+    // never overlap each other.
+    rdcarray<rdcpair<uint64_t, uint64_t>> written;
+    written.reserve(copies.size() + literals.size());
     {
+      size_t c = 0, l = 0;
+      while(c < copies.size() || l < literals.size())
       {
-        ReadSerialiser ser(
-            new StreamReader(new LZ4Decompressor(xferser.GetReader(), Ownership::Nothing),
-                             uncompSize, Ownership::Stream),
-            Ownership::Stream);
+        if(l == literals.size() || (c < copies.size() && copies[c].offs < literals[l].offs))
+        {
+          written.push_back(make_rdcpair(copies[c].offs, copies[c].offs + copies[c].length));
+          c++;
+        }
+        else
+        {
+          written.push_back(make_rdcpair(literals[l].offs, literals[l].offs + literals[l].length));
+          l++;
+        }
+      }
+    }
 
-        SERIALISE_ELEMENT(deltas);
+    auto isWritten = [&written](uint64_t begin, uint64_t end) {
+      // find the first write that ends after begin
+      auto it = std::lower_bound(
+          written.begin(), written.end(), begin,
+          [](const rdcpair<uint64_t, uint64_t> &w, uint64_t offs) { return w.second <= offs; });
+      return it != written.end() && it->first < end;
+    };
 
-        // add any necessary padding.
-        uint64_t offs = ser.GetReader()->GetOffset();
-        RDCASSERT(offs <= uncompSize, offs, uncompSize);
-        RDCASSERT(uncompSize - offs < sizeof(empty), offs, uncompSize);
+    bytebuf saved;
+    // the offset of each copy's source in saved, or ~0 if it's applied in place
+    rdcarray<uint64_t> savedOffs;
+    savedOffs.resize(copies.size());
 
-        ser.GetReader()->Read(empty, uncompSize - offs);
-      }
+    for(size_t i = 0; i < copies.size(); i++)
+    {
+      DeltaCopy &copy = copies[i];
 
-      if(deltas.empty())
+      if(copy.refOffs + copy.length > prevSize || copy.offs + copy.length > newSize)
       {
-        RDCERR("Unexpected empty delta list");
+        RDCERR("Copy {%llu, %llu} from %llu out of bounds of reference data (%llu -> %llu bytes)",
+               copy.offs, copy.length, copy.refOffs, prevSize, newSize);
+        copy.length = 0;
+        continue;
       }
-      else if(referenceData.empty())
-      {
-        // if we don't have reference data we blat the whole contents.
-        // in this case we only expect one delta with the whole range
-        if(deltas.size() != 1)
-          RDCERR("Got more than one delta with no reference data - taking first delta.");
 
-        referenceData = deltas.front().contents;
-        RDCDEBUG("Creating new reference data, %llu bytes", (uint64_t)referenceData.size());
+      const uint64_t srcEnd = copy.refOffs + copy.length;
+
+      if(srcEnd <= newSize && !isWritten(copy.refOffs, srcEnd))
+      {
+        savedOffs[i] = ~0ULL;
       }
       else
       {
-        uint64_t deltaBytes = 0;
+        savedOffs[i] = saved.size();
+        saved.append(referenceData.data() + (size_t)copy.refOffs, (size_t)copy.length);
+      }
+    }
 
-        // apply deltas to refData
-        for(const DeltaSection &delta : deltas)
-        {
-          if(delta.offs + delta.contents.size() > referenceData.size())
-          {
-            RDCERR("{%llu, %llu} larger than reference data (%llu bytes) - expanding to fit.",
-                   delta.offs, (uint64_t)delta.contents.size(), (uint64_t)referenceData.size());
+    if(referenceData.empty())
+      RDCDEBUG("Creating new reference data, %llu bytes", newSize);
 
-            referenceData.resize(size_t(delta.offs + delta.contents.size()));
-          }
+    referenceData.resize((size_t)newSize);
 
-          byte *dst = referenceData.data() + (ptrdiff_t)delta.offs;
-          const byte *src = delta.contents.data();
+    uint64_t deltaBytes = 0;
 
-          memcpy(dst, src, delta.contents.size());
+    for(size_t i = 0; i < copies.size(); i++)
+    {
+      const DeltaCopy &copy = copies[i];
 
-          deltaBytes += (uint64_t)delta.contents.size();
-        }
+      if(copy.length == 0)
+        continue;
 
-        RDCDEBUG("Applied %u deltas data, %llu total delta bytes to %llu resource size",
-                 (uint32_t)deltas.size(), deltaBytes, (uint64_t)referenceData.size());
+      // sources applied in place can't be written by any other copy, so order doesn't matter
+      const byte *src = savedOffs[i] == ~0ULL ? referenceData.data() + (size_t)copy.refOffs
+                                              : saved.data() + (size_t)savedOffs[i];
+
+      memcpy(referenceData.data() + (size_t)copy.offs, src, (size_t)copy.length);
+    }
+
+    for(const DeltaLiteral &literal : literals)
+    {
+      if(literal.offs + literal.length > newSize)
+      {
+        RDCERR("{%llu, %llu} larger than reference data (%llu bytes)", literal.offs,
+               literal.length, newSize);
+        ser.GetReader()->SkipBytes(literal.length);
+        continue;
       }
+
+      ser.GetReader()->Read(referenceData.data() + (size_t)literal.offs, literal.length);
+
+      deltaBytes += literal.length;
     }
+
+    // add any necessary padding.
+    uint64_t offs = ser.GetReader()->GetOffset();
+    RDCASSERT(offs <= uncompSize, offs, uncompSize);
+    RDCASSERT(uncompSize - offs < sizeof(empty), offs, uncompSize);
+
+    ser.GetReader()->Read(empty, uncompSize - offs);
+
+    RDCDEBUG("Applied %u copies and %u literals, %llu total literal bytes to %llu resource size",
+             (uint32_t)copies.size(), (uint32_t)literals.size(), deltaBytes, newSize);
+
+    if(!matched)
+      referenceData.clear();
+
+    return matched;
   }
   else
   {
-    uint64_t uncompSize = 0;
+    newSize = newData.size();
+
+    refHash = HashDeltaReference(&referenceData);
+
+    // if the receiver has different reference data (e.g. it evicted it from its cache and we
+    // didn't, or vice-versa) we can't delta against ours, so send everything.
+    if(refHash != receiverRefHash)
+    {
+      RDCDEBUG("Reference data doesn't match receiver's, sending %llu bytes in full", newSize);
+      referenceData.clear();
+      refHash = 0;
+    }
+
+    xferser.Serialise("refHash", refHash);
+
+    auto addLiteral = [&literals](size_t offs, size_t length) {
+      if(!literals.empty() && literals.back().offs + literals.back().length == offs)
+        literals.back().length += length;
+      else
+        literals.push_back({offs, length});
+    };
 
     if(referenceData.empty())
     {
       // no previous reference data, need to transfer the whole object.
-      deltas.resize(1);
-      deltas.back().contents = newData;
+      if(newSize > 0)
+        addLiteral(0, (size_t)newSize);
     }
     else
     {
-      if(referenceData.size() != newData.size())
-      {
-        RDCERR("Reference data existed at %llu bytes, but new data is now %llu bytes",
-               referenceData.size(), newData.size());
+      const byte *src = newData.data();
+      const byte *ref = referenceData.data();
+      const size_t refSize = referenceData.size();
+      const size_t commonSize = RDCMIN((size_t)newSize, refSize);
 
-        // re-transfer the whole block, something went seriously wrong if the resource changed size.
-        deltas.resize(1);
-        deltas.back().contents = newData;
-      }
-      else
+      // find what's changed in place first. This is the common case by far - e.g. a pixel-wide
+      // line drawn down a texture only sends the pixels that changed.
+      rdcarray<rdcpair<size_t, size_t>> ranges;
+      FindDiffRanges(src, ref, commonSize, DeltaMergeGap, ranges);
+
+      if(newSize > commonSize)
+        ranges.push_back(make_rdcpair(commonSize, (size_t)newSize));
+
+      // content-defined chunks of the reference data by hash, only built if we need it
+      std::unordered_map<uint64_t, size_t> refChunks;
+
+      for(const rdcpair<size_t, size_t> &range : ranges)
       {
-        // do actual diff.
-        const byte *srcBegin = newData.data();
-        const byte *src = srcBegin;
-        const byte *dst = referenceData.data();
-        size_t bytesRemain = newData.size();
-
-        // we only care about large-ish chunks at a time. This prevents us generating lots of tiny
-        // deltas where we could batch changes together. This is tuned to not be too large (and
-        // thus causing us to miss too many sections we could skip) and not too small (causing us
-        // to devolve into lots of byte-wise deltas). The current value as of this comment of 128
-        // is definitely on the small end of the range, but consider e.g. an android image of
-        // 1440x2560 and a pixel-wide line that goes vertically from top to bottom. Reading
-        // horizontally that will mean 2560 different diffs, and only actually one pixel changed.
-        // The larger this value gets, the more redundant data we'll send along with.
-        const size_t chunkSize = 128;
-
-        // we use a simple state machine. Start in state 1
-        //
-        // State 1: No active delta. Look at the current chunk, if there's no difference move to the
-        //          next chunk and stay in this state. If there is a difference, push a delta onto
-        //          the list at the current offset. Copy the current chunk into the contents of the
-        //          delta. Move to state 2.
-        // State 2. Active delta. Look at the current chunk, if there is a difference then append
-        //          the current chunk to the last delta's contents, move to the next chunk, and stay
-        //          in this state. If there isn't a difference, move back to state 1 (the delta is
-        //          already 'finished' so we have no need to do anything more on it).
-        //
-        // At any point we can end the loop, both states are 'complete' at all points.
-
-        enum DeltaState
+        if(range.second - range.first < DeltaMinSearchSize)
         {
-          None,
-          Active
-        };
-        DeltaState state = DeltaState::None;
+          addLiteral(range.first, range.second - range.first);
+          continue;
+        }
 
-        // loop over whole chunks
-        while(bytesRemain > chunkSize)
+        if(refChunks.empty())
         {
-          // check if there's a difference in this chunk.
-          bool chunkDiff = memcmp(src, dst, chunkSize) != 0;
+          refChunks.reserve(refSize / 256);
 
-          // if we're in state 1
-          if(state == DeltaState::None)
+          for(size_t offs = 0; offs < refSize;)
           {
-            // if there's a difference, append a new delta with the current offset and chunk
-            // contents and move to state 2
-            if(chunkDiff)
-            {
-              deltas.push_back(DeltaSection());
-              deltas.back().offs = src - srcBegin;
-              deltas.back().contents.append(src, chunkSize);
-
-              state = DeltaState::Active;
-            }
+            size_t end = NextDeltaChunk(ref, offs, refSize);
+            refChunks.insert({HashDeltaChunk(ref + offs, end - offs), offs});
+            offs = end;
           }
-          // if we're in state 2
-          else if(state == DeltaState::Active)
+        }
+
+        for(size_t offs = range.first; offs < range.second;)
+        {
+          size_t end = NextDeltaChunk(src, offs, range.second);
+          size_t length = end - offs;
+
+          auto it = refChunks.find(HashDeltaChunk(src + offs, length));
+
+          if(it != refChunks.end() && it->second + length <= refSize &&
+             memcmp(src + offs, ref + it->second, length) == 0)
           {
-            // continue to append to the delta if there's another difference in this chunk.
-            if(chunkDiff)
-            {
-              deltas.back().contents.append(src, chunkSize);
-            }
+            if(!copies.empty() && copies.back().offs + copies.back().length == offs &&
+               copies.back().refOffs + copies.back().length == it->second)
+              copies.back().length += length;
             else
-            {
-              state = DeltaState::None;
-            }
+              copies.push_back({offs, it->second, length});
+          }
+          else
+          {
+            addLiteral(offs, length);
           }
 
-          // move to the next chunk
-          bytesRemain -= chunkSize;
-          src += chunkSize;
-          dst += chunkSize;
-        }
-
-        // if there are still some bytes remaining at the end of the image, smaller than the chunk
-        // size, just diff directly and send if needed. We could combine this with the last delta if
-        // we ended in the active state.
-        if(bytesRemain > 0 && memcmp(src, dst, bytesRemain))
-        {
-          deltas.push_back(DeltaSection());
-          deltas.back().offs = src - srcBegin;
-          deltas.back().contents.append(src, bytesRemain);
+          offs = end;
         }
       }
     }
 
+    uint64_t uncompSize = 0;
+
     // fast path - no changes.
-    if(deltas.empty())
-    {
-      uncompSize = 0;
-    }
-    else
+    if(!copies.empty() || !literals.empty() || newSize != referenceData.size())
     {
       // serialise to an invalid writer, to get the size of the data that will be written.
       WriteSerialiser ser(new StreamWriter(StreamWriter::InvalidStream), Ownership::Stream);
 
-      SERIALISE_ELEMENT(deltas);
+      SERIALISE_ELEMENT(newSize);
+      SERIALISE_ELEMENT(copies);
+      SERIALISE_ELEMENT(literals);
 
       uncompSize = ser.GetWriter()->GetOffset() + ser.GetChunkAlignment();
+
+      for(const DeltaLiteral &literal : literals)
+        uncompSize += literal.length;
     }
 
     xferser.Serialise("uncompSize", uncompSize);
@@ -1970,7 +2195,13 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
                                            Ownership::Stream),
                           Ownership::Stream);
 
-      SERIALISE_ELEMENT(deltas);
+      SERIALISE_ELEMENT(newSize);
+      SERIALISE_ELEMENT(copies);
+      SERIALISE_ELEMENT(literals);
+
+      // the literal bytes go straight from the new data, back to back
+      for(const DeltaLiteral &literal : literals)
+        ser.GetWriter()->Write(newData.data() + (size_t)literal.offs, literal.length);
 
       // add any necessary padding.
       uint64_t offs = ser.GetWriter()->GetOffset();
@@ -1983,6 +2214,8 @@ void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &reference
     // This is the proxy side, so we have the complete newest contents in data. Swap the new data
     // into refData for next time.
     referenceData.swap(newData);
+
+    return true;
   }
 }
 
@@ -1993,9 +2226,15 @@ void ReplayProxy::Proxied_CacheBufferData(ParamSerialiser &paramser, ReturnSeria
   const ReplayProxyPacket expectedPacket = eReplayProxy_CacheBufferData;
   ReplayProxyPacket packet = eReplayProxy_CacheBufferData;
 
+  // the client's cached copy, which the data is delta'd against if we still have the same
+  uint64_t refHash = 0;
+  if(paramser.IsWriting())
+    refHash = HashDeltaReference(m_ProxyBufferData.Peek(buff));
+
   {
     BEGIN_PARAMS();
     SERIALISE_ELEMENT(buff);
+    SERIALISE_ELEMENT(refHash);
     END_PARAMS();
   }
 
@@ -2013,7 +2252,8 @@ void ReplayProxy::Proxied_CacheBufferData(ParamSerialiser &paramser, ReturnSeria
     SERIALISE_ELEMENT(packet);
   }
 
-  DeltaTransferBytes(retser, m_ProxyBufferData[buff], data);
+  DeltaTransferBytes(retser, m_ProxyBufferData.Insert(buff), data, refHash);
+  m_ProxyBufferData.Trim();
 
   retser.EndChunk();
 
@@ -2033,15 +2273,25 @@ void ReplayProxy::Proxied_CacheTextureData(ParamSerialiser &paramser, ReturnSeri
   const ReplayProxyPacket expectedPacket = eReplayProxy_CacheTextureData;
   ReplayProxyPacket packet = eReplayProxy_CacheTextureData;
 
+  TextureCacheEntry entry = {tex, arrayIdx, mip};
+
+  // the client's cached copy, which the data is delta'd against if we still have the same
+  uint64_t refHash = 0;
+  if(paramser.IsWriting())
+    refHash = HashDeltaReference(m_ProxyTextureData.Peek(entry));
+
   {
     BEGIN_PARAMS();
     SERIALISE_ELEMENT(tex);
     SERIALISE_ELEMENT(arrayIdx);
     SERIALISE_ELEMENT(mip);
     SERIALISE_ELEMENT(params);
+    SERIALISE_ELEMENT(refHash);
     END_PARAMS();
   }
 
+  entry = {tex, arrayIdx, mip};
+
   bytebuf data;
 
   {
@@ -2056,8 +2306,8 @@ void ReplayProxy::Proxied_CacheTextureData(ParamSerialiser &paramser, ReturnSeri
     SERIALISE_ELEMENT(packet);
   }
 
-  TextureCacheEntry entry = {tex, arrayIdx, mip};
-  DeltaTransferBytes(retser, m_ProxyTextureData[entry], data);
+  DeltaTransferBytes(retser, m_ProxyTextureData.Insert(entry), data, refHash);
+  m_ProxyTextureData.Trim();
 
   retser.EndChunk();
 
@@ -2154,59 +2404,114 @@ void ReplayProxy::EnsureTexCached(ResourceId texid, uint32_t arrayIdx, uint32_t
   if(m_Reader.IsErrored() || m_Writer.IsErrored())
     return;
 
+  if(m_LocalTextures.find(texid) != m_LocalTextures.end())
+    return;
+
   TextureCacheEntry entry = {texid, arrayIdx, mip};
 
   // 3D textures shouldn't cache by array index, since we fetch the whole texture at once.
+  const TextureDescription *tex = NULL;
   {
     auto it = m_TextureInfo.find(texid);
-    if(it != m_TextureInfo.end() && it->second.dimension == 3)
+    if(it != m_TextureInfo.end())
+      tex = &it->second;
+    if(tex && tex->dimension == 3)
       entry.arrayIdx = 0;
   }
 
-  if(m_LocalTextures.find(texid) != m_LocalTextures.end())
+  if(m_TextureProxyCache.find(entry) != m_TextureProxyCache.end())
+  {
+    if(m_PrefetchedTextures.erase(entry))
+      m_PrefetchHits++;
     return;
+  }
+
+  FetchProxyTexture(entry);
+
+  if(!m_PrefetchSubresources || !tex)
+    return;
+
+  TextureCacheEntry next[] = {
+      {texid, entry.arrayIdx, mip + 1}, {texid, entry.arrayIdx + 1, mip},
+  };
 
-  if(m_TextureProxyCache.find(entry) == m_TextureProxyCache.end())
+  for(const TextureCacheEntry &n : next)
   {
-    if(m_ProxyTextures.find(texid) == m_ProxyTextures.end())
-    {
-      TextureDescription tex = GetTexture(texid);
+    if(n.mip >= tex->mips)
+      continue;
 
-      ProxyTextureProperties proxy;
-      RemapProxyTextureIfNeeded(tex, proxy.params);
+    if(n.arrayIdx != entry.arrayIdx && (tex->dimension == 3 || n.arrayIdx >= tex->arraysize))
+      continue;
 
-      proxy.id = m_Proxy->CreateProxyTexture(tex);
-      proxy.msSamp = RDCMAX(1U, tex.msSamp);
-      m_ProxyTextures[texid] = proxy;
-    }
+    if(m_TextureProxyCache.find(n) != m_TextureProxyCache.end())
+      continue;
 
-    const ProxyTextureProperties &proxy = m_ProxyTextures[texid];
+    FetchProxyTexture(n);
 
-    for(uint32_t sample = 0; sample < proxy.msSamp; sample++)
-    {
-      // MSAA array textures are remapped so it's:
-      // [slice 0 samp 0, slice 0 samp 1, slice 1 samp 0, slice 1 samp 1, ...]
-      // so we need to calculate the effective array index to fetch and set the data.
-      // For non-MSAA textures this operation does nothing (sample is 0, proxy.msSamp is 1)
-      uint32_t sampleArrayIdx = arrayIdx * proxy.msSamp + sample;
+    m_PrefetchedTextures.insert(n);
+    m_Prefetched++;
+  }
+}
+
+void ReplayProxy::FetchProxyTexture(const TextureCacheEntry &entry)
+{
+  ResourceId texid = entry.replayid;
+  uint32_t arrayIdx = entry.arrayIdx, mip = entry.mip;
+
+  if(m_ProxyTextures.find(texid) == m_ProxyTextures.end())
+  {
+    TextureDescription tex = GetTexture(texid);
+
+    ProxyTextureProperties proxy;
+    RemapProxyTextureIfNeeded(tex, proxy.params);
+
+    proxy.id = m_Proxy->CreateProxyTexture(tex);
+    proxy.msSamp = RDCMAX(1U, tex.msSamp);
+    m_ProxyTextures[texid] = proxy;
+  }
+
+  const ProxyTextureProperties &proxy = m_ProxyTextures[texid];
+
+  for(uint32_t sample = 0; sample < proxy.msSamp; sample++)
+  {
+    // MSAA array textures are remapped so it's:
+    // [slice 0 samp 0, slice 0 samp 1, slice 1 samp 0, slice 1 samp 1, ...]
+    // so we need to calculate the effective array index to fetch and set the data.
+    // For non-MSAA textures this operation does nothing (sample is 0, proxy.msSamp is 1)
+    uint32_t sampleArrayIdx = arrayIdx * proxy.msSamp + sample;
 
-      TextureCacheEntry sampleArrayEntry = entry;
-      sampleArrayEntry.arrayIdx = sampleArrayIdx;
+    TextureCacheEntry sampleArrayEntry = entry;
+    sampleArrayEntry.arrayIdx = sampleArrayIdx;
 
+    EventCacheEntry eventEntry = {texid, sampleArrayIdx, mip, m_EventID};
+
+    bytebuf *data = m_EventDataCacheable ? m_EventData.Find(eventEntry) : NULL;
+
+    if(!data)
+    {
 #if ENABLED(TRANSFER_RESOURCE_CONTENTS_DELTAS)
       CacheTextureData(texid, sampleArrayIdx, mip, proxy.params);
 #else
-      GetTextureData(texid, sampleArrayIdx, mip, proxy.params, m_ProxyTextureData[entry]);
+      GetTextureData(texid, sampleArrayIdx, mip, proxy.params,
+                     m_ProxyTextureData.Insert(sampleArrayEntry));
+      m_ProxyTextureData.Trim();
 #endif
 
-      auto it = m_ProxyTextureData.find(sampleArrayEntry);
-      if(it != m_ProxyTextureData.end())
-        m_Proxy->SetProxyTextureData(proxy.id, sampleArrayIdx, mip, it->second.data(),
-                                     it->second.size());
+      data = m_ProxyTextureData.Peek(sampleArrayEntry);
+
+      if(data && m_EventDataCacheable)
+      {
+        bytebuf &cached = m_EventData.Insert(eventEntry);
+        cached = *data;
+        m_EventData.Trim();
+      }
     }
 
-    m_TextureProxyCache.insert(entry);
+    if(data)
+      m_Proxy->SetProxyTextureData(proxy.id, sampleArrayIdx, mip, data->data(), data->size());
   }
+
+  m_TextureProxyCache.insert(entry);
 }
 
 void ReplayProxy::EnsureBufCached(ResourceId bufid)
@@ -2224,20 +2529,54 @@ void ReplayProxy::EnsureBufCached(ResourceId bufid)
 
     ResourceId proxyid = m_ProxyBufferIds[bufid];
 
+    EventCacheEntry eventEntry = {bufid, 0, 0, m_EventID};
+
+    bytebuf *data = m_EventDataCacheable ? m_EventData.Find(eventEntry) : NULL;
+
+    if(!data)
+    {
 #if ENABLED(TRANSFER_RESOURCE_CONTENTS_DELTAS)
-    CacheBufferData(bufid);
+      CacheBufferData(bufid);
 #else
-    GetBufferData(bufid, 0, 0, m_ProxyBufferData[bufid]);
+      GetBufferData(bufid, 0, 0, m_ProxyBufferData.Insert(bufid));
+      m_ProxyBufferData.Trim();
 #endif
 
-    auto it = m_ProxyBufferData.find(bufid);
-    if(it != m_ProxyBufferData.end())
-      m_Proxy->SetProxyBufferData(proxyid, it->second.data(), it->second.size());
+      data = m_ProxyBufferData.Peek(bufid);
+
+      if(data && m_EventDataCacheable)
+      {
+        bytebuf &cached = m_EventData.Insert(eventEntry);
+        cached = *data;
+        m_EventData.Trim();
+      }
+    }
+
+    if(data)
+      m_Proxy->SetProxyBufferData(proxyid, data->data(), data->size());
 
     m_BufferProxyCache.insert(bufid);
   }
 }
 
+ReplayProxy::CacheStatistics ReplayProxy::GetCacheStatistics() const
+{
+  CacheStatistics ret;
+  ret.textureData = m_ProxyTextureData.GetStats();
+  ret.bufferData = m_ProxyBufferData.GetStats();
+  ret.eventData = m_EventData.GetStats();
+  ret.prefetched = m_Prefetched;
+  ret.prefetchHits = m_PrefetchHits;
+  return ret;
+}
+
+void ReplayProxy::SetDataCacheBudget(uint64_t bytes)
+{
+  // split the same way as the defaults, textures are generally larger and more numerous
+  m_ProxyTextureData.SetBudget(bytes / 3 * 2);
+  m_ProxyBufferData.SetBudget(bytes / 3);
+}
+
 const DrawcallDescription *ReplayProxy::FindDraw(const rdcarray<DrawcallDescription> &drawcallList,
                                                  uint32_t eventId)
 {
@@ -2643,3 +2982,375 @@ bool ReplayProxy::Tick(int type)
 
   return true;
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#undef None
+
+#include "3rdparty/catch/catch.hpp"
+
+// sends data from one side to the other, returning how many bytes went over the wire
+static uint64_t TestDeltaTransfer(bytebuf &sendRef, bytebuf &recvRef, const bytebuf &data,
+                                  double *sendTime = NULL, double *recvTime = NULL)
+{
+  bytebuf newData = data;
+
+  StreamWriter *writer = new StreamWriter(data.size() + 1024);
+
+  PerformanceTimer timer;
+
+  // the receiver sends this ahead with the request
+  uint64_t recvHash = ReplayProxy::HashDeltaReference(&recvRef);
+
+  {
+    WriteSerialiser ser(writer, Ownership::Nothing);
+    ReplayProxy::DeltaTransferBytes(ser, sendRef, newData, recvHash);
+  }
+
+  if(sendTime)
+    *sendTime = timer.GetMilliseconds();
+
+  uint64_t size = writer->GetOffset();
+
+  timer.Restart();
+
+  {
+    ReadSerialiser ser(new StreamReader(writer->GetData(), size), Ownership::Stream);
+    bytebuf dummy;
+    CHECK(ReplayProxy::DeltaTransferBytes(ser, recvRef, dummy, recvHash));
+  }
+
+  if(recvTime)
+    *recvTime = timer.GetMilliseconds();
+
+  delete writer;
+
+  return size;
+}
+
+// something like texture data - smooth gradients with some noise so it doesn't compress away
+static bytebuf MakeDeltaTestData(size_t size, uint32_t seed)
+{
+  bytebuf ret;
+  ret.resize(size);
+
+  for(size_t i = 0; i < size; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    ret[i] = byte((i / 4) + (i % 4) * 64 + ((seed >> 16) & 0x1f));
+  }
+
+  return ret;
+}
+
+TEST_CASE("Test replay proxy delta transfer", "[replayproxy]")
+{
+  bytebuf sendRef, recvRef;
+
+  bytebuf data = MakeDeltaTestData(1024 * 1024, 1);
+
+  SECTION("No reference data")
+  {
+    uint64_t sent = TestDeltaTransfer(sendRef, recvRef, data);
+
+    CHECK(sent > 0);
+    CHECK((recvRef == data));
+    CHECK((sendRef == data));
+  };
+
+  TestDeltaTransfer(sendRef, recvRef, data);
+
+  SECTION("Unchanged")
+  {
+    // only the reference hash and size prefix are sent
+    CHECK(TestDeltaTransfer(sendRef, recvRef, data) == 2 * sizeof(uint64_t));
+    CHECK((recvRef == data));
+  };
+
+  SECTION("Receiver evicted its reference")
+  {
+    recvRef.clear();
+    data[100] ^= 0x1;
+
+    CHECK(TestDeltaTransfer(sendRef, recvRef, data) > 64 * 1024);
+    CHECK((recvRef == data));
+  };
+
+  SECTION("Sender evicted its reference")
+  {
+    sendRef.clear();
+    data[100] ^= 0x1;
+
+    CHECK(TestDeltaTransfer(sendRef, recvRef, data) > 64 * 1024);
+    CHECK((recvRef == data));
+    CHECK((sendRef == data));
+  };
+
+  SECTION("References differ")
+  {
+    recvRef[500] ^= 0x1;
+
+    // unchanged as far as the sender is concerned, but the receiver's copy isn't the same
+    TestDeltaTransfer(sendRef, recvRef, data);
+    CHECK((recvRef == data));
+  };
+
+  SECTION("Delta against the wrong reference is rejected")
+  {
+    data[100] ^= 0x1;
+    bytebuf newData = data;
+
+    StreamWriter writer(StreamWriter::DefaultScratchSize);
+
+    {
+      WriteSerialiser ser(&writer, Ownership::Nothing);
+      ReplayProxy::DeltaTransferBytes(ser, sendRef, newData,
+                                      ReplayProxy::HashDeltaReference(&sendRef));
+    }
+
+    // the receiver's reference changed after it sent its hash
+    recvRef[500] ^= 0x1;
+
+    ReadSerialiser ser(new StreamReader(writer.GetData(), writer.GetOffset()), Ownership::Stream);
+    bytebuf dummy;
+    CHECK_FALSE(ReplayProxy::DeltaTransferBytes(ser, recvRef, dummy,
+                                                ReplayProxy::HashDeltaReference(&recvRef)));
+    CHECK(recvRef.empty());
+    CHECK(ser.GetReader()->AtEnd());
+  };
+
+  SECTION("Scattered changes in place")
+  {
+    // a pixel-wide vertical line in a 1024-wide RGBA8 texture, and a few changed bytes elsewhere
+    for(size_t row = 0; row < 256; row++)
+      data[row * 4096 + 1000] ^= 0xff;
+
+    data[5] ^= 0x1;
+    data[data.size() - 1] ^= 0x1;
+
+    uint64_t sent = TestDeltaTransfer(sendRef, recvRef, data);
+
+    CHECK(sent < 256 * 64);
+    CHECK((recvRef == data));
+  };
+
+  SECTION("Shifted data")
+  {
+    bytebuf shifted;
+    shifted.append(data.data() + 1000, 13);
+    shifted.append(data.data(), data.size() - 13);
+    data = shifted;
+
+    uint64_t sent = TestDeltaTransfer(sendRef, recvRef, data);
+
+    CHECK(sent < 16 * 1024);
+    CHECK((recvRef == data));
+  };
+
+  SECTION("Moved data")
+  {
+    bytebuf swapped;
+    swapped.append(data.data() + data.size() / 2, data.size() / 2);
+    swapped.append(data.data(), data.size() / 2);
+    data = swapped;
+
+    uint64_t sent = TestDeltaTransfer(sendRef, recvRef, data);
+
+    CHECK(sent < 16 * 1024);
+    CHECK((recvRef == data));
+  };
+
+  SECTION("Duplicated data")
+  {
+    // copies from data that stays where it is, mixed with copies from data that's overwritten
+    memcpy(data.data() + 256 * 1024, data.data(), 128 * 1024);
+    memcpy(data.data() + 512 * 1024, data.data() + 768 * 1024, 128 * 1024);
+    memcpy(data.data() + 768 * 1024, data.data() + 640 * 1024, 128 * 1024);
+
+    uint64_t sent = TestDeltaTransfer(sendRef, recvRef, data);
+
+    CHECK(sent < 16 * 1024);
+    CHECK((recvRef == data));
+  };
+
+  SECTION("Size changes")
+  {
+    data.resize(data.size() + 5000);
+    data[data.size() - 1] = 0x7f;
+
+    TestDeltaTransfer(sendRef, recvRef, data);
+    CHECK((recvRef == data));
+
+    data.resize(1000);
+
+    CHECK(TestDeltaTransfer(sendRef, recvRef, data) < 1024);
+    CHECK((recvRef == data));
+
+    data.clear();
+
+    TestDeltaTransfer(sendRef, recvRef, data);
+    CHECK(recvRef.empty());
+  };
+
+  SECTION("Everything changed")
+  {
+    data = MakeDeltaTestData(data.size(), 2);
+
+    TestDeltaTransfer(sendRef, recvRef, data);
+    CHECK((recvRef == data));
+  };
+}
+
+TEST_CASE("Test replay proxy data cache", "[replayproxy]")
+{
+  ProxyDataCache<uint32_t> cache(1000);
+
+  auto add = [&cache](uint32_t key, size_t size) {
+    cache.Insert(key).resize(size);
+    cache.Trim();
+  };
+
+  CHECK(cache.Find(1) == NULL);
+
+  add(1, 400);
+  add(2, 400);
+
+  CHECK(cache.GetStats().bytes == 800);
+  CHECK(cache.GetStats().misses == 3);
+
+  SECTION("Least recently used is evicted first")
+  {
+    // touch 1 so 2 is the oldest
+    REQUIRE(cache.Find(1) != NULL);
+    CHECK(cache.Find(1)->size() == 400);
+
+    add(3, 400);
+
+    CHECK(cache.Peek(1) != NULL);
+    CHECK(cache.Peek(2) == NULL);
+    CHECK(cache.Peek(3) != NULL);
+    CHECK(cache.GetStats().bytes == 800);
+    CHECK(cache.GetStats().evictions == 1);
+  };
+
+  SECTION("Resizing existing data is accounted")
+  {
+    add(2, 100);
+    CHECK(cache.GetStats().bytes == 500);
+
+    add(1, 950);
+    CHECK(cache.Peek(2) == NULL);
+    CHECK(cache.GetStats().bytes == 950);
+  };
+
+  SECTION("The most recent entry is never evicted")
+  {
+    add(3, 5000);
+
+    CHECK(cache.Peek(1) == NULL);
+    CHECK(cache.Peek(2) == NULL);
+    REQUIRE(cache.Peek(3) != NULL);
+    CHECK(cache.Peek(3)->size() == 5000);
+    CHECK(cache.GetStats().bytes == 5000);
+  };
+
+  SECTION("Lowering the budget evicts")
+  {
+    cache.SetBudget(500);
+
+    CHECK(cache.Peek(1) == NULL);
+    CHECK(cache.Peek(2) != NULL);
+    CHECK(cache.GetStats().bytes == 400);
+    CHECK(cache.GetStats().evictions == 1);
+
+    cache.SetBudget(2000);
+    add(3, 1000);
+    CHECK(cache.Peek(2) != NULL);
+    CHECK(cache.GetStats().bytes == 1400);
+  };
+
+  SECTION("Clear")
+  {
+    cache.Clear();
+
+    CHECK(cache.Peek(1) == NULL);
+    CHECK(cache.GetStats().bytes == 0);
+
+    add(1, 10);
+    CHECK(cache.GetStats().bytes == 10);
+  };
+}
+
+TEST_CASE("Benchmark replay proxy delta transfer", "[.][benchmark][replayproxy]")
+{
+  // a 2048x2048 RGBA8 texture
+  const size_t width = 2048, height = 2048, pitch = width * 4;
+  const bytebuf texture = MakeDeltaTestData(pitch * height, 1);
+
+  struct Edit
+  {
+    const char *name;
+    std::function<void(bytebuf &)> apply;
+  };
+
+  Edit edits[] = {
+      {"vertical line",
+       [&](bytebuf &d) {
+         for(size_t y = 0; y < height; y++)
+           memset(&d[y * pitch + 1000 * 4], 0xff, 4);
+       }},
+      {"scattered pixels",
+       [&](bytebuf &d) {
+         uint32_t seed = 7;
+         for(int i = 0; i < 5000; i++)
+         {
+           seed = seed * 1103515245 + 12345;
+           d[(seed % (width * height)) * 4] ^= 0x80;
+         }
+       }},
+      {"small rectangles",
+       [&](bytebuf &d) {
+         for(size_t r = 0; r < 16; r++)
+           for(size_t y = 0; y < 32; y++)
+             memset(&d[(r * 120 + y) * pitch + r * 400], 0x40, 32 * 4);
+       }},
+      {"scrolled one row",
+       [&](bytebuf &d) {
+         memmove(d.data(), d.data() + pitch, d.size() - pitch);
+         memset(d.data() + d.size() - pitch, 0, pitch);
+       }},
+      {"buffer insertion",
+       [&](bytebuf &d) {
+         bytebuf inserted;
+         inserted.append(d.data(), 4096);
+         inserted.append(d.data() + 1000, 48);
+         inserted.append(d.data() + 4096, d.size() - 4096 - 48);
+         d = inserted;
+       }},
+      {"buffer sparse writes",
+       [&](bytebuf &d) {
+         for(size_t i = 0; i < d.size(); i += 64 * 1024)
+           memset(&d[i], 0x11, 16);
+       }},
+  };
+
+  for(const Edit &edit : edits)
+  {
+    bytebuf sendRef, recvRef;
+
+    TestDeltaTransfer(sendRef, recvRef, texture);
+
+    bytebuf data = texture;
+    edit.apply(data);
+
+    double sendTime = 0.0, recvTime = 0.0;
+    uint64_t sent = TestDeltaTransfer(sendRef, recvRef, data, &sendTime, &recvTime);
+
+    CHECK((recvRef == data));
+
+    RDCLOG("%s: sent %llu bytes of %llu, %.2f ms to encode, %.2f ms to apply", edit.name, sent,
+           (uint64_t)data.size(), sendTime, recvTime);
+  }
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -25,6 +25,8 @@
 
 #pragma once
 
+#include <list>
+#include <map>
 #include "os/os_specific.h"
 #include "replay/replay_driver.h"
 #include "serialise/serialiser.h"
@@ -103,6 +105,114 @@ enum ReplayProxyPacket
 
 DECLARE_REFLECTION_ENUM(ReplayProxyPacket);
 
+// hit, miss and eviction counts for a ProxyDataCache, for tuning its budget
+struct ProxyDataCacheStats
+{
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  uint64_t bytes = 0;
+};
+
+// a cache of resource contents bounded to a budget in bytes, evicting the least recently used
+// entries first. The most recently used entry is never evicted, so it can be held onto until the
+// next lookup.
+template <typename Key>
+class ProxyDataCache
+{
+public:
+  ProxyDataCache(uint64_t budget) : m_Budget(budget) {}
+  // returns the data for key and marks it as most recently used, or NULL if it's not cached
+  bytebuf *Find(const Key &key)
+  {
+    auto it = m_Lookup.find(key);
+    if(it == m_Lookup.end())
+    {
+      m_Stats.misses++;
+      return NULL;
+    }
+
+    m_Stats.hits++;
+    m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+    return &it->second->data;
+  }
+
+  // as Find, but adds empty data if key isn't cached. The data can then be modified, and Trim()
+  // must be called afterwards to account for its new size.
+  bytebuf &Insert(const Key &key)
+  {
+    bytebuf *data = Find(key);
+    if(data)
+      return *data;
+
+    m_Entries.push_front(Entry());
+    m_Entries.front().key = key;
+    m_Lookup[key] = m_Entries.begin();
+    return m_Entries.front().data;
+  }
+
+  // returns the data for key without marking it as used
+  bytebuf *Peek(const Key &key)
+  {
+    auto it = m_Lookup.find(key);
+    return it == m_Lookup.end() ? NULL : &it->second->data;
+  }
+
+  // updates the size of the most recently used entry, then evicts until we're within budget
+  void Trim()
+  {
+    if(m_Entries.empty())
+      return;
+
+    Entry &recent = m_Entries.front();
+    m_Stats.bytes = m_Stats.bytes - recent.size + recent.data.size();
+    recent.size = recent.data.size();
+
+    Evict();
+  }
+
+  // changes the budget, evicting straight away if we're now over it
+  void SetBudget(uint64_t budget)
+  {
+    m_Budget = budget;
+    Evict();
+  }
+
+  void Clear()
+  {
+    m_Entries.clear();
+    m_Lookup.clear();
+    m_Stats.bytes = 0;
+  }
+
+  const ProxyDataCacheStats &GetStats() const { return m_Stats; }
+
+private:
+  struct Entry
+  {
+    Key key;
+    bytebuf data;
+    uint64_t size = 0;
+  };
+
+  void Evict()
+  {
+    while(m_Stats.bytes > m_Budget && m_Entries.size() > 1)
+    {
+      Entry &oldest = m_Entries.back();
+      m_Stats.bytes -= oldest.size;
+      m_Lookup.erase(oldest.key);
+      m_Entries.pop_back();
+      m_Stats.evictions++;
+    }
+  }
+
+  uint64_t m_Budget;
+  std::list<Entry> m_Entries;
+  std::map<Key, typename std::list<Entry>::iterator> m_Lookup;
+  ProxyDataCacheStats m_Stats;
+};
+
 #define IMPLEMENT_FUNCTION_PROXIED(rettype, name, ...)                                  \
   rettype name(__VA_ARGS__);                                                            \
   template <typename ParamSerialiser, typename ReturnSerialiser>                        \
@@ -126,6 +236,14 @@ public:
         m_Replay(NULL),
         m_RemoteServer(false)
   {
+    // each prefetch is a blocking round-trip on top of the fetch that was asked for, so it's only a
+    // win on fast connections and is opt-in
+    const char *prefetch = Process::GetEnvVariable("RENDERDOC_PROXY_PREFETCH");
+    m_PrefetchSubresources = (prefetch && prefetch[0] == '1');
+
+    if(m_PrefetchSubresources)
+      RDCLOG("Prefetching proxied texture subresources");
+
     GetAPIProperties();
     FetchStructuredFile();
   }
@@ -160,6 +278,18 @@ public:
   void EndRemoteExecution();
   void RemoteExecutionThreadEntry();
 
+  struct CacheStatistics
+  {
+    ProxyDataCacheStats textureData, bufferData, eventData;
+    // how many subresources were fetched speculatively, and how many of those were then used
+    uint64_t prefetched = 0, prefetchHits = 0;
+  };
+  CacheStatistics GetCacheStatistics() const;
+
+  // sets how much resource data is cached on the remote side. Both sides of the connection should
+  // use the same budget so they evict the same entries, otherwise more data is sent in full.
+  void SetDataCacheBudget(uint64_t bytes);
+
   bool IsRemoteProxy() { return !m_RemoteServer; }
   void Shutdown() { delete this; }
   ReplayStatus ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers)
@@ -524,9 +654,15 @@ public:
                              uint32_t mip, const GetTextureDataParams &params);
 
   // utility function to serialise the contents of a byte array given the previous contents that's
-  // available on both sides of the communication.
+  // available on both sides of the communication. Each side caches its reference data separately,
+  // so receiverRefHash is the HashDeltaReference() of the receiver's copy, which it sends ahead.
+  // If the sender's reference doesn't match the whole contents are sent instead. Returns false on
+  // the receiving side if the data was delta'd against a reference other than its own, in which
+  // case the reference data is cleared.
   template <typename SerialiserType>
-  void DeltaTransferBytes(SerialiserType &xferser, bytebuf &referenceData, bytebuf &newData);
+  static bool DeltaTransferBytes(SerialiserType &xferser, bytebuf &referenceData, bytebuf &newData,
+                                 uint64_t receiverRefHash);
+  static uint64_t HashDeltaReference(const bytebuf *referenceData);
 
   void FileChanged() {}
   // will never be used
@@ -580,12 +716,46 @@ private:
       return mip < o.mip;
     }
   };
+  void FetchProxyTexture(const TextureCacheEntry &entry);
+
   // this cache only exists on the client side, with the proxy renderer. This denotes cases where we
   // already have up-to-date texture data for the current event so we don't need to check for any
   // deltas. It is cleared any time we set event.
   set<TextureCacheEntry> m_TextureProxyCache;
   set<ResourceId> m_BufferProxyCache;
 
+  // entries in m_TextureProxyCache that were fetched speculatively and haven't been used yet
+  set<TextureCacheEntry> m_PrefetchedTextures;
+  // fetch the next mip and slice whenever a texture subresource is fetched, since the texture
+  // viewer is likely to show them next. Enabled with RENDERDOC_PROXY_PREFETCH=1
+  bool m_PrefetchSubresources = false;
+  uint64_t m_Prefetched = 0, m_PrefetchHits = 0;
+
+  struct EventCacheEntry
+  {
+    ResourceId id;
+    // always 0 for buffers
+    uint32_t arrayIdx;
+    uint32_t mip;
+    uint32_t eventId;
+
+    bool operator<(const EventCacheEntry &o) const
+    {
+      if(id != o.id)
+        return id < o.id;
+      if(arrayIdx != o.arrayIdx)
+        return arrayIdx < o.arrayIdx;
+      if(mip != o.mip)
+        return mip < o.mip;
+      return eventId < o.eventId;
+    }
+  };
+  // this cache only exists on the client side. It holds texture and buffer contents as they were at
+  // each event, so going back to an event doesn't need to fetch anything. Contents are only cached
+  // when the replay is at a complete event, and it's cleared when resources are replaced.
+  ProxyDataCache<EventCacheEntry> m_EventData{256 * 1024 * 1024ULL};
+  bool m_EventDataCacheable = false;
+
   struct ProxyTextureProperties
   {
     ResourceId id;
@@ -606,8 +776,11 @@ private:
   // this cache exists on *both* sides of the proxy connection, and must be kept in sync. It is used
   // on the remote side to determine which deltas are necessary, and then each time on the client
   // side the data is uploaded into the proxy textures above.
-  std::map<TextureCacheEntry, bytebuf> m_ProxyTextureData;
-  std::map<ResourceId, bytebuf> m_ProxyBufferData;
+  // Both sides see the same sequence of lookups on the same data, so with the same budget they
+  // evict the same entries. In case they don't, each request carries a hash of the receiver's cached
+  // data and the data is sent in full instead of as a delta if the sender's doesn't match.
+  ProxyDataCache<TextureCacheEntry> m_ProxyTextureData{512 * 1024 * 1024ULL};
+  ProxyDataCache<ResourceId> m_ProxyBufferData{256 * 1024 * 1024ULL};
 
   // this lists any textures which are only created locally (e.g. custom visualisation shaders) and
   // should not be treated as proxied.
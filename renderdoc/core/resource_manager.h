@@ -400,6 +400,8 @@ public:
 
   // insert the chunks for the resources referenced in the frame
   void InsertReferencedChunks(WriteSerialiser &ser);
+  // as InsertReferencedChunks, but gathers the chunks in the order they're written instead
+  void GetReferencedChunks(map<int32_t, Chunk *> &sortedChunks);
 
   // mark resource records as unwritten, ready to be written to a new logfile.
   void MarkUnwrittenResources();
@@ -407,6 +409,10 @@ public:
   // clear the list of frame-referenced resources - e.g. if you're about to recapture a frame
   void ClearReferencedResources();
 
+  // incremented every time the frame-referenced resources are cleared. Lets callers that reference
+  // the same resources repeatedly tell if they've already done so for the current frame.
+  uint32_t GetFrameReferenceEpoch() { return m_FrameReferenceEpoch; }
+
   // indicates this resource could have been modified by the GPU,
   // so it's now suspect and the data we have on it might well be out of date
   // and to be correct its contents should be serialised out at the start
@@ -517,6 +523,7 @@ protected:
 
   // used during capture - holds resources referenced in current frame (and how they're referenced)
   map<ResourceId, FrameRefType> m_FrameReferencedResources;
+  uint32_t m_FrameReferenceEpoch = 1;
 
   // used during capture - holds resources marked as dirty, needing initial contents
   set<ResourceId> m_DirtyResources;
@@ -873,6 +880,17 @@ void ResourceManager<Configuration>::InsertReferencedChunks(WriteSerialiser &ser
 {
   map<int32_t, Chunk *> sortedChunks;
 
+  GetReferencedChunks(sortedChunks);
+
+  for(auto it = sortedChunks.begin(); it != sortedChunks.end(); it++)
+    it->second->Write(ser);
+
+  RDCDEBUG("inserted to serialiser");
+}
+
+template <typename Configuration>
+void ResourceManager<Configuration>::GetReferencedChunks(map<int32_t, Chunk *> &sortedChunks)
+{
   SCOPED_LOCK(m_Lock);
 
   RDCDEBUG("%u frame resource records", (uint32_t)m_FrameReferencedResources.size());
@@ -911,11 +929,6 @@ void ResourceManager<Configuration>::InsertReferencedChunks(WriteSerialiser &ser
   }
 
   RDCDEBUG("%u frame resource chunks", (uint32_t)sortedChunks.size());
-
-  for(auto it = sortedChunks.begin(); it != sortedChunks.end(); it++)
-    it->second->Write(ser);
-
-  RDCDEBUG("inserted to serialiser");
 }
 
 template <typename Configuration>
@@ -1152,6 +1165,7 @@ void ResourceManager<Configuration>::ClearReferencedResources()
   }
 
   m_FrameReferencedResources.clear();
+  m_FrameReferenceEpoch++;
 }
 
 template <typename Configuration>
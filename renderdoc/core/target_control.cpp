@@ -25,12 +25,13 @@
 
 #include "android/android.h"
 #include "api/replay/renderdoc_replay.h"
+#include "core/capture_transfer.h"
 #include "core/core.h"
 #include "jpeg-compressor/jpgd.h"
 #include "os/os_specific.h"
 #include "serialise/serialiser.h"
 
-static const uint32_t TargetControlProtocolVersion = 4;
+static const uint32_t TargetControlProtocolVersion = 5;
 
 static bool IsProtocolVersionSupported(const uint32_t protocolVersion)
 {
@@ -42,6 +43,10 @@ static bool IsProtocolVersionSupported(const uint32_t protocolVersion)
   if(protocolVersion == 3)
     return true;
 
+  // 4 -> 5 changed capture copies to be resumable and compressed
+  if(protocolVersion == 4)
+    return true;
+
   if(protocolVersion == TargetControlProtocolVersion)
     return true;
 
@@ -319,10 +324,13 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
         caps = RenderDoc::Inst().GetCaptures();
 
         uint32_t id;
+        CaptureTransferState state;
 
         {
           READ_DATA_SCOPE();
           SERIALISE_ELEMENT(id);
+          if(version >= 5)
+            SERIALISE_ELEMENT(state);
         }
 
         if(id < caps.size())
@@ -333,12 +341,24 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
 
           std::string filename = caps[id].path;
 
-          StreamReader fileStream(FileIO::fopen(filename.c_str(), "rb"));
-          ser.SerialiseStream(filename, fileStream);
+          bool success = false;
 
-          if(fileStream.IsErrored() || ser.IsErrored())
-            SAFE_DELETE(client);
+          if(version >= 5)
+          {
+            success = CaptureTransfer::Send(ser, filename.c_str(), state,
+                                            RENDERDOC_ProgressCallback());
+          }
           else
+          {
+            StreamReader fileStream(FileIO::fopen(filename.c_str(), "rb"));
+            ser.SerialiseStream(filename, fileStream);
+
+            success = !fileStream.IsErrored();
+          }
+
+          if(ser.IsErrored())
+            SAFE_DELETE(client);
+          else if(success)
             RenderDoc::Inst().MarkCaptureRetrieved(id);
         }
       }
@@ -607,6 +627,13 @@ public:
 
     SERIALISE_ELEMENT(remoteID);
 
+    if(m_Version >= 5)
+    {
+      // if we already have some or all of the capture at this path, only the rest is sent
+      CaptureTransferState state = CaptureTransfer::GetLocalState(localpath);
+      SERIALISE_ELEMENT(state);
+    }
+
     if(ser.IsErrored())
     {
       SAFE_DELETE(m_Socket);
@@ -798,9 +825,20 @@ public:
 
       msg.newCapture.path = m_CaptureCopies[msg.newCapture.captureId];
 
-      StreamWriter streamWriter(FileIO::fopen(msg.newCapture.path.c_str(), "wb"), Ownership::Stream);
+      if(m_Version >= 5)
+      {
+        bool success = CaptureTransfer::Receive(ser, msg.newCapture.path.c_str(), progress);
 
-      ser.SerialiseStream(msg.newCapture.path.c_str(), streamWriter, progress);
+        if(!success)
+          RDCERR("Failed to copy capture to '%s'", msg.newCapture.path.c_str());
+      }
+      else
+      {
+        StreamWriter streamWriter(FileIO::fopen(msg.newCapture.path.c_str(), "wb"),
+                                  Ownership::Stream);
+
+        ser.SerialiseStream(msg.newCapture.path.c_str(), streamWriter, progress);
+      }
 
       if(reader.IsErrored())
       {
@@ -467,6 +467,11 @@ bool D3D11InitParams::IsSupportedVersion(uint64_t ver)
   if(ver == CurrentVersion)
     return true;
 
+  // 0x10 -> 0x11 - callstacks collected while capturing are stored as an index into a new callstack
+  // dictionary section
+  if(ver == 0x10)
+    return true;
+
   // 0x0F -> 0x10 - serialised the number of subresources in resource initial states after
   // multiplying on sample count rather than before
   if(ver == 0x0F)
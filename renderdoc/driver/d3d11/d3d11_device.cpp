@@ -1086,7 +1086,12 @@ ReplayStatus WrappedID3D11Device::ReadLogInitialisation(RDCFile *rdc, bool store
 
   ReadSerialiser ser(reader, Ownership::Stream);
 
+  // older captures store callstacks inline, the dictionary section was added in 0x11
+  if(m_SectionVersion >= 0x11)
+    m_Callstacks.Load(rdc);
+
   ser.SetStringDatabase(&m_StringDB);
+  ser.SetCallstackDictionary(&m_Callstacks);
   ser.SetUserData(GetResourceManager());
 
   ser.ConfigureStructuredExport(&GetChunkName, storeStructuredBuffers);
@@ -1702,8 +1707,8 @@ bool WrappedID3D11Device::EndFrameCapture(void *dev, void *wnd)
     {
       SectionProperties props;
 
-      // Compress with LZ4 so that it's fast
-      props.flags = SectionFlags::LZ4Compressed;
+      // Compress with LZ4 so that it's fast, in independent blocks so that it can use every core
+      props.flags = SectionFlags::LZ4Compressed | SectionFlags::LZ4IndependentBlocks;
       props.version = m_SectionVersion;
       props.type = SectionType::FrameCapture;
 
@@ -65,7 +65,7 @@ struct D3D11InitParams
   D3D_FEATURE_LEVEL FeatureLevels[16];
 
   // check if a frame capture section version is supported
-  static const uint64_t CurrentVersion = 0x10;
+  static const uint64_t CurrentVersion = 0x11;
   static bool IsSupportedVersion(uint64_t ver);
 };
 
@@ -341,6 +341,7 @@ private:
 
   WriteSerialiser m_ScratchSerialiser;
   std::set<std::string> m_StringDB;
+  CallstackDictionary m_Callstacks;
 
   ResourceId m_ResourceID;
   D3D11ResourceRecord *m_DeviceRecord;
@@ -400,6 +401,7 @@ public:
     m_SectionVersion = sectionVersion;
   }
   uint64_t GetLogVersion() { return m_SectionVersion; }
+  const CallstackDictionary *GetCallstackDictionary() { return &m_Callstacks; }
   virtual ~WrappedID3D11Device();
 
   ////////////////////////////////////////////////////////////////
@@ -3826,7 +3826,7 @@ ReplayStatus D3D11_CreateReplayDevice(RDCFile *rdc, IReplayDriver **driver)
 
 static DriverRegistration D3D11DriverRegistration(RDCDriver::D3D11, &D3D11_CreateReplayDevice);
 
-void D3D11_ProcessStructured(RDCFile *rdc, SDFile &output)
+void D3D11_ProcessStructured(RDCFile *rdc, SDFile &output, bool lazy)
 {
   WrappedID3D11Device device(NULL, D3D11InitParams());
 
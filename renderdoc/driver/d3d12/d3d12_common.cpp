@@ -158,6 +158,11 @@ bool D3D12InitParams::IsSupportedVersion(uint64_t ver)
   if(ver == CurrentVersion)
     return true;
 
+  // 0x6 -> 0x7 - callstacks collected while capturing are stored as an index into a new callstack
+  //              dictionary section
+  if(ver == 0x6)
+    return true;
+
   // 0x5 -> 0x6 - Multiply by number of planes in format when serialising initial states -
   //              i.e. stencil is saved with depth in initial states.
   if(ver == 0x5)
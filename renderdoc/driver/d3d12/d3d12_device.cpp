@@ -1200,7 +1200,7 @@ bool WrappedID3D12Device::Serialise_WriteToSubresource(SerialiserType &ser, ID3D
     }
   }
 
-  SERIALISE_ELEMENT_ARRAY(pSrcData, dataSize);
+  SERIALISE_ELEMENT_ARRAY_ZEROCOPY(pSrcData, dataSize);
   SERIALISE_ELEMENT(dataSize).Hidden();
 
   SERIALISE_ELEMENT(SrcRowPitch);
@@ -1723,8 +1723,8 @@ bool WrappedID3D12Device::EndFrameCapture(void *dev, void *wnd)
   {
     SectionProperties props;
 
-    // Compress with LZ4 so that it's fast
-    props.flags = SectionFlags::LZ4Compressed;
+    // Compress with LZ4 so that it's fast, in independent blocks so that it can use every core
+    props.flags = SectionFlags::LZ4Compressed | SectionFlags::LZ4IndependentBlocks;
     props.version = m_SectionVersion;
     props.type = SectionType::FrameCapture;
 
@@ -2762,7 +2762,12 @@ ReplayStatus WrappedID3D12Device::ReadLogInitialisation(RDCFile *rdc, bool store
 
   ReadSerialiser ser(reader, Ownership::Stream);
 
+  // older captures store callstacks inline, the dictionary section was added in 0x7
+  if(m_SectionVersion >= 0x7)
+    m_Callstacks.Load(rdc);
+
   ser.SetStringDatabase(&m_StringDB);
+  ser.SetCallstackDictionary(&m_Callstacks);
   ser.SetUserData(GetResourceManager());
 
   ser.ConfigureStructuredExport(&GetChunkName, storeStructuredBuffers);
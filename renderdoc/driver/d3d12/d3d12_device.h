@@ -46,7 +46,7 @@ struct D3D12InitParams
   D3D_FEATURE_LEVEL MinimumFeatureLevel;
 
   // check if a frame capture section version is supported
-  static const uint64_t CurrentVersion = 0x6;
+  static const uint64_t CurrentVersion = 0x7;
 
   static bool IsSupportedVersion(uint64_t ver);
 };
@@ -374,6 +374,7 @@ private:
   Chunk *m_HeaderChunk;
 
   std::set<std::string> m_StringDB;
+  CallstackDictionary m_Callstacks;
 
   ResourceId m_ResourceID;
   D3D12ResourceRecord *m_DeviceRecord;
@@ -485,6 +486,7 @@ public:
     m_SectionVersion = sectionVersion;
   }
   uint64_t GetLogVersion() { return m_SectionVersion; }
+  const CallstackDictionary *GetCallstackDictionary() { return &m_Callstacks; }
   CaptureState GetState() { return m_State; }
   D3D12Replay *GetReplay() { return &m_Replay; }
   WrappedID3D12CommandQueue *GetQueue() { return m_Queue; }
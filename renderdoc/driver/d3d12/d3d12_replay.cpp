@@ -3747,7 +3747,7 @@ ReplayStatus D3D12_CreateReplayDevice(RDCFile *rdc, IReplayDriver **driver)
 
 static DriverRegistration D3D12DriverRegistration(RDCDriver::D3D12, &D3D12_CreateReplayDevice);
 
-void D3D12_ProcessStructured(RDCFile *rdc, SDFile &output)
+void D3D12_ProcessStructured(RDCFile *rdc, SDFile &output, bool lazy)
 {
   WrappedID3D12Device device(NULL, D3D12InitParams(), false);
 
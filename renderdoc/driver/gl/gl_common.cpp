@@ -1145,6 +1145,11 @@ bool GLInitParams::IsSupportedVersion(uint64_t ver)
   if(ver == 0x1E)
     return true;
 
+  // 0x1F -> 0x20 - callstacks collected while capturing are stored as an index into a new callstack
+  // dictionary section
+  if(ver == 0x1F)
+    return true;
+
   return false;
 }
 
@@ -26,6 +26,7 @@
 #include "gl_driver.h"
 #include <algorithm>
 #include "common/common.h"
+#include "core/capture_writer.h"
 #include "driver/shaders/spirv/spirv_common.h"
 #include "jpeg-compressor/jpge.h"
 #include "serialise/rdcfile.h"
@@ -545,6 +546,19 @@ WrappedOpenGL::WrappedOpenGL(GLPlatform &platform)
 
   m_FetchCounters = false;
 
+  m_StateShadowMode = StateShadowMode::Disabled;
+  {
+    const char *shadow = Process::GetEnvVariable("RENDERDOC_GL_STATE_SHADOW");
+    if(shadow && !strcmp(shadow, "verify"))
+      m_StateShadowMode = StateShadowMode::Verify;
+    else if(shadow && shadow[0] == '1')
+      m_StateShadowMode = StateShadowMode::Enabled;
+
+    if(m_StateShadowMode != StateShadowMode::Disabled)
+      RDCLOG("GL binding state shadow enabled%s",
+             m_StateShadowMode == StateShadowMode::Verify ? " with verification" : "");
+  }
+
   RDCEraseEl(m_ActiveQueries);
   m_ActiveConditional = false;
   m_ActiveFeedback = false;
@@ -1654,6 +1668,8 @@ void WrappedOpenGL::SwapBuffers(void *windowHandle)
 
   m_NoCtxFrames = 0;
 
+  InvalidateAllStateShadows();
+
   m_FrameCounter++;    // first present becomes frame #1, this function is at the end of the frame
 
   GetResourceManager()->FlushPendingDirty();
@@ -1838,6 +1854,8 @@ void WrappedOpenGL::StartFrameCapture(void *dev, void *wnd)
   m_FailedFrame = 0;
   m_FailedReason = CaptureSucceeded;
 
+  InvalidateAllStateShadows();
+
   GLWindowingData prevctx = m_ActiveContexts[Threading::GetCurrentID()];
   GLWindowingData switchctx = prevctx;
   MakeValidContextCurrent(switchctx, wnd);
@@ -1887,6 +1905,8 @@ bool WrappedOpenGL::EndFrameCapture(void *dev, void *wnd)
 
   CaptureFailReason reason = CaptureSucceeded;
 
+  InvalidateAllStateShadows();
+
   GLWindowingData prevctx = m_ActiveContexts[Threading::GetCurrentID()];
   GLWindowingData switchctx = prevctx;
   MakeValidContextCurrent(switchctx, wnd);
@@ -1931,26 +1951,20 @@ bool WrappedOpenGL::EndFrameCapture(void *dev, void *wnd)
       delete it->second;
     m_BackbufferImages.clear();
 
-    StreamWriter *captureWriter = NULL;
+    SectionProperties props;
 
-    if(rdc)
-    {
-      SectionProperties props;
+    // Compress with LZ4 so that it's fast, in independent blocks so that it can use every core
+    props.flags = SectionFlags::LZ4Compressed | SectionFlags::LZ4IndependentBlocks;
+    props.version = m_SectionVersion;
+    props.type = SectionType::FrameCapture;
 
-      // Compress with LZ4 so that it's fast
-      props.flags = SectionFlags::LZ4Compressed;
-      props.version = m_SectionVersion;
-      props.type = SectionType::FrameCapture;
-
-      captureWriter = rdc->WriteSection(props);
-    }
-    else
-    {
-      captureWriter = new StreamWriter(StreamWriter::InvalidStream);
-    }
+    // gather the contents in memory, then compress and write them to disk on a background thread
+    CaptureContents *contents = rdc ? new CaptureContents(props) : NULL;
 
     {
-      WriteSerialiser ser(captureWriter, Ownership::Stream);
+      WriteSerialiser ser(contents ? new StreamWriter(contents, Ownership::Nothing)
+                                   : new StreamWriter(StreamWriter::InvalidStream),
+                          Ownership::Stream);
 
       ser.SetChunkMetadataRecording(m_ScratchSerialiser.GetChunkMetadataRecording());
 
@@ -1980,6 +1994,8 @@ bool WrappedOpenGL::EndFrameCapture(void *dev, void *wnd)
 
       RDCDEBUG("Inserting Resource Serialisers");
 
+      // buffer records can keep their contents in a creation chunk that's updated in place, so
+      // resource chunks are copied now rather than handed over
       GetResourceManager()->InsertReferencedChunks(ser);
 
       GetResourceManager()->InsertInitialContentsChunks(ser);
@@ -2019,18 +2035,21 @@ bool WrappedOpenGL::EndFrameCapture(void *dev, void *wnd)
         float num = float(recordlist.size());
         float idx = 0.0f;
 
+        // the context records' chunks aren't modified after being recorded, so they're handed over
+        // to be written without copying them
         for(auto it = recordlist.begin(); it != recordlist.end(); ++it)
         {
           RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseFrameContents, idx / num);
           idx += 1.0f;
-          it->second->Write(ser);
+          if(contents)
+            contents->AddChunk(it->second);
         }
 
         RDCDEBUG("Done");
       }
     }
 
-    RenderDoc::Inst().FinishCaptureWriting(rdc, m_CapturedFrames.back().frameNumber);
+    RenderDoc::Inst().QueueCaptureWriting(rdc, m_CapturedFrames.back().frameNumber, contents);
 
     m_State = CaptureState::BackgroundCapturing;
 
@@ -2698,7 +2717,12 @@ ReplayStatus WrappedOpenGL::ReadLogInitialisation(RDCFile *rdc, bool storeStruct
 
   ReadSerialiser ser(reader, Ownership::Stream);
 
+  // older captures store callstacks inline, the dictionary section was added in 0x20
+  if(m_SectionVersion >= 0x20)
+    m_Callstacks.Load(rdc);
+
   ser.SetStringDatabase(&m_StringDB);
+  ser.SetCallstackDictionary(&m_Callstacks);
   ser.SetUserData(GetResourceManager());
 
   ser.ConfigureStructuredExport(&GetChunkName, storeStructuredBuffers);
@@ -4399,6 +4423,7 @@ ReplayStatus WrappedOpenGL::ContextReplayLog(CaptureState readType, uint32_t sta
   ReadSerialiser ser(m_FrameReader, Ownership::Nothing);
 
   ser.SetStringDatabase(&m_StringDB);
+  ser.SetCallstackDictionary(&m_Callstacks);
   ser.SetUserData(GetResourceManager());
   ser.SetVersion(m_SectionVersion);
 
@@ -4635,8 +4660,9 @@ void WrappedOpenGL::AddUsage(const DrawcallDescription &d)
   // Shaders
 
   {
+    // only the bindings are needed to record which resources each draw uses
     GLRenderState rs;
-    rs.FetchState(this);
+    rs.FetchBindings(this);
 
     ShaderReflection *refl[6] = {NULL};
     ShaderBindpointMapping mapping[6];
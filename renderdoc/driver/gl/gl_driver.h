@@ -54,7 +54,7 @@ struct GLInitParams
   bool isYFlipped;
 
   // check if a frame capture section version is supported
-  static const uint64_t CurrentVersion = 0x1F;
+  static const uint64_t CurrentVersion = 0x20;
   static bool IsSupportedVersion(uint64_t ver);
 };
 
@@ -129,6 +129,7 @@ private:
 
   WriteSerialiser m_ScratchSerialiser;
   std::set<std::string> m_StringDB;
+  CallstackDictionary m_Callstacks;
 
   StreamReader *m_FrameReader = NULL;
 
@@ -246,6 +247,13 @@ private:
 
   bool m_FetchCounters;
 
+  enum class StateShadowMode
+  {
+    Disabled,
+    Enabled,
+    Verify,
+  } m_StateShadowMode;
+
   // buffer used
   vector<byte> m_ScratchBuf;
 
@@ -403,6 +411,8 @@ private:
     GLResourceRecord *m_ContextDataRecord;
 
     ResourceId m_ContextFBOID;
+
+    GLStateShadow m_StateShadow;
   };
 
   struct ClientMemoryData
@@ -497,6 +507,26 @@ public:
   ContextPair &GetCtx();
   GLResourceRecord *GetContextRecord();
 
+  // the current context's binding shadow, or NULL if it's not enabled or we're not capturing
+  GLStateShadow *GetStateShadow()
+  {
+    if(m_StateShadowMode == StateShadowMode::Disabled || !IsCaptureMode(m_State))
+      return NULL;
+    return &GetCtxData().m_StateShadow;
+  }
+  bool IsStateShadowVerifying() { return m_StateShadowMode == StateShadowMode::Verify; }
+  void InvalidateStateShadow()
+  {
+    if(GLStateShadow *shadow = GetStateShadow())
+      shadow->Invalidate();
+  }
+  // for when our own GL work (overlay, capture begin/end) may have touched any context's bindings
+  void InvalidateAllStateShadows()
+  {
+    for(auto it = m_ContextData.begin(); it != m_ContextData.end(); ++it)
+      it->second.m_StateShadow.Invalidate();
+  }
+
   void *ShareCtx(void *ctx) { return ctx ? m_ContextData[ctx].shareGroup : NULL; }
   void SetStructuredExport(uint64_t sectionVersion)
   {
@@ -581,6 +611,9 @@ public:
     // pre-calculated bindpoint mapping for SPIR-V shaders. NOT valid for normal GLSL shaders
     ShaderBindpointMapping mapping;
 
+    // parses spirvWords on first use, if the application uploaded SPIR-V
+    SPVModule &GetSPIRV();
+
     void ProcessCompilation(WrappedOpenGL &drv, ResourceId id, GLuint realShader);
     void ProcessSPIRVCompilation(WrappedOpenGL &drv, ResourceId id, GLuint realShader,
                                  const GLchar *pEntryPoint, GLuint numSpecializationConstants,
@@ -27,6 +27,183 @@
 #include <algorithm>
 #include "driver/gl/gl_driver.h"
 
+GLResourceTable::Group *GLResourceTable::FindGroup(void *shareGroup) const
+{
+  if(m_LastGroup && m_LastGroup->shareGroup == shareGroup)
+    return m_LastGroup;
+
+  for(Group *group : m_Groups)
+  {
+    if(group->shareGroup == shareGroup)
+    {
+      m_LastGroup = group;
+      return group;
+    }
+  }
+
+  return NULL;
+}
+
+const GLResourceTable::Entry *GLResourceTable::Find(GLResource res) const
+{
+  if(!IsDense(res))
+  {
+    auto it = m_Overflow.find(res);
+    return it == m_Overflow.end() ? NULL : &it->second;
+  }
+
+  Group *group = FindGroup(res.ContextShareGroup);
+  if(!group)
+    return NULL;
+
+  const rdcarray<Page *> &pages = group->pages[res.Namespace];
+  uint32_t pageIdx = res.name >> PageBits;
+
+  if(pageIdx >= pages.size() || pages[pageIdx] == NULL)
+    return NULL;
+
+  return &pages[pageIdx]->entries[res.name & (PageSize - 1)];
+}
+
+GLResourceTable::Entry *GLResourceTable::GetEntry(GLResource res, bool create)
+{
+  if(!IsDense(res))
+  {
+    if(create)
+      return &m_Overflow[res];
+
+    auto it = m_Overflow.find(res);
+    return it == m_Overflow.end() ? NULL : &it->second;
+  }
+
+  Group *group = FindGroup(res.ContextShareGroup);
+  if(!group)
+  {
+    if(!create)
+      return NULL;
+
+    group = new Group;
+    group->shareGroup = res.ContextShareGroup;
+    m_Groups.push_back(group);
+    m_LastGroup = group;
+  }
+
+  rdcarray<Page *> &pages = group->pages[res.Namespace];
+  uint32_t pageIdx = res.name >> PageBits;
+
+  if(pageIdx >= pages.size())
+  {
+    if(!create)
+      return NULL;
+
+    pages.resize(pageIdx + 1);
+  }
+
+  if(pages[pageIdx] == NULL)
+  {
+    if(!create)
+      return NULL;
+
+    pages[pageIdx] = new Page;
+  }
+
+  Entry *entry = &pages[pageIdx]->entries[res.name & (PageSize - 1)];
+
+  // count the entry as used in its page when it first gets something stored in it
+  if(create && entry->id == ResourceId() && entry->record == NULL)
+    pages[pageIdx]->used++;
+
+  return entry;
+}
+
+void GLResourceTable::ReleaseEntry(GLResource res, Entry *entry)
+{
+  if(entry->id != ResourceId() || entry->record != NULL)
+    return;
+
+  if(!IsDense(res))
+  {
+    m_Overflow.erase(res);
+    return;
+  }
+
+  Group *group = FindGroup(res.ContextShareGroup);
+  rdcarray<Page *> &pages = group->pages[res.Namespace];
+  uint32_t pageIdx = res.name >> PageBits;
+
+  // free pages once they're empty, so that names which are only ever incremented don't accumulate
+  if(--pages[pageIdx]->used == 0)
+  {
+    delete pages[pageIdx];
+    pages[pageIdx] = NULL;
+  }
+}
+
+void GLResourceTable::SetID(GLResource res, ResourceId id)
+{
+  Entry *entry = GetEntry(res, true);
+
+  if(entry->id == ResourceId())
+    m_NumIDs++;
+  entry->id = id;
+
+  ReleaseEntry(res, entry);
+}
+
+void GLResourceTable::ClearID(GLResource res)
+{
+  Entry *entry = GetEntry(res, false);
+
+  if(entry == NULL || entry->id == ResourceId())
+    return;
+
+  m_NumIDs--;
+  entry->id = ResourceId();
+
+  ReleaseEntry(res, entry);
+}
+
+void GLResourceTable::SetRecord(GLResource res, GLResourceRecord *record)
+{
+  Entry *entry = GetEntry(res, true);
+
+  if(entry->record == NULL)
+    m_NumRecords++;
+  entry->record = record;
+
+  ReleaseEntry(res, entry);
+}
+
+void GLResourceTable::ClearRecord(GLResource res, GLResourceRecord *record)
+{
+  Entry *entry = GetEntry(res, false);
+
+  if(entry == NULL || entry->record == NULL || entry->record != record)
+    return;
+
+  m_NumRecords--;
+  entry->record = NULL;
+
+  ReleaseEntry(res, entry);
+}
+
+void GLResourceTable::Clear()
+{
+  for(Group *group : m_Groups)
+  {
+    for(uint32_t ns = 0; ns < NumNamespaces; ns++)
+      for(Page *page : group->pages[ns])
+        delete page;
+
+    delete group;
+  }
+
+  m_Groups.clear();
+  m_LastGroup = NULL;
+  m_Overflow.clear();
+  m_NumIDs = m_NumRecords = 0;
+}
+
 GLResourceManager::GLResourceManager(WrappedOpenGL *driver)
     : ResourceManager(), m_Driver(driver), m_SyncName(1)
 {
@@ -134,3 +311,208 @@ bool GLResourceManager::ResourceTypeRelease(GLResource res)
   m_Driver->QueueResourceRelease(res);
   return true;
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#undef None
+
+#include "3rdparty/catch/catch.hpp"
+#include "common/timing.h"
+
+TEST_CASE("GL resource table", "[gl]")
+{
+  GLResourceTable table;
+
+  int groupA = 0, groupB = 0;
+  ContextPair ctxA = {&groupA, &groupA};
+  ContextPair ctxB = {&groupB, &groupB};
+
+  ResourceId idA = ResourceIDGen::GetNewUniqueID();
+  ResourceId idB = ResourceIDGen::GetNewUniqueID();
+  ResourceId idC = ResourceIDGen::GetNewUniqueID();
+
+  GLResourceRecord *record = (GLResourceRecord *)0x1234;
+
+  SECTION("Lookups are per share group, namespace and name")
+  {
+    table.SetID(TextureRes(ctxA, 5), idA);
+    table.SetID(BufferRes(ctxA, 5), idB);
+    table.SetID(TextureRes(ctxB, 5), idC);
+
+    CHECK(table.NumIDs() == 3);
+
+    REQUIRE(table.Find(TextureRes(ctxA, 5)));
+    CHECK(table.Find(TextureRes(ctxA, 5))->id == idA);
+    CHECK(table.Find(BufferRes(ctxA, 5))->id == idB);
+    CHECK(table.Find(TextureRes(ctxB, 5))->id == idC);
+
+    // names sharing a page with a stored one may have an empty entry
+    const GLResourceTable::Entry *missing = table.Find(TextureRes(ctxA, 6));
+    CHECK((missing == NULL || missing->id == ResourceId()));
+    CHECK(table.Find(TextureRes(ctxA, 100000)) == NULL);
+    CHECK(table.Find(SamplerRes(ctxA, 5)) == NULL);
+
+    table.ClearID(TextureRes(ctxA, 5));
+    CHECK(table.NumIDs() == 2);
+    CHECK(table.Find(TextureRes(ctxA, 5)) == NULL);
+    CHECK(table.Find(BufferRes(ctxA, 5))->id == idB);
+
+    // clearing something not present is fine
+    table.ClearID(TextureRes(ctxA, 5));
+    table.ClearID(TextureRes(ctxA, 9999999));
+    CHECK(table.NumIDs() == 2);
+  }
+
+  SECTION("Records and IDs are independent")
+  {
+    GLResource res = TextureRes(ctxA, 7);
+
+    table.SetID(res, idA);
+    table.SetRecord(res, record);
+    CHECK(table.NumRecords() == 1);
+
+    table.ClearID(res);
+    REQUIRE(table.Find(res));
+    CHECK(table.Find(res)->id == ResourceId());
+    CHECK(table.Find(res)->record == record);
+
+    // a different record doesn't clear it
+    table.ClearRecord(res, (GLResourceRecord *)0x5678);
+    CHECK(table.Find(res)->record == record);
+
+    table.ClearRecord(res, record);
+    CHECK(table.NumRecords() == 0);
+    CHECK(table.Find(res) == NULL);
+  }
+
+  SECTION("Names too large to index directly")
+  {
+    GLResource res = BufferRes(ctxA, 0xfffffff0U);
+
+    table.SetID(res, idA);
+    table.SetID(BufferRes(ctxB, 0xfffffff0U), idB);
+    REQUIRE(table.Find(res));
+    CHECK(table.Find(res)->id == idA);
+    CHECK(table.NumIDs() == 2);
+
+    table.ClearID(res);
+    CHECK(table.Find(res) == NULL);
+    CHECK(table.NumIDs() == 1);
+  }
+
+  SECTION("Iterating while removing")
+  {
+    for(GLuint i = 1; i <= 1000; i++)
+    {
+      table.SetID(TextureRes(ctxA, i), ResourceIDGen::GetNewUniqueID());
+      table.SetID(TextureRes(ctxB, i), ResourceIDGen::GetNewUniqueID());
+    }
+    table.SetID(BufferRes(ctxA, 0x80000000U), idA);
+
+    size_t visited = 0;
+    table.ForEachInGroup(&groupA, [&table, &visited](GLResource res, GLResourceTable::Entry) {
+      visited++;
+      table.ClearID(res);
+    });
+
+    CHECK(visited == 1001);
+    CHECK(table.NumIDs() == 1000);
+    CHECK(table.Find(TextureRes(ctxA, 500)) == NULL);
+    CHECK(table.Find(TextureRes(ctxB, 500))->id != ResourceId());
+
+    visited = 0;
+    table.ForEach([&visited, &groupB](GLResource res, GLResourceTable::Entry entry) {
+      visited++;
+      CHECK(res.ContextShareGroup == (void *)&groupB);
+    });
+    CHECK(visited == 1000);
+  }
+}
+
+TEST_CASE("Benchmark GL resource lookups", "[.][benchmark][gl]")
+{
+  const GLuint numResources = 100000;
+  const int lookupPasses = 20;
+
+  int group = 0;
+  ContextPair ctx = {&group, &group};
+
+  rdcarray<GLResource> resources;
+  rdcarray<ResourceId> ids;
+  for(GLuint i = 1; i <= numResources; i++)
+  {
+    resources.push_back(TextureRes(ctx, i));
+    resources.push_back(BufferRes(ctx, i));
+    ids.push_back(ResourceIDGen::GetNewUniqueID());
+    ids.push_back(ResourceIDGen::GetNewUniqueID());
+  }
+
+  size_t found[2] = {};
+  double registerMS[2], lookupMS[2], unregisterMS[2];
+
+  PerformanceTimer timer;
+
+  {
+    std::map<GLResource, ResourceId> map;
+
+    timer.Restart();
+    for(size_t i = 0; i < resources.size(); i++)
+      map[resources[i]] = ids[i];
+    registerMS[0] = timer.GetMilliseconds();
+
+    timer.Restart();
+    for(int pass = 0; pass < lookupPasses; pass++)
+    {
+      for(size_t i = 0; i < resources.size(); i++)
+      {
+        auto it = map.find(resources[i]);
+        if(it != map.end() && it->second == ids[i])
+          found[0]++;
+      }
+    }
+    lookupMS[0] = timer.GetMilliseconds();
+
+    timer.Restart();
+    for(const GLResource &res : resources)
+      map.erase(res);
+    unregisterMS[0] = timer.GetMilliseconds();
+  }
+
+  {
+    GLResourceTable table;
+
+    timer.Restart();
+    for(size_t i = 0; i < resources.size(); i++)
+      table.SetID(resources[i], ids[i]);
+    registerMS[1] = timer.GetMilliseconds();
+
+    timer.Restart();
+    for(int pass = 0; pass < lookupPasses; pass++)
+    {
+      for(size_t i = 0; i < resources.size(); i++)
+      {
+        const GLResourceTable::Entry *entry = table.Find(resources[i]);
+        if(entry && entry->id == ids[i])
+          found[1]++;
+      }
+    }
+    lookupMS[1] = timer.GetMilliseconds();
+
+    timer.Restart();
+    for(const GLResource &res : resources)
+      table.ClearID(res);
+    unregisterMS[1] = timer.GetMilliseconds();
+  }
+
+  CHECK(found[0] == resources.size() * lookupPasses);
+  CHECK(found[1] == found[0]);
+
+  const char *names[] = {"std::map", "GLResourceTable"};
+  for(int i = 0; i < 2; i++)
+    RDCLOG("%s: %u resources registered in %.1f ms, %d lookup passes in %.1f ms, unregistered in "
+           "%.1f ms",
+           names[i], (uint32_t)resources.size(), registerMS[i], lookupPasses, lookupMS[i],
+           unregisterMS[i]);
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -39,6 +39,140 @@ struct GLResourceManagerConfiguration
   typedef GLInitialContents InitialContentData;
 };
 
+// GL names are small integers, allocated densely per namespace within each context or share group.
+// Rather than a sorted map keyed on the whole GLResource, the ID and record for each resource are
+// stored in pages indexed directly by name, one set of pages per namespace and share group. Names
+// too large to reasonably index directly are kept in a map instead.
+class GLResourceTable
+{
+public:
+  struct Entry
+  {
+    ResourceId id;
+    GLResourceRecord *record = NULL;
+  };
+
+  GLResourceTable() = default;
+  ~GLResourceTable() { Clear(); }
+  GLResourceTable(const GLResourceTable &) = delete;
+  GLResourceTable &operator=(const GLResourceTable &) = delete;
+
+  // returns NULL if nothing is stored for this resource
+  const Entry *Find(GLResource res) const;
+
+  void SetID(GLResource res, ResourceId id);
+  void ClearID(GLResource res);
+
+  void SetRecord(GLResource res, GLResourceRecord *record);
+  // only clears the record if it's still the one stored for the resource
+  void ClearRecord(GLResource res, GLResourceRecord *record);
+
+  size_t NumIDs() const { return m_NumIDs; }
+  size_t NumRecords() const { return m_NumRecords; }
+  void Clear();
+
+  // calls callback(GLResource, Entry) for every stored resource, optionally only those in one share
+  // group. The callback is free to modify the table, any entries it adds may or may not be visited.
+  template <typename Callback>
+  void ForEach(Callback callback)
+  {
+    for(size_t g = 0; g < m_Groups.size(); g++)
+      ForEachInGroup(m_Groups[g], callback);
+
+    ForEachOverflow(false, NULL, callback);
+  }
+
+  template <typename Callback>
+  void ForEachInGroup(void *shareGroup, Callback callback)
+  {
+    Group *group = FindGroup(shareGroup);
+    if(group)
+      ForEachInGroup(group, callback);
+
+    ForEachOverflow(true, shareGroup, callback);
+  }
+
+private:
+  static const uint32_t PageBits = 8;
+  static const uint32_t PageSize = 1U << PageBits;
+  // 16k pages per namespace at most, beyond that names go in the overflow map
+  static const uint32_t MaxDenseName = 1U << 22;
+  static const uint32_t NumNamespaces = eResExternalSemaphore + 1;
+
+  struct Page
+  {
+    // number of entries with an ID or record, the page is freed when this reaches 0
+    uint32_t used = 0;
+    Entry entries[PageSize];
+  };
+
+  struct Group
+  {
+    void *shareGroup;
+    rdcarray<Page *> pages[NumNamespaces];
+  };
+
+  static bool IsDense(GLResource res)
+  {
+    return uint32_t(res.Namespace) < NumNamespaces && res.name < MaxDenseName;
+  }
+
+  Group *FindGroup(void *shareGroup) const;
+  Entry *GetEntry(GLResource res, bool create);
+  void ReleaseEntry(GLResource res, Entry *entry);
+
+  template <typename Callback>
+  void ForEachInGroup(Group *group, Callback callback)
+  {
+    // pages may be added or freed by the callback, so look everything up again at each step
+    for(uint32_t ns = 0; ns < NumNamespaces; ns++)
+    {
+      for(size_t p = 0; p < group->pages[ns].size(); p++)
+      {
+        for(uint32_t i = 0; i < PageSize; i++)
+        {
+          Page *page = group->pages[ns][p];
+          if(page == NULL)
+            break;
+
+          Entry entry = page->entries[i];
+          if(entry.id != ResourceId() || entry.record != NULL)
+            callback(GLResource(group->shareGroup, GLNamespace(ns), GLuint((p << PageBits) + i)),
+                     entry);
+        }
+      }
+    }
+  }
+
+  template <typename Callback>
+  void ForEachOverflow(bool filterGroup, void *shareGroup, Callback callback)
+  {
+    if(m_Overflow.empty())
+      return;
+
+    rdcarray<GLResource> keys;
+    for(auto it = m_Overflow.begin(); it != m_Overflow.end(); ++it)
+      if(!filterGroup || it->first.ContextShareGroup == shareGroup)
+        keys.push_back(it->first);
+
+    for(const GLResource &res : keys)
+    {
+      auto it = m_Overflow.find(res);
+      if(it != m_Overflow.end())
+        callback(res, Entry(it->second));
+    }
+  }
+
+  rdcarray<Group *> m_Groups;
+  // the most recently used group, since almost every lookup is in the same share group
+  mutable Group *m_LastGroup = NULL;
+
+  std::map<GLResource, Entry> m_Overflow;
+
+  size_t m_NumIDs = 0;
+  size_t m_NumRecords = 0;
+};
+
 class GLResourceManager : public ResourceManager<GLResourceManagerConfiguration>
 {
 public:
@@ -65,38 +199,44 @@ public:
     // records
     // that have already freed their parents.
     {
-      auto it = m_GLResourceRecords.begin();
+      rdcarray<GLResourceRecord *> records;
 
-      for(size_t i = 0; it != m_GLResourceRecords.end();)
+      for(;;)
       {
-        size_t prevSize = m_GLResourceRecords.size();
-        it->second->FreeParents(this);
+        records.clear();
+        m_Resources.ForEach([&records](GLResource, GLResourceTable::Entry entry) {
+          if(entry.record)
+            records.push_back(entry.record);
+        });
+
+        size_t prevSize = m_Resources.NumRecords();
 
-        // collection modified, restart loop
-        if(prevSize != m_GLResourceRecords.size())
+        size_t i = 0;
+        for(; i < records.size(); i++)
         {
-          i = 0;
-          it = m_GLResourceRecords.begin();
-          continue;
+          records[i]->FreeParents(this);
+
+          // collection modified, restart loop
+          if(prevSize != m_Resources.NumRecords())
+            break;
         }
 
-        // collection not modified, continue
-        i++;
-        it++;
+        if(i == records.size())
+          break;
       }
     }
 
-    while(!m_GLResourceRecords.empty())
-    {
-      auto it = m_GLResourceRecords.begin();
-      ResourceId id = it->second->GetResourceID();
-      it->second->Delete(this);
+    m_Resources.ForEach([this](GLResource res, GLResourceTable::Entry entry) {
+      if(entry.record)
+      {
+        entry.record->Delete(this);
 
-      if(!m_GLResourceRecords.empty() && m_GLResourceRecords.begin()->second->GetResourceID() == id)
-        m_GLResourceRecords.erase(m_GLResourceRecords.begin());
-    }
+        // if it wasn't deleted, forcibly remove it
+        m_Resources.ClearRecord(res, entry.record);
+      }
+    });
 
-    m_CurrentResourceIds.clear();
+    m_Resources.Clear();
 
     ResourceManager::Shutdown();
   }
@@ -104,36 +244,28 @@ public:
   void DeleteContext(void *context)
   {
     size_t count = 0;
-    for(auto it = m_CurrentResourceIds.begin(); it != m_CurrentResourceIds.end();)
-    {
-      if(it->first.ContextShareGroup == context && it->first.Namespace != eResSpecial)
+    m_Resources.ForEachInGroup(context, [this, &count](GLResource res, GLResourceTable::Entry entry) {
+      if(res.Namespace != eResSpecial && entry.id != ResourceId())
       {
         ++count;
-        ResourceId res = it->second;
-        MarkCleanResource(res);
-        if(HasResourceRecord(res))
-          GetResourceRecord(res)->Delete(this);
-        ReleaseCurrentResource(it->second);
-        it = m_CurrentResourceIds.erase(it);
+        ResourceId id = entry.id;
+        MarkCleanResource(id);
+        if(HasResourceRecord(id))
+          GetResourceRecord(id)->Delete(this);
+        ReleaseCurrentResource(id);
+        m_Resources.ClearID(res);
       }
-      else
-      {
-        ++it;
-      }
-    }
+    });
     RDCDEBUG("Removed %zu/%zu resources belonging to context/sharegroup %p", count,
-             m_CurrentResourceIds.size(), context);
+             m_Resources.NumIDs(), context);
   }
 
   inline void RemoveResourceRecord(ResourceId id)
   {
-    for(auto it = m_GLResourceRecords.begin(); it != m_GLResourceRecords.end(); it++)
+    if(ResourceManager::HasResourceRecord(id))
     {
-      if(it->second->GetResourceID() == id)
-      {
-        m_GLResourceRecords.erase(it);
-        break;
-      }
+      GLResourceRecord *record = ResourceManager::GetResourceRecord(id);
+      m_Resources.ClearRecord(record->Resource, record);
     }
 
     ResourceManager::RemoveResourceRecord(id);
@@ -142,7 +274,7 @@ public:
   ResourceId RegisterResource(GLResource res)
   {
     ResourceId id = ResourceIDGen::GetNewUniqueID();
-    m_CurrentResourceIds[res] = id;
+    m_Resources.SetID(res, id);
     AddCurrentResource(id, res);
     return id;
   }
@@ -151,28 +283,25 @@ public:
 
   bool HasCurrentResource(GLResource res)
   {
-    auto it = m_CurrentResourceIds.find(res);
-    if(it != m_CurrentResourceIds.end())
-      return true;
-
-    return false;
+    const GLResourceTable::Entry *entry = m_Resources.Find(res);
+    return entry && entry->id != ResourceId();
   }
 
   void UnregisterResource(GLResource res)
   {
-    auto it = m_CurrentResourceIds.find(res);
-    if(it != m_CurrentResourceIds.end())
+    const GLResourceTable::Entry *entry = m_Resources.Find(res);
+    if(entry && entry->id != ResourceId())
     {
-      ReleaseCurrentResource(it->second);
-      m_CurrentResourceIds.erase(res);
+      ReleaseCurrentResource(entry->id);
+      m_Resources.ClearID(res);
     }
   }
 
   ResourceId GetID(GLResource res)
   {
-    auto it = m_CurrentResourceIds.find(res);
-    if(it != m_CurrentResourceIds.end())
-      return it->second;
+    const GLResourceTable::Entry *entry = m_Resources.Find(res);
+    if(entry)
+      return entry->id;
     return ResourceId();
   }
 
@@ -181,7 +310,7 @@ public:
     GLResourceRecord *ret = ResourceManager::AddResourceRecord(id);
     GLResource res = GetCurrentResource(id);
 
-    m_GLResourceRecords[res] = ret;
+    m_Resources.SetRecord(res, ret);
     ret->Resource = res;
 
     return ret;
@@ -194,9 +323,9 @@ public:
 
   GLResourceRecord *GetResourceRecord(GLResource res)
   {
-    auto it = m_GLResourceRecords.find(res);
-    if(it != m_GLResourceRecords.end())
-      return it->second;
+    const GLResourceTable::Entry *entry = m_Resources.Find(res);
+    if(entry && entry->record)
+      return entry->record;
 
     return ResourceManager::GetResourceRecord(GetID(res));
   }
@@ -265,9 +394,8 @@ private:
   void Create_InitialState(ResourceId id, GLResource live, bool hasData);
   void Apply_InitialState(GLResource live, GLInitialContents initial);
 
-  map<GLResource, GLResourceRecord *> m_GLResourceRecords;
-
-  map<GLResource, ResourceId> m_CurrentResourceIds;
+  // the current ID and record of each GL resource
+  GLResourceTable m_Resources;
 
   // sync objects must be treated differently as they're not GLuint names, but pointer sized.
   // We manually give them GLuint names so they're otherwise namespaced as (eResSync, GLuint)
@@ -708,27 +708,10 @@ bool GLRenderState::CheckEnableDisableParam(GLenum pname)
   return true;
 }
 
-void GLRenderState::FetchState(WrappedOpenGL *driver)
+void GLRenderState::QueryBindings(WrappedOpenGL *driver)
 {
   ContextPair &ctx = driver->GetCtx();
 
-  if(ctx.ctx == NULL)
-  {
-    ContextPresent = false;
-    return;
-  }
-
-  for(GLuint i = 0; i < eEnabled_Count; i++)
-  {
-    if(!CheckEnableDisableParam(enable_disable_cap[i].cap))
-    {
-      Enabled[i] = false;
-      continue;
-    }
-
-    Enabled[i] = (GL.glIsEnabled(enable_disable_cap[i].cap) == GL_TRUE);
-  }
-
   GL.glGetIntegerv(eGL_ACTIVE_TEXTURE, (GLint *)&ActiveTexture);
 
   GLuint maxTextures = 0;
@@ -846,39 +829,6 @@ void GLRenderState::FetchState(WrappedOpenGL *driver)
     FeedbackObj = FeedbackRes(ctx, name);
   }
 
-  // the spec says that you can only query for the format that was previously set, or you get
-  // undefined results. Ie. if someone set ints, this might return anything. However there's also
-  // no way to query for the type so we just have to hope for the best and hope most people are
-  // sane and don't use these except for a default "all 0s" attrib.
-
-  GLuint maxNumAttribs = 0;
-  GL.glGetIntegerv(eGL_MAX_VERTEX_ATTRIBS, (GLint *)&maxNumAttribs);
-  for(GLuint i = 0; i < RDCMIN(maxNumAttribs, (GLuint)ARRAY_COUNT(GenericVertexAttribs)); i++)
-    GL.glGetVertexAttribfv(i, eGL_CURRENT_VERTEX_ATTRIB, &GenericVertexAttribs[i].x);
-
-  GL.glGetFloatv(eGL_LINE_WIDTH, &LineWidth);
-  if(!IsGLES)
-  {
-    GL.glGetFloatv(eGL_POINT_FADE_THRESHOLD_SIZE, &PointFadeThresholdSize);
-    GL.glGetIntegerv(eGL_POINT_SPRITE_COORD_ORIGIN, (GLint *)&PointSpriteOrigin);
-    GL.glGetFloatv(eGL_POINT_SIZE, &PointSize);
-  }
-
-  if(!IsGLES)
-    GL.glGetIntegerv(eGL_PRIMITIVE_RESTART_INDEX, (GLint *)&PrimitiveRestartIndex);
-  if(HasExt[ARB_clip_control])
-  {
-    GL.glGetIntegerv(eGL_CLIP_ORIGIN, (GLint *)&ClipOrigin);
-    GL.glGetIntegerv(eGL_CLIP_DEPTH_MODE, (GLint *)&ClipDepth);
-  }
-  else
-  {
-    ClipOrigin = eGL_LOWER_LEFT;
-    ClipDepth = eGL_NEGATIVE_ONE_TO_ONE;
-  }
-  if(!IsGLES)
-    GL.glGetIntegerv(eGL_PROVOKING_VERTEX, (GLint *)&ProvokingVertex);
-
   {
     GLuint name = 0;
     GL.glGetIntegerv(eGL_CURRENT_PROGRAM, (GLint *)&name);
@@ -896,54 +846,6 @@ void GLRenderState::FetchState(WrappedOpenGL *driver)
     Pipeline = ProgramRes(ctx, 0);
   }
 
-  const GLenum shs[] = {
-      eGL_VERTEX_SHADER,   eGL_TESS_CONTROL_SHADER, eGL_TESS_EVALUATION_SHADER,
-      eGL_GEOMETRY_SHADER, eGL_FRAGMENT_SHADER,     eGL_COMPUTE_SHADER,
-  };
-
-  if(HasExt[ARB_shader_subroutine])
-  {
-    RDCCOMPILE_ASSERT(ARRAY_COUNT(shs) == ARRAY_COUNT(Subroutines),
-                      "Subroutine array not the right size");
-
-    for(size_t s = 0; s < ARRAY_COUNT(shs); s++)
-    {
-      if(shs[s] == eGL_COMPUTE_SHADER && !HasExt[ARB_compute_shader])
-        continue;
-
-      if((shs[s] == eGL_TESS_CONTROL_SHADER || shs[s] == eGL_TESS_EVALUATION_SHADER) &&
-         !HasExt[ARB_tessellation_shader])
-        continue;
-
-      GLuint prog = Program.name;
-      if(prog == 0 && Pipeline.name != 0)
-      {
-        // can't query for GL_COMPUTE_SHADER on some AMD cards
-        if(shs[s] != eGL_COMPUTE_SHADER || !VendorCheck[VendorCheck_AMD_pipeline_compute_query])
-          GL.glGetProgramPipelineiv(Pipeline.name, shs[s], (GLint *)&prog);
-      }
-
-      if(prog == 0)
-        continue;
-
-      GLint numSubroutines = 0;
-      GL.glGetProgramStageiv(prog, shs[s], eGL_ACTIVE_SUBROUTINES, &numSubroutines);
-
-      if(numSubroutines == 0)
-        continue;
-
-      GL.glGetProgramStageiv(prog, shs[s], eGL_ACTIVE_SUBROUTINE_UNIFORM_LOCATIONS,
-                             &Subroutines[s].numSubroutines);
-
-      for(GLint i = 0; i < Subroutines[s].numSubroutines; i++)
-        GL.glGetUniformSubroutineuiv(shs[s], i, &Subroutines[s].Values[0]);
-    }
-  }
-  else
-  {
-    RDCEraseEl(Subroutines);
-  }
-
   // buffers are always shared
   for(size_t i = 0; i < ARRAY_COUNT(BufferBindings); i++)
     BufferBindings[i].ContextShareGroup = ctx.shareGroup;
@@ -1024,6 +926,128 @@ void GLRenderState::FetchState(WrappedOpenGL *driver)
     }
   }
 
+  {
+    GLuint draw, read;
+    GL.glGetIntegerv(eGL_DRAW_FRAMEBUFFER_BINDING, (GLint *)&draw);
+    GL.glGetIntegerv(eGL_READ_FRAMEBUFFER_BINDING, (GLint *)&read);
+    DrawFBO = FramebufferRes(ctx, draw);
+    ReadFBO = FramebufferRes(ctx, read);
+
+    // if the default FBO is bound, we must force the use of the context itself, rather than the
+    // sharegroup (if FBOs are normally shared).
+    if(draw == 0)
+      DrawFBO = FramebufferRes({ctx.ctx, ctx.ctx}, draw);
+    if(read == 0)
+      ReadFBO = FramebufferRes({ctx.ctx, ctx.ctx}, read);
+  }
+}
+
+void GLRenderState::FetchState(WrappedOpenGL *driver)
+{
+  ContextPair &ctx = driver->GetCtx();
+
+  if(ctx.ctx == NULL)
+  {
+    ContextPresent = false;
+    return;
+  }
+
+  for(GLuint i = 0; i < eEnabled_Count; i++)
+  {
+    if(!CheckEnableDisableParam(enable_disable_cap[i].cap))
+    {
+      Enabled[i] = false;
+      continue;
+    }
+
+    Enabled[i] = (GL.glIsEnabled(enable_disable_cap[i].cap) == GL_TRUE);
+  }
+
+  // the bindings come from the state shadow if it's valid, and seed it if not. The shadow doesn't
+  // cover anything else, so the rest is always queried.
+  FetchBindings(driver);
+
+  // the spec says that you can only query for the format that was previously set, or you get
+  // undefined results. Ie. if someone set ints, this might return anything. However there's also
+  // no way to query for the type so we just have to hope for the best and hope most people are
+  // sane and don't use these except for a default "all 0s" attrib.
+
+  GLuint maxNumAttribs = 0;
+  GL.glGetIntegerv(eGL_MAX_VERTEX_ATTRIBS, (GLint *)&maxNumAttribs);
+  for(GLuint i = 0; i < RDCMIN(maxNumAttribs, (GLuint)ARRAY_COUNT(GenericVertexAttribs)); i++)
+    GL.glGetVertexAttribfv(i, eGL_CURRENT_VERTEX_ATTRIB, &GenericVertexAttribs[i].x);
+
+  GL.glGetFloatv(eGL_LINE_WIDTH, &LineWidth);
+  if(!IsGLES)
+  {
+    GL.glGetFloatv(eGL_POINT_FADE_THRESHOLD_SIZE, &PointFadeThresholdSize);
+    GL.glGetIntegerv(eGL_POINT_SPRITE_COORD_ORIGIN, (GLint *)&PointSpriteOrigin);
+    GL.glGetFloatv(eGL_POINT_SIZE, &PointSize);
+  }
+
+  if(!IsGLES)
+    GL.glGetIntegerv(eGL_PRIMITIVE_RESTART_INDEX, (GLint *)&PrimitiveRestartIndex);
+  if(HasExt[ARB_clip_control])
+  {
+    GL.glGetIntegerv(eGL_CLIP_ORIGIN, (GLint *)&ClipOrigin);
+    GL.glGetIntegerv(eGL_CLIP_DEPTH_MODE, (GLint *)&ClipDepth);
+  }
+  else
+  {
+    ClipOrigin = eGL_LOWER_LEFT;
+    ClipDepth = eGL_NEGATIVE_ONE_TO_ONE;
+  }
+  if(!IsGLES)
+    GL.glGetIntegerv(eGL_PROVOKING_VERTEX, (GLint *)&ProvokingVertex);
+
+  const GLenum shs[] = {
+      eGL_VERTEX_SHADER,   eGL_TESS_CONTROL_SHADER, eGL_TESS_EVALUATION_SHADER,
+      eGL_GEOMETRY_SHADER, eGL_FRAGMENT_SHADER,     eGL_COMPUTE_SHADER,
+  };
+
+  if(HasExt[ARB_shader_subroutine])
+  {
+    RDCCOMPILE_ASSERT(ARRAY_COUNT(shs) == ARRAY_COUNT(Subroutines),
+                      "Subroutine array not the right size");
+
+    for(size_t s = 0; s < ARRAY_COUNT(shs); s++)
+    {
+      if(shs[s] == eGL_COMPUTE_SHADER && !HasExt[ARB_compute_shader])
+        continue;
+
+      if((shs[s] == eGL_TESS_CONTROL_SHADER || shs[s] == eGL_TESS_EVALUATION_SHADER) &&
+         !HasExt[ARB_tessellation_shader])
+        continue;
+
+      GLuint prog = Program.name;
+      if(prog == 0 && Pipeline.name != 0)
+      {
+        // can't query for GL_COMPUTE_SHADER on some AMD cards
+        if(shs[s] != eGL_COMPUTE_SHADER || !VendorCheck[VendorCheck_AMD_pipeline_compute_query])
+          GL.glGetProgramPipelineiv(Pipeline.name, shs[s], (GLint *)&prog);
+      }
+
+      if(prog == 0)
+        continue;
+
+      GLint numSubroutines = 0;
+      GL.glGetProgramStageiv(prog, shs[s], eGL_ACTIVE_SUBROUTINES, &numSubroutines);
+
+      if(numSubroutines == 0)
+        continue;
+
+      GL.glGetProgramStageiv(prog, shs[s], eGL_ACTIVE_SUBROUTINE_UNIFORM_LOCATIONS,
+                             &Subroutines[s].numSubroutines);
+
+      for(GLint i = 0; i < Subroutines[s].numSubroutines; i++)
+        GL.glGetUniformSubroutineuiv(shs[s], i, &Subroutines[s].Values[0]);
+    }
+  }
+  else
+  {
+    RDCEraseEl(Subroutines);
+  }
+
   GLuint maxDraws = 0;
   GL.glGetIntegerv(eGL_MAX_DRAW_BUFFERS, (GLint *)&maxDraws);
 
@@ -1122,21 +1146,6 @@ void GLRenderState::FetchState(WrappedOpenGL *driver)
       memcpy(&DepthRanges[i], &DepthRanges[0], sizeof(DepthRanges[i]));
   }
 
-  {
-    GLuint draw, read;
-    GL.glGetIntegerv(eGL_DRAW_FRAMEBUFFER_BINDING, (GLint *)&draw);
-    GL.glGetIntegerv(eGL_READ_FRAMEBUFFER_BINDING, (GLint *)&read);
-    DrawFBO = FramebufferRes(ctx, draw);
-    ReadFBO = FramebufferRes(ctx, read);
-
-    // if the default FBO is bound, we must force the use of the context itself, rather than the
-    // sharegroup (if FBOs are normally shared).
-    if(draw == 0)
-      DrawFBO = FramebufferRes({ctx.ctx, ctx.ctx}, draw);
-    if(read == 0)
-      ReadFBO = FramebufferRes({ctx.ctx, ctx.ctx}, read);
-  }
-
   GL.glBindFramebuffer(eGL_DRAW_FRAMEBUFFER, 0);
   GL.glBindFramebuffer(eGL_READ_FRAMEBUFFER, 0);
 
@@ -1294,6 +1303,309 @@ void GLRenderState::FetchState(WrappedOpenGL *driver)
   ClearGLErrors();
 }
 
+void GLRenderState::FetchBindings(WrappedOpenGL *driver)
+{
+  ContextPair &ctx = driver->GetCtx();
+
+  if(ctx.ctx == NULL)
+  {
+    ContextPresent = false;
+    return;
+  }
+
+  GLStateShadow *shadow = driver->GetStateShadow();
+
+  if(shadow && shadow->valid && !driver->IsStateShadowVerifying())
+  {
+    CopyBindings(shadow->state);
+    return;
+  }
+
+  QueryBindings(driver);
+
+  if(shadow)
+  {
+    if(shadow->valid && !BindingsMatch(shadow->state))
+      RDCERR("GL state shadow has diverged from the real bindings, re-seeding");
+
+    shadow->state.CopyBindings(*this);
+    shadow->valid = true;
+  }
+}
+
+void GLRenderState::CopyBindings(const GLRenderState &o)
+{
+  memcpy(Tex1D, o.Tex1D, sizeof(Tex1D));
+  memcpy(Tex2D, o.Tex2D, sizeof(Tex2D));
+  memcpy(Tex3D, o.Tex3D, sizeof(Tex3D));
+  memcpy(Tex1DArray, o.Tex1DArray, sizeof(Tex1DArray));
+  memcpy(Tex2DArray, o.Tex2DArray, sizeof(Tex2DArray));
+  memcpy(TexCubeArray, o.TexCubeArray, sizeof(TexCubeArray));
+  memcpy(TexRect, o.TexRect, sizeof(TexRect));
+  memcpy(TexBuffer, o.TexBuffer, sizeof(TexBuffer));
+  memcpy(TexCube, o.TexCube, sizeof(TexCube));
+  memcpy(Tex2DMS, o.Tex2DMS, sizeof(Tex2DMS));
+  memcpy(Tex2DMSArray, o.Tex2DMSArray, sizeof(Tex2DMSArray));
+  memcpy(Samplers, o.Samplers, sizeof(Samplers));
+  ActiveTexture = o.ActiveTexture;
+
+  memcpy(Images, o.Images, sizeof(Images));
+
+  Program = o.Program;
+  Pipeline = o.Pipeline;
+  VAO = o.VAO;
+  FeedbackObj = o.FeedbackObj;
+
+  memcpy(BufferBindings, o.BufferBindings, sizeof(BufferBindings));
+  memcpy(AtomicCounter, o.AtomicCounter, sizeof(AtomicCounter));
+  memcpy(ShaderStorage, o.ShaderStorage, sizeof(ShaderStorage));
+  memcpy(TransformFeedback, o.TransformFeedback, sizeof(TransformFeedback));
+  memcpy(UniformBinding, o.UniformBinding, sizeof(UniformBinding));
+
+  ReadFBO = o.ReadFBO;
+  DrawFBO = o.DrawFBO;
+}
+
+bool GLRenderState::BindingsMatch(const GLRenderState &o) const
+{
+  for(size_t i = 0; i < ARRAY_COUNT(Tex2D); i++)
+  {
+    if(Tex1D[i] != o.Tex1D[i] || Tex2D[i] != o.Tex2D[i] || Tex3D[i] != o.Tex3D[i] ||
+       Tex1DArray[i] != o.Tex1DArray[i] || Tex2DArray[i] != o.Tex2DArray[i] ||
+       TexCubeArray[i] != o.TexCubeArray[i] || TexRect[i] != o.TexRect[i] ||
+       TexBuffer[i] != o.TexBuffer[i] || TexCube[i] != o.TexCube[i] ||
+       Tex2DMS[i] != o.Tex2DMS[i] || Tex2DMSArray[i] != o.Tex2DMSArray[i] ||
+       Samplers[i] != o.Samplers[i])
+      return false;
+  }
+
+  if(ActiveTexture != o.ActiveTexture)
+    return false;
+
+  for(size_t i = 0; i < ARRAY_COUNT(Images); i++)
+  {
+    const Image &a = Images[i], &b = o.Images[i];
+    if(a.res != b.res || a.level != b.level || a.layered != b.layered || a.access != b.access ||
+       a.format != b.format || (a.layered && a.layer != b.layer))
+      return false;
+  }
+
+  if(Program != o.Program || Pipeline != o.Pipeline || VAO != o.VAO || FeedbackObj != o.FeedbackObj)
+    return false;
+
+  for(size_t i = 0; i < ARRAY_COUNT(BufferBindings); i++)
+    if(BufferBindings[i] != o.BufferBindings[i])
+      return false;
+
+  const IdxRangeBuffer *idxBufs[][2] = {
+      {AtomicCounter, o.AtomicCounter},
+      {ShaderStorage, o.ShaderStorage},
+      {TransformFeedback, o.TransformFeedback},
+      {UniformBinding, o.UniformBinding},
+  };
+  const size_t idxCounts[] = {
+      ARRAY_COUNT(AtomicCounter), ARRAY_COUNT(ShaderStorage), ARRAY_COUNT(TransformFeedback),
+      ARRAY_COUNT(UniformBinding),
+  };
+
+  for(size_t b = 0; b < ARRAY_COUNT(idxBufs); b++)
+  {
+    for(size_t i = 0; i < idxCounts[b]; i++)
+    {
+      const IdxRangeBuffer &x = idxBufs[b][0][i], &y = idxBufs[b][1][i];
+      if(x.res != y.res)
+        return false;
+
+      // glBindBufferBase() is shadowed as a 0-sized range, and implementations disagree on what
+      // they report for the range in that case. Only compare ranges that were set explicitly.
+      if(x.size != 0 && y.size != 0 && (x.start != y.start || x.size != y.size))
+        return false;
+    }
+  }
+
+  return ReadFBO == o.ReadFBO && DrawFBO == o.DrawFBO;
+}
+
+GLResource *GLStateShadow::TextureSlot(GLenum target, GLuint unit)
+{
+  if(unit >= ARRAY_COUNT(state.Tex2D))
+    return NULL;
+
+  switch(target)
+  {
+    case eGL_TEXTURE_1D: return &state.Tex1D[unit];
+    case eGL_TEXTURE_2D: return &state.Tex2D[unit];
+    case eGL_TEXTURE_3D: return &state.Tex3D[unit];
+    case eGL_TEXTURE_1D_ARRAY: return &state.Tex1DArray[unit];
+    case eGL_TEXTURE_2D_ARRAY: return &state.Tex2DArray[unit];
+    case eGL_TEXTURE_CUBE_MAP_ARRAY: return &state.TexCubeArray[unit];
+    case eGL_TEXTURE_RECTANGLE: return &state.TexRect[unit];
+    case eGL_TEXTURE_BUFFER: return &state.TexBuffer[unit];
+    case eGL_TEXTURE_CUBE_MAP: return &state.TexCube[unit];
+    case eGL_TEXTURE_2D_MULTISAMPLE: return &state.Tex2DMS[unit];
+    case eGL_TEXTURE_2D_MULTISAMPLE_ARRAY: return &state.Tex2DMSArray[unit];
+    default: break;
+  }
+
+  return NULL;
+}
+
+void GLStateShadow::SetActiveTexture(GLenum texture)
+{
+  state.ActiveTexture = texture;
+}
+
+void GLStateShadow::BindTexture(GLenum target, GLuint unit, GLResource res)
+{
+  if(!valid)
+    return;
+
+  // units past what we track are never fetched either, so there's nothing to update
+  if(unit >= ARRAY_COUNT(state.Tex2D))
+    return;
+
+  GLResource *slot = TextureSlot(target, unit);
+  if(slot)
+    *slot = res;
+  else
+    Invalidate();
+}
+
+void GLStateShadow::UnbindTextureUnit(GLuint unit)
+{
+  if(!valid || unit >= ARRAY_COUNT(state.Tex2D))
+    return;
+
+  const GLenum targets[] = {
+      eGL_TEXTURE_1D,
+      eGL_TEXTURE_2D,
+      eGL_TEXTURE_3D,
+      eGL_TEXTURE_1D_ARRAY,
+      eGL_TEXTURE_2D_ARRAY,
+      eGL_TEXTURE_CUBE_MAP_ARRAY,
+      eGL_TEXTURE_RECTANGLE,
+      eGL_TEXTURE_BUFFER,
+      eGL_TEXTURE_CUBE_MAP,
+      eGL_TEXTURE_2D_MULTISAMPLE,
+      eGL_TEXTURE_2D_MULTISAMPLE_ARRAY,
+  };
+
+  for(size_t t = 0; t < ARRAY_COUNT(targets); t++)
+    TextureSlot(targets[t], unit)->name = 0;
+}
+
+void GLStateShadow::BindSampler(GLuint unit, GLResource res)
+{
+  if(valid && unit < ARRAY_COUNT(state.Samplers))
+    state.Samplers[unit] = res;
+}
+
+void GLStateShadow::BindImage(GLuint unit, GLResource res, GLint level, GLboolean layered,
+                              GLint layer, GLenum access, GLenum format)
+{
+  if(!valid || unit >= ARRAY_COUNT(state.Images))
+    return;
+
+  // unbinding resets the unit to its default state rather than keeping the given parameters
+  if(res.name == 0)
+  {
+    level = 0;
+    layered = GL_FALSE;
+    layer = 0;
+    access = eGL_READ_ONLY;
+    format = eGL_R8;
+  }
+
+  GLRenderState::Image &img = state.Images[unit];
+  img.res = res;
+  img.level = (uint32_t)level;
+  img.layered = (layered == GL_TRUE);
+  img.layer = (uint32_t)layer;
+  img.access = access;
+  img.format = format;
+}
+
+void GLStateShadow::BindBuffer(GLenum target, GLResource res)
+{
+  if(!valid)
+    return;
+
+  int idx = -1;
+
+  switch(target)
+  {
+    case eGL_ARRAY_BUFFER: idx = GLRenderState::eBufIdx_Array; break;
+    case eGL_COPY_READ_BUFFER: idx = GLRenderState::eBufIdx_Copy_Read; break;
+    case eGL_COPY_WRITE_BUFFER: idx = GLRenderState::eBufIdx_Copy_Write; break;
+    case eGL_DRAW_INDIRECT_BUFFER: idx = GLRenderState::eBufIdx_Draw_Indirect; break;
+    case eGL_DISPATCH_INDIRECT_BUFFER: idx = GLRenderState::eBufIdx_Dispatch_Indirect; break;
+    case eGL_PIXEL_PACK_BUFFER: idx = GLRenderState::eBufIdx_Pixel_Pack; break;
+    case eGL_PIXEL_UNPACK_BUFFER: idx = GLRenderState::eBufIdx_Pixel_Unpack; break;
+    case eGL_QUERY_BUFFER: idx = GLRenderState::eBufIdx_Query; break;
+    case eGL_TEXTURE_BUFFER: idx = GLRenderState::eBufIdx_Texture; break;
+    case eGL_PARAMETER_BUFFER_ARB: idx = GLRenderState::eBufIdx_Parameter; break;
+    // the generic binding points of indexed targets aren't part of the render state, and the
+    // element array binding is VAO state
+    case eGL_ATOMIC_COUNTER_BUFFER:
+    case eGL_SHADER_STORAGE_BUFFER:
+    case eGL_TRANSFORM_FEEDBACK_BUFFER:
+    case eGL_UNIFORM_BUFFER:
+    case eGL_ELEMENT_ARRAY_BUFFER: return;
+    default: Invalidate(); return;
+  }
+
+  state.BufferBindings[idx] = res;
+}
+
+void GLStateShadow::BindBufferRange(GLenum target, GLuint index, GLResource res, uint64_t start,
+                                    uint64_t size)
+{
+  if(!valid)
+    return;
+
+  GLRenderState::IdxRangeBuffer *bufs = NULL;
+  size_t count = 0;
+
+  switch(target)
+  {
+    case eGL_ATOMIC_COUNTER_BUFFER:
+      bufs = state.AtomicCounter;
+      count = ARRAY_COUNT(state.AtomicCounter);
+      break;
+    case eGL_SHADER_STORAGE_BUFFER:
+      bufs = state.ShaderStorage;
+      count = ARRAY_COUNT(state.ShaderStorage);
+      break;
+    case eGL_TRANSFORM_FEEDBACK_BUFFER:
+      bufs = state.TransformFeedback;
+      count = ARRAY_COUNT(state.TransformFeedback);
+      break;
+    case eGL_UNIFORM_BUFFER:
+      bufs = state.UniformBinding;
+      count = ARRAY_COUNT(state.UniformBinding);
+      break;
+    default: Invalidate(); return;
+  }
+
+  if(index < count)
+  {
+    bufs[index].res = res;
+    bufs[index].start = start;
+    bufs[index].size = size;
+  }
+}
+
+void GLStateShadow::BindFramebuffer(GLenum target, GLResource res)
+{
+  if(!valid)
+    return;
+
+  if(target == eGL_DRAW_FRAMEBUFFER || target == eGL_FRAMEBUFFER)
+    state.DrawFBO = res;
+  if(target == eGL_READ_FRAMEBUFFER || target == eGL_FRAMEBUFFER)
+    state.ReadFBO = res;
+}
+
 void GLRenderState::ApplyState(WrappedOpenGL *driver)
 {
   ContextPair &ctx = driver->GetCtx();
@@ -2082,3 +2394,120 @@ void DoSerialise(SerialiserType &ser, GLRenderState &el)
 }
 
 INSTANTIATE_SERIALISE_TYPE(GLRenderState);
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#undef None
+
+#include "3rdparty/catch/catch.hpp"
+
+TEST_CASE("GL state shadow", "[gl]")
+{
+  void *share = (void *)0x1000;
+  void *ctx = (void *)0x2000;
+  ContextPair pair = {ctx, share};
+
+  GLStateShadow shadow;
+
+  SECTION("Updates are ignored until seeded")
+  {
+    shadow.BindTexture(eGL_TEXTURE_2D, 0, TextureRes(pair, 5));
+    CHECK(shadow.state.Tex2D[0].name == 0);
+    CHECK_FALSE(shadow.valid);
+  };
+
+  shadow.valid = true;
+
+  SECTION("Textures and samplers")
+  {
+    shadow.BindTexture(eGL_TEXTURE_2D, 3, TextureRes(pair, 5));
+    shadow.BindTexture(eGL_TEXTURE_CUBE_MAP, 3, TextureRes(pair, 6));
+    shadow.BindTexture(eGL_TEXTURE_2D_MULTISAMPLE_ARRAY, 127, TextureRes(pair, 7));
+    shadow.BindSampler(3, SamplerRes(pair, 8));
+
+    CHECK((shadow.state.Tex2D[3] == TextureRes(pair, 5)));
+    CHECK((shadow.state.TexCube[3] == TextureRes(pair, 6)));
+    CHECK((shadow.state.Tex2DMSArray[127] == TextureRes(pair, 7)));
+    CHECK((shadow.state.Samplers[3] == SamplerRes(pair, 8)));
+
+    // units we don't track are ignored rather than overflowing
+    shadow.BindTexture(eGL_TEXTURE_2D, 200, TextureRes(pair, 9));
+    CHECK(shadow.valid);
+
+    shadow.UnbindTextureUnit(3);
+    CHECK(shadow.state.Tex2D[3].name == 0);
+    CHECK(shadow.state.TexCube[3].name == 0);
+    CHECK(shadow.state.Tex2D[3].ContextShareGroup == share);
+    CHECK(shadow.state.Samplers[3].name == 8);
+
+    // we can't follow a target we don't know, so give up until the next real fetch
+    shadow.BindTexture(eGL_NONE, 0, TextureRes(pair, 5));
+    CHECK_FALSE(shadow.valid);
+  };
+
+  SECTION("Buffers")
+  {
+    shadow.BindBuffer(eGL_ARRAY_BUFFER, BufferRes(pair, 1));
+    shadow.BindBuffer(eGL_DRAW_INDIRECT_BUFFER, BufferRes(pair, 2));
+    shadow.BindBuffer(eGL_ELEMENT_ARRAY_BUFFER, BufferRes(pair, 3));
+    shadow.BindBufferRange(eGL_UNIFORM_BUFFER, 4, BufferRes(pair, 4), 256, 64);
+    shadow.BindBufferRange(eGL_SHADER_STORAGE_BUFFER, 1000, BufferRes(pair, 5), 0, 0);
+
+    CHECK(shadow.valid);
+    CHECK((shadow.state.BufferBindings[GLRenderState::eBufIdx_Array] == BufferRes(pair, 1)));
+    CHECK((shadow.state.BufferBindings[GLRenderState::eBufIdx_Draw_Indirect] ==
+           BufferRes(pair, 2)));
+    CHECK((shadow.state.UniformBinding[4].res == BufferRes(pair, 4)));
+    CHECK(shadow.state.UniformBinding[4].start == 256);
+    CHECK(shadow.state.UniformBinding[4].size == 64);
+
+    for(size_t i = 0; i < ARRAY_COUNT(shadow.state.BufferBindings); i++)
+      CHECK(shadow.state.BufferBindings[i].name != 3);
+  };
+
+  SECTION("Images reset to defaults when unbound")
+  {
+    shadow.BindImage(2, TextureRes(pair, 5), 3, GL_TRUE, 4, eGL_WRITE_ONLY, eGL_RGBA32F);
+    CHECK(shadow.state.Images[2].level == 3);
+    CHECK(shadow.state.Images[2].layered);
+
+    shadow.BindImage(2, TextureRes(pair, 0), 3, GL_TRUE, 4, eGL_WRITE_ONLY, eGL_RGBA32F);
+    CHECK(shadow.state.Images[2].level == 0);
+    CHECK_FALSE(shadow.state.Images[2].layered);
+    CHECK(shadow.state.Images[2].access == eGL_READ_ONLY);
+  };
+
+  SECTION("Framebuffers")
+  {
+    shadow.BindFramebuffer(eGL_FRAMEBUFFER, FramebufferRes(pair, 4));
+    CHECK(shadow.state.DrawFBO.name == 4);
+    CHECK(shadow.state.ReadFBO.name == 4);
+
+    shadow.BindFramebuffer(eGL_READ_FRAMEBUFFER, FramebufferRes(pair, 5));
+    CHECK(shadow.state.DrawFBO.name == 4);
+    CHECK(shadow.state.ReadFBO.name == 5);
+  };
+
+  SECTION("Comparing against fetched bindings")
+  {
+    GLRenderState fetched;
+    fetched.CopyBindings(shadow.state);
+    CHECK(fetched.BindingsMatch(shadow.state));
+
+    // a base binding is shadowed without a range, which matches whatever the driver reports
+    shadow.BindBufferRange(eGL_UNIFORM_BUFFER, 0, BufferRes(pair, 4), 0, 0);
+    fetched.UniformBinding[0].res = BufferRes(pair, 4);
+    fetched.UniformBinding[0].start = 0;
+    fetched.UniformBinding[0].size = 1024;
+    CHECK(fetched.BindingsMatch(shadow.state));
+
+    shadow.BindBufferRange(eGL_UNIFORM_BUFFER, 0, BufferRes(pair, 4), 0, 512);
+    CHECK_FALSE(fetched.BindingsMatch(shadow.state));
+
+    fetched.CopyBindings(shadow.state);
+    shadow.state.Program = ProgramRes(pair, 9);
+    CHECK_FALSE(fetched.BindingsMatch(shadow.state));
+  };
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -77,6 +77,13 @@ struct GLRenderState
   void ApplyState(WrappedOpenGL *driver);
   void Clear();
 
+  // fetches only the object bindings - everything MarkReferenced() needs. If the driver has a
+  // state shadow enabled this is a copy out of the shadow rather than a set of glGet queries.
+  // FetchState() gets its bindings through this too.
+  void FetchBindings(WrappedOpenGL *driver);
+  void CopyBindings(const GLRenderState &o);
+  bool BindingsMatch(const GLRenderState &o) const;
+
   void MarkReferenced(WrappedOpenGL *driver, bool initial) const;
   void MarkDirty(WrappedOpenGL *driver);
 
@@ -301,6 +308,31 @@ struct GLRenderState
 
 private:
   bool CheckEnableDisableParam(GLenum pname);
+  void QueryBindings(WrappedOpenGL *driver);
+};
+
+// shadow copy of one context's object bindings, updated by the binding wrappers as the application
+// calls them. It starts out invalid and is seeded from a real query the first time it's needed,
+// and anything it can't follow precisely (deletes, transform feedback objects, unknown targets)
+// invalidates it again. Opt-in with RENDERDOC_GL_STATE_SHADOW=1, or =verify to cross-check every
+// use against the real state.
+struct GLStateShadow
+{
+  bool valid = false;
+  GLRenderState state;
+
+  void Invalidate() { valid = false; }
+  GLResource *TextureSlot(GLenum target, GLuint unit);
+
+  void SetActiveTexture(GLenum texture);
+  void BindTexture(GLenum target, GLuint unit, GLResource res);
+  void UnbindTextureUnit(GLuint unit);
+  void BindSampler(GLuint unit, GLResource res);
+  void BindImage(GLuint unit, GLResource res, GLint level, GLboolean layered, GLint layer,
+                 GLenum access, GLenum format);
+  void BindBuffer(GLenum target, GLResource res);
+  void BindBufferRange(GLenum target, GLuint index, GLResource res, uint64_t start, uint64_t size);
+  void BindFramebuffer(GLenum target, GLResource res);
 };
 
 DECLARE_REFLECTION_STRUCT(GLRenderState::Image);
@@ -729,7 +729,7 @@ string GLReplay::DisassembleShader(ResourceId pipeline, const ShaderReflection *
     std::string &disasm = shaderDetails.disassembly;
 
     if(disasm.empty())
-      disasm = shaderDetails.spirv.Disassemble(refl->entryPoint.c_str());
+      disasm = shaderDetails.GetSPIRV().Disassemble(refl->entryPoint.c_str());
 
     return disasm;
   }
@@ -3466,7 +3466,7 @@ class GLDummyPlatform : public GLPlatform
   }
 };
 
-void GL_ProcessStructured(RDCFile *rdc, SDFile &output)
+void GL_ProcessStructured(RDCFile *rdc, SDFile &output, bool lazy)
 {
   GLDummyPlatform dummy;
   WrappedOpenGL device(dummy);
@@ -230,6 +230,9 @@ void WrappedOpenGL::glBindBuffer(GLenum target, GLuint buffer)
 {
   SERIALISE_TIME_CALL(GL.glBindBuffer(target, buffer));
 
+  if(GLStateShadow *shadow = GetStateShadow())
+    shadow->BindBuffer(target, BufferRes(GetCtx(), buffer));
+
   ContextData &cd = GetCtxData();
 
   size_t idx = BufferIdx(target);
@@ -383,7 +386,7 @@ bool WrappedOpenGL::Serialise_glNamedBufferStorageEXT(SerialiserType &ser, GLuin
   SERIALISE_ELEMENT_LOCAL(buffer, BufferRes(GetCtx(), bufferHandle));
 
   SERIALISE_ELEMENT_LOCAL(bytesize, (uint64_t)size);
-  SERIALISE_ELEMENT_ARRAY(data, bytesize);
+  SERIALISE_ELEMENT_ARRAY_ZEROCOPY(data, bytesize);
 
   if(ser.IsWriting())
   {
@@ -528,7 +531,7 @@ bool WrappedOpenGL::Serialise_glNamedBufferDataEXT(SerialiserType &ser, GLuint b
   SERIALISE_ELEMENT_LOCAL(buffer, BufferRes(GetCtx(), bufferHandle));
 
   SERIALISE_ELEMENT_LOCAL(bytesize, (uint64_t)size);
-  SERIALISE_ELEMENT_ARRAY(data, bytesize);
+  SERIALISE_ELEMENT_ARRAY_ZEROCOPY(data, bytesize);
 
   if(ser.IsWriting())
   {
@@ -844,7 +847,7 @@ bool WrappedOpenGL::Serialise_glNamedBufferSubDataEXT(SerialiserType &ser, GLuin
   SERIALISE_ELEMENT_LOCAL(offset, (uint64_t)offsetPtr);
 
   SERIALISE_ELEMENT_LOCAL(bytesize, (uint64_t)size);
-  SERIALISE_ELEMENT_ARRAY(data, bytesize);
+  SERIALISE_ELEMENT_ARRAY_ZEROCOPY(data, bytesize);
 
   SERIALISE_CHECK_READ_ERRORS();
 
@@ -1124,6 +1127,9 @@ void WrappedOpenGL::glBindBufferBase(GLenum target, GLuint index, GLuint buffer)
 
   SERIALISE_TIME_CALL(GL.glBindBufferBase(target, index, buffer));
 
+  if(GLStateShadow *shadow = GetStateShadow())
+    shadow->BindBufferRange(target, index, BufferRes(GetCtx(), buffer), 0, 0);
+
   if(IsCaptureMode(m_State))
   {
     size_t idx = BufferIdx(target);
@@ -1234,6 +1240,10 @@ void WrappedOpenGL::glBindBufferRange(GLenum target, GLuint index, GLuint buffer
 
   SERIALISE_TIME_CALL(GL.glBindBufferRange(target, index, buffer, offset, size));
 
+  if(GLStateShadow *shadow = GetStateShadow())
+    shadow->BindBufferRange(target, index, BufferRes(GetCtx(), buffer), (uint64_t)offset,
+                            (uint64_t)size);
+
   if(IsCaptureMode(m_State))
   {
     size_t idx = BufferIdx(target);
@@ -1358,6 +1368,13 @@ void WrappedOpenGL::glBindBuffersBase(GLenum target, GLuint first, GLsizei count
 {
   SERIALISE_TIME_CALL(GL.glBindBuffersBase(target, first, count, buffers));
 
+  if(GLStateShadow *shadow = GetStateShadow())
+  {
+    for(GLsizei i = 0; i < count; i++)
+      shadow->BindBufferRange(target, first + i, BufferRes(GetCtx(), buffers ? buffers[i] : 0), 0,
+                              0);
+  }
+
   if(IsCaptureMode(m_State) && count > 0)
   {
     ContextData &cd = GetCtxData();
@@ -1540,6 +1557,18 @@ void WrappedOpenGL::glBindBuffersRange(GLenum target, GLuint first, GLsizei coun
 {
   SERIALISE_TIME_CALL(GL.glBindBuffersRange(target, first, count, buffers, offsets, sizes));
 
+  if(GLStateShadow *shadow = GetStateShadow())
+  {
+    for(GLsizei i = 0; i < count; i++)
+    {
+      if(buffers && buffers[i])
+        shadow->BindBufferRange(target, first + i, BufferRes(GetCtx(), buffers[i]),
+                                (uint64_t)offsets[i], (uint64_t)sizes[i]);
+      else
+        shadow->BindBufferRange(target, first + i, BufferRes(GetCtx(), 0), 0, 0);
+    }
+  }
+
   if(IsCaptureMode(m_State) && count > 0)
   {
     ContextData &cd = GetCtxData();
@@ -2177,7 +2206,7 @@ bool WrappedOpenGL::Serialise_glUnmapNamedBufferEXT(SerialiserType &ser, GLuint
   SERIALISE_ELEMENT(diffStart);
   SERIALISE_ELEMENT(diffEnd);
 
-  SERIALISE_ELEMENT_ARRAY(MapWrittenData, length);
+  SERIALISE_ELEMENT_ARRAY_ZEROCOPY(MapWrittenData, length);
 
   SERIALISE_CHECK_READ_ERRORS();
 
@@ -2352,7 +2381,7 @@ bool WrappedOpenGL::Serialise_glFlushMappedNamedBufferRangeEXT(SerialiserType &s
     MapOffset = record->Map.offset;
   }
 
-  SERIALISE_ELEMENT_ARRAY(FlushedData, length);
+  SERIALISE_ELEMENT_ARRAY_ZEROCOPY(FlushedData, length);
 
   if(ser.VersionAtLeast(0x1F))
   {
@@ -2697,6 +2726,8 @@ void WrappedOpenGL::glDeleteTransformFeedbacks(GLsizei n, const GLuint *ids)
     }
   }
 
+  InvalidateStateShadow();
+
   GL.glDeleteTransformFeedbacks(n, ids);
 }
 
@@ -2831,6 +2862,9 @@ void WrappedOpenGL::glBindTransformFeedback(GLenum target, GLuint id)
 {
   SERIALISE_TIME_CALL(GL.glBindTransformFeedback(target, id));
 
+  // the indexed transform feedback buffer bindings come with the object, so re-fetch everything
+  InvalidateStateShadow();
+
   GLResourceRecord *record = NULL;
 
   if(IsCaptureMode(m_State))
@@ -4125,6 +4159,9 @@ void WrappedOpenGL::glBindVertexArray(GLuint array)
 {
   SERIALISE_TIME_CALL(GL.glBindVertexArray(array));
 
+  if(GLStateShadow *shadow = GetStateShadow())
+    shadow->state.VAO = VertexArrayRes(GetCtx(), array);
+
   GLResourceRecord *record = NULL;
 
   if(IsCaptureMode(m_State))
@@ -4603,6 +4640,8 @@ void WrappedOpenGL::glDeleteBuffers(GLsizei n, const GLuint *buffers)
     }
   }
 
+  InvalidateStateShadow();
+
   GL.glDeleteBuffers(n, buffers);
 }
 
@@ -4620,6 +4659,8 @@ void WrappedOpenGL::glDeleteVertexArrays(GLsizei n, const GLuint *arrays)
     }
   }
 
+  InvalidateStateShadow();
+
   GL.glDeleteVertexArrays(n, arrays);
 }
 
@@ -163,7 +163,7 @@ void WrappedOpenGL::glDispatchCompute(GLuint num_groups_x, GLuint num_groups_y,
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -271,7 +271,7 @@ void WrappedOpenGL::glDispatchComputeGroupSizeARB(GLuint num_groups_x, GLuint nu
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -340,7 +340,7 @@ void WrappedOpenGL::glDispatchComputeIndirect(GLintptr indirect)
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -506,7 +506,7 @@ void WrappedOpenGL::glDrawTransformFeedback(GLenum mode, GLuint id)
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -575,7 +575,7 @@ void WrappedOpenGL::glDrawTransformFeedbackInstanced(GLenum mode, GLuint id, GLs
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -643,7 +643,7 @@ void WrappedOpenGL::glDrawTransformFeedbackStream(GLenum mode, GLuint id, GLuint
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -716,7 +716,7 @@ void WrappedOpenGL::glDrawTransformFeedbackStreamInstanced(GLenum mode, GLuint i
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -948,7 +948,7 @@ void WrappedOpenGL::glDrawArrays(GLenum mode, GLint first, GLsizei count)
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
 
     RestoreClientMemoryArrays(clientMemory, eGL_NONE);
@@ -1024,7 +1024,7 @@ void WrappedOpenGL::glDrawArraysIndirect(GLenum mode, const void *indirect)
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -1095,7 +1095,7 @@ void WrappedOpenGL::glDrawArraysInstanced(GLenum mode, GLint first, GLsizei coun
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
 
     RestoreClientMemoryArrays(clientMemory, eGL_NONE);
@@ -1172,7 +1172,7 @@ void WrappedOpenGL::glDrawArraysInstancedBaseInstance(GLenum mode, GLint first,
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
 
     RestoreClientMemoryArrays(clientMemory, eGL_NONE);
@@ -1262,7 +1262,7 @@ void WrappedOpenGL::glDrawElements(GLenum mode, GLsizei count, GLenum type, cons
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
 
     RestoreClientMemoryArrays(clientMemory, type);
@@ -1344,7 +1344,7 @@ void WrappedOpenGL::glDrawElementsIndirect(GLenum mode, GLenum type, const void
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -1421,7 +1421,7 @@ void WrappedOpenGL::glDrawRangeElements(GLenum mode, GLuint start, GLuint end, G
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
 
     RestoreClientMemoryArrays(clientMemory, type);
@@ -1505,7 +1505,7 @@ void WrappedOpenGL::glDrawRangeElementsBaseVertex(GLenum mode, GLuint start, GLu
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
 
     RestoreClientMemoryArrays(clientMemory, type);
@@ -1583,7 +1583,7 @@ void WrappedOpenGL::glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
 
     RestoreClientMemoryArrays(clientMemory, type);
@@ -1661,7 +1661,7 @@ void WrappedOpenGL::glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum t
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
 
     RestoreClientMemoryArrays(clientMemory, type);
@@ -1746,7 +1746,7 @@ void WrappedOpenGL::glDrawElementsInstancedBaseInstance(GLenum mode, GLsizei cou
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
 
     RestoreClientMemoryArrays(clientMemory, type);
@@ -1831,7 +1831,7 @@ void WrappedOpenGL::glDrawElementsInstancedBaseVertex(GLenum mode, GLsizei count
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
 
     RestoreClientMemoryArrays(clientMemory, type);
@@ -1917,7 +1917,7 @@ void WrappedOpenGL::glDrawElementsInstancedBaseVertexBaseInstance(GLenum mode, G
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
 
     RestoreClientMemoryArrays(clientMemory, type);
@@ -2056,7 +2056,7 @@ void WrappedOpenGL::glMultiDrawArrays(GLenum mode, const GLint *first, const GLs
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -2217,7 +2217,7 @@ void WrappedOpenGL::glMultiDrawElements(GLenum mode, const GLsizei *count, GLenu
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -2384,7 +2384,7 @@ void WrappedOpenGL::glMultiDrawElementsBaseVertex(GLenum mode, const GLsizei *co
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -2592,7 +2592,7 @@ void WrappedOpenGL::glMultiDrawArraysIndirect(GLenum mode, const void *indirect,
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -2623,9 +2623,6 @@ bool WrappedOpenGL::Serialise_glMultiDrawElementsIndirect(SerialiserType &ser, G
   {
     if(IsLoading(m_State))
     {
-      GLRenderState state;
-      state.FetchState(this);
-
       GL.glMultiDrawElementsIndirect(mode, type, (const void *)offset, drawcount, stride);
 
       DrawcallDescription draw;
@@ -2810,7 +2807,7 @@ void WrappedOpenGL::glMultiDrawElementsIndirect(GLenum mode, GLenum type, const
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -3033,7 +3030,7 @@ void WrappedOpenGL::glMultiDrawArraysIndirectCount(GLenum mode, const void *indi
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -3261,7 +3258,7 @@ void WrappedOpenGL::glMultiDrawElementsIndirectCount(GLenum mode, GLenum type, c
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
@@ -3365,7 +3362,7 @@ void WrappedOpenGL::glClearNamedFramebufferfv(GLuint framebuffer, GLenum buffer,
     GetContextRecord()->AddChunk(scope.Get());
 
     GLRenderState state;
-    state.FetchState(this);
+    state.FetchBindings(this);
     state.MarkReferenced(this, false);
   }
   else if(IsBackgroundCapturing(m_State))
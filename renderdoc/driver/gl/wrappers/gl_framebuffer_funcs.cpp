@@ -1530,6 +1530,14 @@ void WrappedOpenGL::glBindFramebuffer(GLenum target, GLuint framebuffer)
 {
   SERIALISE_TIME_CALL(GL.glBindFramebuffer(target, framebuffer));
 
+  if(GLStateShadow *shadow = GetStateShadow())
+  {
+    // the default framebuffer belongs to the context itself, see GLRenderState::QueryBindings()
+    ContextPair &ctx = GetCtx();
+    shadow->BindFramebuffer(target, framebuffer == 0 ? FramebufferRes({ctx.ctx, ctx.ctx}, 0)
+                                                     : FramebufferRes(ctx, framebuffer));
+  }
+
   if(IsActiveCapturing(m_State))
   {
     USE_SCRATCH_SERIALISER();
@@ -2045,6 +2053,8 @@ void WrappedOpenGL::glDeleteFramebuffers(GLsizei n, const GLuint *framebuffers)
     }
   }
 
+  InvalidateStateShadow();
+
   GL.glDeleteFramebuffers(n, framebuffers);
 }
 
@@ -168,6 +168,9 @@ void WrappedOpenGL::glBindSampler(GLuint unit, GLuint sampler)
 {
   SERIALISE_TIME_CALL(GL.glBindSampler(unit, sampler));
 
+  if(GLStateShadow *shadow = GetStateShadow())
+    shadow->BindSampler(unit, SamplerRes(GetCtx(), sampler));
+
   if(IsActiveCapturing(m_State))
   {
     USE_SCRATCH_SERIALISER();
@@ -216,6 +219,12 @@ void WrappedOpenGL::glBindSamplers(GLuint first, GLsizei count, const GLuint *sa
 {
   SERIALISE_TIME_CALL(GL.glBindSamplers(first, count, samplers));
 
+  if(GLStateShadow *shadow = GetStateShadow())
+  {
+    for(GLsizei i = 0; i < count; i++)
+      shadow->BindSampler(first + i, SamplerRes(GetCtx(), samplers ? samplers[i] : 0));
+  }
+
   if(IsActiveCapturing(m_State))
   {
     USE_SCRATCH_SERIALISER();
@@ -620,6 +629,8 @@ void WrappedOpenGL::glDeleteSamplers(GLsizei n, const GLuint *ids)
     }
   }
 
+  InvalidateStateShadow();
+
   GL.glDeleteSamplers(n, ids);
 }
 
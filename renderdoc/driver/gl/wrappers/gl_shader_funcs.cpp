@@ -27,6 +27,7 @@
 #include "../gl_shader_refl.h"
 #include "common/common.h"
 #include "driver/shaders/spirv/spirv_common.h"
+#include "driver/shaders/spirv/spirv_reflection_cache.h"
 #include "strings/string_utils.h"
 
 enum GLshaderbitfield
@@ -54,6 +55,14 @@ std::string DoStringise(const GLshaderbitfield &el)
   END_BITFIELD_STRINGISE();
 }
 
+SPVModule &WrappedOpenGL::ShaderData::GetSPIRV()
+{
+  if(spirv.spirv.empty() && !spirvWords.empty())
+    ParseSPIRV(spirvWords.data(), spirvWords.size(), spirv);
+
+  return spirv;
+}
+
 void WrappedOpenGL::ShaderData::ProcessSPIRVCompilation(WrappedOpenGL &drv, ResourceId id,
                                                         GLuint realShader, const GLchar *pEntryPoint,
                                                         GLuint numSpecializationConstants,
@@ -64,13 +73,14 @@ void WrappedOpenGL::ShaderData::ProcessSPIRVCompilation(WrappedOpenGL &drv, Reso
   reflection.entryPoint = pEntryPoint;
   reflection.stage = MakeShaderStage(type);
   reflection.encoding = ShaderEncoding::SPIRV;
-  reflection.rawBytes.assign((byte *)spirv.spirv.data(), spirv.spirv.size() * sizeof(uint32_t));
+  reflection.rawBytes.assign((byte *)spirvWords.data(), spirvWords.size() * sizeof(uint32_t));
 
   // we discard this too, because we don't need it - we don't do any SPIR-V patching in GL
   SPIRVPatchData patchData;
 
-  spirv.MakeReflection(GraphicsAPI::OpenGL, ShaderStage(ShaderIdx(type)), pEntryPoint, reflection,
-                       mapping, patchData);
+  MakeCachedSPIRVReflection(GraphicsAPI::OpenGL, ShaderStage(ShaderIdx(type)), pEntryPoint,
+                            spirvWords, reflection, mapping, patchData,
+                            [this]() -> const SPVModule & { return GetSPIRV(); });
 
   version = 460;
 
@@ -1279,6 +1289,9 @@ void WrappedOpenGL::glUseProgram(GLuint program)
 
   GetCtxData().m_Program = program;
 
+  if(GLStateShadow *shadow = GetStateShadow())
+    shadow->state.Program = ProgramRes(GetCtx(), program);
+
   if(IsActiveCapturing(m_State))
   {
     USE_SCRATCH_SERIALISER();
@@ -1668,6 +1681,9 @@ void WrappedOpenGL::glBindProgramPipeline(GLuint pipeline)
 
   GetCtxData().m_ProgramPipeline = pipeline;
 
+  if(GLStateShadow *shadow = GetStateShadow())
+    shadow->state.Pipeline = ProgramPipeRes(GetCtx(), pipeline);
+
   if(IsActiveCapturing(m_State))
   {
     USE_SCRATCH_SERIALISER();
@@ -1725,6 +1741,8 @@ void WrappedOpenGL::glDeleteProgramPipelines(GLsizei n, const GLuint *pipelines)
     }
   }
 
+  InvalidateStateShadow();
+
   GL.glDeleteProgramPipelines(n, pipelines);
 }
 
@@ -1910,8 +1928,8 @@ bool WrappedOpenGL::Serialise_glSpecializeShader(SerialiserType &ser, GLuint sha
     GL.glSpecializeShader(shader.name, pEntryPoint, numSpecializationConstants, pConstantIndex,
                           pConstantValue);
 
-    ParseSPIRV(m_Shaders[liveId].spirvWords.data(), m_Shaders[liveId].spirvWords.size(),
-               m_Shaders[liveId].spirv);
+    // the module is parsed on demand, if it's needed
+    m_Shaders[liveId].spirv = SPVModule();
 
     m_Shaders[liveId].ProcessSPIRVCompilation(*this, GetResourceManager()->GetOriginalID(liveId),
                                               shader.name, pEntryPoint, numSpecializationConstants,
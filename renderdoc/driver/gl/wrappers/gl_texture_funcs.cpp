@@ -233,6 +233,8 @@ void WrappedOpenGL::glDeleteTextures(GLsizei n, const GLuint *textures)
     }
   }
 
+  InvalidateStateShadow();
+
   GL.glDeleteTextures(n, textures);
 }
 
@@ -265,6 +267,9 @@ void WrappedOpenGL::glBindTexture(GLenum target, GLuint texture)
 {
   SERIALISE_TIME_CALL(GL.glBindTexture(target, texture));
 
+  if(GLStateShadow *shadow = GetStateShadow())
+    shadow->BindTexture(target, GetCtxData().m_TextureUnit, TextureRes(GetCtx(), texture));
+
   if(texture != 0 && GetResourceManager()->GetID(TextureRes(GetCtx(), texture)) == ResourceId())
     return;
 
@@ -373,6 +378,24 @@ void WrappedOpenGL::glBindTextures(GLuint first, GLsizei count, const GLuint *te
 {
   SERIALISE_TIME_CALL(GL.glBindTextures(first, count, textures));
 
+  if(GLStateShadow *shadow = GetStateShadow())
+  {
+    for(GLsizei i = 0; i < count; i++)
+    {
+      if(textures == NULL || textures[i] == 0)
+      {
+        shadow->UnbindTextureUnit(first + i);
+      }
+      else
+      {
+        GLResourceRecord *r =
+            GetResourceManager()->GetResourceRecord(TextureRes(GetCtx(), textures[i]));
+        shadow->BindTexture(r ? TextureTarget(r->datatype) : eGL_NONE, first + i,
+                            TextureRes(GetCtx(), textures[i]));
+      }
+    }
+  }
+
   if(IsActiveCapturing(m_State))
   {
     USE_SCRATCH_SERIALISER();
@@ -426,6 +449,9 @@ void WrappedOpenGL::glBindMultiTextureEXT(GLenum texunit, GLenum target, GLuint
 {
   SERIALISE_TIME_CALL(GL.glBindMultiTextureEXT(texunit, target, texture));
 
+  if(GLStateShadow *shadow = GetStateShadow())
+    shadow->BindTexture(target, texunit - eGL_TEXTURE0, TextureRes(GetCtx(), texture));
+
   if(texture != 0 && GetResourceManager()->GetID(TextureRes(GetCtx(), texture)) == ResourceId())
     return;
 
@@ -509,6 +535,20 @@ void WrappedOpenGL::glBindTextureUnit(GLuint unit, GLuint texture)
 {
   SERIALISE_TIME_CALL(GL.glBindTextureUnit(unit, texture));
 
+  if(GLStateShadow *shadow = GetStateShadow())
+  {
+    if(texture == 0)
+    {
+      shadow->UnbindTextureUnit(unit);
+    }
+    else
+    {
+      GLResourceRecord *r = GetResourceManager()->GetResourceRecord(TextureRes(GetCtx(), texture));
+      shadow->BindTexture(r ? TextureTarget(r->datatype) : eGL_NONE, unit,
+                          TextureRes(GetCtx(), texture));
+    }
+  }
+
   if(texture != 0 && GetResourceManager()->GetID(TextureRes(GetCtx(), texture)) == ResourceId())
     return;
 
@@ -566,6 +606,9 @@ void WrappedOpenGL::glBindImageTexture(GLuint unit, GLuint texture, GLint level,
 {
   SERIALISE_TIME_CALL(GL.glBindImageTexture(unit, texture, level, layered, layer, access, format));
 
+  if(GLStateShadow *shadow = GetStateShadow())
+    shadow->BindImage(unit, TextureRes(GetCtx(), texture), level, layered, layer, access, format);
+
   if(IsActiveCapturing(m_State))
   {
     Chunk *chunk = NULL;
@@ -628,6 +671,9 @@ void WrappedOpenGL::glBindImageTextures(GLuint first, GLsizei count, const GLuin
 {
   SERIALISE_TIME_CALL(GL.glBindImageTextures(first, count, textures));
 
+  // the implied level/layer/format per texture isn't worth replicating here
+  InvalidateStateShadow();
+
   if(IsActiveCapturing(m_State))
   {
     USE_SCRATCH_SERIALISER();
@@ -2048,6 +2094,9 @@ void WrappedOpenGL::glActiveTexture(GLenum texture)
 
   GetCtxData().m_TextureUnit = texture - eGL_TEXTURE0;
 
+  if(GLStateShadow *shadow = GetStateShadow())
+    shadow->SetActiveTexture(texture);
+
   if(IsActiveCapturing(m_State))
   {
     Chunk *chunk = NULL;
@@ -2107,7 +2156,7 @@ bool WrappedOpenGL::Serialise_glTextureImage1DEXT(SerialiserType &ser, GLuint te
 
   size_t subimageSize = GetByteSize(width, 1, 1, format, type);
 
-  SERIALISE_ELEMENT_ARRAY(pixels, subimageSize);
+  SERIALISE_ELEMENT_ARRAY_ZEROCOPY(pixels, subimageSize);
 
   SAFE_DELETE_ARRAY(unpackedPixels);
 
@@ -2328,7 +2377,7 @@ bool WrappedOpenGL::Serialise_glTextureImage2DEXT(SerialiserType &ser, GLuint te
 
   size_t subimageSize = GetByteSize(width, height, 1, format, type);
 
-  SERIALISE_ELEMENT_ARRAY(pixels, subimageSize);
+  SERIALISE_ELEMENT_ARRAY_ZEROCOPY(pixels, subimageSize);
 
   SAFE_DELETE_ARRAY(unpackedPixels);
 
@@ -2579,7 +2628,7 @@ bool WrappedOpenGL::Serialise_glTextureImage3DEXT(SerialiserType &ser, GLuint te
 
   size_t subimageSize = GetByteSize(width, height, depth, format, type);
 
-  SERIALISE_ELEMENT_ARRAY(pixels, subimageSize);
+  SERIALISE_ELEMENT_ARRAY_ZEROCOPY(pixels, subimageSize);
 
   SAFE_DELETE_ARRAY(unpackedPixels);
 
@@ -2805,7 +2854,7 @@ bool WrappedOpenGL::Serialise_glCompressedTextureImage1DEXT(SerialiserType &ser,
   }
 
   SERIALISE_ELEMENT(imageSize);
-  SERIALISE_ELEMENT_ARRAY(pixels, imageSize);
+  SERIALISE_ELEMENT_ARRAY_ZEROCOPY(pixels, imageSize);
 
   SAFE_DELETE_ARRAY(unpackedPixels);
 
@@ -3125,7 +3174,7 @@ bool WrappedOpenGL::Serialise_glCompressedTextureImage2DEXT(SerialiserType &ser,
   }
 
   SERIALISE_ELEMENT(imageSize);
-  SERIALISE_ELEMENT_ARRAY(pixels, imageSize);
+  SERIALISE_ELEMENT_ARRAY_ZEROCOPY(pixels, imageSize);
 
   SAFE_DELETE_ARRAY(unpackedPixels);
 
@@ -3385,7 +3434,7 @@ bool WrappedOpenGL::Serialise_glCompressedTextureImage3DEXT(SerialiserType &ser,
   }
 
   SERIALISE_ELEMENT(imageSize);
-  SERIALISE_ELEMENT_ARRAY(pixels, imageSize);
+  SERIALISE_ELEMENT_ARRAY_ZEROCOPY(pixels, imageSize);
 
   SAFE_DELETE_ARRAY(unpackedPixels);
 
@@ -61,6 +61,56 @@ void ShutdownSPIRVCompiler()
   }
 }
 
+void ScanSPIRVEntryPoints(const std::vector<uint32_t> &spirv, rdcarray<ShaderEntryPoint> &entries)
+{
+  // skip the header
+  size_t it = 5;
+  bool seenEntry = false;
+
+  while(it < spirv.size())
+  {
+    uint32_t WordCount = spirv[it] >> spv::WordCountShift;
+    spv::Op opcode = spv::Op(spirv[it] & spv::OpCodeMask);
+
+    if(WordCount == 0 || it + WordCount > spirv.size())
+      break;
+
+    if(opcode == spv::OpEntryPoint && WordCount >= 4)
+    {
+      seenEntry = true;
+
+      ShaderStage stage = ShaderStage::Count;
+      switch(spv::ExecutionModel(spirv[it + 1]))
+      {
+        case spv::ExecutionModelVertex: stage = ShaderStage::Vertex; break;
+        case spv::ExecutionModelTessellationControl: stage = ShaderStage::Tess_Control; break;
+        case spv::ExecutionModelTessellationEvaluation: stage = ShaderStage::Tess_Eval; break;
+        case spv::ExecutionModelGeometry: stage = ShaderStage::Geometry; break;
+        case spv::ExecutionModelFragment: stage = ShaderStage::Fragment; break;
+        case spv::ExecutionModelGLCompute: stage = ShaderStage::Compute; break;
+        default: break;
+      }
+
+      // the name is a nul-terminated string packed into the remaining words
+      const char *name = (const char *)&spirv[it + 3];
+      size_t maxLen = (WordCount - 3) * sizeof(uint32_t);
+      size_t len = 0;
+      while(len < maxLen && name[len])
+        len++;
+
+      if(stage != ShaderStage::Count)
+        entries.push_back({std::string(name, len), stage});
+    }
+    else if(seenEntry)
+    {
+      // entry points are all declared together, near the start of the module
+      break;
+    }
+
+    it += WordCount;
+  }
+}
+
 void SPIRVFillCBufferVariables(const rdcarray<ShaderConstant> &invars,
                                vector<ShaderVariable> &outvars, const bytebuf &data,
                                size_t baseOffset)
@@ -155,6 +155,9 @@ string CompileSPIRV(const SPIRVCompilationSettings &settings, const vector<strin
                     vector<uint32_t> &spirv);
 void ParseSPIRV(uint32_t *spirv, size_t spirvLength, SPVModule &module);
 
+// lists the entry points declared in a module without parsing all of it
+void ScanSPIRVEntryPoints(const std::vector<uint32_t> &spirv, rdcarray<ShaderEntryPoint> &entries);
+
 void SPIRVFillCBufferVariables(const rdcarray<ShaderConstant> &invars,
                                vector<ShaderVariable> &outvars, const bytebuf &data,
                                size_t baseOffset);
@@ -54,12 +54,52 @@ DECLARE_STRINGISE_TYPE(SPIRVId);
 // length of 1 word in the top 16-bits, OpNop = 0 in the lower 16-bits
 #define SPV_NOP (0x00010000)
 
+// hack around enum class being useless for array indices :(
+struct SPIRVSection
+{
+  enum Type
+  {
+    Capabilities,
+    First = Capabilities,
+    Extensions,
+    ExtInst,
+    MemoryModel,
+    EntryPoints,
+    ExecutionMode,
+    Debug,
+    Annotations,
+    TypesVariablesConstants,
+    // handy aliases
+    Types = TypesVariablesConstants,
+    Variables = TypesVariablesConstants,
+    Constants = TypesVariablesConstants,
+    Functions,
+    Count,
+  };
+};
+
+// the editor keeps instructions in a linked list of these nodes, with each instruction's words
+// contiguous somewhere in its arena. Node 0 is never used so it can mean 'no instruction', and the
+// next SPIRVSection::Count nodes are nops marking the start of each section.
+struct SPIRVInstruction
+{
+  size_t offset;
+  uint32_t prev;
+  uint32_t next;
+};
+
 class SPIRVIterator
 {
 public:
   // constructors
   SPIRVIterator() = default;
+  // iterate over a flat array of words, such as a SPIRVOperation's
   SPIRVIterator(std::vector<uint32_t> &w, size_t o) : words(&w), offset(o) {}
+  // iterate over the editor's instruction list
+  SPIRVIterator(std::vector<uint32_t> &w, std::vector<SPIRVInstruction> &l, uint32_t n)
+      : words(&w), list(&l), node(n), limit((uint32_t)l.size())
+  {
+  }
   // increment to the next op
   SPIRVIterator operator++(int)
   {
@@ -71,34 +111,51 @@ public:
   {
     do
     {
-      offset += cur() >> spv::WordCountShift;
-      // silently skip nops
-    } while(*this && opcode() == spv::OpNop);
+      if(list)
+        node = (*list)[node].next;
+      else
+        offset += cur() >> spv::WordCountShift;
+      // silently skip nops, but stop at the start of the next section
+    } while(*this && opcode() == spv::OpNop && !sectionMarker());
 
     return *this;
   }
   bool operator==(const SPIRVIterator &it) const = delete;
   bool operator!=(const SPIRVIterator &it) const = delete;
-  bool operator<(const SPIRVIterator &it) const { return words == it.words && offset < it.offset; }
+  // an iterator into the instruction list is only less than an end iterator until it reaches it,
+  // or reaches an instruction added after the end iterator was fetched. That way a loop over a
+  // section doesn't visit anything appended to the section while it runs.
+  bool operator<(const SPIRVIterator &it) const
+  {
+    if(list)
+      return list == it.list && node != 0 && node != it.node && node < it.limit;
+    return words == it.words && offset < it.offset;
+  }
   // utility functions
-  explicit operator bool() const { return words != NULL && offset < words->size(); }
+  explicit operator bool() const
+  {
+    return list ? node != 0 : words != NULL && offset < words->size();
+  }
   uint32_t &operator*() { return cur(); }
   const uint32_t &operator*() const { return cur(); }
   spv::Op opcode() { return spv::Op(cur() & spv::OpCodeMask); }
-  uint32_t &word(size_t idx) { return words->at(offset + idx); }
-  const uint32_t &word(size_t idx) const { return words->at(offset + idx); }
-  size_t offs() const { return offset; }
+  uint32_t &word(size_t idx) { return words->at(start() + idx); }
+  const uint32_t &word(size_t idx) const { return words->at(start() + idx); }
   size_t size() const { return cur() >> spv::WordCountShift; }
 private:
-  inline uint32_t &cur() { return words->at(offset); }
-  inline const uint32_t &cur() const { return words->at(offset); }
+  // look up the offset each time, as the editor may move an instruction when it grows
+  inline size_t start() const { return list ? (*list)[node].offset : offset; }
+  inline uint32_t &cur() { return words->at(start()); }
+  inline const uint32_t &cur() const { return words->at(start()); }
+  inline bool sectionMarker() const { return list && node <= SPIRVSection::Count; }
   // we add some friend classes to poke directly into words when it wants to edit
   friend class SPIRVOperation;
   friend class SPIRVEditor;
-  std::vector<uint32_t>::iterator it() { return words->begin() + offset; }
-  std::vector<uint32_t>::const_iterator it() const { return words->cbegin() + offset; }
   size_t offset = 0;
   std::vector<uint32_t> *words = NULL;
+  std::vector<SPIRVInstruction> *list = NULL;
+  uint32_t node = 0;
+  uint32_t limit = 0;
 };
 
 class SPIRVOperation
@@ -125,7 +182,9 @@ public:
   {
     SPIRVOperation ret(it);
 
-    ret.words.insert(ret.words.begin(), it.it(), it.it() + it.size());
+    ret.words.resize(it.size());
+    for(size_t i = 0; i < ret.words.size(); i++)
+      ret.words[i] = it.word(i);
     ret.iter = SPIRVIterator(ret.words, 0);
 
     return ret;
@@ -145,8 +204,6 @@ public:
 private:
   friend class SPIRVEditor;
 
-  std::vector<uint32_t>::const_iterator begin() const { return iter.it(); }
-  std::vector<uint32_t>::const_iterator end() const { return iter.it() + size(); }
   inline static uint32_t MakeHeader(spv::Op op, size_t WordCount)
   {
     return (uint32_t(op) & spv::OpCodeMask) | (uint16_t(WordCount) << spv::WordCountShift);
@@ -356,36 +413,13 @@ struct SPIRVFunction
   SPIRVOperation decl(SPIRVEditor &editor) const;
 };
 
-// hack around enum class being useless for array indices :(
-struct SPIRVSection
-{
-  enum Type
-  {
-    Capabilities,
-    First = Capabilities,
-    Extensions,
-    ExtInst,
-    MemoryModel,
-    EntryPoints,
-    ExecutionMode,
-    Debug,
-    Annotations,
-    TypesVariablesConstants,
-    // handy aliases
-    Types = TypesVariablesConstants,
-    Variables = TypesVariablesConstants,
-    Constants = TypesVariablesConstants,
-    Functions,
-    Count,
-  };
-};
-
 class SPIRVEditor
 {
 public:
   SPIRVEditor(std::vector<uint32_t> &spirvWords);
-  ~SPIRVEditor() { StripNops(); }
-  void StripNops();
+  ~SPIRVEditor() { Serialise(); }
+  // write the instructions back out in order to the words we were created with, skipping nops
+  void Serialise();
 
   SPIRVId MakeId();
 
@@ -418,16 +452,27 @@ public:
   void AddFunction(const SPIRVOperation *ops, size_t count);
 
   SPIRVIterator GetID(SPIRVId id);
+  // returns the result type of a variable, constant, undef or function (or function parameter)
+  SPIRVId GetIDType(SPIRVId id) { return idTypes[id]; }
   // the entry point has 'two' opcodes, the entrypoint declaration and the function.
   // This returns the first, GetID returns the second.
   SPIRVIterator GetEntry(SPIRVId id);
   SPIRVIterator Begin(SPIRVSection::Type section)
   {
-    return SPIRVIterator(spirv, sections[section].startOffset);
+    if(instructions.empty())
+      return SPIRVIterator();
+
+    // step from the section's marker to its first instruction, or the next marker if it's empty
+    SPIRVIterator it = Iter(SectionMarker(section));
+    ++it;
+    return it;
   }
   SPIRVIterator End(SPIRVSection::Type section)
   {
-    return SPIRVIterator(spirv, sections[section].endOffset);
+    if(instructions.empty())
+      return SPIRVIterator();
+
+    return Iter(section + 1 < SPIRVSection::Count ? SectionMarker(section + 1) : 0);
   }
 
   // fetches the id of this type. If it exists already the old ID will be returned, otherwise it
@@ -492,24 +537,33 @@ public:
   const std::vector<SPIRVEntry> &GetEntries() { return entries; }
   const std::vector<SPIRVId> &GetFunctions() { return functions; }
 private:
-  inline void addWords(size_t offs, size_t num) { addWords(offs, (int32_t)num); }
-  void addWords(size_t offs, int32_t num);
+  inline uint32_t SectionMarker(uint32_t section) { return 1 + section; }
+  inline SPIRVIterator Iter(uint32_t node) { return SPIRVIterator(arena, instructions, node); }
+  // link a new node for the instruction at offset in the arena before next, or at the end if next
+  // is 0.
+  uint32_t Link(uint32_t next, size_t offset);
+  // copy the operation's words into the arena and link it before next
+  uint32_t Insert(uint32_t next, const SPIRVOperation &op);
 
   void RegisterOp(SPIRVIterator iter);
   void UnregisterOp(SPIRVIterator iter);
 
-  struct LogicalSection
-  {
-    size_t startOffset = 0;
-    size_t endOffset = 0;
-  };
-
-  LogicalSection sections[SPIRVSection::Count];
-
   spv::AddressingModel addressmodel;
   spv::MemoryModel memorymodel;
 
-  std::vector<size_t> idOffsets;
+  // the words of every instruction, starting with the module as it was passed in. Edits append
+  // instructions to the end and never move anything else, so insertions don't shift the rest of the
+  // module. Words belonging to removed or moved instructions are just left behind.
+  std::vector<uint32_t> arena;
+  std::vector<SPIRVInstruction> instructions;
+  uint32_t lastInstruction = 0;
+
+  // the first OpModuleProcessed, which any names we add must come before
+  uint32_t moduleProcessed = 0;
+
+  // the node defining each id, for those we track
+  std::vector<uint32_t> idDefs;
+  std::vector<SPIRVId> idTypes;
 
   std::vector<SPIRVEntry> entries;
   std::vector<SPIRVId> functions;
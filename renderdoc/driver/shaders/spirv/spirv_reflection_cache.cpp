@@ -0,0 +1,383 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2019 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+
+#include "spirv_reflection_cache.h"
+#include "api/replay/version.h"
+#include "common/shader_cache.h"
+#include "core/core.h"
+#include "serialise/serialiser.h"
+
+DECLARE_REFLECTION_STRUCT(SPIRVPatchData::InterfaceAccess);
+DECLARE_REFLECTION_STRUCT(SPIRVPatchData);
+
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, SPIRVPatchData::InterfaceAccess &el)
+{
+  SERIALISE_MEMBER(ID);
+  SERIALISE_MEMBER(structID);
+  SERIALISE_MEMBER(accessChain);
+  SERIALISE_MEMBER(isMatrix);
+}
+
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, SPIRVPatchData &el)
+{
+  SERIALISE_MEMBER(inputs);
+  SERIALISE_MEMBER(outputs);
+  SERIALISE_MEMBER(outTopo);
+}
+
+static const uint32_t SPIRVReflectionCacheMagic = 0xf00d5bec;
+// bumped if the cache layout itself changes. The version stored in the file also covers the build,
+// see GetSPIRVReflectionCacheVersion().
+static const uint32_t SPIRVReflectionCacheVersion = 2;
+
+// the reflection generated from SPIR-V and the serialised types can change with any build, so a
+// cache is only used by the build that wrote it. Builds without a git hash only differ by version
+// string, so between those the cache version above must still be bumped by hand.
+static uint32_t GetSPIRVReflectionCacheVersion()
+{
+  uint32_t hash = 2166136261U;
+
+  auto hashString = [&hash](const char *str) {
+    for(; *str; str++)
+    {
+      hash ^= (byte)*str;
+      hash *= 16777619U;
+    }
+  };
+
+  hashString(FULL_VERSION_STRING);
+  hashString(GitVersionHash);
+
+  return hash ^ SPIRVReflectionCacheVersion;
+}
+
+// beyond this many entries we stop adding new ones, rather than growing the file without bound
+static const size_t SPIRVReflectionCacheMaxEntries = 64 * 1024;
+
+typedef std::vector<byte> *SPIRVReflectionBlob;
+
+struct SPIRVReflectionCacheCallbacks
+{
+  bool Create(uint32_t size, byte *data, SPIRVReflectionBlob *ret) const
+  {
+    *ret = new std::vector<byte>(data, data + size);
+    return true;
+  }
+  void Destroy(SPIRVReflectionBlob blob) const { delete blob; }
+  uint32_t GetSize(SPIRVReflectionBlob blob) const { return (uint32_t)blob->size(); }
+  const byte *GetData(SPIRVReflectionBlob blob) const { return blob->data(); }
+} SPIRVReflectionCacheCallbacks;
+
+struct SPIRVReflectionCache
+{
+  Threading::CriticalSection lock;
+  bool loaded = false;
+  bool dirty = false;
+  std::map<uint32_t, SPIRVReflectionBlob> blobs;
+};
+
+static SPIRVReflectionCache reflCache;
+
+static void SaveSPIRVReflectionCache()
+{
+  SCOPED_LOCK(reflCache.lock);
+
+  if(reflCache.dirty)
+  {
+    // this also destroys the blobs
+    SaveShaderCache("spirvreflection.cache", SPIRVReflectionCacheMagic,
+                    GetSPIRVReflectionCacheVersion(), reflCache.blobs,
+                    SPIRVReflectionCacheCallbacks);
+  }
+  else
+  {
+    for(auto it = reflCache.blobs.begin(); it != reflCache.blobs.end(); ++it)
+      SPIRVReflectionCacheCallbacks.Destroy(it->second);
+  }
+
+  reflCache.blobs.clear();
+  reflCache.loaded = false;
+  reflCache.dirty = false;
+}
+
+// must be called with the lock held. Returns false if the cache shouldn't be used at all
+static bool PrepareSPIRVReflectionCache()
+{
+  if(!RenderDoc::Inst().IsReplayApp())
+    return false;
+
+  if(!reflCache.loaded)
+  {
+    reflCache.loaded = true;
+
+    bool success = LoadShaderCache("spirvreflection.cache", SPIRVReflectionCacheMagic,
+                                   GetSPIRVReflectionCacheVersion(), reflCache.blobs,
+                                   SPIRVReflectionCacheCallbacks);
+
+    // if we failed to load from the cache, write it out on shutdown
+    reflCache.dirty = !success;
+
+    RenderDoc::Inst().RegisterShutdownFunction(&SaveSPIRVReflectionCache);
+  }
+
+  return true;
+}
+
+// FNV-1a over the module and everything that affects the reflection generated from it
+uint64_t HashSPIRVReflectionKey(GraphicsAPI sourceAPI, ShaderStage stage,
+                                const std::string &entryPoint, const std::vector<uint32_t> &spirv)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  auto hashBytes = [&hash](const void *data, size_t len) {
+    const byte *bytes = (const byte *)data;
+    for(size_t i = 0; i < len; i++)
+    {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+    }
+  };
+
+  hashBytes(spirv.data(), spirv.size() * sizeof(uint32_t));
+  hashBytes(entryPoint.c_str(), entryPoint.size() + 1);
+  hashBytes(&sourceAPI, sizeof(sourceAPI));
+  hashBytes(&stage, sizeof(stage));
+
+  return hash;
+}
+
+bool LookupSPIRVReflection(uint64_t hash, size_t numWords, ShaderReflection &reflection,
+                           ShaderBindpointMapping &mapping, SPIRVPatchData &patchData)
+{
+  if(numWords == 0)
+    return false;
+
+  std::vector<byte> blob;
+
+  {
+    SCOPED_LOCK(reflCache.lock);
+
+    if(!PrepareSPIRVReflectionCache())
+      return false;
+
+    auto it = reflCache.blobs.find(uint32_t(hash ^ (hash >> 32)));
+    if(it == reflCache.blobs.end())
+      return false;
+
+    blob = *it->second;
+  }
+
+  ReadSerialiser ser(new StreamReader(blob), Ownership::Stream);
+
+  // the file is keyed by a 32-bit hash, so check the full hash and length to rule out collisions
+  uint64_t fullHash = 0;
+  uint64_t fullNumWords = 0;
+  ser.Serialise("hash", fullHash);
+  ser.Serialise("numWords", fullNumWords);
+
+  if(ser.IsErrored() || fullHash != hash || fullNumWords != numWords)
+    return false;
+
+  ShaderReflection refl;
+  ShaderBindpointMapping map;
+  SPIRVPatchData patch;
+
+  ser.Serialise("reflection", refl);
+  ser.Serialise("mapping", map);
+  ser.Serialise("patchData", patch);
+
+  if(ser.IsErrored())
+    return false;
+
+  // the raw bytes and ID aren't cached, keep whatever the caller has already filled out
+  refl.resourceId = reflection.resourceId;
+  refl.rawBytes.swap(reflection.rawBytes);
+
+  reflection = refl;
+  mapping = map;
+  patchData = patch;
+
+  return true;
+}
+
+void CacheSPIRVReflection(uint64_t hash, size_t numWords, const ShaderReflection &reflection,
+                          const ShaderBindpointMapping &mapping, const SPIRVPatchData &patchData)
+{
+  if(numWords == 0)
+    return;
+
+  uint32_t key = uint32_t(hash ^ (hash >> 32));
+
+  {
+    SCOPED_LOCK(reflCache.lock);
+
+    if(!PrepareSPIRVReflectionCache())
+      return;
+
+    if(reflCache.blobs.size() >= SPIRVReflectionCacheMaxEntries ||
+       reflCache.blobs.find(key) != reflCache.blobs.end())
+      return;
+  }
+
+  // the raw bytes are just the module, which we have anyway
+  ShaderReflection refl = reflection;
+  refl.resourceId = ResourceId();
+  refl.rawBytes.clear();
+
+  ShaderBindpointMapping map = mapping;
+  SPIRVPatchData patch = patchData;
+
+  StreamWriter *writer = new StreamWriter(4 * 1024);
+
+  {
+    WriteSerialiser ser(writer, Ownership::Nothing);
+
+    uint64_t fullNumWords = numWords;
+    ser.Serialise("hash", hash);
+    ser.Serialise("numWords", fullNumWords);
+    ser.Serialise("reflection", refl);
+    ser.Serialise("mapping", map);
+    ser.Serialise("patchData", patch);
+  }
+
+  SPIRVReflectionBlob blob =
+      new std::vector<byte>(writer->GetData(), writer->GetData() + writer->GetOffset());
+
+  delete writer;
+
+  SCOPED_LOCK(reflCache.lock);
+
+  SPIRVReflectionBlob &entry = reflCache.blobs[key];
+
+  // another thread may have cached the same module while we were serialising
+  if(entry)
+    SPIRVReflectionCacheCallbacks.Destroy(entry);
+
+  entry = blob;
+  reflCache.dirty = true;
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#undef None
+
+#include "3rdparty/catch/catch.hpp"
+
+TEST_CASE("Test SPIR-V reflection cache", "[spirv]")
+{
+  InitSPIRVCompiler();
+  RenderDoc::Inst().RegisterShutdownFunction(&ShutdownSPIRVCompiler);
+
+  SPIRVCompilationSettings settings;
+  settings.entryPoint = "main";
+  settings.lang = SPIRVSourceLanguage::VulkanGLSL;
+  settings.stage = SPIRVShaderStage::Vertex;
+
+  std::vector<std::string> sources = {
+      R"(#version 450 core
+
+layout(binding = 3) uniform sampler2D tex;
+
+layout(location = 0) in vec4 pos;
+layout(location = 0) out vec4 col;
+
+void main() {
+  gl_Position = pos;
+  col = textureLod(tex, pos.xy, 0.0f);
+}
+)",
+  };
+
+  std::vector<uint32_t> spirv;
+  std::string errors = CompileSPIRV(settings, sources, spirv);
+
+  INFO("SPIR-V compilation" << errors);
+
+  REQUIRE(spirv.size() > 0);
+
+  // use only an in-memory cache, nothing is loaded from or saved to disk
+  bool wasReplay = RenderDoc::Inst().IsReplayApp();
+  RenderDoc::Inst().SetReplayApp(true);
+  {
+    SCOPED_LOCK(reflCache.lock);
+    reflCache.loaded = true;
+  }
+
+  SPVModule module;
+  int parses = 0;
+  auto getModule = [&]() -> const SPVModule & {
+    parses++;
+    ParseSPIRV(spirv.data(), spirv.size(), module);
+    return module;
+  };
+
+  ShaderReflection refl[2];
+  ShaderBindpointMapping mapping[2];
+  SPIRVPatchData patchData[2];
+
+  for(int i = 0; i < 2; i++)
+  {
+    refl[i].resourceId = ResourceIDGen::GetNewUniqueID();
+    MakeCachedSPIRVReflection(GraphicsAPI::Vulkan, ShaderStage::Vertex, "main", spirv, refl[i],
+                              mapping[i], patchData[i], getModule);
+  }
+
+  // only the first reflection should have parsed
+  CHECK(parses == 1);
+
+  // the cached reflection is the same, but keeps the ID it was given
+  CHECK(refl[1].resourceId != refl[0].resourceId);
+  CHECK(refl[1].entryPoint == refl[0].entryPoint);
+  CHECK(refl[1].inputSignature.size() == refl[0].inputSignature.size());
+  CHECK(refl[1].outputSignature.size() == refl[0].outputSignature.size());
+  REQUIRE(refl[1].readOnlyResources.size() == 1);
+  CHECK(refl[1].readOnlyResources[0].name == refl[0].readOnlyResources[0].name);
+  REQUIRE(mapping[1].readOnlyResources.size() == 1);
+  CHECK(mapping[1].readOnlyResources[0].bind == 3);
+  CHECK(patchData[1].outputs.size() == patchData[0].outputs.size());
+
+  // a different API or entry point doesn't hit the same entry
+  ShaderReflection glRefl;
+  ShaderBindpointMapping glMapping;
+  SPIRVPatchData glPatchData;
+  MakeCachedSPIRVReflection(GraphicsAPI::OpenGL, ShaderStage::Vertex, "main", spirv, glRefl,
+                            glMapping, glPatchData, getModule);
+
+  CHECK(parses == 2);
+
+  {
+    SCOPED_LOCK(reflCache.lock);
+    for(auto it = reflCache.blobs.begin(); it != reflCache.blobs.end(); ++it)
+      SPIRVReflectionCacheCallbacks.Destroy(it->second);
+    reflCache.blobs.clear();
+    reflCache.loaded = false;
+    reflCache.dirty = false;
+  }
+  RenderDoc::Inst().SetReplayApp(wasReplay);
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -0,0 +1,62 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2019 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+
+#pragma once
+
+#include "spirv_common.h"
+
+// A persistent on-disk cache of the reflection generated from SPIR-V modules, so that loading the
+// same capture again doesn't need to parse each module. Entries are keyed by a hash of the SPIR-V
+// words together with the API, stage and entry point that were reflected.
+//
+// The cache is only used when replaying, and is written out on shutdown if anything was added.
+uint64_t HashSPIRVReflectionKey(GraphicsAPI sourceAPI, ShaderStage stage,
+                                const std::string &entryPoint, const std::vector<uint32_t> &spirv);
+bool LookupSPIRVReflection(uint64_t key, size_t numWords, ShaderReflection &reflection,
+                           ShaderBindpointMapping &mapping, SPIRVPatchData &patchData);
+void CacheSPIRVReflection(uint64_t key, size_t numWords, const ShaderReflection &reflection,
+                          const ShaderBindpointMapping &mapping, const SPIRVPatchData &patchData);
+
+// reflects the given entry point, from the cache if possible. The module is only parsed (via the
+// callback) if there's no cached reflection.
+template <typename ParseCallback>
+void MakeCachedSPIRVReflection(GraphicsAPI sourceAPI, ShaderStage stage,
+                               const std::string &entryPoint, const std::vector<uint32_t> &spirv,
+                               ShaderReflection &reflection, ShaderBindpointMapping &mapping,
+                               SPIRVPatchData &patchData, ParseCallback getModule)
+{
+  // parsing is allowed to consume the words, so don't refer to them after that
+  const size_t numWords = spirv.size();
+  const uint64_t key = HashSPIRVReflectionKey(sourceAPI, stage, entryPoint, spirv);
+
+  if(LookupSPIRVReflection(key, numWords, reflection, mapping, patchData))
+    return;
+
+  const SPVModule &module = getModule();
+
+  module.MakeReflection(sourceAPI, stage, entryPoint, reflection, mapping, patchData);
+
+  CacheSPIRVReflection(key, numWords, reflection, mapping, patchData);
+}
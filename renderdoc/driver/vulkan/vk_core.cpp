@@ -23,6 +23,7 @@
  ******************************************************************************/
 
 #include "vk_core.h"
+#include "core/capture_writer.h"
 #include "driver/ihv/amd/amd_rgp.h"
 #include "jpeg-compressor/jpge.h"
 #include "maths/formatpacking.h"
@@ -1646,26 +1647,20 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
   RDCFile *rdc =
       RenderDoc::Inst().CreateRDC(RDCDriver::Vulkan, m_CapturedFrames.back().frameNumber, fp);
 
-  StreamWriter *captureWriter = NULL;
+  SectionProperties props;
 
-  if(rdc)
-  {
-    SectionProperties props;
-
-    // Compress with LZ4 so that it's fast
-    props.flags = SectionFlags::LZ4Compressed;
-    props.version = m_SectionVersion;
-    props.type = SectionType::FrameCapture;
+  // Compress with LZ4 so that it's fast, in independent blocks so that it can use every core
+  props.flags = SectionFlags::LZ4Compressed | SectionFlags::LZ4IndependentBlocks;
+  props.version = m_SectionVersion;
+  props.type = SectionType::FrameCapture;
 
-    captureWriter = rdc->WriteSection(props);
-  }
-  else
-  {
-    captureWriter = new StreamWriter(StreamWriter::InvalidStream);
-  }
+  // gather the contents in memory, then compress and write them to disk on a background thread
+  CaptureContents *contents = rdc ? new CaptureContents(props) : NULL;
 
   {
-    WriteSerialiser ser(captureWriter, Ownership::Stream);
+    WriteSerialiser ser(contents ? new StreamWriter(contents, Ownership::Nothing)
+                                 : new StreamWriter(StreamWriter::InvalidStream),
+                        Ownership::Stream);
 
     ser.SetChunkMetadataRecording(GetThreadSerialiser().GetChunkMetadataRecording());
 
@@ -1679,8 +1674,21 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
 
     RDCDEBUG("Inserting Resource Serialisers");
 
-    GetResourceManager()->InsertReferencedChunks(ser);
+    // recorded chunks are never modified after being recorded, so they're handed over to be written
+    // without copying them
+    {
+      std::map<int32_t, Chunk *> sortedChunks;
+
+      GetResourceManager()->GetReferencedChunks(sortedChunks);
 
+      if(contents)
+      {
+        for(auto it = sortedChunks.begin(); it != sortedChunks.end(); ++it)
+          contents->AddChunk(it->second);
+      }
+    }
+
+    // initial contents live in memory that's freed once the capture ends, so they're serialised now
     GetResourceManager()->InsertInitialContentsChunks(ser);
 
     RDCDEBUG("Creating Capture Scope");
@@ -1727,14 +1735,15 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
       {
         RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseFrameContents, idx / num);
         idx += 1.0f;
-        it->second->Write(ser);
+        if(contents)
+          contents->AddChunk(it->second);
       }
 
       RDCDEBUG("Done");
     }
   }
 
-  RenderDoc::Inst().FinishCaptureWriting(rdc, m_CapturedFrames.back().frameNumber);
+  RenderDoc::Inst().QueueCaptureWriting(rdc, m_CapturedFrames.back().frameNumber, contents);
 
   SAFE_DELETE(m_HeaderChunk);
 
@@ -1888,10 +1897,16 @@ ReplayStatus WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStruct
 
   ReadSerialiser ser(reader, Ownership::Stream);
 
+  // older captures store callstacks inline, the dictionary section was added in 0x10
+  if(m_SectionVersion >= 0x10)
+    m_Callstacks.Load(rdc);
+
   ser.SetStringDatabase(&m_StringDB);
+  ser.SetCallstackDictionary(&m_Callstacks);
   ser.SetUserData(GetResourceManager());
 
   ser.ConfigureStructuredExport(&GetChunkName, storeStructuredBuffers);
+  ser.SetLazyStructuredExport(m_LazyStructuredExport);
 
   m_StructuredFile = &ser.GetStructuredFile();
 
@@ -1913,6 +1928,30 @@ ReplayStatus WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStruct
 
   SCOPED_TIMER("chunk initialisation");
 
+  // shader modules are parsed and reflected in the background while the rest of the chunks are
+  // read. Everything is joined before we leave, however we leave.
+  Threading::ThreadPool shaderPreparePool(Threading::NumberOfCores());
+
+  struct ShaderPrepareScope
+  {
+    ShaderPrepareScope(VulkanCreationInfo &info, Threading::ThreadPool &pool) : info(info)
+    {
+      info.m_ShaderPreparePool = &pool;
+    }
+    ~ShaderPrepareScope() { Finish(); }
+    void Finish()
+    {
+      if(!info.m_ShaderPreparePool)
+        return;
+
+      for(auto it = info.m_ShaderModule.begin(); it != info.m_ShaderModule.end(); ++it)
+        it->second.Join();
+
+      info.m_ShaderPreparePool = NULL;
+    }
+    VulkanCreationInfo &info;
+  } shaderPrepareScope(m_CreationInfo, shaderPreparePool);
+
   uint64_t frameDataSize = 0;
 
   for(;;)
@@ -1928,7 +1967,9 @@ ReplayStatus WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStruct
     if(reader->IsErrored())
       return ReplayStatus::APIDataCorrupted;
 
-    bool success = ProcessChunk(ser, context);
+    // lazily indexed chunks still need to be processed when loading for replay
+    bool success = (IsStructuredExporting(m_State) && ser.CanSkipCurrentChunk()) ||
+                   ProcessChunk(ser, context);
 
     ser.EndChunk();
 
@@ -1957,8 +1998,12 @@ ReplayStatus WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStruct
       // read the remaining data into memory and pass to immediate context
       frameDataSize = reader->GetSize() - reader->GetOffset();
 
+      m_FrameReaderOffset = reader->GetOffset();
       m_FrameReader = new StreamReader(reader, frameDataSize);
 
+      // all modules are created by now, and the frame's replay may use any of them
+      shaderPrepareScope.Finish();
+
       ReplayStatus status = ContextReplayLog(m_State, 0, 0, false);
 
       if(status != ReplayStatus::Succeeded)
@@ -2033,6 +2078,7 @@ ReplayStatus WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t sta
   ReadSerialiser ser(m_FrameReader, Ownership::Nothing);
 
   ser.SetStringDatabase(&m_StringDB);
+  ser.SetCallstackDictionary(&m_Callstacks);
   ser.SetUserData(GetResourceManager());
   ser.SetVersion(m_SectionVersion);
 
@@ -2041,6 +2087,7 @@ ReplayStatus WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t sta
   if(IsLoading(m_State) || IsStructuredExporting(m_State))
   {
     ser.ConfigureStructuredExport(&GetChunkName, IsStructuredExporting(m_State));
+    ser.SetLazyStructuredExport(m_LazyStructuredExport, m_FrameReaderOffset);
 
     ser.GetStructuredFile().Swap(*m_StructuredFile);
 
@@ -2052,7 +2099,7 @@ ReplayStatus WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t sta
 
   if(partial)
     ser.SkipCurrentChunk();
-  else
+  else if(!IsStructuredExporting(m_State) || !ser.CanSkipCurrentChunk())
     Serialise_BeginCaptureFrame(ser);
 
   ser.EndChunk();
@@ -2125,7 +2172,8 @@ ReplayStatus WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t sta
 
     m_LastCmdBufferID = ResourceId();
 
-    bool success = ContextProcessChunk(ser, chunktype);
+    bool success = (IsStructuredExporting(m_State) && ser.CanSkipCurrentChunk()) ||
+                   ContextProcessChunk(ser, chunktype);
 
     ser.EndChunk();
 
@@ -2352,6 +2400,19 @@ bool WrappedVulkan::ContextProcessChunk(ReadSerialiser &ser, VulkanChunk chunk)
   return true;
 }
 
+bool WrappedVulkan::ProcessStructuredChunk(ReadSerialiser &ser, VulkanChunk chunk)
+{
+  ser.SetStringDatabase(&m_StringDB);
+  ser.SetUserData(GetResourceManager());
+  ser.SetVersion(m_SectionVersion);
+
+  // the frame's begin chunk is read directly in ContextReplayLog, not through ProcessChunk
+  if((SystemChunk)chunk == SystemChunk::CaptureBegin)
+    return Serialise_BeginCaptureFrame(ser);
+
+  return ProcessChunk(ser, chunk);
+}
+
 bool WrappedVulkan::ProcessChunk(ReadSerialiser &ser, VulkanChunk chunk)
 {
   switch(chunk)
@@ -55,7 +55,7 @@ struct VkInitParams
   uint32_t GetSerialiseSize();
 
   // check if a frame capture section version is supported
-  static const uint64_t CurrentVersion = 0xF;
+  static const uint64_t CurrentVersion = 0x10;
   static bool IsSupportedVersion(uint64_t ver);
 };
 
@@ -279,8 +279,14 @@ private:
   uint64_t m_SectionVersion;
 
   StreamReader *m_FrameReader = NULL;
+  // where the frame reader's data starts in the capture section
+  uint64_t m_FrameReaderOffset = 0;
+
+  // only export chunk metadata during structured export, see ProcessStructuredChunk
+  bool m_LazyStructuredExport = false;
 
   std::set<std::string> m_StringDB;
+  CallstackDictionary m_Callstacks;
 
   VkResourceRecord *m_FrameCaptureRecord;
   Chunk *m_HeaderChunk;
@@ -897,11 +903,16 @@ public:
 
   ReplayStatus Initialise(VkInitParams &params, uint64_t sectionVersion);
   uint64_t GetLogVersion() { return m_SectionVersion; }
-  void SetStructuredExport(uint64_t sectionVersion)
+  void SetStructuredExport(uint64_t sectionVersion, bool lazy = false)
   {
     m_SectionVersion = sectionVersion;
     m_State = CaptureState::StructuredExport;
+    m_LazyStructuredExport = lazy;
   }
+  // when loading for replay, only index the structured data and leave chunk contents to be loaded
+  // on demand
+  void SetLazyStructuredData(bool lazy) { m_LazyStructuredExport = lazy; }
+  bool ProcessStructuredChunk(ReadSerialiser &ser, VulkanChunk chunk);
   void Shutdown();
   void ReplayLog(uint32_t startEventID, uint32_t endEventID, ReplayLogType replayType);
   ReplayStatus ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers);
@@ -24,6 +24,7 @@
 
 #include "vk_info.h"
 #include "3rdparty/glslang/SPIRV/spirv.hpp"
+#include "driver/shaders/spirv/spirv_reflection_cache.h"
 
 VkDynamicState ConvertDynamicState(VulkanDynamicStateIndex idx)
 {
@@ -233,7 +234,7 @@ void VulkanCreationInfo::Pipeline::Init(VulkanResourceManager *resourceMan, Vulk
 
     ShaderModule::Reflection &reflData = info.m_ShaderModule[id].m_Reflections[shad.entryPoint];
 
-    reflData.Init(resourceMan, id, info.m_ShaderModule[id].spirv, shad.entryPoint,
+    reflData.Init(resourceMan, id, info.m_ShaderModule[id], shad.entryPoint,
                   pCreateInfo->pStages[i].stage);
 
     if(pCreateInfo->pStages[i].pSpecializationInfo)
@@ -528,7 +529,7 @@ void VulkanCreationInfo::Pipeline::Init(VulkanResourceManager *resourceMan, Vulk
 
     ShaderModule::Reflection &reflData = info.m_ShaderModule[id].m_Reflections[shad.entryPoint];
 
-    reflData.Init(resourceMan, id, info.m_ShaderModule[id].spirv, shad.entryPoint,
+    reflData.Init(resourceMan, id, info.m_ShaderModule[id], shad.entryPoint,
                   pCreateInfo->stage.stage);
 
     if(pCreateInfo->stage.pSpecializationInfo)
@@ -943,12 +944,86 @@ void VulkanCreationInfo::ShaderModule::Init(VulkanResourceManager *resourceMan,
   else
   {
     RDCASSERT(pCreateInfo->codeSize % sizeof(uint32_t) == 0);
-    ParseSPIRV((uint32_t *)pCreateInfo->pCode, pCreateInfo->codeSize / sizeof(uint32_t), spirv);
+    spirvWords.assign(pCreateInfo->pCode,
+                      pCreateInfo->pCode + pCreateInfo->codeSize / sizeof(uint32_t));
+
+    // nothing here depends on any other state, so it can happen while the rest of the capture loads
+    if(info.m_ShaderPreparePool)
+    {
+      preparePool = info.m_ShaderPreparePool;
+      prepareJob = preparePool->AddJob([this]() { Prepare(); });
+    }
   }
 }
 
+void VulkanCreationInfo::ShaderModule::Prepare()
+{
+  rdcarray<ShaderEntryPoint> entries;
+  ScanSPIRVEntryPoints(spirvWords, entries);
+
+  prepared.resize(entries.size());
+
+  for(size_t i = 0; i < entries.size(); i++)
+  {
+    Reflection &r = prepared[i];
+
+    r.entryPoint = entries[i].name;
+    r.stageIndex = (uint32_t)entries[i].stage;
+
+    MakeCachedSPIRVReflection(GraphicsAPI::Vulkan, entries[i].stage, r.entryPoint, spirvWords,
+                              r.refl, r.mapping, r.patchData,
+                              [this]() -> const SPVModule & {
+                                ParseWords();
+                                return spirv;
+                              });
+  }
+
+  // the parsed module keeps its own copy of the words
+  if(spirvParsed)
+  {
+    spirvWords.clear();
+    spirvWords.shrink_to_fit();
+  }
+}
+
+void VulkanCreationInfo::ShaderModule::Join()
+{
+  if(prepareJob)
+  {
+    preparePool->WaitForJob(prepareJob);
+    prepareJob = NULL;
+  }
+}
+
+void VulkanCreationInfo::ShaderModule::ParseWords()
+{
+  if(!spirvParsed)
+  {
+    spirvParsed = true;
+
+    if(!spirvWords.empty())
+      ParseSPIRV(spirvWords.data(), spirvWords.size(), spirv);
+  }
+}
+
+SPVModule &VulkanCreationInfo::ShaderModule::GetSPIRV()
+{
+  Join();
+
+  if(!spirvParsed)
+  {
+    ParseWords();
+
+    // the parsed module keeps its own copy of the words
+    spirvWords.clear();
+    spirvWords.shrink_to_fit();
+  }
+
+  return spirv;
+}
+
 void VulkanCreationInfo::ShaderModule::Reflection::Init(VulkanResourceManager *resourceMan,
-                                                        ResourceId id, const SPVModule &spv,
+                                                        ResourceId id, ShaderModule &module,
                                                         const std::string &entry,
                                                         VkShaderStageFlagBits stage)
 {
@@ -957,16 +1032,41 @@ void VulkanCreationInfo::ShaderModule::Reflection::Init(VulkanResourceManager *r
     entryPoint = entry;
     stageIndex = StageIndex(stage);
 
-    spv.MakeReflection(GraphicsAPI::Vulkan, ShaderStage(stageIndex), entryPoint, refl, mapping,
-                       patchData);
+    module.Join();
+
+    bool found = false;
+
+    for(Reflection &r : module.prepared)
+    {
+      if(r.entryPoint == entryPoint && r.stageIndex == stageIndex)
+      {
+        refl = std::move(r.refl);
+        mapping = std::move(r.mapping);
+        patchData = std::move(r.patchData);
+        found = true;
+        break;
+      }
+    }
+
+    if(!found)
+    {
+      const std::vector<uint32_t> &words = module.GetSPIRVWords();
+
+      MakeCachedSPIRVReflection(GraphicsAPI::Vulkan, ShaderStage(stageIndex), entryPoint, words,
+                                refl, mapping, patchData,
+                                [&module]() -> const SPVModule & { return module.GetSPIRV(); });
+    }
 
     refl.resourceId = resourceMan->GetOriginalID(id);
     refl.entryPoint = entryPoint;
 
-    if(!spv.spirv.empty())
+    // parsing may have moved the words into the module
+    const std::vector<uint32_t> &spirv = module.GetSPIRVWords();
+
+    if(!spirv.empty())
     {
       refl.encoding = ShaderEncoding::SPIRV;
-      refl.rawBytes.assign((byte *)spv.spirv.data(), spv.spirv.size() * sizeof(uint32_t));
+      refl.rawBytes.assign((byte *)spirv.data(), spirv.size() * sizeof(uint32_t));
     }
   }
 }
@@ -456,7 +456,17 @@ struct VulkanCreationInfo
     void Init(VulkanResourceManager *resourceMan, VulkanCreationInfo &info,
               const VkShaderModuleCreateInfo *pCreateInfo);
 
-    SPVModule spirv;
+    // the module is only parsed the first time something needs more than its reflection, which
+    // might have come from the cache.
+    SPVModule &GetSPIRV();
+    const std::vector<uint32_t> &GetSPIRVWords() const
+    {
+      return spirvParsed ? spirv.spirv : spirvWords;
+    }
+
+    // waits for the module to finish being prepared in the background, if it was. Must be called
+    // before the module is used while a capture is loading.
+    void Join();
 
     string unstrippedPath;
 
@@ -469,13 +479,32 @@ struct VulkanCreationInfo
       ShaderBindpointMapping mapping;
       SPIRVPatchData patchData;
 
-      void Init(VulkanResourceManager *resourceMan, ResourceId id, const SPVModule &spv,
+      void Init(VulkanResourceManager *resourceMan, ResourceId id, ShaderModule &module,
                 const std::string &entry, VkShaderStageFlagBits stage);
     };
     map<string, Reflection> m_Reflections;
+
+  private:
+    void ParseWords();
+    void Prepare();
+
+    // the raw words until the module is parsed, after which they're in the parsed module
+    std::vector<uint32_t> spirvWords;
+    SPVModule spirv;
+    bool spirvParsed = false;
+
+    // reflection for each entry point, generated in the background while loading and then claimed
+    // by the first Reflection::Init for that entry point
+    std::vector<Reflection> prepared;
+    Threading::ThreadPool *preparePool = NULL;
+    Threading::ThreadPool::Job *prepareJob = NULL;
   };
   map<ResourceId, ShaderModule> m_ShaderModule;
 
+  // while loading a capture, shader modules are parsed and reflected on this pool as soon as
+  // they're created
+  Threading::ThreadPool *m_ShaderPreparePool = NULL;
+
   struct DescSetPool
   {
     void Init(VulkanResourceManager *resourceMan, VulkanCreationInfo &info,
@@ -32,159 +32,265 @@
 #define TRDBG(...)
 #endif
 
-template <typename SrcBarrierType>
-void VulkanResourceManager::RecordSingleBarrier(vector<pair<ResourceId, ImageRegionState> > &dststates,
-                                                ResourceId id, const SrcBarrierType &t,
-                                                uint32_t nummips, uint32_t numslices)
+// Image states - both the barriers accumulated in a command buffer and the tracked layouts of each
+// image - are stored per image either as a single subresource range, or as soon as different
+// subresources need to be in different states, as a dense grid of one entry per subresource in
+// plane-major then slice-major order (index = (plane * layerCount + layer) * levelCount + mip).
+// Barriers then index straight into the grid instead of searching for and splitting ranges, and a
+// barrier covering the whole image collapses a tracked grid back down to one range.
+//
+// The plane dimension is only used once a barrier transitions the planes of a multi-planar image
+// separately, at which point each cell's aspect is its plane. Otherwise there's one plane and the
+// aspect isn't tracked, since depth-stencil images must always be transitioned with both aspects
+// together.
+
+typedef pair<ResourceId, ImageRegionState> PendingImageState;
+
+static const VkImageAspectFlags planeAspects[] = {
+    VK_IMAGE_ASPECT_PLANE_0_BIT, VK_IMAGE_ASPECT_PLANE_1_BIT, VK_IMAGE_ASPECT_PLANE_2_BIT,
+};
+
+// how many planes an aspect needs to be represented, 1 unless it names individual planes
+static uint32_t NumAspectPlanes(VkImageAspectFlags aspect)
+{
+  if(aspect & VK_IMAGE_ASPECT_PLANE_2_BIT)
+    return 3;
+  if(aspect & (VK_IMAGE_ASPECT_PLANE_0_BIT | VK_IMAGE_ASPECT_PLANE_1_BIT))
+    return 2;
+  return 1;
+}
+
+// the planes out of numPlanes that an aspect covers, as a bitmask. Anything that doesn't name
+// individual planes, like the colour aspect, covers them all
+static uint32_t PlaneMask(VkImageAspectFlags aspect, uint32_t numPlanes)
+{
+  const uint32_t all = (1U << numPlanes) - 1;
+
+  uint32_t mask = 0;
+  for(uint32_t p = 0; p < ARRAY_COUNT(planeAspects); p++)
+    if(aspect & planeAspects[p])
+      mask |= 1U << p;
+
+  return mask ? (mask & all) : all;
+}
+
+// the planes needed for barriers with the given aspect on an image with imagePlanes planes, which
+// is 0 if unknown. Images that aren't multi-planar ignore the aspect
+static uint32_t NeedPlanes(VkImageAspectFlags aspect, uint32_t imagePlanes)
+{
+  if(imagePlanes == 1)
+    return 1;
+
+  uint32_t planes = NumAspectPlanes(aspect);
+  return planes > 1 ? RDCMAX(planes, imagePlanes) : 1;
+}
+
+static bool SameRange(const VkImageSubresourceRange &a, uint32_t baseMip, uint32_t nummips,
+                      uint32_t baseSlice, uint32_t numslices)
 {
-  bool done = false;
+  return a.baseMipLevel == baseMip && a.levelCount == nummips && a.baseArrayLayer == baseSlice &&
+         a.layerCount == numslices;
+}
 
-  auto it = dststates.begin();
-  for(; it != dststates.end(); ++it)
+static void SetGridCell(ImageRegionState &cell, uint32_t mip, uint32_t slice, uint32_t plane,
+                        uint32_t planes)
+{
+  cell.subresourceRange.baseMipLevel = mip;
+  cell.subresourceRange.levelCount = 1;
+  cell.subresourceRange.baseArrayLayer = slice;
+  cell.subresourceRange.layerCount = 1;
+  if(planes > 1)
+    cell.subresourceRange.aspectMask = planeAspects[plane];
+}
+
+// if the run of states is a dense grid, returns true and its dimensions. The last cell is always
+// the last subresource, so the dimensions come for free
+static bool GetGridSize(const ImageRegionState &first, const ImageRegionState &last, size_t count,
+                        uint32_t &levels, uint32_t &layers, uint32_t &planes)
+{
+  if(count <= 1 || first.subresourceRange.levelCount != 1 || first.subresourceRange.layerCount != 1)
+    return false;
+
+  levels = last.subresourceRange.baseMipLevel + 1;
+  layers = last.subresourceRange.baseArrayLayer + 1;
+  planes = 1;
+
+  if(first.subresourceRange.aspectMask == VK_IMAGE_ASPECT_PLANE_0_BIT)
   {
-    // image barriers are handled by initially inserting one subresource range for each aspect,
-    // and whenever we need more fine-grained detail we split it immediately for one range for
-    // each subresource in that aspect. Thereafter if a barrier comes in that covers multiple
-    // subresources, we update all matching ranges.
+    for(uint32_t p = 1; p < ARRAY_COUNT(planeAspects); p++)
+      if(last.subresourceRange.aspectMask == planeAspects[p])
+        planes = p + 1;
+  }
+
+  return size_t(levels) * layers * planes == count;
+}
 
-    // find the states matching this id
-    if(it->first < id)
+// re-lays the pending states for one image at [offs, offs+count) as a levels x layers x planes
+// grid. Any subresource that no barrier has touched gets an unknown new layout and is skipped when
+// applying.
+static void ExpandPendingStates(vector<PendingImageState> &states, size_t offs, size_t count,
+                                uint32_t levels, uint32_t layers, uint32_t planes)
+{
+  ImageRegionState untouched = states[offs].second;
+  untouched.oldLayout = untouched.newLayout = UNKNOWN_PREV_IMG_LAYOUT;
+
+  vector<PendingImageState> grid(size_t(levels) * layers * planes,
+                                 std::make_pair(states[offs].first, untouched));
+
+  for(uint32_t plane = 0; plane < planes; plane++)
+    for(uint32_t slice = 0; slice < layers; slice++)
+      for(uint32_t mip = 0; mip < levels; mip++)
+        SetGridCell(grid[(plane * layers + slice) * levels + mip].second, mip, slice, plane, planes);
+
+  for(size_t i = offs; i < offs + count; i++)
+  {
+    const ImageRegionState &src = states[i].second;
+    const VkImageSubresourceRange &r = src.subresourceRange;
+
+    if(src.newLayout == UNKNOWN_PREV_IMG_LAYOUT)
       continue;
-    if(it->first != id)
-      break;
 
-    it->second.dstQueueFamilyIndex = t.dstQueueFamilyIndex;
+    const uint32_t planeMask = PlaneMask(r.aspectMask, planes);
 
+    for(uint32_t plane = 0; plane < planes; plane++)
     {
-      // we've found a range that completely matches our region, doesn't matter if that's
-      // a whole image and the barrier is the whole image, or it's one subresource.
-      // note that for images with only one array/mip slice (e.g. render targets) we'll never
-      // really have to worry about the else{} branch
-      if(it->second.subresourceRange.baseMipLevel == t.subresourceRange.baseMipLevel &&
-         it->second.subresourceRange.levelCount == nummips &&
-         it->second.subresourceRange.baseArrayLayer == t.subresourceRange.baseArrayLayer &&
-         it->second.subresourceRange.layerCount == numslices)
-      {
-        // verify
-        // RDCASSERT(it->second.newLayout == t.oldLayout);
-
-        // apply it (prevstate is from the start of all barriers accumulated, so only set once)
-        if(it->second.oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
-          it->second.oldLayout = t.oldLayout;
-        it->second.newLayout = t.newLayout;
+      if(!(planeMask & (1U << plane)))
+        continue;
 
-        done = true;
-        break;
-      }
-      else
+      for(uint32_t slice = r.baseArrayLayer; slice < RDCMIN(layers, r.baseArrayLayer + r.layerCount);
+          slice++)
       {
-        // this handles the case where the barrier covers a number of subresources and we need
-        // to update each matching subresource. If the barrier was only one mip & array slice
-        // it would have hit the case above. Find each subresource within the range, update it,
-        // and continue (marking as done so whenever we stop finding matching ranges, we are
-        // satisfied.
-        //
-        // note that regardless of how we lay out our subresources (slice-major or mip-major) the
-        // new
-        // range could be sparse, but that's OK as we only break out of the loop once we go past the
-        // whole
-        // aspect. Any subresources that don't match the range, after the split, will fail to meet
-        // any
-        // of the handled cases, so we'll just continue processing.
-        if(it->second.subresourceRange.levelCount == 1 &&
-           it->second.subresourceRange.layerCount == 1 &&
-           it->second.subresourceRange.baseMipLevel >= t.subresourceRange.baseMipLevel &&
-           it->second.subresourceRange.baseMipLevel < t.subresourceRange.baseMipLevel + nummips &&
-           it->second.subresourceRange.baseArrayLayer >= t.subresourceRange.baseArrayLayer &&
-           it->second.subresourceRange.baseArrayLayer < t.subresourceRange.baseArrayLayer + numslices)
-        {
-          // apply it (prevstate is from the start of all barriers accumulated, so only set once)
-          if(it->second.oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
-            it->second.oldLayout = t.oldLayout;
-          it->second.newLayout = t.newLayout;
-
-          // continue as there might be more, but we're done
-          done = true;
-          continue;
-        }
-        // finally handle the case where we have a range that covers a whole image but we need to
-        // split it. If the barrier covered the whole image too it would have hit the very first
-        // case, so we know that the barrier doesn't cover the whole range.
-        // Also, if we've already done the split this case won't be hit and we'll either fall into
-        // the case above, or we'll finish as we've covered the whole barrier.
-        else if(it->second.subresourceRange.levelCount > 1 ||
-                it->second.subresourceRange.layerCount > 1)
+        for(uint32_t mip = r.baseMipLevel; mip < RDCMIN(levels, r.baseMipLevel + r.levelCount);
+            mip++)
         {
-          pair<ResourceId, ImageRegionState> existing = *it;
-
-          // remember where we were in the array, as after this iterators will be
-          // invalidated.
-          size_t offs = it - dststates.begin();
-          size_t count =
-              it->second.subresourceRange.levelCount * it->second.subresourceRange.layerCount;
-
-          // only insert count-1 as we want count entries total - one per subresource
-          dststates.insert(it, count - 1, existing);
-
-          // it now points at the first subresource, but we need to modify the ranges
-          // to be valid
-          it = dststates.begin() + offs;
-
-          for(size_t i = 0; i < count; i++)
-          {
-            it->second.subresourceRange.levelCount = 1;
-            it->second.subresourceRange.layerCount = 1;
-
-            // slice-major
-            it->second.subresourceRange.baseArrayLayer =
-                uint32_t(i / existing.second.subresourceRange.levelCount);
-            it->second.subresourceRange.baseMipLevel =
-                uint32_t(i % existing.second.subresourceRange.levelCount);
-            it++;
-          }
-
-          // reset the iterator to point to the first subresource
-          it = dststates.begin() + offs;
-
-          // the loop will continue after this point and look at the next subresources
-          // so we need to check to see if the first subresource lies in the range here
-          if(it->second.subresourceRange.baseMipLevel >= t.subresourceRange.baseMipLevel &&
-             it->second.subresourceRange.baseMipLevel < t.subresourceRange.baseMipLevel + nummips &&
-             it->second.subresourceRange.baseArrayLayer >= t.subresourceRange.baseArrayLayer &&
-             it->second.subresourceRange.baseArrayLayer <
-                 t.subresourceRange.baseArrayLayer + numslices)
-          {
-            // apply it (prevstate is from the start of all barriers accumulated, so only set once)
-            if(it->second.oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
-              it->second.oldLayout = t.oldLayout;
-            it->second.newLayout = t.newLayout;
-
-            // continue as there might be more, but we're done
-            done = true;
-          }
-
-          // continue processing from here
-          continue;
+          ImageRegionState &cell = grid[(plane * layers + slice) * levels + mip].second;
+          cell.dstQueueFamilyIndex = src.dstQueueFamilyIndex;
+          cell.oldLayout = src.oldLayout;
+          cell.newLayout = src.newLayout;
         }
       }
     }
-
-    // otherwise continue to try and find the subresource range
   }
 
-  if(done)
+  // overwrite what overlaps and insert or erase the difference, so we only shift the tail once
+  size_t overlap = RDCMIN(count, grid.size());
+  for(size_t i = 0; i < overlap; i++)
+    states[offs + i] = grid[i];
+
+  if(grid.size() > count)
+    states.insert(states.begin() + offs + count, grid.begin() + count, grid.end());
+  else if(grid.size() < count)
+    states.erase(states.begin() + offs + grid.size(), states.begin() + offs + count);
+}
+
+template <typename SrcBarrierType>
+void VulkanResourceManager::RecordSingleBarrier(vector<PendingImageState> &dststates, ResourceId id,
+                                                const SrcBarrierType &t, uint32_t nummips,
+                                                uint32_t numslices, uint32_t imageMips,
+                                                uint32_t imageSlices, uint32_t imagePlanes)
+{
+  // states are sorted by ID, so find the run for this image
+  auto begin = std::lower_bound(
+      dststates.begin(), dststates.end(), id,
+      [](const PendingImageState &a, ResourceId b) { return a.first < b; });
+  auto end = std::upper_bound(
+      begin, dststates.end(), id,
+      [](ResourceId a, const PendingImageState &b) { return a < b.first; });
+
+  const uint32_t baseMip = t.subresourceRange.baseMipLevel;
+  const uint32_t baseSlice = t.subresourceRange.baseArrayLayer;
+  const VkImageAspectFlags aspect = t.subresourceRange.aspectMask;
+
+  // we don't have an existing barrier for this image, insert into place
+  if(begin == end)
+  {
+    VkImageSubresourceRange subRange = t.subresourceRange;
+    subRange.levelCount = nummips;
+    subRange.layerCount = numslices;
+    dststates.insert(begin, std::make_pair(id, ImageRegionState(VK_QUEUE_FAMILY_IGNORED, subRange,
+                                                                t.oldLayout, t.newLayout)));
     return;
+  }
+
+  size_t offs = begin - dststates.begin();
+  size_t count = end - begin;
+
+  // a barrier that exactly matches the single range we have just updates it. This is the common
+  // case for whole-image barriers and images with only one subresource
+  if(count == 1 &&
+     SameRange(begin->second.subresourceRange, baseMip, nummips, baseSlice, numslices))
+  {
+    ImageRegionState &state = begin->second;
+
+    const uint32_t planes =
+        RDCMAX(NeedPlanes(aspect, imagePlanes),
+               NeedPlanes(state.subresourceRange.aspectMask, imagePlanes));
+
+    if(PlaneMask(state.subresourceRange.aspectMask, planes) == PlaneMask(aspect, planes))
+    {
+      state.dstQueueFamilyIndex = t.dstQueueFamilyIndex;
+
+      // apply it (prevstate is from the start of all barriers accumulated, so only set once)
+      if(state.oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
+        state.oldLayout = t.oldLayout;
+      state.newLayout = t.newLayout;
+      return;
+    }
+  }
+
+  // otherwise we need per-subresource detail. Make sure we have a grid big enough for both the
+  // barrier and the image, re-laying the existing states if not.
+  uint32_t levels = 0, layers = 0, planes = 0;
+  bool grid = GetGridSize(begin->second, (end - 1)->second, count, levels, layers, planes);
+
+  uint32_t needLevels = RDCMAX(imageMips, baseMip + nummips);
+  uint32_t needLayers = RDCMAX(imageSlices, baseSlice + numslices);
+  uint32_t needPlanes = NeedPlanes(aspect, imagePlanes);
+
+  if(!grid || levels < needLevels || layers < needLayers || planes < needPlanes)
+  {
+    for(auto it = begin; it != end; ++it)
+    {
+      const VkImageSubresourceRange &r = it->second.subresourceRange;
+      needLevels = RDCMAX(needLevels, r.baseMipLevel + r.levelCount);
+      needLayers = RDCMAX(needLayers, r.baseArrayLayer + r.layerCount);
+      needPlanes = RDCMAX(needPlanes, NeedPlanes(r.aspectMask, imagePlanes));
+    }
+
+    levels = RDCMAX(levels, needLevels);
+    layers = RDCMAX(layers, needLayers);
+    planes = RDCMAX(planes, needPlanes);
+
+    ExpandPendingStates(dststates, offs, count, levels, layers, planes);
+  }
 
-  // we don't have an existing barrier for this memory region, insert into place. it points to
-  // where it should be inserted
-  VkImageSubresourceRange subRange = t.subresourceRange;
-  subRange.levelCount = nummips;
-  subRange.layerCount = numslices;
-  dststates.insert(it, std::make_pair(id, ImageRegionState(VK_QUEUE_FAMILY_IGNORED, subRange,
-                                                           t.oldLayout, t.newLayout)));
+  PendingImageState *cells = &dststates[offs];
+
+  const uint32_t planeMask = PlaneMask(aspect, planes);
+
+  for(uint32_t plane = 0; plane < planes; plane++)
+  {
+    if(!(planeMask & (1U << plane)))
+      continue;
+
+    for(uint32_t slice = baseSlice; slice < baseSlice + numslices; slice++)
+    {
+      for(uint32_t mip = baseMip; mip < baseMip + nummips; mip++)
+      {
+        ImageRegionState &cell = cells[(plane * layers + slice) * levels + mip].second;
+
+        cell.dstQueueFamilyIndex = t.dstQueueFamilyIndex;
+
+        // apply it (prevstate is from the start of all barriers accumulated, so only set once)
+        if(cell.oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
+          cell.oldLayout = t.oldLayout;
+        cell.newLayout = t.newLayout;
+      }
+    }
+  }
 }
 
-void VulkanResourceManager::RecordBarriers(vector<pair<ResourceId, ImageRegionState> > &states,
+void VulkanResourceManager::RecordBarriers(vector<PendingImageState> &states,
                                            const map<ResourceId, ImageLayouts> &layouts,
                                            uint32_t numBarriers, const VkImageMemoryBarrier *barriers)
 {
@@ -204,9 +310,17 @@ void VulkanResourceManager::RecordBarriers(vector<pair<ResourceId, ImageRegionSt
 
     uint32_t nummips = t.subresourceRange.levelCount;
     uint32_t numslices = t.subresourceRange.layerCount;
+    uint32_t imageMips = 0, imageSlices = 0, imagePlanes = 0;
 
     auto it = layouts.find(id);
 
+    if(it != layouts.end())
+    {
+      imageMips = (uint32_t)it->second.levelCount;
+      imageSlices = (uint32_t)it->second.layerCount;
+      imagePlanes = GetYUVPlaneCount(it->second.format);
+    }
+
     if(nummips == VK_REMAINING_MIP_LEVELS)
     {
       if(it != layouts.end())
@@ -223,22 +337,47 @@ void VulkanResourceManager::RecordBarriers(vector<pair<ResourceId, ImageRegionSt
         numslices = 1;
     }
 
-    RecordSingleBarrier(states, id, t, nummips, numslices);
+    RecordSingleBarrier(states, id, t, nummips, numslices, imageMips, imageSlices, imagePlanes);
   }
 
   TRDBG("Post-record, there are %u states", (uint32_t)states.size());
 }
 
-void VulkanResourceManager::MergeBarriers(vector<pair<ResourceId, ImageRegionState> > &dststates,
-                                          vector<pair<ResourceId, ImageRegionState> > &srcstates)
+void VulkanResourceManager::MergeBarriers(vector<PendingImageState> &dststates,
+                                          vector<PendingImageState> &srcstates)
 {
   TRDBG("Merging %u states", (uint32_t)srcstates.size());
 
-  for(size_t ti = 0; ti < srcstates.size(); ti++)
+  for(size_t ti = 0; ti < srcstates.size();)
   {
-    const ImageRegionState &t = srcstates[ti].second;
-    RecordSingleBarrier(dststates, srcstates[ti].first, t, t.subresourceRange.levelCount,
-                        t.subresourceRange.layerCount);
+    ResourceId id = srcstates[ti].first;
+
+    size_t count = 1;
+    while(ti + count < srcstates.size() && srcstates[ti + count].first == id)
+      count++;
+
+    // a source grid tells us how big the image is, so the destination can be laid out to match
+    uint32_t levels = 0, layers = 0, planes = 0;
+    GetGridSize(srcstates[ti].second, srcstates[ti + count - 1].second, count, levels, layers,
+                planes);
+
+    // a grid without a plane dimension doesn't say whether the image is multi-planar
+    if(planes == 1)
+      planes = 0;
+
+    for(size_t i = ti; i < ti + count; i++)
+    {
+      const ImageRegionState &t = srcstates[i].second;
+
+      // subresources in a grid that no barrier touched
+      if(t.newLayout == UNKNOWN_PREV_IMG_LAYOUT)
+        continue;
+
+      RecordSingleBarrier(dststates, id, t, t.subresourceRange.levelCount,
+                          t.subresourceRange.layerCount, levels, layers, planes);
+    }
+
+    ti += count;
   }
 
   TRDBG("Post-merge, there are %u states", (uint32_t)dststates.size());
@@ -376,6 +515,33 @@ void VulkanResourceManager::MarkSparseMapReferenced(ResourceInfo *sparse)
   }
 }
 
+void VulkanResourceManager::MarkDescriptorSetReferenced(DescriptorSetData *descInfo)
+{
+  const uint32_t epoch = GetFrameReferenceEpoch();
+
+  size_t count = descInfo->bindFrameRefs.size();
+
+  if(descInfo->refdEpoch == epoch && descInfo->refdVersion == descInfo->bindFrameRefsVersion)
+    count = descInfo->numVolatileRefs;
+
+  for(size_t i = 0; i < count; i++)
+  {
+    const DescSetBindRef &ref = descInfo->bindFrameRefs[i];
+
+    MarkResourceFrameReferenced(ref.id, ref.ref);
+
+    if(ref.sparse)
+    {
+      VkResourceRecord *sparserecord = GetResourceRecord(ref.id);
+
+      MarkSparseMapReferenced(sparserecord->resInfo);
+    }
+  }
+
+  descInfo->refdEpoch = epoch;
+  descInfo->refdVersion = descInfo->bindFrameRefsVersion;
+}
+
 void VulkanResourceManager::SetInternalResource(ResourceId id)
 {
   if(!RenderDoc::Inst().IsReplayApp())
@@ -386,20 +552,209 @@ void VulkanResourceManager::SetInternalResource(ResourceId id)
   }
 }
 
+// re-lays an image's tracked states as a dense grid, for any state list that isn't already either
+// a single whole-image range or a grid. Subresources not covered by any range keep the state of the
+// first range.
+static void NormaliseImageLayouts(ImageLayouts &layouts, uint32_t levels, uint32_t layers,
+                                  uint32_t planes)
+{
+  vector<ImageRegionState> &states = layouts.subresourceStates;
+
+  vector<ImageRegionState> grid(size_t(levels) * layers * planes, states[0]);
+
+  for(uint32_t plane = 0; plane < planes; plane++)
+    for(uint32_t slice = 0; slice < layers; slice++)
+      for(uint32_t mip = 0; mip < levels; mip++)
+        SetGridCell(grid[(plane * layers + slice) * levels + mip], mip, slice, plane, planes);
+
+  for(const ImageRegionState &src : states)
+  {
+    const VkImageSubresourceRange &r = src.subresourceRange;
+
+    const uint32_t planeMask = PlaneMask(r.aspectMask, planes);
+
+    for(uint32_t plane = 0; plane < planes; plane++)
+    {
+      if(!(planeMask & (1U << plane)))
+        continue;
+
+      for(uint32_t slice = r.baseArrayLayer; slice < RDCMIN(layers, r.baseArrayLayer + r.layerCount);
+          slice++)
+      {
+        for(uint32_t mip = r.baseMipLevel; mip < RDCMIN(levels, r.baseMipLevel + r.levelCount);
+            mip++)
+        {
+          ImageRegionState &cell = grid[(plane * layers + slice) * levels + mip];
+          cell.oldLayout = src.oldLayout;
+          cell.newLayout = src.newLayout;
+        }
+      }
+    }
+  }
+
+  states.swap(grid);
+}
+
+// applies one barrier to the tracked state of an image. If the barrier exactly covers one tracked
+// state, its oldLayout is replaced with the layout that state was in.
+static bool ApplyImageBarrier(ImageLayouts &layouts, ImageRegionState &t, uint32_t nummips,
+                              uint32_t numslices)
+{
+  vector<ImageRegionState> &states = layouts.subresourceStates;
+
+  if(states.empty())
+    return false;
+
+  const uint32_t levels = (uint32_t)RDCMAX(1, layouts.levelCount);
+  const uint32_t layers = (uint32_t)RDCMAX(1, layouts.layerCount);
+  const uint32_t baseMip = t.subresourceRange.baseMipLevel;
+  const uint32_t baseSlice = t.subresourceRange.baseArrayLayer;
+
+  if(baseMip >= levels || baseSlice >= layers)
+    return false;
+
+  nummips = RDCMIN(nummips, levels - baseMip);
+  numslices = RDCMIN(numslices, layers - baseSlice);
+
+  const uint32_t imagePlanes = GetYUVPlaneCount(layouts.format);
+
+  uint32_t gridLevels = 0, gridLayers = 0, gridPlanes = 0;
+  bool grid = GetGridSize(states.front(), states.back(), states.size(), gridLevels, gridLayers,
+                          gridPlanes) &&
+              gridLevels == levels && gridLayers == layers;
+
+  // only split by plane once the planes are transitioned separately
+  uint32_t planes = NeedPlanes(t.subresourceRange.aspectMask, imagePlanes);
+  if(grid)
+  {
+    planes = RDCMAX(planes, gridPlanes);
+  }
+  else
+  {
+    for(const ImageRegionState &s : states)
+      planes = RDCMAX(planes, NeedPlanes(s.subresourceRange.aspectMask, imagePlanes));
+  }
+
+  grid = grid && gridPlanes == planes;
+
+  const uint32_t allPlanes = (1U << planes) - 1;
+  const uint32_t planeMask = PlaneMask(t.subresourceRange.aspectMask, planes);
+
+  const size_t numSubresources = size_t(levels) * layers * planes;
+  const bool wholeImage = baseMip == 0 && baseSlice == 0 && nummips == levels &&
+                          numslices == layers && planeMask == allPlanes;
+
+  if(!grid &&
+     (states.size() != 1 || !SameRange(states[0].subresourceRange, 0, levels, 0, layers) ||
+      PlaneMask(states[0].subresourceRange.aspectMask, planes) != allPlanes))
+  {
+    NormaliseImageLayouts(layouts, levels, layers, planes);
+    grid = (numSubresources > 1);
+  }
+
+  if(!grid)
+  {
+    ImageRegionState &state = states[0];
+
+    // a whole image barrier on a whole image state, the fast path
+    if(wholeImage)
+    {
+      if(state.oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
+        state.oldLayout = t.oldLayout;
+      t.oldLayout = state.newLayout;
+      state.newLayout = t.newLayout;
+      return true;
+    }
+
+    // split into one state per subresource
+    ImageRegionState whole = state;
+    states.resize(numSubresources, whole);
+    for(uint32_t plane = 0; plane < planes; plane++)
+      for(uint32_t slice = 0; slice < layers; slice++)
+        for(uint32_t mip = 0; mip < levels; mip++)
+          SetGridCell(states[(plane * layers + slice) * levels + mip], mip, slice, plane, planes);
+  }
+  else if(wholeImage)
+  {
+    // everything is in the same state again, collapse back down to one range
+    ImageRegionState whole = states[0];
+    whole.subresourceRange.baseMipLevel = 0;
+    whole.subresourceRange.levelCount = levels;
+    whole.subresourceRange.baseArrayLayer = 0;
+    whole.subresourceRange.layerCount = layers;
+
+    // the barrier's aspect covers every plane
+    if(planes > 1)
+      whole.subresourceRange.aspectMask = t.subresourceRange.aspectMask;
+
+    if(whole.oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
+      whole.oldLayout = t.oldLayout;
+    whole.newLayout = t.newLayout;
+
+    states.resize(1);
+    states[0] = whole;
+    return true;
+  }
+
+  if(nummips == 1 && numslices == 1 && (planeMask & (planeMask - 1)) == 0)
+  {
+    uint32_t plane = 0;
+    while(!(planeMask & (1U << plane)))
+      plane++;
+
+    ImageRegionState &state = states[(plane * layers + baseSlice) * levels + baseMip];
+
+    if(state.oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
+      state.oldLayout = t.oldLayout;
+    t.oldLayout = state.newLayout;
+    state.newLayout = t.newLayout;
+    return true;
+  }
+
+  for(uint32_t plane = 0; plane < planes; plane++)
+  {
+    if(!(planeMask & (1U << plane)))
+      continue;
+
+    for(uint32_t slice = baseSlice; slice < baseSlice + numslices; slice++)
+    {
+      for(uint32_t mip = baseMip; mip < baseMip + nummips; mip++)
+      {
+        ImageRegionState &state = states[(plane * layers + slice) * levels + mip];
+
+        // apply it (prevstate is from the start of all barriers accumulated, so only set once)
+        if(state.oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
+          state.oldLayout = t.oldLayout;
+        state.newLayout = t.newLayout;
+      }
+    }
+  }
+
+  return true;
+}
+
 void VulkanResourceManager::ApplyBarriers(uint32_t queueFamilyIndex,
-                                          vector<pair<ResourceId, ImageRegionState> > &states,
+                                          vector<PendingImageState> &states,
                                           map<ResourceId, ImageLayouts> &layouts)
 {
   TRDBG("Applying %u barriers", (uint32_t)states.size());
 
+  auto stit = layouts.end();
+
   for(size_t ti = 0; ti < states.size(); ti++)
   {
     ResourceId id = states[ti].first;
     ImageRegionState &t = states[ti].second;
 
+    // subresources in a pending grid that no barrier touched
+    if(t.newLayout == UNKNOWN_PREV_IMG_LAYOUT)
+      continue;
+
     TRDBG("Applying barrier to %llu", GetOriginalID(id));
 
-    auto stit = layouts.find(id);
+    // states for the same image are contiguous, so only look up on a new image
+    if(stit == layouts.end() || stit->first != id)
+      stit = layouts.find(id);
 
     if(stit == layouts.end())
     {
@@ -417,9 +772,9 @@ void VulkanResourceManager::ApplyBarriers(uint32_t queueFamilyIndex,
     uint32_t nummips = t.subresourceRange.levelCount;
     uint32_t numslices = t.subresourceRange.layerCount;
     if(nummips == VK_REMAINING_MIP_LEVELS)
-      nummips = layouts[id].levelCount;
+      nummips = stit->second.levelCount;
     if(numslices == VK_REMAINING_ARRAY_LAYERS)
-      numslices = layouts[id].layerCount;
+      numslices = stit->second.layerCount;
 
     if(nummips == 0)
       nummips = 1;
@@ -434,146 +789,7 @@ void VulkanResourceManager::ApplyBarriers(uint32_t queueFamilyIndex,
           t.subresourceRange.baseArrayLayer, t.subresourceRange.layerCount,
           ToStr(t.oldLayout).c_str(), ToStr(t.newLayout).c_str());
 
-    bool done = false;
-
-    TRDBG("Matching image has %u subresource states", stit->second.subresourceStates.size());
-
-    auto it = stit->second.subresourceStates.begin();
-    for(; it != stit->second.subresourceStates.end(); ++it)
-    {
-      TRDBG(".. state %s (%u->%u, %u->%u) from %s to %s", ToStr(it->subresourceRange.aspect).c_str(),
-            it->range.baseMipLevel, it->range.levelCount, it->range.baseArrayLayer,
-            it->range.layerCount, ToStr(it->oldLayout).c_str(), ToStr(it->newLayout).c_str());
-
-      // image barriers are handled by initially inserting one subresource range for the whole
-      // object,
-      // and whenever we need more fine-grained detail we split it immediately.
-      // Thereafter if a barrier comes in that covers multiple subresources, we update all matching
-      // ranges.
-      // NOTE: Depth-stencil images must always be trasnsitioned together for both aspects, so we
-      // don't
-      // have to worry about different aspects being in different states and can in fact ignore the
-      // aspect
-      // for the purpose of this case.
-
-      {
-        // we've found a range that completely matches our region, doesn't matter if that's
-        // a whole image and the barrier is the whole image, or it's one subresource.
-        // note that for images with only one array/mip slice (e.g. render targets) we'll never
-        // really have to worry about the else{} branch
-        if(it->subresourceRange.baseMipLevel == t.subresourceRange.baseMipLevel &&
-           it->subresourceRange.levelCount == nummips &&
-           it->subresourceRange.baseArrayLayer == t.subresourceRange.baseArrayLayer &&
-           it->subresourceRange.layerCount == numslices)
-        {
-          /*
-          RDCASSERT(t.oldLayout == UNKNOWN_PREV_IMG_LAYOUT || it->newLayout ==
-          UNKNOWN_PREV_IMG_LAYOUT || // renderdoc untracked/ignored
-                    it->newLayout == t.oldLayout || // valid barrier
-                    t.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED); // can barrier from UNDEFINED to any
-          state
-          */
-          if(it->oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
-            it->oldLayout = t.oldLayout;
-          t.oldLayout = it->newLayout;
-          it->newLayout = t.newLayout;
-
-          done = true;
-          break;
-        }
-        else
-        {
-          // this handles the case where the barrier covers a number of subresources and we need
-          // to update each matching subresource. If the barrier was only one mip & array slice
-          // it would have hit the case above. Find each subresource within the range, update it,
-          // and continue (marking as done so whenever we stop finding matching ranges, we are
-          // satisfied.
-          //
-          // note that regardless of how we lay out our subresources (slice-major or mip-major) the
-          // new
-          // range could be sparse, but that's OK as we only break out of the loop once we go past
-          // the whole
-          // aspect. Any subresources that don't match the range, after the split, will fail to meet
-          // any
-          // of the handled cases, so we'll just continue processing.
-          if(it->subresourceRange.levelCount == 1 && it->subresourceRange.layerCount == 1 &&
-             it->subresourceRange.baseMipLevel >= t.subresourceRange.baseMipLevel &&
-             it->subresourceRange.baseMipLevel < t.subresourceRange.baseMipLevel + nummips &&
-             it->subresourceRange.baseArrayLayer >= t.subresourceRange.baseArrayLayer &&
-             it->subresourceRange.baseArrayLayer < t.subresourceRange.baseArrayLayer + numslices)
-          {
-            // apply it (prevstate is from the start of all barriers accumulated, so only set once)
-            if(it->oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
-              it->oldLayout = t.oldLayout;
-            it->newLayout = t.newLayout;
-
-            // continue as there might be more, but we're done
-            done = true;
-            continue;
-          }
-          // finally handle the case where we have a range that covers a whole image but we need to
-          // split it. If the barrier covered the whole image too it would have hit the very first
-          // case, so we know that the barrier doesn't cover the whole range.
-          // Also, if we've already done the split this case won't be hit and we'll either fall into
-          // the case above, or we'll finish as we've covered the whole barrier.
-          else if(it->subresourceRange.levelCount > 1 || it->subresourceRange.layerCount > 1)
-          {
-            ImageRegionState existing = *it;
-
-            // remember where we were in the array, as after this iterators will be
-            // invalidated.
-            size_t offs = it - stit->second.subresourceStates.begin();
-            size_t count = it->subresourceRange.levelCount * it->subresourceRange.layerCount;
-
-            // only insert count-1 as we want count entries total - one per subresource
-            stit->second.subresourceStates.insert(it, count - 1, existing);
-
-            // it now points at the first subresource, but we need to modify the ranges
-            // to be valid
-            it = stit->second.subresourceStates.begin() + offs;
-
-            for(size_t i = 0; i < count; i++)
-            {
-              it->subresourceRange.levelCount = 1;
-              it->subresourceRange.layerCount = 1;
-
-              // slice-major
-              it->subresourceRange.baseArrayLayer =
-                  uint32_t(i / existing.subresourceRange.levelCount);
-              it->subresourceRange.baseMipLevel = uint32_t(i % existing.subresourceRange.levelCount);
-              it++;
-            }
-
-            // reset the iterator to point to the first subresource
-            it = stit->second.subresourceStates.begin() + offs;
-
-            // the loop will continue after this point and look at the next subresources
-            // so we need to check to see if the first subresource lies in the range here
-            if(it->subresourceRange.baseMipLevel >= t.subresourceRange.baseMipLevel &&
-               it->subresourceRange.baseMipLevel < t.subresourceRange.baseMipLevel + nummips &&
-               it->subresourceRange.baseArrayLayer >= t.subresourceRange.baseArrayLayer &&
-               it->subresourceRange.baseArrayLayer < t.subresourceRange.baseArrayLayer + numslices)
-            {
-              // apply it (prevstate is from the start of all barriers accumulated, so only set
-              // once)
-              if(it->oldLayout == UNKNOWN_PREV_IMG_LAYOUT)
-                it->oldLayout = t.oldLayout;
-              it->newLayout = t.newLayout;
-
-              // continue as there might be more, but we're done
-              done = true;
-            }
-
-            // continue processing from here
-            continue;
-          }
-        }
-      }
-
-      // otherwise continue to try and find the subresource range
-    }
-
-    if(!done)
+    if(!ApplyImageBarrier(stit->second, t, nummips, numslices))
       RDCERR("Couldn't find subresource range to apply barrier to - invalid!");
   }
 }
@@ -654,3 +870,251 @@ bool VulkanResourceManager::ResourceTypeRelease(WrappedVkRes *res)
 {
   return m_Core->ReleaseResource(res);
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#undef None
+
+#include "3rdparty/catch/catch.hpp"
+
+static pair<ResourceId, ImageRegionState> MakePendingBarrier(ResourceId id, uint32_t baseMip,
+                                                             uint32_t numMips, uint32_t baseSlice,
+                                                             uint32_t numSlices,
+                                                             VkImageLayout oldLayout,
+                                                             VkImageLayout newLayout,
+                                                             VkImageAspectFlags aspect =
+                                                                 VK_IMAGE_ASPECT_COLOR_BIT)
+{
+  VkImageSubresourceRange range = {aspect, baseMip, numMips, baseSlice, numSlices};
+  return std::make_pair(id, ImageRegionState(VK_QUEUE_FAMILY_IGNORED, range, oldLayout, newLayout));
+}
+
+TEST_CASE("Vulkan image layout tracking", "[vulkan]")
+{
+  VulkanResourceManager rm(CaptureState::BackgroundCapturing, NULL);
+
+  const uint32_t levels = 4, layers = 6;
+
+  ResourceId id = ResourceIDGen::GetNewUniqueID();
+  ResourceId other = ResourceIDGen::GetNewUniqueID();
+
+  map<ResourceId, ImageLayouts> layouts;
+
+  for(ResourceId im : {id, other})
+  {
+    ImageLayouts &l = layouts[im];
+    l.levelCount = levels;
+    l.layerCount = layers;
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, layers};
+    l.subresourceStates.push_back(ImageRegionState(VK_QUEUE_FAMILY_IGNORED, range,
+                                                   UNKNOWN_PREV_IMG_LAYOUT,
+                                                   VK_IMAGE_LAYOUT_UNDEFINED));
+  }
+
+  auto layoutAt = [&layouts](ResourceId im, uint32_t mip, uint32_t slice) {
+    for(const ImageRegionState &s : layouts[im].subresourceStates)
+    {
+      const VkImageSubresourceRange &r = s.subresourceRange;
+      if(mip >= r.baseMipLevel && mip < r.baseMipLevel + r.levelCount &&
+         slice >= r.baseArrayLayer && slice < r.baseArrayLayer + r.layerCount)
+        return s.newLayout;
+    }
+    return UNKNOWN_PREV_IMG_LAYOUT;
+  };
+
+  SECTION("Whole image barriers keep a single state")
+  {
+    vector<pair<ResourceId, ImageRegionState> > src, pending;
+    src.push_back(MakePendingBarrier(id, 0, levels, 0, layers, VK_IMAGE_LAYOUT_UNDEFINED,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
+    src.push_back(MakePendingBarrier(id, 0, levels, 0, layers, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+    rm.MergeBarriers(pending, src);
+
+    REQUIRE(pending.size() == 1);
+    CHECK(pending[0].second.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+    CHECK(pending[0].second.newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    rm.ApplyBarriers(0, pending, layouts);
+
+    REQUIRE(layouts[id].subresourceStates.size() == 1);
+    CHECK(layouts[id].subresourceStates[0].newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    CHECK(layouts[id].subresourceStates[0].subresourceRange.levelCount == levels);
+    CHECK(layouts[id].subresourceStates[0].subresourceRange.layerCount == layers);
+    CHECK(layouts[other].subresourceStates.size() == 1);
+  };
+
+  SECTION("Per-subresource barriers split into a grid")
+  {
+    vector<pair<ResourceId, ImageRegionState> > src, pending;
+
+    // transition each layer of mip 0, then generate mips one level at a time
+    for(uint32_t slice = 0; slice < layers; slice++)
+      src.push_back(MakePendingBarrier(id, 0, 1, slice, 1, VK_IMAGE_LAYOUT_UNDEFINED,
+                                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL));
+    for(uint32_t mip = 1; mip < levels - 1; mip++)
+      src.push_back(MakePendingBarrier(id, mip, 1, 0, layers, VK_IMAGE_LAYOUT_UNDEFINED,
+                                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
+    src.push_back(MakePendingBarrier(other, 0, 1, 2, 1, VK_IMAGE_LAYOUT_UNDEFINED,
+                                     VK_IMAGE_LAYOUT_GENERAL));
+
+    rm.MergeBarriers(pending, src);
+
+    size_t numid = 0;
+    for(auto &p : pending)
+      numid += (p.first == id) ? 1 : 0;
+    // merged barriers don't know the image size, so only cover the subresources they touch
+    CHECK(numid == (levels - 1) * layers);
+
+    rm.ApplyBarriers(0, pending, layouts);
+
+    CHECK(layouts[id].subresourceStates.size() == levels * layers);
+
+    for(uint32_t slice = 0; slice < layers; slice++)
+    {
+      CHECK(layoutAt(id, 0, slice) == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+      for(uint32_t mip = 1; mip < levels - 1; mip++)
+        CHECK(layoutAt(id, mip, slice) == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+      // the last mip was never touched, it must still be in its original layout
+      CHECK(layoutAt(id, levels - 1, slice) == VK_IMAGE_LAYOUT_UNDEFINED);
+
+      CHECK(layoutAt(other, 0, slice) ==
+            (slice == 2 ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED));
+    }
+
+    // a single subresource barrier that matches exactly reports the layout it came from
+    pending.clear();
+    pending.push_back(MakePendingBarrier(id, 1, 1, 3, 1, VK_IMAGE_LAYOUT_UNDEFINED,
+                                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+    rm.ApplyBarriers(0, pending, layouts);
+
+    CHECK(pending[0].second.oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    CHECK(layoutAt(id, 1, 3) == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    CHECK(layoutAt(id, 1, 2) == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    // a whole image barrier collapses the grid back down
+    pending.clear();
+    pending.push_back(MakePendingBarrier(id, 0, VK_REMAINING_MIP_LEVELS, 0,
+                                         VK_REMAINING_ARRAY_LAYERS, VK_IMAGE_LAYOUT_UNDEFINED,
+                                         VK_IMAGE_LAYOUT_GENERAL));
+    rm.ApplyBarriers(0, pending, layouts);
+
+    REQUIRE(layouts[id].subresourceStates.size() == 1);
+    CHECK(layouts[id].subresourceStates[0].newLayout == VK_IMAGE_LAYOUT_GENERAL);
+    CHECK(layouts[id].subresourceStates[0].subresourceRange.levelCount == levels);
+    CHECK(layouts[id].subresourceStates[0].subresourceRange.layerCount == layers);
+  };
+
+  SECTION("Overlapping barriers merge across command buffers")
+  {
+    vector<pair<ResourceId, ImageRegionState> > cmd1, cmd2, pending;
+
+    cmd1.push_back(MakePendingBarrier(id, 0, levels, 0, 3, VK_IMAGE_LAYOUT_UNDEFINED,
+                                      VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+    cmd2.push_back(MakePendingBarrier(id, 0, levels, 0, layers, VK_IMAGE_LAYOUT_UNDEFINED,
+                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
+    cmd2.push_back(MakePendingBarrier(id, 2, 1, 4, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+
+    rm.MergeBarriers(pending, cmd1);
+    rm.MergeBarriers(pending, cmd2);
+
+    rm.ApplyBarriers(0, pending, layouts);
+
+    for(uint32_t slice = 0; slice < layers; slice++)
+    {
+      for(uint32_t mip = 0; mip < levels; mip++)
+      {
+        if(mip == 2 && slice == 4)
+          CHECK(layoutAt(id, mip, slice) == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        else
+          CHECK(layoutAt(id, mip, slice) == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+      }
+    }
+  };
+
+  SECTION("Multi-planar images track planes separately")
+  {
+    ResourceId planar = ResourceIDGen::GetNewUniqueID();
+
+    {
+      ImageLayouts &l = layouts[planar];
+      l.levelCount = levels;
+      l.layerCount = layers;
+      l.format = VK_FORMAT_G8_B8R8_2PLANE_420_UNORM;
+      VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, layers};
+      l.subresourceStates.push_back(ImageRegionState(VK_QUEUE_FAMILY_IGNORED, range,
+                                                     UNKNOWN_PREV_IMG_LAYOUT,
+                                                     VK_IMAGE_LAYOUT_UNDEFINED));
+    }
+
+    auto planeLayoutAt = [&layouts, planar](uint32_t mip, uint32_t slice,
+                                            VkImageAspectFlags plane) {
+      for(const ImageRegionState &s : layouts[planar].subresourceStates)
+      {
+        const VkImageSubresourceRange &r = s.subresourceRange;
+        if(mip >= r.baseMipLevel && mip < r.baseMipLevel + r.levelCount &&
+           slice >= r.baseArrayLayer && slice < r.baseArrayLayer + r.layerCount &&
+           (r.aspectMask & (plane | VK_IMAGE_ASPECT_COLOR_BIT)))
+          return s.newLayout;
+      }
+      return UNKNOWN_PREV_IMG_LAYOUT;
+    };
+
+    vector<pair<ResourceId, ImageRegionState> > src, pending;
+
+    // transition the whole luma plane, and one subresource of the chroma plane
+    src.push_back(MakePendingBarrier(planar, 0, levels, 0, layers, VK_IMAGE_LAYOUT_UNDEFINED,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                     VK_IMAGE_ASPECT_PLANE_0_BIT));
+    src.push_back(MakePendingBarrier(planar, 1, 1, 2, 1, VK_IMAGE_LAYOUT_UNDEFINED,
+                                     VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_PLANE_1_BIT));
+
+    rm.MergeBarriers(pending, src);
+
+    // every pending state must name the single plane it applies to
+    for(auto &p : pending)
+    {
+      CHECK((p.second.subresourceRange.aspectMask == VK_IMAGE_ASPECT_PLANE_0_BIT ||
+             p.second.subresourceRange.aspectMask == VK_IMAGE_ASPECT_PLANE_1_BIT));
+    }
+
+    rm.ApplyBarriers(0, pending, layouts);
+
+    CHECK(layouts[planar].subresourceStates.size() == levels * layers * 2);
+
+    for(uint32_t slice = 0; slice < layers; slice++)
+    {
+      for(uint32_t mip = 0; mip < levels; mip++)
+      {
+        CHECK(planeLayoutAt(mip, slice, VK_IMAGE_ASPECT_PLANE_0_BIT) ==
+              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        CHECK(planeLayoutAt(mip, slice, VK_IMAGE_ASPECT_PLANE_1_BIT) ==
+              (mip == 1 && slice == 2 ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED));
+      }
+    }
+
+    // a colour aspect barrier covers every plane, so collapses the grid back down
+    pending.clear();
+    pending.push_back(MakePendingBarrier(planar, 0, levels, 0, layers, VK_IMAGE_LAYOUT_UNDEFINED,
+                                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+    rm.ApplyBarriers(0, pending, layouts);
+
+    REQUIRE(layouts[planar].subresourceStates.size() == 1);
+    CHECK(layouts[planar].subresourceStates[0].subresourceRange.aspectMask ==
+          VK_IMAGE_ASPECT_COLOR_BIT);
+    CHECK(planeLayoutAt(1, 2, VK_IMAGE_ASPECT_PLANE_1_BIT) ==
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // non-planar images still ignore the aspect
+    pending.clear();
+    pending.push_back(MakePendingBarrier(id, 0, levels, 0, layers, VK_IMAGE_LAYOUT_UNDEFINED,
+                                         VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_PLANE_0_BIT));
+    rm.ApplyBarriers(0, pending, layouts);
+
+    CHECK(layouts[id].subresourceStates.size() == 1);
+  };
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
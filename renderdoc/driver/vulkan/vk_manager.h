@@ -244,10 +244,6 @@ public:
   }
 
   // handling memory & image layouts
-  template <typename SrcBarrierType>
-  void RecordSingleBarrier(vector<pair<ResourceId, ImageRegionState> > &states, ResourceId id,
-                           const SrcBarrierType &t, uint32_t nummips, uint32_t numslices);
-
   void RecordBarriers(vector<pair<ResourceId, ImageRegionState> > &states,
                       const map<ResourceId, ImageLayouts> &layouts, uint32_t numBarriers,
                       const VkImageMemoryBarrier *barriers);
@@ -408,11 +404,22 @@ public:
   // helper for sparse mappings
   void MarkSparseMapReferenced(ResourceInfo *sparse);
 
+  // mark all resources bound in a descriptor set as referenced. Skips the refs that can't have
+  // changed if nothing in the set has since it was last marked in this frame.
+  void MarkDescriptorSetReferenced(DescriptorSetData *descInfo);
+
   void SetInternalResource(ResourceId id);
 
 private:
   bool ResourceTypeRelease(WrappedVkRes *res);
 
+  // image dimensions are only hints for laying out per-subresource states, and may be 0 if unknown.
+  // imagePlanes is only used if planes of a multi-planar image are transitioned separately
+  template <typename SrcBarrierType>
+  void RecordSingleBarrier(vector<pair<ResourceId, ImageRegionState> > &states, ResourceId id,
+                           const SrcBarrierType &t, uint32_t nummips, uint32_t numslices,
+                           uint32_t imageMips, uint32_t imageSlices, uint32_t imagePlanes);
+
   bool Force_InitialState(WrappedVkRes *res, bool prepare);
   bool AllowDeletedResource_InitialState() { return true; }
   bool Need_InitialStateChunk(WrappedVkRes *res);
@@ -1916,7 +1916,7 @@ void VulkanReplay::FetchVSOut(uint32_t eventId)
   }
 
   uint32_t bufStride = 0;
-  vector<uint32_t> modSpirv = moduleInfo.spirv.spirv;
+  vector<uint32_t> modSpirv = moduleInfo.GetSPIRVWords();
 
   struct CompactedAttrBuffer
   {
@@ -2690,7 +2690,7 @@ void VulkanReplay::FetchTessGSOut(uint32_t eventId)
   const VulkanCreationInfo::ShaderModule &moduleInfo =
       creationInfo.m_ShaderModule[pipeInfo.shaders[stageIndex].module];
 
-  std::vector<uint32_t> modSpirv = moduleInfo.spirv.spirv;
+  std::vector<uint32_t> modSpirv = moduleInfo.GetSPIRVWords();
 
   uint32_t xfbStride = 0;
 
@@ -90,9 +90,50 @@ APIProperties VulkanReplay::GetAPIProperties()
   return ret;
 }
 
+class VulkanStructuredLoader : public StructuredChunkLoader
+{
+public:
+  VulkanStructuredLoader(RDCFile *rdc, int sectionIdx, bool includeBuffers)
+      : StructuredChunkLoader(rdc, sectionIdx, &WrappedVulkan::GetChunkName, includeBuffers)
+  {
+    m_Vulkan.SetStructuredExport(rdc->GetSectionProperties(sectionIdx).version);
+  }
+
+protected:
+  bool ProcessChunk(ReadSerialiser &ser, uint32_t chunkID)
+  {
+    return m_Vulkan.ProcessStructuredChunk(ser, (VulkanChunk)chunkID);
+  }
+
+private:
+  WrappedVulkan m_Vulkan;
+};
+
 ReplayStatus VulkanReplay::ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers)
 {
-  return m_pDriver->ReadLogInitialisation(rdc, storeStructuredBuffers);
+  // chunk contents are only needed when something like the API inspector looks at them, so if the
+  // loader can read the capture independently of rdc, only index the chunks while loading and load
+  // their contents on demand.
+  VulkanStructuredLoader *loader = NULL;
+
+  int sectionIdx = rdc ? rdc->SectionIndex(SectionType::FrameCapture) : -1;
+  if(sectionIdx >= 0)
+  {
+    loader = new VulkanStructuredLoader(rdc, sectionIdx, storeStructuredBuffers);
+    if(!loader->OwnsFile())
+      SAFE_DELETE(loader);
+  }
+
+  m_pDriver->SetLazyStructuredData(loader != NULL);
+
+  ReplayStatus status = m_pDriver->ReadLogInitialisation(rdc, storeStructuredBuffers);
+
+  if(loader && status == ReplayStatus::Succeeded)
+    m_pDriver->GetStructuredFile().SetChunkLoader(loader, StructuredChunkLoader::DefaultMaxLoaded);
+  else
+    SAFE_DELETE(loader);
+
+  return status;
 }
 
 void VulkanReplay::ReplayLog(uint32_t endEventID, ReplayLogType replayType)
@@ -317,12 +358,14 @@ rdcarray<ShaderEntryPoint> VulkanReplay::GetShaderEntryPoints(ResourceId shader)
   if(shad == m_pDriver->m_CreationInfo.m_ShaderModule.end())
     return {};
 
-  std::vector<std::string> entries = shad->second.spirv.EntryPoints();
+  const SPVModule &spirv = shad->second.GetSPIRV();
+
+  std::vector<std::string> entries = spirv.EntryPoints();
 
   rdcarray<ShaderEntryPoint> ret;
 
   for(const std::string &e : entries)
-    ret.push_back({e, shad->second.spirv.StageForEntry(e)});
+    ret.push_back({e, spirv.StageForEntry(e)});
 
   return ret;
 }
@@ -337,7 +380,7 @@ ShaderReflection *VulkanReplay::GetShader(ResourceId shader, ShaderEntryPoint en
     return NULL;
   }
 
-  shad->second.m_Reflections[entry.name].Init(GetResourceManager(), shader, shad->second.spirv,
+  shad->second.m_Reflections[entry.name].Init(GetResourceManager(), shader, shad->second,
                                               entry.name,
                                               VkShaderStageFlagBits(1 << uint32_t(entry.stage)));
 
@@ -377,7 +420,7 @@ string VulkanReplay::DisassembleShader(ResourceId pipeline, const ShaderReflecti
     std::string &disasm = it->second.m_Reflections[refl->entryPoint.c_str()].disassembly;
 
     if(disasm.empty())
-      disasm = it->second.spirv.Disassemble(refl->entryPoint.c_str());
+      disasm = it->second.GetSPIRV().Disassemble(refl->entryPoint.c_str());
 
     return disasm;
   }
@@ -3823,7 +3866,7 @@ struct VulkanDriverRegistration
 
 static VulkanDriverRegistration VkDriverRegistration;
 
-void Vulkan_ProcessStructured(RDCFile *rdc, SDFile &output)
+void Vulkan_ProcessStructured(RDCFile *rdc, SDFile &output, bool lazy)
 {
   WrappedVulkan vulkan;
 
@@ -3832,11 +3875,40 @@ void Vulkan_ProcessStructured(RDCFile *rdc, SDFile &output)
   if(sectionIdx < 0)
     return;
 
-  vulkan.SetStructuredExport(rdc->GetSectionProperties(sectionIdx).version);
+  const SectionProperties &props = rdc->GetSectionProperties(sectionIdx);
+
+  // to export everything in parallel, first index the chunks with a lazy export then load ranges
+  // of them on separate threads, each through its own handle to the file. That needs each thread
+  // to seek to its range, which streaming LZ4 sections can only do by decompressing everything
+  // before it, so those are exported in one pass. Independent-block LZ4 and zstd can seek.
+  // Only Vulkan has a lazy export, so the other drivers always export in one pass. The indexing
+  // pass is serial and still decompresses the whole section, so the parallel pass only speeds up
+  // building the structured data.
+  bool seekable = !(props.flags & SectionFlags::LZ4Compressed) ||
+                  (props.flags & SectionFlags::LZ4IndependentBlocks);
+  bool parallel = !lazy && seekable && Threading::NumberOfCores() > 1;
+
+  vulkan.SetStructuredExport(props.version, lazy || parallel);
   ReplayStatus status = vulkan.ReadLogInitialisation(rdc, true);
 
   if(status == ReplayStatus::Succeeded)
+  {
     vulkan.GetStructuredFile().Swap(output);
+
+    if(lazy)
+    {
+      output.SetChunkLoader(new VulkanStructuredLoader(rdc, sectionIdx, true),
+                            StructuredChunkLoader::DefaultMaxLoaded);
+    }
+    else if(parallel)
+    {
+      LoadLazyChunksParallel(output,
+                             [rdc, sectionIdx]() -> SDChunkLoader * {
+                               return new VulkanStructuredLoader(rdc, sectionIdx, true);
+                             },
+                             Threading::NumberOfCores());
+    }
+  }
 }
 
 static StructuredProcessRegistration VulkanProcessRegistration(RDCDriver::Vulkan,
@@ -2985,6 +2985,79 @@ VkFormat MakeVkFormat(ResourceFormat fmt)
   return ret;
 }
 
+void DescriptorSetData::MoveBindFrameRef(size_t from, size_t to)
+{
+  if(from == to)
+    return;
+
+  bindFrameRefs[to] = bindFrameRefs[from];
+  bindFrameRefIndex[bindFrameRefs[to].id] = to;
+}
+
+void DescriptorSetData::AddBindFrameRef(ResourceId id, FrameRefType ref, bool hasSparse)
+{
+  bindFrameRefsVersion++;
+
+  auto it = bindFrameRefIndex.find(id);
+  if(it != bindFrameRefIndex.end())
+  {
+    // be conservative - mark refs as read before write if we see a write and a read ref on it
+    DescSetBindRef &bindRef = bindFrameRefs[it->second];
+    bindRef.ref = ComposeFrameRefsUnordered(bindRef.ref, ref);
+    bindRef.count++;
+    return;
+  }
+
+  DescSetBindRef bindRef = {id, 1, ref, hasSparse};
+
+  bindFrameRefs.push_back(bindRef);
+  bindFrameRefIndex[id] = bindFrameRefs.size() - 1;
+
+  // re-marking is only idempotent for reads, and read-before-write which can't change further
+  if(hasSparse || ref == eFrameRef_Write || ref == eFrameRef_Clear)
+  {
+    // swap into the end of the volatile refs
+    size_t idx = bindFrameRefs.size() - 1;
+    MoveBindFrameRef(numVolatileRefs, idx);
+    bindFrameRefs[numVolatileRefs] = bindRef;
+    bindFrameRefIndex[id] = numVolatileRefs;
+    numVolatileRefs++;
+  }
+}
+
+void DescriptorSetData::RemoveBindFrameRef(ResourceId id)
+{
+  auto it = bindFrameRefIndex.find(id);
+
+  // in the case of re-used handles bound to descriptor sets,
+  // it's possible to try and remove a frameref on something we
+  // don't have (which means we'll have a corresponding stale ref)
+  // but this is harmless so we can ignore it.
+  if(it == bindFrameRefIndex.end())
+    return;
+
+  size_t idx = it->second;
+
+  bindFrameRefs[idx].count--;
+
+  if(bindFrameRefs[idx].count > 0)
+    return;
+
+  bindFrameRefIndex.erase(it);
+
+  // fill the hole from the end of its partition, then the end of the volatile partition from the
+  // end of the list
+  if(idx < numVolatileRefs)
+  {
+    numVolatileRefs--;
+    MoveBindFrameRef(numVolatileRefs, idx);
+    idx = numVolatileRefs;
+  }
+
+  MoveBindFrameRef(bindFrameRefs.size() - 1, idx);
+  bindFrameRefs.pop_back();
+}
+
 VkResourceRecord::~VkResourceRecord()
 {
   VkResourceType resType = Resource != NULL ? IdentifyTypeByPtr(Resource) : eResUnknown;
@@ -3806,4 +3879,79 @@ TEST_CASE("Vulkan formats", "[format][vulkan]")
   }
 };
 
+TEST_CASE("Vulkan descriptor set bind refs", "[vulkan]")
+{
+  DescriptorSetData set;
+
+  ResourceId ids[6];
+  for(ResourceId &id : ids)
+    id = ResourceIDGen::GetNewUniqueID();
+
+  // check that the index and the volatile partition are consistent with the list
+  auto checkRefs = [&set]() {
+    CHECK(set.bindFrameRefIndex.size() == set.bindFrameRefs.size());
+    CHECK(set.numVolatileRefs <= set.bindFrameRefs.size());
+
+    for(size_t i = 0; i < set.bindFrameRefs.size(); i++)
+    {
+      const DescSetBindRef &ref = set.bindFrameRefs[i];
+      CHECK(set.bindFrameRefIndex[ref.id] == i);
+
+      bool isVolatile = ref.sparse || ref.ref == eFrameRef_Write;
+      if(isVolatile)
+        CHECK(i < set.numVolatileRefs);
+    }
+  };
+
+  set.AddBindFrameRef(ids[0], eFrameRef_Read, false);
+  set.AddBindFrameRef(ids[1], eFrameRef_Write, false);
+  set.AddBindFrameRef(ids[2], eFrameRef_Read, true);
+  set.AddBindFrameRef(ids[3], eFrameRef_Read, false);
+  set.AddBindFrameRef(ids[4], eFrameRef_Write, false);
+  checkRefs();
+
+  CHECK(set.bindFrameRefs.size() == 5);
+  CHECK(set.numVolatileRefs == 3);
+
+  uint32_t version = set.bindFrameRefsVersion;
+
+  // adding an existing ref bumps the refcount and composes the ref type
+  set.AddBindFrameRef(ids[0], eFrameRef_Write, false);
+  CHECK(set.bindFrameRefs.size() == 5);
+  CHECK(set.bindFrameRefs[set.bindFrameRefIndex[ids[0]]].count == 2);
+  CHECK((set.bindFrameRefs[set.bindFrameRefIndex[ids[0]]].ref == eFrameRef_ReadBeforeWrite));
+  CHECK(set.bindFrameRefsVersion != version);
+  checkRefs();
+
+  set.RemoveBindFrameRef(ids[0]);
+  CHECK(set.HasBindFrameRef(ids[0]));
+
+  // removing from either partition keeps everything packed
+  set.RemoveBindFrameRef(ids[1]);
+  CHECK_FALSE(set.HasBindFrameRef(ids[1]));
+  CHECK(set.numVolatileRefs == 2);
+  checkRefs();
+
+  set.RemoveBindFrameRef(ids[3]);
+  CHECK_FALSE(set.HasBindFrameRef(ids[3]));
+  checkRefs();
+
+  // removing something never added is ignored
+  set.RemoveBindFrameRef(ids[5]);
+  checkRefs();
+
+  set.AddBindFrameRef(ids[5], eFrameRef_Write, false);
+  checkRefs();
+  CHECK(set.numVolatileRefs == 3);
+
+  set.RemoveBindFrameRef(ids[4]);
+  set.RemoveBindFrameRef(ids[5]);
+  set.RemoveBindFrameRef(ids[2]);
+  set.RemoveBindFrameRef(ids[0]);
+  checkRefs();
+
+  CHECK(set.bindFrameRefs.empty());
+  CHECK(set.numVolatileRefs == 0);
+};
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -936,6 +936,16 @@ struct CmdBufferRecordingInfo
 
 struct DescSetLayout;
 
+struct DescSetBindRef
+{
+  ResourceId id;
+  // number of bindings in the set that reference this resource
+  uint32_t count;
+  FrameRefType ref;
+  // the resource has sparse mapping information
+  bool sparse;
+};
+
 struct DescriptorSetData
 {
   DescriptorSetData() : layout(NULL) {}
@@ -952,13 +962,37 @@ struct DescriptorSetData
   // create from the layout.
   vector<DescriptorSetSlot *> descBindings;
 
+  void AddBindFrameRef(ResourceId id, FrameRefType ref, bool hasSparse);
+  void RemoveBindFrameRef(ResourceId id);
+  bool HasBindFrameRef(ResourceId id) const
+  {
+    return bindFrameRefIndex.find(id) != bindFrameRefIndex.end();
+  }
+
   // contains the framerefs (ref counted) for the bound resources
   // in the binding slots. Updated when updating descriptor sets
   // and then applied in a block on descriptor set bind.
-  // the refcount has the high-bit set if this resource has sparse
-  // mapping information
-  static const uint32_t SPARSE_REF_BIT = 0x80000000;
-  map<ResourceId, pair<uint32_t, FrameRefType> > bindFrameRefs;
+  //
+  // Marking a read-only ref again later in the same frame can't change how the resource is
+  // referenced, but a write (which might have been read in between) or a sparse resource (whose
+  // mapping might have changed) can. Those refs are kept at the start of the list so that a set
+  // that hasn't changed since it was last referenced this frame only needs to re-mark them.
+  vector<DescSetBindRef> bindFrameRefs;
+  uint32_t numVolatileRefs = 0;
+
+  // index into bindFrameRefs for each resource
+  map<ResourceId, size_t> bindFrameRefIndex;
+
+  // incremented whenever the refs change
+  uint32_t bindFrameRefsVersion = 0;
+
+  // the resource manager's frame reference epoch and the version of the refs, at the last time
+  // all refs were marked as referenced
+  uint32_t refdEpoch = 0;
+  uint32_t refdVersion = 0;
+
+private:
+  void MoveBindFrameRef(size_t from, size_t to);
 };
 
 struct PipelineLayoutData
@@ -1039,18 +1073,7 @@ public:
       RDCERR("Unexpected NULL resource ID being added as a bind frame ref");
       return;
     }
-    auto it = descInfo->bindFrameRefs.find(id);
-    if((it->second.first & ~DescriptorSetData::SPARSE_REF_BIT) == 0)
-    {
-      it->second = std::make_pair(1 | (hasSparse ? DescriptorSetData::SPARSE_REF_BIT : 0), ref);
-    }
-    else
-    {
-      // be conservative - mark refs as read before write if we see a write and a read ref on it
-      descInfo->bindFrameRefs[id].second =
-          ComposeFrameRefsUnordered(descInfo->bindFrameRefs[id].second, ref);
-      descInfo->bindFrameRefs[id].first++;
-    }
+    descInfo->AddBindFrameRef(id, ref, hasSparse);
   }
 
   void RemoveBindFrameRef(ResourceId id)
@@ -1060,19 +1083,7 @@ public:
     if(id == ResourceId())
       return;
 
-    auto it = descInfo->bindFrameRefs.find(id);
-
-    // in the case of re-used handles bound to descriptor sets,
-    // it's possible to try and remove a frameref on something we
-    // don't have (which means we'll have a corresponding stale ref)
-    // but this is harmless so we can ignore it.
-    if(it == descInfo->bindFrameRefs.end())
-      return;
-
-    it->second.first--;
-
-    if((it->second.first & ~DescriptorSetData::SPARSE_REF_BIT) == 0)
-      descInfo->bindFrameRefs.erase(it);
+    descInfo->RemoveBindFrameRef(id);
   }
 
   // we have a lot of 'cold' data in the resource record, as it can be accessed
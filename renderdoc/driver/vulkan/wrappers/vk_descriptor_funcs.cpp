@@ -956,18 +956,7 @@ void WrappedVulkan::vkUpdateDescriptorSets(VkDevice device, uint32_t writeCount,
 
       VkResourceRecord *setrecord = GetRecord(pDescriptorCopies[i].srcSet);
 
-      for(auto refit = setrecord->descInfo->bindFrameRefs.begin();
-          refit != setrecord->descInfo->bindFrameRefs.end(); ++refit)
-      {
-        GetResourceManager()->MarkResourceFrameReferenced(refit->first, refit->second.second);
-
-        if(refit->second.first & DescriptorSetData::SPARSE_REF_BIT)
-        {
-          VkResourceRecord *record = GetResourceManager()->GetResourceRecord(refit->first);
-
-          GetResourceManager()->MarkSparseMapReferenced(record->resInfo);
-        }
-      }
+      GetResourceManager()->MarkDescriptorSetReferenced(setrecord->descInfo);
     }
   }
 
@@ -25,6 +25,13 @@
 #include "../vk_core.h"
 #include "../vk_debug.h"
 
+// differing ranges of a coherent map closer than this are flushed together, since each range
+// becomes its own chunk
+static const size_t CoherentMapMergeGap = 4096;
+
+// beyond this many ranges, the span covering all of them is flushed as one
+static const size_t MaxCoherentMapFlushRanges = 256;
+
 template <typename SerialiserType>
 bool WrappedVulkan::Serialise_vkGetDeviceQueue(SerialiserType &ser, VkDevice device,
                                                uint32_t queueFamilyIndex, uint32_t queueIndex,
@@ -782,6 +789,7 @@ VkResult WrappedVulkan::vkQueueSubmit(VkQueue queue, uint32_t submitCount,
   bool present = false;
 
   set<ResourceId> refdIDs;
+  set<DescriptorSetData *> refdDescSets;
 
   VkResourceRecord *queueRecord = GetRecord(queue);
 
@@ -844,19 +852,8 @@ VkResult WrappedVulkan::vkQueueSubmit(VkQueue queue, uint32_t submitCount,
 
           VkResourceRecord *setrecord = GetRecord(*it);
 
-          for(auto refit = setrecord->descInfo->bindFrameRefs.begin();
-              refit != setrecord->descInfo->bindFrameRefs.end(); ++refit)
-          {
-            refdIDs.insert(refit->first);
-            GetResourceManager()->MarkResourceFrameReferenced(refit->first, refit->second.second);
-
-            if(refit->second.first & DescriptorSetData::SPARSE_REF_BIT)
-            {
-              VkResourceRecord *sparserecord = GetResourceManager()->GetResourceRecord(refit->first);
-
-              GetResourceManager()->MarkSparseMapReferenced(sparserecord->resInfo);
-            }
-          }
+          GetResourceManager()->MarkDescriptorSetReferenced(setrecord->descInfo);
+          refdDescSets.insert(setrecord->descInfo);
         }
 
         for(auto it = record->bakedCommands->cmdInfo->sparse.begin();
@@ -910,6 +907,9 @@ VkResult WrappedVulkan::vkQueueSubmit(VkQueue queue, uint32_t submitCount,
       maps = m_CoherentMaps;
     }
 
+    rdcarray<rdcpair<size_t, size_t>> diffRanges;
+    std::vector<VkMappedMemoryRange> flushRanges;
+
     for(auto it = maps.begin(); it != maps.end(); ++it)
     {
       VkResourceRecord *record = *it;
@@ -919,14 +919,18 @@ VkResult WrappedVulkan::vkQueueSubmit(VkQueue queue, uint32_t submitCount,
       if(state.mapCoherent && state.mappedPtr && !state.mapFlushed)
       {
         // only need to flush memory that could affect this submitted batch of work
-        if(refdIDs.find(record->GetResourceID()) == refdIDs.end())
+        bool refd = refdIDs.find(record->GetResourceID()) != refdIDs.end();
+        for(auto setit = refdDescSets.begin(); !refd && setit != refdDescSets.end(); ++setit)
+          refd = (*setit)->HasBindFrameRef(record->GetResourceID());
+
+        if(!refd)
         {
           RDCDEBUG("Map of memory %llu not referenced in this queue - not flushing",
                    record->GetResourceID());
           continue;
         }
 
-        size_t diffStart = 0, diffEnd = 0;
+        diffRanges.clear();
         bool found = true;
 
 // enabled as this is necessary for programs with very large coherent mappings
@@ -955,11 +959,22 @@ VkResult WrappedVulkan::vkQueueSubmit(VkQueue queue, uint32_t submitCount,
         // if we have a previous set of data, compare.
         // otherwise just serialise it all
         if(state.refData)
-          found = FindDiffRange((byte *)state.mappedPtr, state.refData, (size_t)state.mapSize,
-                                diffStart, diffEnd);
+        {
+          // merge ranges that are close together, so that scattered small writes don't each
+          // become a separate flush
+          found = FindDiffRanges(state.mappedPtr + (size_t)state.mapOffset, state.refData,
+                                 (size_t)state.mapSize, CoherentMapMergeGap, diffRanges);
+
+          // if there are too many ranges, flush the span covering them all instead
+          if(diffRanges.size() > MaxCoherentMapFlushRanges)
+          {
+            diffRanges[0].second = diffRanges.back().second;
+            diffRanges.resize(1);
+          }
+        }
         else
 #endif
-          diffEnd = (size_t)state.mapSize;
+          diffRanges.push_back(make_rdcpair(size_t(0), (size_t)state.mapSize));
 
         if(found)
         {
@@ -968,12 +983,19 @@ VkResult WrappedVulkan::vkQueueSubmit(VkQueue queue, uint32_t submitCount,
           VkDevice dev = GetDev();
 
           {
-            RDCLOG("Persistent map flush forced for %llu (%llu -> %llu)", record->GetResourceID(),
-                   (uint64_t)diffStart, (uint64_t)diffEnd);
-            VkMappedMemoryRange range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, NULL,
-                                         (VkDeviceMemory)(uint64_t)record->Resource,
-                                         state.mapOffset + diffStart, diffEnd - diffStart};
-            vkFlushMappedMemoryRanges(dev, 1, &range);
+            RDCLOG("Persistent map flush forced for %llu (%llu -> %llu in %u ranges)",
+                   record->GetResourceID(), (uint64_t)diffRanges[0].first,
+                   (uint64_t)diffRanges.back().second, (uint32_t)diffRanges.size());
+
+            // can't use GetTempArray here, vkFlushMappedMemoryRanges uses it for unwrapping
+            flushRanges.resize(diffRanges.size());
+            for(size_t r = 0; r < diffRanges.size(); r++)
+              flushRanges[r] = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, NULL,
+                                (VkDeviceMemory)(uint64_t)record->Resource,
+                                state.mapOffset + diffRanges[r].first,
+                                diffRanges[r].second - diffRanges[r].first};
+
+            vkFlushMappedMemoryRanges(dev, (uint32_t)flushRanges.size(), flushRanges.data());
             state.mapFlushed = false;
           }
 
@@ -733,8 +733,8 @@ bool WrappedVulkan::Serialise_vkFlushMappedMemoryRanges(SerialiserType &ser, VkD
   {
     if(!state->refData)
     {
-      // if we're in this case, the range should be for the whole memory region.
-      RDCASSERT(MemRange.offset == 0 && memRangeSize == state->mapSize);
+      // if we're in this case, the range should be for the whole mapped region.
+      RDCASSERT(MemRange.offset == state->mapOffset && memRangeSize == state->mapSize);
 
       // allocate ref data so we can compare next time to minimise serialised data
       state->refData = AllocAlignedBuffer((size_t)state->mapSize);
@@ -747,7 +747,9 @@ bool WrappedVulkan::Serialise_vkFlushMappedMemoryRanges(SerialiserType &ser, VkD
 
     const byte *serialisedData = ser.GetWriter()->GetData() + offs;
 
-    memcpy(state->refData, serialisedData, (size_t)memRangeSize);
+    // refData mirrors the mapped region, and each flushed range updates its own part of it
+    memcpy(state->refData + (size_t)(MemRange.offset - state->mapOffset), serialisedData,
+           (size_t)memRangeSize);
   }
 
   return true;
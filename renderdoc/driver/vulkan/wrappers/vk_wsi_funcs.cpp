@@ -413,6 +413,8 @@ bool WrappedVulkan::Serialise_vkCreateSwapchainKHR(SerialiserType &ser, VkDevice
 
       m_ImageLayouts[liveId].extent = iminfo.extent;
       m_ImageLayouts[liveId].format = iminfo.format;
+      m_ImageLayouts[liveId].layerCount = CreateInfo.imageArrayLayers;
+      m_ImageLayouts[liveId].levelCount = 1;
 
       m_ImageLayouts[liveId].subresourceStates.clear();
       m_ImageLayouts[liveId].subresourceStates.push_back(ImageRegionState(
@@ -548,6 +550,8 @@ void WrappedVulkan::WrapAndProcessCreatedSwapchain(VkDevice device,
         // fill out image info so we track resource state barriers
         {
           SCOPED_LOCK(m_ImageLayoutsLock);
+          m_ImageLayouts[imid].layerCount = pCreateInfo->imageArrayLayers;
+          m_ImageLayouts[imid].levelCount = 1;
           m_ImageLayouts[imid].subresourceStates.clear();
           m_ImageLayouts[imid].subresourceStates.push_back(ImageRegionState(
               VK_QUEUE_FAMILY_IGNORED, range, UNKNOWN_PREV_IMG_LAYOUT, VK_IMAGE_LAYOUT_UNDEFINED));
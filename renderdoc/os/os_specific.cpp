@@ -501,6 +501,64 @@ TEST_CASE("Test OS-specific functions", "[osspecific]")
     }
   };
 
+  SECTION("Joining with a timeout")
+  {
+    Threading::CriticalSection lock;
+    lock.Lock();
+
+    Threading::ThreadHandle th = Threading::CreateThread([&lock]() {
+      lock.Lock();
+      lock.Unlock();
+    });
+
+    // the thread can't finish while we hold the lock
+    CHECK_FALSE(Threading::JoinThread(th, 20));
+
+    lock.Unlock();
+
+    // platforms without a timed join never join, so finish the thread off normally there
+    if(!Threading::JoinThread(th, 5000))
+      Threading::JoinThread(th);
+    Threading::CloseThread(th);
+  };
+
+  SECTION("Freeing TLS slots")
+  {
+    static int32_t destructed = 0;
+    destructed = 0;
+
+    uint64_t slot = Threading::AllocateTLSSlot([](void *) { Atomic::Inc32(&destructed); });
+
+    Threading::CriticalSection lock;
+    lock.Lock();
+
+    void *value = NULL;
+    volatile int32_t ready = 0;
+
+    Threading::ThreadHandle th = Threading::CreateThread([&lock, &value, &ready, slot]() {
+      Threading::SetTLSValue(slot, &lock);
+      Atomic::Inc32(&ready);
+      lock.Lock();
+      value = Threading::GetTLSValue(slot);
+      lock.Unlock();
+    });
+
+    // wait for the thread to set its value
+    while(Atomic::CmpExch32(&ready, 1, 1) != 1)
+      Threading::Sleep(1);
+
+    Threading::FreeTLSSlot(slot);
+
+    lock.Unlock();
+
+    Threading::JoinThread(th);
+    Threading::CloseThread(th);
+
+    // the value was cleared and the destructor wasn't called on thread exit
+    CHECK(value == NULL);
+    CHECK(destructed == 0);
+  };
+
   SECTION("Atomics")
   {
     volatile int32_t value = 0;
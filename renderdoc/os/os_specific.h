@@ -131,21 +131,52 @@ public:
   data m_Data;
 };
 
+template <class data>
+class SemaphoreTemplate
+{
+public:
+  SemaphoreTemplate();
+  ~SemaphoreTemplate();
+
+  // blocks until the semaphore has been woken, consuming one wake
+  void WaitForWake();
+  // wakes up to numToWake waiting threads. Wakes with no waiters are kept for the next wait
+  void Wake(uint32_t numToWake);
+
+  // no copying
+  SemaphoreTemplate &operator=(const SemaphoreTemplate &other) = delete;
+  SemaphoreTemplate(const SemaphoreTemplate &other) = delete;
+
+  data m_Data;
+};
+
 void Init();
 void Shutdown();
-uint64_t AllocateTLSSlot();
+
+// called with a thread's value for a slot when the thread exits, if the value isn't NULL. Not called
+// for threads still running at Shutdown()
+typedef void (*TLSDestructor)(void *value);
+uint64_t AllocateTLSSlot(TLSDestructor destructor = NULL);
 
 void *GetTLSValue(uint64_t slot);
 void SetTLSValue(uint64_t slot, void *value);
+// clear the slot's value on every thread and drop its destructor, so nothing refers to the values
+// afterwards. The values themselves aren't freed and slots aren't reused
+void FreeTLSSlot(uint64_t slot);
 
-// must typedef CriticalSectionTemplate<X> CriticalSection
+// must typedef CriticalSectionTemplate<X> CriticalSection, RWLockTemplate<Y> RWLock and
+// SemaphoreTemplate<Z> Semaphore
 
 typedef uint64_t ThreadHandle;
 ThreadHandle CreateThread(std::function<void()> entryFunc);
 uint64_t GetCurrentID();
 void JoinThread(ThreadHandle handle);
+// as JoinThread, but gives up after the timeout. Returns true if the thread was joined. Where the
+// platform can't wait with a timeout this returns false straight away.
+bool JoinThread(ThreadHandle handle, uint32_t timeoutMilliseconds);
 void CloseThread(ThreadHandle handle);
 void Sleep(uint32_t milliseconds);
+uint32_t NumberOfCores();
 
 // kind of windows specific, to handle this case:
 // http://blogs.msdn.com/b/oldnewthing/archive/2013/11/05/10463645.aspx
@@ -173,6 +204,8 @@ public:
   bool IsRecvDataWaiting();
 
   bool SendDataBlocking(const void *buf, uint32_t length);
+  // sends part of a file, straight from the file to the socket where the OS supports it
+  bool SendFileBlocking(FILE *file, uint64_t offset, uint64_t length);
   bool RecvDataBlocking(void *data, uint32_t length);
   bool RecvDataNonBlocking(void *data, uint32_t &length);
 
@@ -250,6 +283,16 @@ class StackResolver
 public:
   virtual ~StackResolver() {}
   virtual AddressDetails GetAddr(uint64_t addr) = 0;
+
+  // resolve a whole callstack at once. Resolvers can override this to look up addresses in parallel
+  virtual rdcarray<AddressDetails> GetAddrs(const rdcarray<uint64_t> &addrs)
+  {
+    rdcarray<AddressDetails> ret;
+    ret.reserve(addrs.size());
+    for(uint64_t addr : addrs)
+      ret.push_back(GetAddr(addr));
+    return ret;
+  }
 };
 
 void Init();
@@ -309,6 +352,13 @@ bool feof(FILE *f);
 
 int fclose(FILE *f);
 
+// map a copy-on-write view of length bytes at offset in an open file, without disturbing the file
+// position. Writes through the view are private and never reach the file. Returns a pointer to the
+// data at offset, or NULL if the range can't be mapped in which case the file should be read
+// normally. The returned handle is passed to UnmapFileView to release the view.
+byte *MapFileView(FILE *f, uint64_t offset, uint64_t length, void *&handle);
+void UnmapFileView(void *handle);
+
 // functions for atomically appending to a log that may be in use in multiple
 // processes
 bool logfile_open(const char *filename);
@@ -22,16 +22,265 @@
  * THE SOFTWARE.
  ******************************************************************************/
 
+#include <cxxabi.h>
+#include <elf.h>
 #include <execinfo.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include <map>
 #include <vector>
+#include "3rdparty/miniz/miniz.h"
+#include "common/threading.h"
+#include "common/timing.h"
 #include "os/os_specific.h"
+#include "strings/string_utils.h"
 
 void *renderdocBase = NULL;
 void *renderdocEnd = NULL;
 
+// executable mappings in the process, used to sanity-check return addresses while walking frame
+// pointers. Sorted by base address, and re-read (at most once a second) when an address misses.
+static Threading::RWLock execRangesLock;
+static rdcarray<rdcpair<uintptr_t, uintptr_t>> execRanges;
+static uint64_t execRangesTimestamp = 0;
+
+// each thread's stack bounds, fetched the first time that thread collects a callstack
+static uint64_t stackLowSlot = 0;
+static uint64_t stackHighSlot = 0;
+
+static void ReadExecutableRanges()
+{
+  rdcarray<rdcpair<uintptr_t, uintptr_t>> ranges;
+
+  FILE *f = FileIO::fopen("/proc/self/maps", "r");
+
+  if(f)
+  {
+    while(!feof(f))
+    {
+      char line[512] = {0};
+      if(fgets(line, 511, f))
+      {
+        void *base = NULL, *end = NULL;
+        char perms[8] = {0};
+        if(sscanf(line, "%p-%p %7s", &base, &end, perms) == 3 && perms[2] == 'x')
+          ranges.push_back(make_rdcpair((uintptr_t)base, (uintptr_t)end));
+      }
+    }
+
+    FileIO::fclose(f);
+  }
+
+  std::sort(ranges.begin(), ranges.end());
+
+  SCOPED_WRITELOCK(execRangesLock);
+  execRanges.swap(ranges);
+  execRangesTimestamp = Timing::GetUnixTimestamp();
+}
+
+static bool IsExecutableAddress(uintptr_t addr)
+{
+  for(int attempt = 0; attempt < 2; attempt++)
+  {
+    {
+      SCOPED_READLOCK(execRangesLock);
+
+      auto it = std::upper_bound(
+          execRanges.begin(), execRanges.end(), addr,
+          [](uintptr_t a, const rdcpair<uintptr_t, uintptr_t> &r) { return a < r.first; });
+
+      if(it != execRanges.begin() && addr < (it - 1)->second)
+        return true;
+
+      // a module may have been loaded since we last looked, but don't re-read the maps for every
+      // bad address when walking through frames with no frame pointer.
+      if(attempt > 0 || Timing::GetUnixTimestamp() == execRangesTimestamp)
+        return false;
+    }
+
+    ReadExecutableRanges();
+  }
+
+  return false;
+}
+
+static void GetStackBounds(uintptr_t &low, uintptr_t &high)
+{
+  low = (uintptr_t)Threading::GetTLSValue(stackLowSlot);
+  high = (uintptr_t)Threading::GetTLSValue(stackHighSlot);
+
+  if(high != 0)
+    return;
+
+  pthread_attr_t attr;
+  if(pthread_getattr_np(pthread_self(), &attr) == 0)
+  {
+    void *addr = NULL;
+    size_t size = 0;
+    if(pthread_attr_getstack(&attr, &addr, &size) == 0)
+    {
+      low = (uintptr_t)addr;
+      high = low + size;
+    }
+    pthread_attr_destroy(&attr);
+  }
+
+  // if we couldn't get the bounds, store something non-zero so we don't keep trying. Every walk
+  // will then fall back to backtrace()
+  if(high == 0)
+    low = high = 1;
+
+  Threading::SetTLSValue(stackLowSlot, (void *)low);
+  Threading::SetTLSValue(stackHighSlot, (void *)high);
+}
+
+// the outermost frames of a thread - e.g. __libc_start_main and _start - are usually compiled
+// without frame pointers, so the frame pointer walk breaks just before the end of the stack. The
+// first time we see a break we fall back to backtrace(), and if only a few frames remained we
+// remember them to append on later walks. The same function can break the chain on different paths
+// to the root, so they're keyed by the last few frames of the walk and not just where it broke.
+static Threading::RWLock stackRootsLock;
+static std::map<uint64_t, rdcarray<void *>> stackRoots;
+
+// the most frames beyond a break that we'll consider to be the root of the stack
+static const int MaxStackRootFrames = 4;
+
+// how many frames up to and including the break must match to use a remembered root
+static const int StackRootKeyFrames = 4;
+
+static uint64_t StackRootKey(void *const *walked, int walkedCount)
+{
+  uint64_t key = 14695981039346656037ULL;
+  for(int i = walkedCount - 1; i >= 0 && i >= walkedCount - StackRootKeyFrames; i--)
+    key = (key ^ (uint64_t)(uintptr_t)walked[i]) * 1099511628211ULL;
+  return key;
+}
+
+static bool AppendStackRoot(void **addrs_ptr, int &count, int maxCount)
+{
+  SCOPED_READLOCK(stackRootsLock);
+
+  auto it = stackRoots.find(StackRootKey(addrs_ptr, count));
+  if(it == stackRoots.end() || count + it->second.count() > maxCount)
+    return false;
+
+  for(void *addr : it->second)
+    addrs_ptr[count++] = addr;
+
+  return true;
+}
+
+static void LearnStackRoot(void *const *walked, int walkedCount, void *const *full, int fullCount)
+{
+  // find where the walk broke in the full callstack, and check that the frames leading up to it
+  // agree - these are the frames the root is keyed on. The innermost frames are our own and differ
+  // between the two, so the check stops there.
+  void *breakAddr = walked[walkedCount - 1];
+
+  for(int i = fullCount - 1; i >= 0 && i >= fullCount - 1 - MaxStackRootFrames; i--)
+  {
+    if(full[i] != breakAddr)
+      continue;
+
+    for(int m = 1; m < StackRootKeyFrames && m < walkedCount; m++)
+      if(m > i || walked[walkedCount - 1 - m] != full[i - m])
+        return;
+
+    rdcarray<void *> root(full + i + 1, fullCount - 1 - i);
+
+    SCOPED_WRITELOCK(stackRootsLock);
+    stackRoots[StackRootKey(walked, walkedCount)] = root;
+    return;
+  }
+}
+
+// the frame pointer chain only leads to a return address's caller if the function it returns into
+// set up a frame pointer. One compiled without leaves its caller's frame pointer in place, so
+// following the chain past it would silently skip its caller. Whether a function has set one up at
+// a given address is checked against its unwind info, and cached per return address.
+static Threading::RWLock framePointerReturnsLock;
+static std::map<uintptr_t, bool> framePointerReturns;
+
+// defined with the DWARF parsing below
+namespace Callstack
+{
+static bool UsesFramePointerAt(uintptr_t pc);
+};
+
+static bool ReturnsToFramePointerFrame(uintptr_t ret)
+{
+  {
+    SCOPED_READLOCK(framePointerReturnsLock);
+    auto it = framePointerReturns.find(ret);
+    if(it != framePointerReturns.end())
+      return it->second;
+  }
+
+  // the return address is just after the call, which may be the last instruction in the function
+  bool result = Callstack::UsesFramePointerAt(ret - 1);
+
+  SCOPED_WRITELOCK(framePointerReturnsLock);
+  framePointerReturns[ret] = result;
+  return result;
+}
+
+// walks the frame pointer chain, which is much cheaper than backtrace()'s unwinding via the unwind
+// tables. Returns false if the chain is broken - e.g. by a function compiled without frame pointers
+// - before it reaches the outermost frame. The frames up to and including the break are returned
+// either way.
+static __attribute__((noinline)) bool WalkFramePointers(void **addrs_ptr, int maxCount, int &count)
+{
+  count = 0;
+
+// only x86 keeps its frame pointer in the unwind info's CFA rule, which is what we validate against
+#if defined(__x86_64__) || defined(__i386__)
+  uintptr_t low = 0, high = 0;
+  GetStackBounds(low, high);
+
+  // frame pointers point at the saved previous frame pointer, followed by the return address
+  const uintptr_t *fp = (const uintptr_t *)__builtin_frame_address(0);
+
+  while(count < maxCount)
+  {
+    uintptr_t cur = (uintptr_t)fp;
+
+    if(cur < low || cur + 2 * sizeof(uintptr_t) > high || (cur % sizeof(uintptr_t)) != 0)
+      return false;
+
+    uintptr_t ret = fp[1];
+    uintptr_t next = fp[0];
+
+    if(ret == 0)
+      return next == 0;
+
+    if(!IsExecutableAddress(ret))
+      return false;
+
+    addrs_ptr[count++] = (void *)ret;
+
+    // the return address itself is right, but the saved frame pointer isn't the caller's
+    if(!ReturnsToFramePointerFrame(ret))
+      return false;
+
+    // the outermost frame has a NULL frame pointer
+    if(next == 0)
+      return true;
+
+    // stacks grow down, so each caller's frame must be above its callee's
+    if(next <= cur)
+      return false;
+
+    fp = (const uintptr_t *)next;
+  }
+
+  return true;
+#else
+  return false;
+#endif
+}
+
 class LinuxCallstack : public Callstack::Stackwalk
 {
 public:
@@ -59,7 +308,22 @@ private:
   {
     void *addrs_ptr[ARRAY_COUNT(addrs)];
 
-    numLevels = backtrace(addrs_ptr, ARRAY_COUNT(addrs));
+    bool complete = WalkFramePointers(addrs_ptr, ARRAY_COUNT(addrs), numLevels);
+
+    if(!complete && numLevels > 0)
+      complete = AppendStackRoot(addrs_ptr, numLevels, ARRAY_COUNT(addrs));
+
+    if(!complete)
+    {
+      void *walked[ARRAY_COUNT(addrs)];
+      int walkedCount = numLevels;
+      memcpy(walked, addrs_ptr, walkedCount * sizeof(void *));
+
+      numLevels = backtrace(addrs_ptr, ARRAY_COUNT(addrs));
+
+      if(walkedCount > 0)
+        LearnStackRoot(walked, walkedCount, addrs_ptr, numLevels);
+    }
 
     int offs = 0;
     // if we want to trim levels of the stack, we can do that here
@@ -82,6 +346,11 @@ namespace Callstack
 {
 void Init()
 {
+  stackLowSlot = Threading::AllocateTLSSlot();
+  stackHighSlot = Threading::AllocateTLSSlot();
+
+  ReadExecutableRanges();
+
   // look for our own line
   FILE *f = FileIO::fopen("/proc/self/maps", "r");
 
@@ -148,164 +417,1333 @@ struct LookupModule
   char path[2048];
 };
 
-class LinuxResolver : public Callstack::StackResolver
+// symbol and line information for one module, parsed once from its ELF file (or the separate
+// debug file it links to) the first time an address in the module is resolved.
+struct ModuleSymbols
+{
+  struct Segment
+  {
+    uint64_t offset;
+    uint64_t vaddr;
+    uint64_t size;
+  };
+
+  struct Symbol
+  {
+    uint64_t addr;
+    uint64_t size;
+    uint32_t name;
+  };
+
+  struct LineRow
+  {
+    uint64_t addr;
+    uint32_t file;
+    // 0 marks the end of a sequence, with no line information until the next row
+    uint32_t line;
+  };
+
+  Threading::CriticalSection lock;
+  bool loaded = false;
+
+  std::vector<Segment> segments;
+  std::vector<Symbol> symbols;
+  std::vector<char> names;
+  std::vector<LineRow> lines;
+  std::vector<string> files;
+};
+
+// minimal ELF reader, only enough to find and read sections and the loadable segments. We only
+// support little-endian files, matching all the architectures we capture on.
+class ElfReader
 {
 public:
-  LinuxResolver(vector<LookupModule> modules) { m_Modules = modules; }
-  Callstack::AddressDetails GetAddr(uint64_t addr)
+  struct Section
+  {
+    string name;
+    uint32_t type;
+    uint64_t flags;
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  ElfReader(const char *path)
   {
-    EnsureCached(addr);
+    m_File = FileIO::fopen(path, "rb");
 
-    return m_Cache[addr];
+    unsigned char ident[EI_NIDENT];
+    if(m_File == NULL || !Read(0, ident, EI_NIDENT) || memcmp(ident, ELFMAG, SELFMAG) != 0 ||
+       ident[EI_DATA] != ELFDATA2LSB)
+      return;
+
+    m_64 = (ident[EI_CLASS] == ELFCLASS64);
+
+    if(m_64)
+      m_Valid = ReadHeaders<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr>();
+    else
+      m_Valid = ReadHeaders<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr>();
   }
 
-private:
-  void EnsureCached(uint64_t addr)
+  ~ElfReader()
   {
-    auto it = m_Cache.insert(
-        std::pair<uint64_t, Callstack::AddressDetails>(addr, Callstack::AddressDetails()));
-    if(!it.second)
-      return;
+    if(m_File)
+      FileIO::fclose(m_File);
+  }
 
-    Callstack::AddressDetails &ret = it.first->second;
+  bool IsValid() const { return m_Valid; }
+  bool Is64() const { return m_64; }
+  const std::vector<ModuleSymbols::Segment> &GetSegments() const { return m_Segments; }
+  const Section *FindSection(const char *name) const
+  {
+    for(const Section &s : m_Sections)
+      if(s.name == name)
+        return &s;
 
-    ret.filename = "Unknown";
-    ret.line = 0;
-    ret.function = StringFormat::Fmt("0x%08llx", addr);
+    return NULL;
+  }
 
-    for(size_t i = 0; i < m_Modules.size(); i++)
+  bool ReadSection(const char *name, std::vector<byte> &data)
+  {
+    const Section *sec = FindSection(name);
+
+    data.clear();
+
+    if(sec == NULL || sec->type == SHT_NOBITS)
+      return false;
+
+    data.resize((size_t)sec->size);
+    if(!Read(sec->offset, data.data(), sec->size))
+      return false;
+
+    if(sec->flags & SHF_COMPRESSED)
     {
-      if(addr >= m_Modules[i].base && addr < m_Modules[i].end)
-      {
-        uint64_t relative = addr - m_Modules[i].base + m_Modules[i].offset;
-        string cmd = StringFormat::Fmt("addr2line -fCe \"%s\" 0x%llx", m_Modules[i].path, relative);
+      uint32_t type = 0;
+      uint64_t size = 0;
+      size_t headerSize = m_64 ? sizeof(Elf64_Chdr) : sizeof(Elf32_Chdr);
 
-        FILE *f = ::popen(cmd.c_str(), "r");
+      if(data.size() < headerSize)
+        return false;
 
-        char result[2048] = {0};
-        fread(result, 1, 2047, f);
+      if(m_64)
+      {
+        Elf64_Chdr chdr;
+        memcpy(&chdr, data.data(), sizeof(chdr));
+        type = chdr.ch_type;
+        size = chdr.ch_size;
+      }
+      else
+      {
+        Elf32_Chdr chdr;
+        memcpy(&chdr, data.data(), sizeof(chdr));
+        type = chdr.ch_type;
+        size = chdr.ch_size;
+      }
 
-        fclose(f);
+      if(type != ELFCOMPRESS_ZLIB)
+        return false;
 
-        char *line2 = strchr(result, '\n');
-        if(line2)
-        {
-          *line2 = 0;
-          line2++;
-        }
+      std::vector<byte> compressed;
+      compressed.swap(data);
+      data.resize((size_t)size);
 
-        ret.function = result;
+      mz_ulong decompressedSize = (mz_ulong)size;
+      if(mz_uncompress(data.data(), &decompressedSize, compressed.data() + headerSize,
+                       (mz_ulong)(compressed.size() - headerSize)) != MZ_OK ||
+         decompressedSize != size)
+      {
+        data.clear();
+        return false;
+      }
+    }
 
-        if(line2)
-        {
-          char *linenum = line2 + strlen(line2) - 1;
-          while(linenum > line2 && *linenum != ':')
-            linenum--;
+    return true;
+  }
 
-          ret.line = 0;
+private:
+  template <typename Ehdr, typename Shdr, typename Phdr>
+  bool ReadHeaders()
+  {
+    Ehdr ehdr;
+    if(!Read(0, &ehdr, sizeof(ehdr)) || ehdr.e_shentsize != sizeof(Shdr) ||
+       ehdr.e_shstrndx >= ehdr.e_shnum)
+      return false;
 
-          if(*linenum == ':')
-          {
-            *linenum = 0;
-            linenum++;
+    if(ehdr.e_phentsize == sizeof(Phdr))
+    {
+      std::vector<Phdr> phdrs(ehdr.e_phnum);
+      if(!Read(ehdr.e_phoff, phdrs.data(), sizeof(Phdr) * phdrs.size()))
+        return false;
 
-            while(*linenum >= '0' && *linenum <= '9')
-            {
-              ret.line *= 10;
-              ret.line += (uint32_t(*linenum) - uint32_t('0'));
-              linenum++;
-            }
-          }
+      for(const Phdr &p : phdrs)
+        if(p.p_type == PT_LOAD)
+          m_Segments.push_back({p.p_offset, p.p_vaddr, p.p_filesz});
+    }
 
-          ret.filename = line2;
-        }
+    std::vector<Shdr> shdrs(ehdr.e_shnum);
+    if(!Read(ehdr.e_shoff, shdrs.data(), sizeof(Shdr) * shdrs.size()))
+      return false;
 
-        break;
-      }
+    const Shdr &strtab = shdrs[ehdr.e_shstrndx];
+    std::vector<char> names((size_t)strtab.sh_size + 1, 0);
+    if(!Read(strtab.sh_offset, names.data(), strtab.sh_size))
+      return false;
+
+    for(const Shdr &s : shdrs)
+    {
+      Section sec;
+      sec.name = s.sh_name < strtab.sh_size ? &names[s.sh_name] : "";
+      sec.type = s.sh_type;
+      sec.flags = s.sh_flags;
+      sec.offset = s.sh_offset;
+      sec.size = s.sh_size;
+      m_Sections.push_back(sec);
     }
+
+    return true;
   }
 
-  std::vector<LookupModule> m_Modules;
-  std::map<uint64_t, Callstack::AddressDetails> m_Cache;
+  bool Read(uint64_t offset, void *dst, uint64_t size)
+  {
+    FileIO::fseek64(m_File, offset, SEEK_SET);
+    return FileIO::fread(dst, 1, (size_t)size, m_File) == size;
+  }
+
+  FILE *m_File = NULL;
+  bool m_Valid = false;
+  bool m_64 = false;
+  std::vector<Section> m_Sections;
+  std::vector<ModuleSymbols::Segment> m_Segments;
 };
 
-StackResolver *MakeResolver(byte *moduleDB, size_t DBSize, RENDERDOC_ProgressCallback progress)
+// bounds-checked cursor over DWARF data. Reading past the end sets the error flag and returns 0
+struct DwarfCursor
 {
-  // we look in the original locations for the files, we don't prompt if we can't
-  // find the file, or the file doesn't have symbols (and we don't validate that
-  // the file is the right version). A good option for doing this would be
-  // http://github.com/mlabbe/nativefiledialog
+  DwarfCursor(const byte *b, const byte *e) : cur(b), end(e) {}
+  template <typename T>
+  T Read()
+  {
+    T ret = T();
+    if(size_t(end - cur) < sizeof(T))
+    {
+      error = true;
+      cur = end;
+      return ret;
+    }
+    memcpy(&ret, cur, sizeof(T));
+    cur += sizeof(T);
+    return ret;
+  }
 
-  if(DBSize < 8 || memcmp(moduleDB, "LNUXCALL", 8))
+  uint64_t ReadULEB()
   {
-    RDCWARN("Can't load callstack resolve for this log. Possibly from another platform?");
-    return NULL;
+    uint64_t ret = 0;
+    uint32_t shift = 0;
+    byte b = 0x80;
+    while(b & 0x80)
+    {
+      b = Read<byte>();
+      if(shift < 64)
+        ret |= uint64_t(b & 0x7f) << shift;
+      shift += 7;
+    }
+    return ret;
   }
 
-  char *start = (char *)(moduleDB + 8);
-  char *search = start;
-  char *dbend = (char *)(moduleDB + DBSize);
+  int64_t ReadSLEB()
+  {
+    int64_t ret = 0;
+    uint32_t shift = 0;
+    byte b = 0x80;
+    while(b & 0x80)
+    {
+      b = Read<byte>();
+      if(shift < 64)
+        ret |= int64_t(b & 0x7f) << shift;
+      shift += 7;
+    }
+    if(shift < 64 && (b & 0x40))
+      ret |= -(int64_t(1) << shift);
+    return ret;
+  }
 
-  vector<LookupModule> modules;
+  const char *ReadString()
+  {
+    const char *ret = (const char *)cur;
+    const byte *nul = (const byte *)memchr(cur, 0, end - cur);
+    if(nul == NULL)
+    {
+      error = true;
+      cur = end;
+      return "";
+    }
+    cur = nul + 1;
+    return ret;
+  }
 
-  while(search && search < dbend)
+  uint64_t ReadSized(uint64_t size)
   {
-    if(progress)
-      progress(float(search - start) / float(DBSize));
+    switch(size)
+    {
+      case 1: return Read<uint8_t>();
+      case 2: return Read<uint16_t>();
+      case 4: return Read<uint32_t>();
+      case 8: return Read<uint64_t>();
+      default: Skip(size); return 0;
+    }
+  }
 
-    // find .text segments
+  void Skip(uint64_t size)
+  {
+    if(uint64_t(end - cur) < size)
     {
-      long unsigned int base = 0, end = 0, offset = 0;
+      error = true;
+      cur = end;
+      return;
+    }
+    cur += size;
+  }
 
-      int inode = 0;
-      int offs = 0;
-      //                        base-end   perms offset devid   inode offs
-      int num = sscanf(search, "%lx-%lx  r-xp  %lx    %*x:%*x %d    %n", &base, &end, &offset,
-                       &inode, &offs);
+  const byte *cur;
+  const byte *end;
+  bool error = false;
+};
 
-      // we don't care about inode actually, we ust use it to verify that
-      // we read all 4 params (and so perms == r-xp)
-      if(num == 4 && offs > 0)
-      {
-        LookupModule mod = {0};
+enum
+{
+  DW_LNS_copy = 1,
+  DW_LNS_advance_pc = 2,
+  DW_LNS_advance_line = 3,
+  DW_LNS_set_file = 4,
+  DW_LNS_const_add_pc = 8,
+  DW_LNS_fixed_advance_pc = 9,
 
-        mod.base = (uint64_t)base;
-        mod.end = (uint64_t)end;
-        mod.offset = (uint64_t)offset;
+  DW_LNE_end_sequence = 1,
+  DW_LNE_set_address = 2,
+  DW_LNE_define_file = 3,
 
-        search += offs;
-        while(search < dbend && (*search == ' ' || *search == '\t'))
-          search++;
+  DW_LNCT_path = 1,
+  DW_LNCT_directory_index = 2,
 
-        if(search < dbend && *search != '[' && *search != 0 && *search != '\n')
-        {
-          size_t n = ARRAY_COUNT(mod.path) - 1;
-          mod.path[n] = 0;
-          for(size_t i = 0; i < n; i++)
-          {
-            if(search[i] == 0 || search[i] == '\n')
-            {
-              mod.path[i] = 0;
-              break;
-            }
-            if(search + i >= dbend)
-            {
-              mod.path[i] = 0;
-              break;
-            }
-            mod.path[i] = search[i];
-          }
+  DW_FORM_block2 = 0x03,
+  DW_FORM_block4 = 0x04,
+  DW_FORM_data2 = 0x05,
+  DW_FORM_data4 = 0x06,
+  DW_FORM_data8 = 0x07,
+  DW_FORM_string = 0x08,
+  DW_FORM_block = 0x09,
+  DW_FORM_block1 = 0x0a,
+  DW_FORM_data1 = 0x0b,
+  DW_FORM_sdata = 0x0d,
+  DW_FORM_strp = 0x0e,
+  DW_FORM_udata = 0x0f,
+  DW_FORM_strx = 0x1a,
+  DW_FORM_data16 = 0x1e,
+  DW_FORM_line_strp = 0x1f,
+  DW_FORM_strx1 = 0x25,
+  DW_FORM_strx2 = 0x26,
+  DW_FORM_strx3 = 0x27,
+  DW_FORM_strx4 = 0x28,
+};
 
-          modules.push_back(mod);
-        }
-      }
-    }
+enum
+{
+  DW_EH_PE_absptr = 0x00,
+  DW_EH_PE_uleb128 = 0x01,
+  DW_EH_PE_udata2 = 0x02,
+  DW_EH_PE_udata4 = 0x03,
+  DW_EH_PE_udata8 = 0x04,
+  DW_EH_PE_sleb128 = 0x09,
+  DW_EH_PE_sdata2 = 0x0a,
+  DW_EH_PE_sdata4 = 0x0b,
+  DW_EH_PE_sdata8 = 0x0c,
+  DW_EH_PE_omit = 0xff,
 
-    if(progress)
-      progress(RDCMIN(1.0f, float(search - start) / float(DBSize)));
+  DW_CFA_advance_loc = 0x40,
+  DW_CFA_offset = 0x80,
+  DW_CFA_restore = 0xc0,
+  DW_CFA_nop = 0x00,
+  DW_CFA_set_loc = 0x01,
+  DW_CFA_advance_loc1 = 0x02,
+  DW_CFA_advance_loc2 = 0x03,
+  DW_CFA_advance_loc4 = 0x04,
+  DW_CFA_offset_extended = 0x05,
+  DW_CFA_restore_extended = 0x06,
+  DW_CFA_undefined = 0x07,
+  DW_CFA_same_value = 0x08,
+  DW_CFA_register = 0x09,
+  DW_CFA_remember_state = 0x0a,
+  DW_CFA_restore_state = 0x0b,
+  DW_CFA_def_cfa = 0x0c,
+  DW_CFA_def_cfa_register = 0x0d,
+  DW_CFA_def_cfa_offset = 0x0e,
+  DW_CFA_def_cfa_expression = 0x0f,
+  DW_CFA_expression = 0x10,
+  DW_CFA_offset_extended_sf = 0x11,
+  DW_CFA_def_cfa_sf = 0x12,
+  DW_CFA_def_cfa_offset_sf = 0x13,
+  DW_CFA_val_offset = 0x14,
+  DW_CFA_val_offset_sf = 0x15,
+  DW_CFA_val_expression = 0x16,
+  DW_CFA_GNU_args_size = 0x2e,
+  DW_CFA_GNU_negative_offset_extended = 0x2f,
+};
 
-    if(search >= dbend)
-      break;
+// libgcc's lookup of the FDE covering an address in any loaded module, the same one its unwinder
+// (and so backtrace()) uses
+struct UnwindEHBases
+{
+  void *tbase;
+  void *dbase;
+  void *func;
+};
+
+extern "C" const void *_Unwind_Find_FDE(void *pc, UnwindEHBases *bases);
+
+static void SkipEncodedPointer(DwarfCursor &cursor, uint8_t encoding)
+{
+  if(encoding == DW_EH_PE_omit)
+    return;
+
+  switch(encoding & 0x0f)
+  {
+    case DW_EH_PE_absptr: cursor.Skip(sizeof(uintptr_t)); break;
+    case DW_EH_PE_uleb128: cursor.ReadULEB(); break;
+    case DW_EH_PE_sleb128: cursor.ReadSLEB(); break;
+    case DW_EH_PE_udata2:
+    case DW_EH_PE_sdata2: cursor.Skip(2); break;
+    case DW_EH_PE_udata4:
+    case DW_EH_PE_sdata4: cursor.Skip(4); break;
+    case DW_EH_PE_udata8:
+    case DW_EH_PE_sdata8: cursor.Skip(8); break;
+    default: cursor.error = true; break;
+  }
+}
+
+// a cursor over a CIE or FDE's contents, after its length. The entry is in loaded memory so the
+// length is all that bounds it.
+static DwarfCursor CFIEntry(const byte *entry)
+{
+  uint32_t length = 0;
+  memcpy(&length, entry, sizeof(length));
+  entry += sizeof(length);
+
+  uint64_t extendedLength = length;
+  if(length == 0xffffffff)
+  {
+    memcpy(&extendedLength, entry, sizeof(extendedLength));
+    entry += sizeof(extendedLength);
+  }
+
+  return DwarfCursor(entry, entry + extendedLength);
+}
+
+// runs call frame instructions until the location passes target, tracking only which register the
+// CFA is defined relative to. Returns false if the instructions can't be followed, otherwise loc is
+// past target if the instructions stopped early.
+static bool RunCallFrameInstructions(DwarfCursor cursor, uint64_t codeAlign, uintptr_t target,
+                                     uintptr_t &loc, uint64_t &cfaReg, std::vector<uint64_t> &stack)
+{
+  const uint64_t cfaExpression = ~0ULL;
+
+  while(!cursor.error && cursor.cur < cursor.end)
+  {
+    uint8_t op = cursor.Read<uint8_t>();
+    uint64_t advance = 0;
+
+    switch(op & 0xc0)
+    {
+      case DW_CFA_advance_loc: advance = op & 0x3f; break;
+      case DW_CFA_offset: cursor.ReadULEB(); continue;
+      case DW_CFA_restore: continue;
+      default: break;
+    }
+
+    switch(op)
+    {
+      case DW_CFA_nop: break;
+      case DW_CFA_remember_state: stack.push_back(cfaReg); break;
+      case DW_CFA_restore_state:
+        if(stack.empty())
+          return false;
+        cfaReg = stack.back();
+        stack.pop_back();
+        break;
+      // the address would need decoding, and compilers don't emit it
+      case DW_CFA_set_loc: return false;
+      case DW_CFA_advance_loc1: advance = cursor.Read<uint8_t>(); break;
+      case DW_CFA_advance_loc2: advance = cursor.Read<uint16_t>(); break;
+      case DW_CFA_advance_loc4: advance = cursor.Read<uint32_t>(); break;
+      case DW_CFA_restore_extended:
+      case DW_CFA_undefined:
+      case DW_CFA_same_value:
+      case DW_CFA_def_cfa_offset:
+      case DW_CFA_GNU_args_size: cursor.ReadULEB(); break;
+      case DW_CFA_def_cfa_offset_sf: cursor.ReadSLEB(); break;
+      case DW_CFA_offset_extended:
+      case DW_CFA_register:
+      case DW_CFA_val_offset:
+      case DW_CFA_GNU_negative_offset_extended:
+        cursor.ReadULEB();
+        cursor.ReadULEB();
+        break;
+      case DW_CFA_offset_extended_sf:
+      case DW_CFA_val_offset_sf:
+        cursor.ReadULEB();
+        cursor.ReadSLEB();
+        break;
+      case DW_CFA_def_cfa:
+        cfaReg = cursor.ReadULEB();
+        cursor.ReadULEB();
+        break;
+      case DW_CFA_def_cfa_sf:
+        cfaReg = cursor.ReadULEB();
+        cursor.ReadSLEB();
+        break;
+      case DW_CFA_def_cfa_register: cfaReg = cursor.ReadULEB(); break;
+      case DW_CFA_def_cfa_expression:
+        cfaReg = cfaExpression;
+        cursor.Skip(cursor.ReadULEB());
+        break;
+      case DW_CFA_expression:
+      case DW_CFA_val_expression:
+        cursor.ReadULEB();
+        cursor.Skip(cursor.ReadULEB());
+        break;
+      default:
+        // the advance_loc form was handled above, anything else we don't know the operands of
+        if((op & 0xc0) != DW_CFA_advance_loc)
+          return false;
+        break;
+    }
+
+    if(advance > 0)
+    {
+      loc += uintptr_t(advance * codeAlign);
+      if(loc > target)
+        return true;
+    }
+  }
+
+  return !cursor.error;
+}
+
+// with a frame pointer set up the CFA is defined relative to it, otherwise it's relative to the stack
+// pointer. Only x86 is handled, elsewhere (e.g. on aarch64) the CFA stays relative to the stack
+// pointer even in functions with frame pointers.
+static bool UsesFramePointerAt(uintptr_t pc)
+{
+#if defined(__x86_64__)
+  const uint64_t framePointerReg = 6;
+#elif defined(__i386__)
+  const uint64_t framePointerReg = 5;
+#else
+  const uint64_t framePointerReg = ~0ULL;
+#endif
+
+  UnwindEHBases bases = {};
+  const byte *fde = (const byte *)_Unwind_Find_FDE((void *)pc, &bases);
+
+  if(fde == NULL || framePointerReg == ~0ULL)
+    return false;
+
+  DwarfCursor fdeCursor = CFIEntry(fde);
+
+  // the CIE pointer is relative to itself
+  const byte *ciePointer = fdeCursor.cur;
+  const byte *cie = ciePointer - fdeCursor.Read<uint32_t>();
+
+  DwarfCursor cieCursor = CFIEntry(cie);
+
+  if(cieCursor.Read<uint32_t>() != 0)
+    return false;
+
+  uint8_t version = cieCursor.Read<uint8_t>();
+  const char *augmentation = cieCursor.ReadString();
+  uint64_t codeAlign = cieCursor.ReadULEB();
+  cieCursor.ReadSLEB();
+  if(version == 1)
+    cieCursor.Read<uint8_t>();
+  else
+    cieCursor.ReadULEB();
+
+  uint8_t fdeEncoding = DW_EH_PE_absptr;
+
+  if(augmentation[0] == 'z')
+  {
+    uint64_t augmentationLength = cieCursor.ReadULEB();
+    const byte *augmentationEnd = cieCursor.cur + augmentationLength;
+
+    for(const char *a = augmentation + 1; *a; a++)
+    {
+      if(*a == 'R')
+      {
+        fdeEncoding = cieCursor.Read<uint8_t>();
+      }
+      else if(*a == 'L')
+      {
+        cieCursor.Read<uint8_t>();
+      }
+      else if(*a == 'P')
+      {
+        uint8_t encoding = cieCursor.Read<uint8_t>();
+        SkipEncodedPointer(cieCursor, encoding);
+      }
+      else if(*a != 'S' && *a != 'B')
+      {
+        break;
+      }
+    }
+
+    cieCursor.cur = augmentationEnd;
+  }
+  else if(augmentation[0] != 0)
+  {
+    return false;
+  }
+
+  // skip the FDE's address range, we know it covers pc and bases.func is where it starts
+  SkipEncodedPointer(fdeCursor, fdeEncoding);
+  SkipEncodedPointer(fdeCursor, fdeEncoding & 0x0f);
+  if(augmentation[0] == 'z')
+    fdeCursor.Skip(fdeCursor.ReadULEB());
+
+  if(cieCursor.error || cieCursor.cur > cieCursor.end || fdeCursor.error)
+    return false;
+
+  uintptr_t loc = (uintptr_t)bases.func;
+  uint64_t cfaReg = ~0ULL;
+  std::vector<uint64_t> stack;
+
+  if(!RunCallFrameInstructions(cieCursor, codeAlign, pc, loc, cfaReg, stack))
+    return false;
+
+  if(loc <= pc && !RunCallFrameInstructions(fdeCursor, codeAlign, pc, loc, cfaReg, stack))
+    return false;
+
+  return cfaReg == framePointerReg;
+}
+
+static const char *LookupString(const std::vector<byte> &strings, uint64_t offset)
+{
+  if(offset >= strings.size() || memchr(&strings[(size_t)offset], 0, strings.size() - offset) == NULL)
+    return NULL;
+  return (const char *)&strings[(size_t)offset];
+}
+
+// read one attribute of a DWARF 5 directory or file entry. Returns false on forms we can't skip
+static bool ReadEntryAttribute(DwarfCursor &cursor, uint64_t form, bool dwarf64,
+                               const std::vector<byte> &lineStrings,
+                               const std::vector<byte> &strings, const char *&str, uint64_t &value)
+{
+  const uint64_t offsetSize = dwarf64 ? 8 : 4;
+
+  switch(form)
+  {
+    case DW_FORM_string: str = cursor.ReadString(); break;
+    case DW_FORM_line_strp: str = LookupString(lineStrings, cursor.ReadSized(offsetSize)); break;
+    case DW_FORM_strp: str = LookupString(strings, cursor.ReadSized(offsetSize)); break;
+    case DW_FORM_udata: value = cursor.ReadULEB(); break;
+    case DW_FORM_sdata: value = (uint64_t)cursor.ReadSLEB(); break;
+    case DW_FORM_data1: value = cursor.ReadSized(1); break;
+    case DW_FORM_data2: value = cursor.ReadSized(2); break;
+    case DW_FORM_data4: value = cursor.ReadSized(4); break;
+    case DW_FORM_data8: value = cursor.ReadSized(8); break;
+    case DW_FORM_data16: cursor.Skip(16); break;
+    case DW_FORM_block: cursor.Skip(cursor.ReadULEB()); break;
+    case DW_FORM_block1: cursor.Skip(cursor.ReadSized(1)); break;
+    case DW_FORM_block2: cursor.Skip(cursor.ReadSized(2)); break;
+    case DW_FORM_block4: cursor.Skip(cursor.ReadSized(4)); break;
+    // string offsets need .debug_str_offsets and the unit's base, which line tables don't have
+    case DW_FORM_strx: cursor.ReadULEB(); break;
+    case DW_FORM_strx1: cursor.Skip(1); break;
+    case DW_FORM_strx2: cursor.Skip(2); break;
+    case DW_FORM_strx3: cursor.Skip(3); break;
+    case DW_FORM_strx4: cursor.Skip(4); break;
+    default: return false;
+  }
+
+  return !cursor.error;
+}
+
+static string JoinPath(const char *dir, const char *name)
+{
+  if(name[0] == '/' || dir == NULL || dir[0] == 0)
+    return name;
+
+  string ret = dir;
+  if(ret.back() != '/')
+    ret += '/';
+  return ret + name;
+}
+
+// parse every line number program in .debug_line, appending rows for each sequence
+static void ParseLineTables(const std::vector<byte> &debugLine, const std::vector<byte> &lineStrings,
+                            const std::vector<byte> &strings, uint8_t defaultAddressSize,
+                            ModuleSymbols &mod)
+{
+  std::map<string, uint32_t> fileIDs;
+  std::vector<ModuleSymbols::LineRow> sequence;
+
+  // file 0 is reserved for unknown files
+  mod.files.push_back("??");
+
+  DwarfCursor units(debugLine.data(), debugLine.data() + debugLine.size());
+
+  while(!units.error && units.cur < units.end)
+  {
+    bool dwarf64 = false;
+    uint64_t unitLength = units.Read<uint32_t>();
+    if(unitLength == 0xffffffff)
+    {
+      dwarf64 = true;
+      unitLength = units.Read<uint64_t>();
+    }
+
+    if(units.error || unitLength > uint64_t(units.end - units.cur))
+      break;
+
+    DwarfCursor cursor(units.cur, units.cur + unitLength);
+    units.cur += unitLength;
+
+    uint16_t version = cursor.Read<uint16_t>();
+    if(version < 2 || version > 5)
+      continue;
+
+    uint8_t addressSize = defaultAddressSize;
+    if(version >= 5)
+    {
+      addressSize = cursor.Read<uint8_t>();
+      cursor.Read<uint8_t>();    // segment selector size
+    }
+
+    uint64_t headerLength = cursor.ReadSized(dwarf64 ? 8 : 4);
+    if(cursor.error || headerLength > uint64_t(cursor.end - cursor.cur))
+      continue;
+
+    const byte *program = cursor.cur + headerLength;
+
+    uint8_t minInstLength = cursor.Read<uint8_t>();
+    if(version >= 4)
+      cursor.Read<uint8_t>();    // maximum operations per instruction, only used for VLIW
+    uint8_t defaultIsStmt = cursor.Read<uint8_t>();
+    (void)defaultIsStmt;
+    int8_t lineBase = cursor.Read<int8_t>();
+    uint8_t lineRange = cursor.Read<uint8_t>();
+    uint8_t opcodeBase = cursor.Read<uint8_t>();
+
+    if(cursor.error || lineRange == 0 || opcodeBase == 0)
+      continue;
+
+    std::vector<uint8_t> opcodeLengths(opcodeBase);
+    for(uint8_t i = 1; i < opcodeBase; i++)
+      opcodeLengths[i] = cursor.Read<uint8_t>();
+
+    std::vector<const char *> dirs;
+    // maps this unit's file indices to our de-duplicated file IDs
+    std::vector<uint32_t> files;
+
+    auto addFile = [&](const char *dir, const char *name) {
+      string path = name ? JoinPath(dir, name) : "??";
+      auto it = fileIDs.insert(std::make_pair(path, (uint32_t)mod.files.size()));
+      if(it.second)
+        mod.files.push_back(path);
+      files.push_back(it.first->second);
+    };
+
+    if(version >= 5)
+    {
+      bool valid = true;
+
+      // directories then files, each a list of entries described by (content type, form) pairs
+      for(int list = 0; list < 2 && valid; list++)
+      {
+        uint8_t formatCount = cursor.Read<uint8_t>();
+        std::vector<rdcpair<uint64_t, uint64_t>> formats;
+        for(uint8_t f = 0; f < formatCount; f++)
+        {
+          uint64_t contentType = cursor.ReadULEB();
+          uint64_t form = cursor.ReadULEB();
+          formats.push_back(make_rdcpair(contentType, form));
+        }
+
+        uint64_t count = cursor.ReadULEB();
+        for(uint64_t e = 0; e < count && valid && !cursor.error; e++)
+        {
+          const char *path = NULL;
+          uint64_t dirIndex = 0;
+
+          for(const rdcpair<uint64_t, uint64_t> &fmt : formats)
+          {
+            const char *str = NULL;
+            uint64_t value = 0;
+            valid = ReadEntryAttribute(cursor, fmt.second, dwarf64, lineStrings, strings, str, value);
+            if(!valid)
+              break;
+
+            if(fmt.first == DW_LNCT_path)
+              path = str;
+            else if(fmt.first == DW_LNCT_directory_index)
+              dirIndex = value;
+          }
+
+          if(list == 0)
+            dirs.push_back(path);
+          else
+            addFile(dirIndex < dirs.size() ? dirs[(size_t)dirIndex] : NULL, path);
+        }
+      }
+
+      if(!valid || cursor.error)
+        continue;
+    }
+    else
+    {
+      // directory and file 0 are implicitly the compilation directory and primary source file,
+      // which only .debug_info knows. Files are 1-based so we add a placeholder
+      dirs.push_back(NULL);
+      files.push_back(0);
+
+      for(const char *dir = cursor.ReadString(); dir[0] && !cursor.error; dir = cursor.ReadString())
+        dirs.push_back(dir);
+
+      for(const char *name = cursor.ReadString(); name[0] && !cursor.error;
+          name = cursor.ReadString())
+      {
+        uint64_t dirIndex = cursor.ReadULEB();
+        cursor.ReadULEB();    // modification time
+        cursor.ReadULEB();    // file length
+        addFile(dirIndex < dirs.size() ? dirs[(size_t)dirIndex] : NULL, name);
+      }
+
+      if(cursor.error)
+        continue;
+    }
+
+    cursor.cur = program;
+
+    uint64_t address = 0;
+    uint64_t file = 1;
+    int64_t line = 1;
+
+    auto emitRow = [&]() {
+      ModuleSymbols::LineRow row;
+      row.addr = address;
+      row.file = file < files.size() ? files[(size_t)file] : 0;
+      row.line = line > 0 ? uint32_t(line) : 0;
+      sequence.push_back(row);
+    };
+
+    while(!cursor.error && cursor.cur < cursor.end)
+    {
+      uint8_t opcode = cursor.Read<uint8_t>();
+
+      if(opcode >= opcodeBase)
+      {
+        uint8_t adjusted = opcode - opcodeBase;
+        address += (adjusted / lineRange) * minInstLength;
+        line += lineBase + (adjusted % lineRange);
+        emitRow();
+      }
+      else if(opcode == 0)
+      {
+        uint64_t length = cursor.ReadULEB();
+        if(length == 0 || length > uint64_t(cursor.end - cursor.cur))
+          break;
+
+        const byte *next = cursor.cur + length;
+        uint8_t extended = cursor.Read<uint8_t>();
+
+        if(extended == DW_LNE_end_sequence)
+        {
+          emitRow();
+          sequence.back().line = 0;
+
+          // sequences for functions discarded at link time are left at address 0
+          if(sequence.front().addr != 0)
+            mod.lines.insert(mod.lines.end(), sequence.begin(), sequence.end());
+
+          sequence.clear();
+          address = 0;
+          file = 1;
+          line = 1;
+        }
+        else if(extended == DW_LNE_set_address)
+        {
+          address = cursor.ReadSized(RDCMIN(uint64_t(addressSize), length - 1));
+        }
+        else if(extended == DW_LNE_define_file)
+        {
+          const char *name = cursor.ReadString();
+          uint64_t dirIndex = cursor.ReadULEB();
+          addFile(dirIndex < dirs.size() ? dirs[(size_t)dirIndex] : NULL, name);
+        }
+
+        cursor.cur = next;
+      }
+      else
+      {
+        switch(opcode)
+        {
+          case DW_LNS_copy: emitRow(); break;
+          case DW_LNS_advance_pc: address += cursor.ReadULEB() * minInstLength; break;
+          case DW_LNS_advance_line: line += cursor.ReadSLEB(); break;
+          case DW_LNS_set_file: file = cursor.ReadULEB(); break;
+          case DW_LNS_const_add_pc:
+            address += ((255 - opcodeBase) / lineRange) * minInstLength;
+            break;
+          case DW_LNS_fixed_advance_pc: address += cursor.Read<uint16_t>(); break;
+          default:
+            // skip the operands of any other standard opcode, we don't need them
+            for(uint8_t i = 0; i < opcodeLengths[opcode]; i++)
+              cursor.ReadULEB();
+            break;
+        }
+      }
+    }
+
+    // discard any unterminated sequence
+    sequence.clear();
+  }
+}
+
+template <typename Sym>
+static void AddSymbols(const std::vector<byte> &symtab, const std::vector<byte> &strtab,
+                       ModuleSymbols &mod)
+{
+  uint32_t nameBase = (uint32_t)mod.names.size();
+  mod.names.insert(mod.names.end(), strtab.begin(), strtab.end());
+  mod.names.push_back(0);
+
+  const Sym *syms = (const Sym *)symtab.data();
+  size_t count = symtab.size() / sizeof(Sym);
+
+  for(size_t i = 0; i < count; i++)
+  {
+    uint8_t type = ELF64_ST_TYPE(syms[i].st_info);
+
+    if((type != STT_FUNC && type != STT_GNU_IFUNC) || syms[i].st_shndx == SHN_UNDEF ||
+       syms[i].st_value == 0 || syms[i].st_name >= strtab.size())
+      continue;
+
+    mod.symbols.push_back({syms[i].st_value, syms[i].st_size, nameBase + syms[i].st_name});
+  }
+}
+
+static bool LoadSymbols(ElfReader &elf, const char *symtabName, const char *strtabName,
+                        ModuleSymbols &mod)
+{
+  std::vector<byte> symtab, strtab;
+  if(!elf.ReadSection(symtabName, symtab) || !elf.ReadSection(strtabName, strtab))
+    return false;
+
+  if(elf.Is64())
+    AddSymbols<Elf64_Sym>(symtab, strtab, mod);
+  else
+    AddSymbols<Elf32_Sym>(symtab, strtab, mod);
+
+  return true;
+}
+
+static bool LoadLines(ElfReader &elf, ModuleSymbols &mod)
+{
+  std::vector<byte> debugLine, lineStrings, strings;
+  if(!elf.ReadSection(".debug_line", debugLine))
+    return false;
+
+  elf.ReadSection(".debug_line_str", lineStrings);
+  elf.ReadSection(".debug_str", strings);
+
+  ParseLineTables(debugLine, lineStrings, strings, elf.Is64() ? 8 : 4, mod);
+
+  return true;
+}
+
+// find the separate debug file for a stripped module, via its build ID or .gnu_debuglink
+static string FindDebugFile(ElfReader &elf, const char *path)
+{
+  std::vector<byte> data;
+
+  if(elf.ReadSection(".note.gnu.build-id", data) && data.size() > 12)
+  {
+    uint32_t nameSize = 0, descSize = 0;
+    memcpy(&nameSize, &data[0], sizeof(uint32_t));
+    memcpy(&descSize, &data[4], sizeof(uint32_t));
+
+    size_t descOffset = 12 + AlignUp4(nameSize);
+
+    if(descSize > 1 && descOffset + descSize <= data.size())
+    {
+      string id;
+      for(uint32_t i = 0; i < descSize; i++)
+        id += StringFormat::Fmt("%02x", data[descOffset + i]);
+
+      string debugPath = "/usr/lib/debug/.build-id/" + id.substr(0, 2) + "/" + id.substr(2) + ".debug";
+      if(FileIO::exists(debugPath.c_str()))
+        return debugPath;
+    }
+  }
+
+  if(elf.ReadSection(".gnu_debuglink", data) && memchr(data.data(), 0, data.size()))
+  {
+    string link = (const char *)data.data();
+    string dir = dirname(string(path));
+
+    string candidates[] = {
+        dir + "/" + link, dir + "/.debug/" + link, "/usr/lib/debug" + dir + "/" + link,
+    };
+
+    for(const string &c : candidates)
+      if(c != path && FileIO::exists(c.c_str()))
+        return c;
+  }
+
+  return string();
+}
+
+static void LoadModuleSymbols(const char *path, ModuleSymbols &mod)
+{
+  ElfReader elf(path);
+
+  if(!elf.IsValid())
+  {
+    RDCWARN("Couldn't read symbols from '%s'", path);
+    return;
+  }
+
+  mod.segments = elf.GetSegments();
+
+  bool hasSymtab = LoadSymbols(elf, ".symtab", ".strtab", mod);
+  bool hasLines = LoadLines(elf, mod);
+
+  if(!hasSymtab || !hasLines)
+  {
+    string debugPath = FindDebugFile(elf, path);
+
+    ElfReader debug(debugPath.c_str());
+    if(!debugPath.empty() && debug.IsValid())
+    {
+      if(!hasSymtab)
+        hasSymtab = LoadSymbols(debug, ".symtab", ".strtab", mod);
+      if(!hasLines)
+        LoadLines(debug, mod);
+    }
+  }
+
+  // the dynamic symbols are a subset of the full table, so only use them as a last resort
+  if(!hasSymtab)
+    LoadSymbols(elf, ".dynsym", ".dynstr", mod);
+
+  // sort symbols by address, preferring the largest where several share an address
+  std::sort(mod.symbols.begin(), mod.symbols.end(),
+            [](const ModuleSymbols::Symbol &a, const ModuleSymbols::Symbol &b) {
+              if(a.addr != b.addr)
+                return a.addr < b.addr;
+              return a.size > b.size;
+            });
+  mod.symbols.erase(std::unique(mod.symbols.begin(), mod.symbols.end(),
+                                [](const ModuleSymbols::Symbol &a, const ModuleSymbols::Symbol &b) {
+                                  return a.addr == b.addr;
+                                }),
+                    mod.symbols.end());
+
+  // where sequences meet, sort the end of one before the start of the next so lookups find the row
+  // that has line information
+  std::stable_sort(mod.lines.begin(), mod.lines.end(),
+                   [](const ModuleSymbols::LineRow &a, const ModuleSymbols::LineRow &b) {
+                     if(a.addr != b.addr)
+                       return a.addr < b.addr;
+                     return a.line == 0 && b.line != 0;
+                   });
+}
+
+static string Demangle(const char *name)
+{
+  int status = 0;
+  char *demangled = abi::__cxa_demangle(name, NULL, NULL, &status);
+
+  if(status != 0 || demangled == NULL)
+    return name;
+
+  string ret = demangled;
+  free(demangled);
+  return ret;
+}
+
+class LinuxResolver : public Callstack::StackResolver
+{
+public:
+  LinuxResolver(vector<LookupModule> modules)
+  {
+    m_Modules = modules;
+
+    std::sort(m_Modules.begin(), m_Modules.end(),
+              [](const LookupModule &a, const LookupModule &b) { return a.base < b.base; });
+
+    for(size_t i = 0; i < m_Modules.size(); i++)
+      m_Symbols.push_back(new ModuleSymbols);
+  }
+
+  ~LinuxResolver()
+  {
+    delete m_Pool;
+
+    for(ModuleSymbols *s : m_Symbols)
+      delete s;
+  }
+
+  Callstack::AddressDetails GetAddr(uint64_t addr)
+  {
+    {
+      SCOPED_LOCK(m_CacheLock);
+      auto it = m_Cache.find(addr);
+      if(it != m_Cache.end())
+        return it->second;
+    }
+
+    Callstack::AddressDetails ret = Resolve(addr);
+
+    SCOPED_LOCK(m_CacheLock);
+    m_Cache[addr] = ret;
+    return ret;
+  }
+
+  rdcarray<Callstack::AddressDetails> GetAddrs(const rdcarray<uint64_t> &addrs)
+  {
+    rdcarray<Callstack::AddressDetails> ret;
+    ret.resize(addrs.size());
+
+    std::vector<size_t> misses;
+
+    {
+      SCOPED_LOCK(m_CacheLock);
+
+      for(size_t i = 0; i < addrs.size(); i++)
+      {
+        auto it = m_Cache.find(addrs[i]);
+        if(it != m_Cache.end())
+          ret[i] = it->second;
+        else
+          misses.push_back(i);
+      }
+
+      if(misses.size() > 1 && m_Pool == NULL)
+        m_Pool = new Threading::ThreadPool(Threading::NumberOfCores());
+    }
+
+    if(misses.size() == 1)
+      ret[misses[0]] = GetAddr(addrs[misses[0]]);
+
+    if(misses.size() <= 1)
+      return ret;
+
+    std::vector<Threading::ThreadPool::Job *> jobs;
+
+    // parsing modules is the bulk of the work, so load each module we need in parallel first
+    std::vector<bool> queued(m_Modules.size());
+    for(size_t i : misses)
+    {
+      int32_t m = FindModule(addrs[i]);
+      if(m >= 0 && !queued[m])
+      {
+        queued[m] = true;
+        jobs.push_back(m_Pool->AddJob([this, m]() { EnsureLoaded(m); }));
+      }
+    }
+
+    for(Threading::ThreadPool::Job *job : jobs)
+      m_Pool->WaitForJob(job);
+    jobs.clear();
+
+    const size_t batchSize = 16;
+    for(size_t b = 0; b < misses.size(); b += batchSize)
+    {
+      jobs.push_back(m_Pool->AddJob([this, b, &misses, &addrs, &ret]() {
+        for(size_t i = b; i < misses.size() && i < b + batchSize; i++)
+          ret[misses[i]] = Resolve(addrs[misses[i]]);
+      }));
+    }
+
+    for(Threading::ThreadPool::Job *job : jobs)
+      m_Pool->WaitForJob(job);
+
+    SCOPED_LOCK(m_CacheLock);
+    for(size_t i : misses)
+      m_Cache[addrs[i]] = ret[i];
+
+    return ret;
+  }
+
+private:
+  int32_t FindModule(uint64_t addr) const
+  {
+    auto it = std::upper_bound(m_Modules.begin(), m_Modules.end(), addr,
+                               [](uint64_t a, const LookupModule &m) { return a < m.base; });
+
+    if(it == m_Modules.begin())
+      return -1;
+
+    --it;
+
+    if(addr >= it->end)
+      return -1;
+
+    return int32_t(it - m_Modules.begin());
+  }
+
+  const ModuleSymbols &EnsureLoaded(int32_t m)
+  {
+    ModuleSymbols &mod = *m_Symbols[m];
+
+    SCOPED_LOCK(mod.lock);
+    if(!mod.loaded)
+    {
+      LoadModuleSymbols(m_Modules[m].path, mod);
+      mod.loaded = true;
+    }
+
+    return mod;
+  }
+
+  Callstack::AddressDetails Resolve(uint64_t addr)
+  {
+    Callstack::AddressDetails ret;
+
+    ret.filename = "Unknown";
+    ret.line = 0;
+    ret.function = StringFormat::Fmt("0x%08llx", addr);
+
+    int32_t m = FindModule(addr);
+    if(m < 0)
+      return ret;
+
+    const ModuleSymbols &mod = EnsureLoaded(m);
+
+    ret.function = "??";
+    ret.filename = "??";
+
+    // translate the mapped address to a file offset, then to a virtual address in the module
+    uint64_t offset = addr - m_Modules[m].base + m_Modules[m].offset;
+    uint64_t vaddr = offset;
+
+    for(const ModuleSymbols::Segment &seg : mod.segments)
+    {
+      if(offset >= seg.offset && offset < seg.offset + seg.size)
+      {
+        vaddr = offset - seg.offset + seg.vaddr;
+        break;
+      }
+    }
+
+    auto sym = std::upper_bound(mod.symbols.begin(), mod.symbols.end(), vaddr,
+                                [](uint64_t a, const ModuleSymbols::Symbol &s) { return a < s.addr; });
+    if(sym != mod.symbols.begin())
+    {
+      --sym;
+      if(sym->size == 0 || vaddr < sym->addr + sym->size)
+        ret.function = Demangle(&mod.names[sym->name]);
+    }
+
+    auto row = std::upper_bound(mod.lines.begin(), mod.lines.end(), vaddr,
+                                [](uint64_t a, const ModuleSymbols::LineRow &r) { return a < r.addr; });
+    if(row != mod.lines.begin())
+    {
+      --row;
+      if(row->line != 0)
+      {
+        ret.filename = mod.files[row->file];
+        ret.line = row->line;
+      }
+    }
+
+    return ret;
+  }
+
+  std::vector<LookupModule> m_Modules;
+  std::vector<ModuleSymbols *> m_Symbols;
+
+  Threading::CriticalSection m_CacheLock;
+  std::map<uint64_t, Callstack::AddressDetails> m_Cache;
+
+  Threading::ThreadPool *m_Pool = NULL;
+};
+
+StackResolver *MakeResolver(byte *moduleDB, size_t DBSize, RENDERDOC_ProgressCallback progress)
+{
+  // we look in the original locations for the files, we don't prompt if we can't
+  // find the file, or the file doesn't have symbols (and we don't validate that
+  // the file is the right version). A good option for doing this would be
+  // http://github.com/mlabbe/nativefiledialog
+
+  if(DBSize < 8 || memcmp(moduleDB, "LNUXCALL", 8))
+  {
+    RDCWARN("Can't load callstack resolve for this log. Possibly from another platform?");
+    return NULL;
+  }
+
+  char *start = (char *)(moduleDB + 8);
+  char *search = start;
+  char *dbend = (char *)(moduleDB + DBSize);
+
+  vector<LookupModule> modules;
+
+  while(search && search < dbend)
+  {
+    if(progress)
+      progress(float(search - start) / float(DBSize));
+
+    // find .text segments
+    {
+      long unsigned int base = 0, end = 0, offset = 0;
+
+      int inode = 0;
+      int offs = 0;
+      //                        base-end   perms offset devid   inode offs
+      int num = sscanf(search, "%lx-%lx  r-xp  %lx    %*x:%*x %d    %n", &base, &end, &offset,
+                       &inode, &offs);
+
+      // we don't care about inode actually, we ust use it to verify that
+      // we read all 4 params (and so perms == r-xp)
+      if(num == 4 && offs > 0)
+      {
+        LookupModule mod = {0};
+
+        mod.base = (uint64_t)base;
+        mod.end = (uint64_t)end;
+        mod.offset = (uint64_t)offset;
+
+        search += offs;
+        while(search < dbend && (*search == ' ' || *search == '\t'))
+          search++;
+
+        if(search < dbend && *search != '[' && *search != 0 && *search != '\n')
+        {
+          size_t n = ARRAY_COUNT(mod.path) - 1;
+          mod.path[n] = 0;
+          for(size_t i = 0; i < n; i++)
+          {
+            if(search[i] == 0 || search[i] == '\n')
+            {
+              mod.path[i] = 0;
+              break;
+            }
+            if(search + i >= dbend)
+            {
+              mod.path[i] = 0;
+              break;
+            }
+            mod.path[i] = search[i];
+          }
+
+          modules.push_back(mod);
+        }
+      }
+    }
+
+    if(progress)
+      progress(RDCMIN(1.0f, float(search - start) / float(DBSize)));
+
+    if(search >= dbend)
+      break;
 
     search = strchr(search, '\n');
     if(search)
@@ -315,3 +1753,217 @@ StackResolver *MakeResolver(byte *moduleDB, size_t DBSize, RENDERDOC_ProgressCal
   return new LinuxResolver(modules);
 }
 };
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "3rdparty/catch/catch.hpp"
+
+TEST_CASE("Resolve callstack addresses in process", "[callstack]")
+{
+  size_t size = 0;
+  Callstack::GetLoadedModules(NULL, size);
+
+  // leave room in case more is mapped between querying the size and reading
+  std::vector<byte> db(size * 2);
+  Callstack::GetLoadedModules(db.data(), size);
+
+  Callstack::StackResolver *resolver = Callstack::MakeResolver(db.data(), size, NULL);
+  REQUIRE(resolver);
+
+  uint64_t init = (uint64_t)(void *)&Callstack::Init;
+  uint64_t collect = (uint64_t)(void *)&Callstack::Collect;
+
+  Callstack::AddressDetails details = resolver->GetAddr(init);
+  CHECK(details.function == "Callstack::Init()");
+
+  // line information is only available when built with debug info
+  if(details.filename != "??")
+  {
+    CHECK(strstr(details.filename.c_str(), "linux_callstack.cpp"));
+    CHECK(details.line > 0);
+  }
+
+  details = resolver->GetAddr(0x10);
+  CHECK(details.function == "0x00000010");
+  CHECK(details.filename == "Unknown");
+
+  rdcarray<uint64_t> stack = {collect, init, 0x10, collect + 1, init};
+  rdcarray<Callstack::AddressDetails> batch = resolver->GetAddrs(stack);
+
+  REQUIRE(batch.size() == stack.size());
+  CHECK(batch[0].function == "Callstack::Collect()");
+  CHECK(batch[3].function == "Callstack::Collect()");
+
+  for(size_t i = 0; i < stack.size(); i++)
+  {
+    Callstack::AddressDetails single = resolver->GetAddr(stack[i]);
+    CHECK(batch[i].function == single.function);
+    CHECK(batch[i].filename == single.filename);
+    CHECK(batch[i].line == single.line);
+  }
+
+  delete resolver;
+}
+
+TEST_CASE("Collect callstacks", "[callstack]")
+{
+  void *expected[128];
+  int numExpected = backtrace(expected, ARRAY_COUNT(expected));
+
+  int offs = 0;
+  while(offs < numExpected && expected[offs] >= renderdocBase && expected[offs] < renderdocEnd)
+    offs++;
+
+  // whichever way the stack was walked, the frames outside of renderdoc are the same. Collect
+  // more than once so that any stack root learned the first time is used.
+  for(int attempt = 0; attempt < 3; attempt++)
+  {
+    Callstack::Stackwalk *stack = Callstack::Collect();
+    REQUIRE(stack);
+
+    REQUIRE(stack->NumLevels() == size_t(numExpected - offs));
+    for(size_t i = 0; i < stack->NumLevels(); i++)
+      CHECK(stack->GetAddrs()[i] == (uint64_t)expected[offs + i]);
+
+    delete stack;
+  }
+
+  // collecting on another thread uses that thread's stack bounds
+  size_t otherLevels = 0;
+  Threading::ThreadHandle th = Threading::CreateThread([&otherLevels]() {
+    Callstack::Stackwalk *other = Callstack::Collect();
+    otherLevels = other->NumLevels();
+    delete other;
+  });
+  Threading::JoinThread(th);
+  Threading::CloseThread(th);
+
+  CHECK(otherLevels > 0);
+}
+
+struct FramePointerWalk
+{
+  void *walked[128];
+  int walkedCount;
+  bool complete;
+
+  void *expected[128];
+  int numExpected;
+};
+
+static __attribute__((noinline)) void WalkAndBacktrace(void *param)
+{
+  FramePointerWalk &walk = *(FramePointerWalk *)param;
+  walk.complete = WalkFramePointers(walk.walked, ARRAY_COUNT(walk.walked), walk.walkedCount);
+  walk.numExpected = backtrace(walk.expected, ARRAY_COUNT(walk.expected));
+}
+
+static __attribute__((noinline)) void CallWithFramePointer(void (*callback)(void *), void *param)
+{
+  callback(param);
+}
+
+#if defined(__x86_64__)
+
+// calls the callback from a function with no frame pointer, like one compiled with
+// -fomit-frame-pointer, leaving its caller's frame pointer in place
+extern "C" void RENDERDOC_TestCallWithoutFramePointer(void (*callback)(void *), void *param);
+
+asm(".text\n"
+    ".globl RENDERDOC_TestCallWithoutFramePointer\n"
+    ".hidden RENDERDOC_TestCallWithoutFramePointer\n"
+    ".type RENDERDOC_TestCallWithoutFramePointer, @function\n"
+    "RENDERDOC_TestCallWithoutFramePointer:\n"
+    ".cfi_startproc\n"
+    "  subq $8, %rsp\n"
+    ".cfi_adjust_cfa_offset 8\n"
+    "  movq %rdi, %rax\n"
+    "  movq %rsi, %rdi\n"
+    "  call *%rax\n"
+    "  addq $8, %rsp\n"
+    ".cfi_adjust_cfa_offset -8\n"
+    "  ret\n"
+    ".cfi_endproc\n"
+    ".size RENDERDOC_TestCallWithoutFramePointer, .-RENDERDOC_TestCallWithoutFramePointer\n");
+
+#endif
+
+TEST_CASE("Frame pointer walks don't skip frames", "[callstack]")
+{
+  FramePointerWalk walk = {};
+
+  // every frame walked must match the unwinder's. The first frames are each from a different call
+  // in WalkAndBacktrace so they're skipped.
+  auto checkWalk = [&walk]() {
+    REQUIRE(walk.walkedCount <= walk.numExpected);
+    for(int i = 1; i < walk.walkedCount; i++)
+      CHECK(walk.walked[i] == walk.expected[i]);
+  };
+
+  SECTION("With frame pointers")
+  {
+    CallWithFramePointer(&WalkAndBacktrace, &walk);
+
+    checkWalk();
+
+#if defined(__x86_64__) || defined(__i386__)
+    // at least as far as this test
+    CHECK(walk.walkedCount > 3);
+#endif
+  }
+
+#if defined(__x86_64__)
+  SECTION("Without a frame pointer")
+  {
+    RENDERDOC_TestCallWithoutFramePointer(&WalkAndBacktrace, &walk);
+
+    checkWalk();
+
+    // the walk stops at the return into the function without a frame pointer
+    CHECK_FALSE(walk.complete);
+    CHECK(walk.walkedCount == 2);
+
+    // and collecting falls back to get every frame
+    Callstack::Stackwalk *stack = NULL;
+    RENDERDOC_TestCallWithoutFramePointer(
+        [](void *param) { *(Callstack::Stackwalk **)param = Callstack::Collect(); }, &stack);
+
+    REQUIRE(stack);
+
+    int offs = 0;
+    while(offs < walk.numExpected && walk.expected[offs] >= renderdocBase &&
+          walk.expected[offs] < renderdocEnd)
+      offs++;
+
+    CHECK(stack->NumLevels() == size_t(walk.numExpected - offs));
+
+    delete stack;
+  }
+#endif
+}
+
+TEST_CASE("Benchmark callstack collection", "[.][benchmark][callstack]")
+{
+  const int numStacks = 100000;
+
+  void *addrs[128];
+
+  PerformanceTimer timer;
+
+  for(int i = 0; i < numStacks; i++)
+    backtrace(addrs, ARRAY_COUNT(addrs));
+
+  double backtraceMS = timer.GetMilliseconds();
+
+  timer.Restart();
+
+  for(int i = 0; i < numStacks; i++)
+    delete Callstack::Collect();
+
+  double collectMS = timer.GetMilliseconds();
+
+  RDCLOG("Collected %d callstacks in %.1f ms, backtrace() took %.1f ms", numStacks, collectMS,
+         backtraceMS);
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
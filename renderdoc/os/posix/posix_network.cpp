@@ -40,6 +40,10 @@
 
 #include "posix_network.h"
 
+#if ENABLED(RDOC_LINUX) || ENABLED(RDOC_ANDROID)
+#include <sys/sendfile.h>
+#endif
+
 using std::string;
 
 // because strerror_r is a complete mess...
@@ -192,6 +196,87 @@ bool Socket::SendDataBlocking(const void *buf, uint32_t length)
   return true;
 }
 
+bool Socket::SendFileBlocking(FILE *file, uint64_t offset, uint64_t length)
+{
+  if(length == 0)
+    return true;
+
+#if ENABLED(RDOC_LINUX) || ENABLED(RDOC_ANDROID)
+  int fd = fileno(file);
+
+  int flags = fcntl(socket, F_GETFL, 0);
+  fcntl(socket, F_SETFL, flags & ~O_NONBLOCK);
+
+  timeval oldtimeout = {0};
+  socklen_t len = sizeof(oldtimeout);
+  getsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (char *)&oldtimeout, &len);
+
+  timeval timeout = {0};
+  timeout.tv_sec = (timeoutMS / 1000);
+  timeout.tv_usec = (timeoutMS % 1000) * 1000;
+  setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+
+  off_t offs = (off_t)offset;
+  uint64_t sent = 0;
+
+  while(sent < length)
+  {
+    // sendfile can send at most this much at once
+    size_t count = (size_t)RDCMIN(length - sent, (uint64_t)0x7ffff000);
+
+    ssize_t ret = sendfile(socket, fd, &offs, count);
+
+    if(ret <= 0)
+    {
+      int err = errno;
+
+      if(ret == 0)
+        RDCWARN("sendfile: unexpected end of file");
+      else if(err == EWOULDBLOCK || err == EAGAIN || err == EINTR)
+        RDCWARN("Timeout in sendfile");
+      else
+        RDCWARN("sendfile: %s", errno_string(err).c_str());
+
+      Shutdown();
+      return false;
+    }
+
+    sent += ret;
+  }
+
+  flags = fcntl(socket, F_GETFL, 0);
+  fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+
+  setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const char *)&oldtimeout, sizeof(oldtimeout));
+
+  return true;
+#else
+  // no sendfile with a usable interface, copy through a buffer
+  const uint64_t bufSize = RDCMIN(length, (uint64_t)1024 * 1024);
+  std::vector<byte> buf((size_t)bufSize);
+
+  FileIO::fseek64(file, offset, SEEK_SET);
+
+  while(length > 0)
+  {
+    uint32_t count = (uint32_t)RDCMIN(length, bufSize);
+
+    if(FileIO::fread(buf.data(), 1, count, file) != count)
+    {
+      RDCWARN("Unexpected end of file sending from file");
+      return false;
+    }
+
+    if(!SendDataBlocking(buf.data(), count))
+      return false;
+
+    length -= count;
+  }
+
+  return true;
+#endif
+}
+
 bool Socket::IsRecvDataWaiting()
 {
   char dummy;
@@ -32,6 +32,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
@@ -465,6 +466,61 @@ int fclose(FILE *f)
   return ::fclose(f);
 }
 
+struct FileView
+{
+  void *base;
+  size_t size;
+};
+
+byte *MapFileView(FILE *f, uint64_t offset, uint64_t length, void *&handle)
+{
+  handle = NULL;
+
+  if(f == NULL || length == 0)
+    return NULL;
+
+  int fd = ::fileno(f);
+
+  // don't map past the end of the file, touching those pages would raise SIGBUS rather than
+  // returning an error
+  struct ::stat st;
+  if(fstat(fd, &st) != 0 || offset + length > (uint64_t)st.st_size)
+    return NULL;
+
+  // the mapping offset must be page aligned, so map from the page containing offset
+  uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+  uint64_t alignedOffset = offset - (offset % pageSize);
+  uint64_t mapSize = length + (offset - alignedOffset);
+
+  if(mapSize != (uint64_t)(size_t)mapSize || alignedOffset != (uint64_t)(off_t)alignedOffset)
+    return NULL;
+
+  void *base =
+      ::mmap(NULL, (size_t)mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)alignedOffset);
+
+  if(base == MAP_FAILED)
+    return NULL;
+
+  FileView *view = new FileView;
+  view->base = base;
+  view->size = (size_t)mapSize;
+
+  handle = view;
+
+  return (byte *)base + (offset - alignedOffset);
+}
+
+void UnmapFileView(void *handle)
+{
+  FileView *view = (FileView *)handle;
+
+  if(view == NULL)
+    return;
+
+  ::munmap(view->base, view->size);
+  delete view;
+}
+
 bool exists(const char *filename)
 {
   struct ::stat st;
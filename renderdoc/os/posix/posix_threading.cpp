@@ -23,6 +23,7 @@
  ******************************************************************************/
 
 #include <time.h>
+#include <algorithm>
 #include <unistd.h>
 #include "os/os_specific.h"
 
@@ -151,6 +152,43 @@ void RWLock::ReadUnlock()
   pthread_rwlock_unlock(&m_Data.rwlock);
 }
 
+template <>
+Semaphore::SemaphoreTemplate()
+{
+  pthread_mutex_init(&m_Data.lock, NULL);
+  pthread_cond_init(&m_Data.cond, NULL);
+  m_Data.count = 0;
+}
+
+template <>
+Semaphore::~SemaphoreTemplate()
+{
+  pthread_cond_destroy(&m_Data.cond);
+  pthread_mutex_destroy(&m_Data.lock);
+}
+
+template <>
+void Semaphore::WaitForWake()
+{
+  pthread_mutex_lock(&m_Data.lock);
+  while(m_Data.count == 0)
+    pthread_cond_wait(&m_Data.cond, &m_Data.lock);
+  m_Data.count--;
+  pthread_mutex_unlock(&m_Data.lock);
+}
+
+template <>
+void Semaphore::Wake(uint32_t numToWake)
+{
+  pthread_mutex_lock(&m_Data.lock);
+  m_Data.count += numToWake;
+  if(numToWake == 1)
+    pthread_cond_signal(&m_Data.cond);
+  else
+    pthread_cond_broadcast(&m_Data.cond);
+  pthread_mutex_unlock(&m_Data.lock);
+}
+
 struct ThreadInitData
 {
   std::function<void()> entryFunc;
@@ -181,10 +219,48 @@ struct TLSData
 
 static CriticalSection *m_TLSListLock = NULL;
 static vector<TLSData *> *m_TLSList = NULL;
+// slots can be allocated during static initialisation before Init(), so destructors are kept in a
+// fixed table that needs no construction. Indexed by slot, which is 1-based
+static const uint64_t MaxTLSDestructorSlots = 1024;
+static TLSDestructor m_TLSDestructors[MaxTLSDestructorSlots] = {};
+
+// called when a thread exits with its slot data
+static void ThreadExitTLS(void *ptr)
+{
+  TLSData *slots = (TLSData *)ptr;
+
+  vector<std::pair<TLSDestructor, void *>> destructors;
+
+  m_TLSListLock->Lock();
+
+  // data for threads still running at shutdown has already been freed
+  auto it = std::find(m_TLSList->begin(), m_TLSList->end(), slots);
+  if(it == m_TLSList->end())
+  {
+    m_TLSListLock->Unlock();
+    return;
+  }
+
+  m_TLSList->erase(it);
+
+  for(size_t i = 0; i < slots->data.size() && i + 1 < MaxTLSDestructorSlots; i++)
+  {
+    if(slots->data[i] && m_TLSDestructors[i + 1])
+      destructors.push_back(std::make_pair(m_TLSDestructors[i + 1], slots->data[i]));
+  }
+
+  m_TLSListLock->Unlock();
+
+  delete slots;
+
+  // run the destructors outside the lock, they may use TLS themselves
+  for(size_t i = 0; i < destructors.size(); i++)
+    destructors[i].first(destructors[i].second);
+}
 
 void Init()
 {
-  int err = pthread_key_create(&OSTLSHandle, NULL);
+  int err = pthread_key_create(&OSTLSHandle, &ThreadExitTLS);
   if(err != 0)
     RDCFATAL("Can't allocate OS TLS slot");
 
@@ -196,21 +272,37 @@ void Init()
 
 void Shutdown()
 {
+  // no exit callbacks run after the key is deleted, so threads still running won't touch the data
+  pthread_key_delete(OSTLSHandle);
+
   for(size_t i = 0; i < m_TLSList->size(); i++)
     delete m_TLSList->at(i);
 
   delete m_TLSList;
   delete m_TLSListLock;
 
-  pthread_key_delete(OSTLSHandle);
+  m_TLSList = NULL;
+  m_TLSListLock = NULL;
 }
 
 // allocate a TLS slot in our per-thread vectors with an atomic increment.
 // Note this is going to be 1-indexed because Inc64 returns the post-increment
 // value
-uint64_t AllocateTLSSlot()
+uint64_t AllocateTLSSlot(TLSDestructor destructor)
 {
-  return Atomic::Inc64(&nextTLSSlot);
+  uint64_t slot = Atomic::Inc64(&nextTLSSlot);
+
+  // the slot can't have any values until it's returned, so no thread will look at this until then
+  if(destructor)
+  {
+    if(slot < MaxTLSDestructorSlots)
+      m_TLSDestructors[slot] = destructor;
+    else
+      RDCERR("TLS slot %llu is past the last slot with exit destructors",
+             (unsigned long long)slot);
+  }
+
+  return slot;
 }
 
 // look up our per-thread vector.
@@ -227,30 +319,53 @@ void SetTLSValue(uint64_t slot, void *value)
   TLSData *slots = (TLSData *)pthread_getspecific(OSTLSHandle);
 
   // resize or allocate slot data if needed.
-  // We don't need to lock this, as it is by definition thread local so we are
-  // blocking on the only possible concurrent access.
+  // This is thread local, but FreeTLSSlot can write to every thread's data so we lock while
+  // resizing. This only happens when the thread first uses a new slot.
   if(slots == NULL || slot - 1 >= slots->data.size())
   {
+    m_TLSListLock->Lock();
+
     if(slots == NULL)
     {
       slots = new TLSData;
       pthread_setspecific(OSTLSHandle, slots);
 
-      // in the case where this thread is entirely new, we globally lock so we can
-      // store its data for shutdown (as we might not get notified of every thread
-      // that exits). This only happens once, so we take the hit of the lock.
-      m_TLSListLock->Lock();
+      // in the case where this thread is entirely new, we store its data for
+      // shutdown (as we might not get notified of every thread that exits).
       m_TLSList->push_back(slots);
-      m_TLSListLock->Unlock();
     }
 
-    if(slot - 1 >= slots->data.size())
     slots->data.resize((size_t)slot);
+
+    m_TLSListLock->Unlock();
   }
 
   slots->data[(size_t)slot - 1] = value;
 }
 
+void FreeTLSSlot(uint64_t slot)
+{
+  // static objects can free their slots after Shutdown(), when there's no thread data left
+  if(m_TLSListLock == NULL)
+    return;
+
+  m_TLSListLock->Lock();
+
+  // exiting threads look up destructors under the lock, so none will be called for this slot after
+  // this point. One that already looked it up may still be running it.
+  if(slot < MaxTLSDestructorSlots)
+    m_TLSDestructors[slot] = NULL;
+
+  for(size_t i = 0; i < m_TLSList->size(); i++)
+  {
+    TLSData *slots = m_TLSList->at(i);
+    if(slot - 1 < slots->data.size())
+      slots->data[(size_t)slot - 1] = NULL;
+  }
+
+  m_TLSListLock->Unlock();
+}
+
 ThreadHandle CreateThread(std::function<void()> entryFunc)
 {
   pthread_t thread;
@@ -277,6 +392,23 @@ void JoinThread(ThreadHandle handle)
 {
   pthread_join((pthread_t)handle, NULL);
 }
+
+bool JoinThread(ThreadHandle handle, uint32_t timeoutMilliseconds)
+{
+#if defined(__GLIBC__)
+  timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+
+  uint64_t nsec = uint64_t(deadline.tv_nsec) + uint64_t(timeoutMilliseconds % 1000) * 1000000;
+  deadline.tv_sec += timeoutMilliseconds / 1000 + time_t(nsec / 1000000000);
+  deadline.tv_nsec = long(nsec % 1000000000);
+
+  return pthread_timedjoin_np((pthread_t)handle, NULL, &deadline) == 0;
+#else
+  // bionic and apple's pthreads have no timed join
+  return false;
+#endif
+}
 void CloseThread(ThreadHandle handle)
 {
 }
@@ -293,4 +425,12 @@ void Sleep(uint32_t milliseconds)
 {
   usleep(milliseconds * 1000);
 }
+
+uint32_t NumberOfCores()
+{
+  long ret = sysconf(_SC_NPROCESSORS_ONLN);
+  if(ret <= 0)
+    return 1;
+  return uint32_t(ret);
+}
 };
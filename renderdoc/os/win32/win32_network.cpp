@@ -205,6 +205,34 @@ bool Socket::SendDataBlocking(const void *buf, uint32_t length)
   return true;
 }
 
+bool Socket::SendFileBlocking(FILE *file, uint64_t offset, uint64_t length)
+{
+  // TransmitFile needs the socket in overlapped mode and the file as a HANDLE, so copy through a
+  // buffer instead.
+  const uint64_t bufSize = RDCMIN(length, (uint64_t)1024 * 1024);
+  std::vector<byte> buf((size_t)bufSize);
+
+  FileIO::fseek64(file, offset, SEEK_SET);
+
+  while(length > 0)
+  {
+    uint32_t count = (uint32_t)RDCMIN(length, bufSize);
+
+    if(FileIO::fread(buf.data(), 1, count, file) != count)
+    {
+      RDCWARN("Unexpected end of file sending from file");
+      return false;
+    }
+
+    if(!SendDataBlocking(buf.data(), count))
+      return false;
+
+    length -= count;
+  }
+
+  return true;
+}
+
 bool Socket::IsRecvDataWaiting()
 {
   char dummy;
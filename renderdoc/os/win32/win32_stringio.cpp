@@ -665,6 +665,71 @@ int fclose(FILE *f)
   return ::fclose(f);
 }
 
+struct FileView
+{
+  HANDLE mapping;
+  void *base;
+};
+
+byte *MapFileView(FILE *f, uint64_t offset, uint64_t length, void *&handle)
+{
+  handle = NULL;
+
+  if(f == NULL || length == 0)
+    return NULL;
+
+  HANDLE file = (HANDLE)::_get_osfhandle(::_fileno(f));
+
+  LARGE_INTEGER fileSize = {};
+  if(file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) ||
+     offset + length > (uint64_t)fileSize.QuadPart)
+    return NULL;
+
+  // views must start on the allocation granularity, so map from the boundary before offset
+  SYSTEM_INFO sysInfo = {};
+  GetSystemInfo(&sysInfo);
+
+  uint64_t alignedOffset = offset - (offset % sysInfo.dwAllocationGranularity);
+  uint64_t mapSize = length + (offset - alignedOffset);
+
+  if(mapSize != (uint64_t)(SIZE_T)mapSize)
+    return NULL;
+
+  HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+
+  if(mapping == NULL)
+    return NULL;
+
+  void *base = MapViewOfFile(mapping, FILE_MAP_COPY, DWORD(alignedOffset >> 32),
+                             DWORD(alignedOffset & 0xffffffff), (SIZE_T)mapSize);
+
+  if(base == NULL)
+  {
+    CloseHandle(mapping);
+    return NULL;
+  }
+
+  FileView *view = new FileView;
+  view->mapping = mapping;
+  view->base = base;
+
+  handle = view;
+
+  return (byte *)base + (offset - alignedOffset);
+}
+
+void UnmapFileView(void *handle)
+{
+  FileView *view = (FileView *)handle;
+
+  if(view == NULL)
+    return;
+
+  UnmapViewOfFile(view->base);
+  CloseHandle(view->mapping);
+  delete view;
+}
+
 static HANDLE logHandle = NULL;
 
 bool logfile_open(const char *filename)
@@ -24,6 +24,7 @@
  ******************************************************************************/
 
 #include <time.h>
+#include <algorithm>
 #include "os/os_specific.h"
 
 double Timing::GetTickFrequency()
@@ -145,6 +146,26 @@ void RWLock::ReadUnlock()
   ReleaseSRWLockShared(&m_Data);
 }
 
+Semaphore::SemaphoreTemplate()
+{
+  m_Data = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+}
+
+Semaphore::~SemaphoreTemplate()
+{
+  CloseHandle(m_Data);
+}
+
+void Semaphore::WaitForWake()
+{
+  WaitForSingleObject(m_Data, INFINITE);
+}
+
+void Semaphore::Wake(uint32_t numToWake)
+{
+  ReleaseSemaphore(m_Data, (LONG)numToWake, NULL);
+}
+
 struct ThreadInitData
 {
   std::function<void()> entryFunc;
@@ -175,11 +196,50 @@ struct TLSData
 
 static CriticalSection *m_TLSListLock = NULL;
 static vector<TLSData *> *m_TLSList = NULL;
+// slots can be allocated during static initialisation before Init(), so destructors are kept in a
+// fixed table that needs no construction. Indexed by slot, which is 1-based
+static const uint64_t MaxTLSDestructorSlots = 1024;
+static TLSDestructor m_TLSDestructors[MaxTLSDestructorSlots] = {};
+
+// called when a thread exits with its slot data
+static void WINAPI ThreadExitTLS(void *ptr)
+{
+  TLSData *slots = (TLSData *)ptr;
+
+  vector<std::pair<TLSDestructor, void *>> destructors;
+
+  m_TLSListLock->Lock();
+
+  // data for threads still running at shutdown has already been freed
+  auto it = std::find(m_TLSList->begin(), m_TLSList->end(), slots);
+  if(it == m_TLSList->end())
+  {
+    m_TLSListLock->Unlock();
+    return;
+  }
+
+  m_TLSList->erase(it);
+
+  for(size_t i = 0; i < slots->data.size() && i + 1 < MaxTLSDestructorSlots; i++)
+  {
+    if(slots->data[i] && m_TLSDestructors[i + 1])
+      destructors.push_back(std::make_pair(m_TLSDestructors[i + 1], slots->data[i]));
+  }
+
+  m_TLSListLock->Unlock();
+
+  delete slots;
+
+  // run the destructors outside the lock, they may use TLS themselves
+  for(size_t i = 0; i < destructors.size(); i++)
+    destructors[i].first(destructors[i].second);
+}
 
 void Init()
 {
-  OSTLSHandle = TlsAlloc();
-  if(OSTLSHandle == TLS_OUT_OF_INDEXES)
+  // fiber local storage is used for its callback on thread exit, plain TLS has none
+  OSTLSHandle = FlsAlloc(&ThreadExitTLS);
+  if(OSTLSHandle == FLS_OUT_OF_INDEXES)
     RDCFATAL("Can't allocate OS TLS slot");
 
   m_TLSListLock = new CriticalSection();
@@ -190,28 +250,48 @@ void Shutdown()
 {
   if(m_TLSList)
   {
+    m_TLSListLock->Lock();
     for(size_t i = 0; i < m_TLSList->size(); i++)
       delete m_TLSList->at(i);
+    m_TLSList->clear();
+    m_TLSListLock->Unlock();
   }
 
+  // this calls the exit callback for threads that are still running, which ignores them since their
+  // data is no longer in the list
+  FlsFree(OSTLSHandle);
+
   delete m_TLSList;
   delete m_TLSListLock;
 
-  TlsFree(OSTLSHandle);
+  m_TLSList = NULL;
+  m_TLSListLock = NULL;
 }
 
 // allocate a TLS slot in our per-thread vectors with an atomic increment.
 // Note this is going to be 1-indexed because Inc64 returns the post-increment
 // value
-uint64_t AllocateTLSSlot()
+uint64_t AllocateTLSSlot(TLSDestructor destructor)
 {
-  return Atomic::Inc64(&nextTLSSlot);
+  uint64_t slot = Atomic::Inc64(&nextTLSSlot);
+
+  // the slot can't have any values until it's returned, so no thread will look at this until then
+  if(destructor)
+  {
+    if(slot < MaxTLSDestructorSlots)
+      m_TLSDestructors[slot] = destructor;
+    else
+      RDCERR("TLS slot %llu is past the last slot with exit destructors",
+             (unsigned long long)slot);
+  }
+
+  return slot;
 }
 
 // look up our per-thread vector.
 void *GetTLSValue(uint64_t slot)
 {
-  TLSData *slots = (TLSData *)TlsGetValue(OSTLSHandle);
+  TLSData *slots = (TLSData *)FlsGetValue(OSTLSHandle);
   if(slots == NULL || slot - 1 >= slots->data.size())
     return NULL;
   return slots->data[(size_t)slot - 1];
@@ -219,33 +299,56 @@ void *GetTLSValue(uint64_t slot)
 
 void SetTLSValue(uint64_t slot, void *value)
 {
-  TLSData *slots = (TLSData *)TlsGetValue(OSTLSHandle);
+  TLSData *slots = (TLSData *)FlsGetValue(OSTLSHandle);
 
   // resize or allocate slot data if needed.
-  // We don't need to lock this, as it is by definition thread local so we are
-  // blocking on the only possible concurrent access.
+  // This is thread local, but FreeTLSSlot can write to every thread's data so we lock while
+  // resizing. This only happens when the thread first uses a new slot.
   if(slots == NULL || slot - 1 >= slots->data.size())
   {
+    m_TLSListLock->Lock();
+
     if(slots == NULL)
     {
       slots = new TLSData;
-      TlsSetValue(OSTLSHandle, slots);
+      FlsSetValue(OSTLSHandle, slots);
 
-      // in the case where this thread is entirely new, we globally lock so we can
-      // store its data for shutdown (as we might not get notified of every thread
-      // that exits). This only happens once, so we take the hit of the lock.
-      m_TLSListLock->Lock();
+      // in the case where this thread is entirely new, we store its data for
+      // shutdown (as we might not get notified of every thread that exits).
       m_TLSList->push_back(slots);
-      m_TLSListLock->Unlock();
     }
 
-    if(slot - 1 >= slots->data.size())
     slots->data.resize((size_t)slot);
+
+    m_TLSListLock->Unlock();
   }
 
   slots->data[(size_t)slot - 1] = value;
 }
 
+void FreeTLSSlot(uint64_t slot)
+{
+  // static objects can free their slots after Shutdown(), when there's no thread data left
+  if(m_TLSListLock == NULL)
+    return;
+
+  m_TLSListLock->Lock();
+
+  // exiting threads look up destructors under the lock, so none will be called for this slot after
+  // this point. One that already looked it up may still be running it.
+  if(slot < MaxTLSDestructorSlots)
+    m_TLSDestructors[slot] = NULL;
+
+  for(size_t i = 0; i < m_TLSList->size(); i++)
+  {
+    TLSData *slots = m_TLSList->at(i);
+    if(slot - 1 < slots->data.size())
+      slots->data[(size_t)slot - 1] = NULL;
+  }
+
+  m_TLSListLock->Unlock();
+}
+
 ThreadHandle CreateThread(std::function<void()> entryFunc)
 {
   ThreadInitData *initData = new ThreadInitData;
@@ -268,6 +371,13 @@ void JoinThread(ThreadHandle handle)
   WaitForSingleObject((HANDLE)handle, INFINITE);
 }
 
+bool JoinThread(ThreadHandle handle, uint32_t timeoutMilliseconds)
+{
+  if(handle == 0)
+    return true;
+  return WaitForSingleObject((HANDLE)handle, timeoutMilliseconds) == WAIT_OBJECT_0;
+}
+
 void CloseThread(ThreadHandle handle)
 {
   if(handle == 0)
@@ -293,4 +403,11 @@ void Sleep(uint32_t milliseconds)
 {
   ::Sleep((DWORD)milliseconds);
 }
+
+uint32_t NumberOfCores()
+{
+  SYSTEM_INFO info = {};
+  GetSystemInfo(&info);
+  return RDCMAX(1U, (uint32_t)info.dwNumberOfProcessors);
+}
 };
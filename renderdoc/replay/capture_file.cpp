@@ -149,8 +149,8 @@ public:
 
     m_StructuredData.chunks.reserve(file.chunks.size());
 
-    for(SDChunk *obj : file.chunks)
-      m_StructuredData.chunks.push_back(obj->Duplicate());
+    for(size_t i = 0; i < file.chunks.size(); i++)
+      m_StructuredData.chunks.push_back(file.GetChunk(i)->Duplicate());
 
     m_StructuredData.buffers.reserve(file.buffers.size());
 
@@ -176,7 +176,8 @@ public:
 private:
   ReplayStatus Init();
 
-  void InitStructuredData(RENDERDOC_ProgressCallback progress = RENDERDOC_ProgressCallback());
+  void InitStructuredData(RENDERDOC_ProgressCallback progress = RENDERDOC_ProgressCallback(),
+                          bool lazy = false);
 
   RDCFile *m_RDC = NULL;
   Callstack::StackResolver *m_Resolver = NULL;
@@ -193,6 +194,12 @@ CaptureFile::CaptureFile()
 
 CaptureFile::~CaptureFile()
 {
+  // release the structured data first, in case it's lazily loaded from m_RDC
+  {
+    SDFile discard;
+    discard.Swap(m_StructuredData);
+  }
+
   SAFE_DELETE(m_RDC);
   SAFE_DELETE(m_Resolver);
 }
@@ -335,8 +342,17 @@ ReplayStatus CaptureFile::Init()
   return ReplayStatus::InternalError;
 }
 
-void CaptureFile::InitStructuredData(RENDERDOC_ProgressCallback progress /*= RENDERDOC_ProgressCallback()*/)
+void CaptureFile::InitStructuredData(
+    RENDERDOC_ProgressCallback progress /*= RENDERDOC_ProgressCallback()*/, bool lazy /*= false*/)
 {
+  // lazily loaded data is fine to convert from, but when the structured data is returned directly
+  // every chunk must be present, so process it again fully.
+  if(!lazy && m_StructuredData.IsLazy())
+  {
+    SDFile discard;
+    discard.Swap(m_StructuredData);
+  }
+
   if(m_StructuredData.chunks.empty() && m_RDC && m_RDC->SectionIndex(SectionType::FrameCapture) >= 0)
   {
     StructuredProcessor proc = RenderDoc::Inst().GetStructuredProcessor(m_RDC->GetDriver());
@@ -344,7 +360,7 @@ void CaptureFile::InitStructuredData(RENDERDOC_ProgressCallback progress /*= REN
     RenderDoc::Inst().SetProgressCallback<LoadProgress>(progress);
 
     if(proc)
-      proc(m_RDC, m_StructuredData);
+      proc(m_RDC, m_StructuredData, lazy);
     else
       RDCERR("Can't get structured data for driver %s", m_RDC->GetDriverName().c_str());
 
@@ -432,9 +448,20 @@ ReplayStatus CaptureFile::Convert(const char *filename, const char *filetype, co
     }
     else
     {
-      InitStructuredData(fetchProgress);
+      // exporters go through the chunks in order, so the structured data can be loaded lazily
+      // without holding the whole capture's structured data in memory.
+      InitStructuredData(fetchProgress, true);
+
+      ReplayStatus ret = exporter(filename, *m_RDC, m_StructuredData, exportProgress);
 
-      return exporter(filename, *m_RDC, GetStructuredData(), exportProgress);
+      // don't keep the lazy data and its loader around after converting
+      if(m_StructuredData.IsLazy())
+      {
+        SDFile discard;
+        discard.Swap(m_StructuredData);
+      }
+
+      return ret;
     }
   }
 
@@ -813,12 +840,11 @@ rdcarray<rdcstr> CaptureFile::GetResolve(const rdcarray<uint64_t> &callstack)
     return ret;
   }
 
-  ret.reserve(callstack.size());
-  for(uint64_t frame : callstack)
-  {
-    Callstack::AddressDetails info = m_Resolver->GetAddr(frame);
+  rdcarray<Callstack::AddressDetails> details = m_Resolver->GetAddrs(callstack);
+
+  ret.reserve(details.size());
+  for(Callstack::AddressDetails &info : details)
     ret.push_back(info.formattedString());
-  }
 
   return ret;
 }
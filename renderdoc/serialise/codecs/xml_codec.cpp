@@ -56,15 +56,190 @@ inline float StructuredProgress(float progress)
   return 0.2f + 0.8f * progress;
 }
 
-struct xml_file_writer : pugi::xml_writer
+// writes an xml document incrementally, so the whole tree never needs to be held in memory. The
+// output matches pugixml's default indented formatting.
+struct xml_stream_writer
 {
   StreamWriter stream;
 
-  xml_file_writer(const char *filename) : stream(FileIO::fopen(filename, "wb"), Ownership::Stream)
+  xml_stream_writer(const char *filename) : stream(FileIO::fopen(filename, "wb"), Ownership::Stream)
   {
+    Raw("<?xml version=\"1.0\"?>\n");
   }
 
-  void write(const void *data, size_t size) { stream.Write(data, size); }
+  void BeginElement(const char *name)
+  {
+    // close the parent's start tag, it now has element children
+    if(!elements.empty() && elements.back().open)
+    {
+      Raw(">\n");
+      elements.back().open = false;
+    }
+
+    Indent();
+    Raw("<");
+    Raw(name);
+
+    elements.push_back({name, true, false});
+  }
+
+  void EndElement()
+  {
+    Element el = elements.back();
+    elements.pop_back();
+
+    if(el.open)
+    {
+      Raw(" />\n");
+      return;
+    }
+
+    if(!el.text)
+      Indent();
+
+    Raw("</");
+    Raw(el.name);
+    Raw(">\n");
+  }
+
+  void Attribute(const char *name, const char *value)
+  {
+    Raw(" ");
+    Raw(name);
+    Raw("=\"");
+    Escape(value, strlen(value), true);
+    Raw("\"");
+  }
+
+  void Attribute(const char *name, uint64_t value)
+  {
+    char str[32];
+    StringFormat::snprintf(str, sizeof(str), "%llu", (unsigned long long)value);
+    Attribute(name, str);
+  }
+
+  void Attribute(const char *name, int64_t value)
+  {
+    char str[32];
+    StringFormat::snprintf(str, sizeof(str), "%lld", (long long)value);
+    Attribute(name, str);
+  }
+
+  void Attribute(const char *name, bool value) { Attribute(name, value ? "true" : "false"); }
+  // escapes and writes text content for the current element. Stops at the first NUL character,
+  // returning false if one was found.
+  bool Text(const char *str, size_t len)
+  {
+    BeginText();
+    return Escape(str, len, false);
+  }
+
+  void Text(const char *str) { Text(str, strlen(str)); }
+  void Text(uint64_t value)
+  {
+    char str[32];
+    StringFormat::snprintf(str, sizeof(str), "%llu", (unsigned long long)value);
+    Text(str);
+  }
+
+  void Text(int64_t value)
+  {
+    char str[32];
+    StringFormat::snprintf(str, sizeof(str), "%lld", (long long)value);
+    Text(str);
+  }
+
+  void Text(double value)
+  {
+    char str[64];
+    StringFormat::snprintf(str, sizeof(str), "%.17g", value);
+    Text(str);
+  }
+
+  void Text(bool value) { Text(value ? "true" : "false"); }
+  // writes pre-formatted text content that is known not to need escaping
+  void RawText(const std::string &str)
+  {
+    BeginText();
+    stream.Write(str.data(), str.size());
+  }
+
+private:
+  struct Element
+  {
+    const char *name;
+    bool open;
+    bool text;
+  };
+
+  std::vector<Element> elements;
+
+  void Raw(const char *str) { stream.Write(str, strlen(str)); }
+  void Indent()
+  {
+    for(size_t i = 0; i < elements.size(); i++)
+      stream.Write('\t');
+  }
+
+  void BeginText()
+  {
+    if(elements.back().open)
+    {
+      Raw(">");
+      elements.back().open = false;
+      elements.back().text = true;
+    }
+  }
+
+  // matches pugixml's escaping. Control characters in attributes other than tab must be escaped
+  // or they'd be normalised to spaces when read back.
+  static bool NeedsEscape(char c, bool attribute)
+  {
+    if(c == '&' || c == '<' || c == '>' || (attribute && c == '"'))
+      return true;
+
+    if((unsigned char)c >= 32 || c == '\t')
+      return false;
+
+    return attribute || (c != '\r' && c != '\n');
+  }
+
+  bool Escape(const char *str, size_t len, bool attribute)
+  {
+    const char *end = str + len;
+
+    while(str < end)
+    {
+      // write out runs of characters that don't need escaping in one go
+      const char *run = str;
+      while(str < end && !NeedsEscape(*str, attribute))
+        str++;
+
+      stream.Write(run, str - run);
+
+      if(str == end)
+        break;
+
+      char c = *str++;
+
+      switch(c)
+      {
+        case 0: return false;
+        case '&': Raw("&amp;"); break;
+        case '<': Raw("&lt;"); break;
+        case '>': Raw("&gt;"); break;
+        case '"': Raw("&quot;"); break;
+        default:
+        {
+          char escaped[6] = {'&', '#', char('0' + c / 10), char('0' + c % 10), ';', 0};
+          Raw(escaped);
+          break;
+        }
+      }
+    }
+
+    return true;
+  }
 };
 
 // avoid &, <, and > since they throw off the ascii alignment
@@ -86,18 +261,19 @@ static constexpr byte FromHex(const char c)
                                      : (c >= 'a' && c <= 'f' ? byte(c - 'a') + 10 : 0));
 }
 
-static void HexEncode(const std::vector<byte> &in, std::string &out)
+static void HexEncode(StreamReader &in, xml_stream_writer &xml)
 {
   const size_t bytesPerLine = 32;
   const size_t bytesPerGroup = 4;
 
   const char digit[] = "0123456789ABCDEF";
-  // Reserve rough required size:
-  // - 3 characters per byte (two for hex, 1 for ascii),
-  // - 4 characters per line (3x space between hex and ascii, newline)
-  // - 1 character per group (space)
-  // - 2 characters for leading/trailing newline
-  out.reserve(in.size() * 3 + (in.size() / bytesPerLine) * 4 + (in.size() / bytesPerGroup) + 2);
+
+  // encode a block at a time, so the input never needs to be fully resident
+  byte block[bytesPerLine * 128];
+
+  std::string out;
+  out.reserve(sizeof(block) * 3 + (sizeof(block) / bytesPerLine) * 4 +
+              (sizeof(block) / bytesPerGroup) + 2);
 
   // leading newline
   out = "\n";
@@ -106,26 +282,41 @@ static void HexEncode(const std::vector<byte> &in, std::string &out)
   std::string ascii;
 
   size_t i = 0;
-  for(byte c : in)
+  uint64_t remaining = in.GetSize() - in.GetOffset();
+  while(remaining > 0 && !in.IsErrored())
   {
-    out.push_back(digit[(c & 0xf0) >> 4]);
-    out.push_back(digit[(c & 0x0f) >> 0]);
+    size_t blockSize = (size_t)RDCMIN(remaining, (uint64_t)sizeof(block));
+    in.Read(block, blockSize);
+    remaining -= blockSize;
 
-    if(IsXMLPrintable((char)c))
-      ascii.push_back((char)c);
-    else
-      ascii.push_back('.');
-
-    i++;
-    if((i % bytesPerLine) == 0)
+    for(size_t b = 0; b < blockSize; b++)
     {
-      out += StringFormat::Fmt("   %s\n", ascii.c_str());
-      ascii.clear();
-    }
-    else if((i % bytesPerGroup) == 0)
-    {
-      out.push_back(' ');
+      byte c = block[b];
+
+      out.push_back(digit[(c & 0xf0) >> 4]);
+      out.push_back(digit[(c & 0x0f) >> 0]);
+
+      if(IsXMLPrintable((char)c))
+        ascii.push_back((char)c);
+      else
+        ascii.push_back('.');
+
+      i++;
+      if((i % bytesPerLine) == 0)
+      {
+        out += "   ";
+        out += ascii;
+        out.push_back('\n');
+        ascii.clear();
+      }
+      else if((i % bytesPerGroup) == 0)
+      {
+        out.push_back(' ');
+      }
     }
+
+    xml.RawText(out);
+    out.clear();
   }
 
   // add remaining part of a line, if we didn't end by completing one
@@ -145,8 +336,12 @@ static void HexEncode(const std::vector<byte> &in, std::string &out)
     }
 
     // add ascii and final newline
-    out += StringFormat::Fmt("   %s\n", ascii.c_str());
+    out += "   ";
+    out += ascii;
+    out.push_back('\n');
   }
+
+  xml.RawText(out);
 }
 
 static void HexDecode(const char *str, const char *end, std::vector<byte> &out)
@@ -186,127 +381,145 @@ static void HexDecode(const char *str, const char *end, std::vector<byte> &out)
   }
 }
 
-static void Obj2XML(pugi::xml_node &parent, SDObject &child)
+static void Obj2XML(xml_stream_writer &xml, const SDObject &child, bool arrayElement)
 {
-  pugi::xml_node obj = parent.append_child(typeNames[(uint32_t)child.type.basetype]);
+  xml.BeginElement(typeNames[(uint32_t)child.type.basetype]);
 
-  obj.append_attribute("name") = child.name.c_str();
+  // array elements are anonymous
+  if(!arrayElement)
+    xml.Attribute("name", child.name.c_str());
 
-  if(!child.type.name.empty())
-    obj.append_attribute("typename") = child.type.name.c_str();
+  // non-empty arrays get their typename from their elements
+  if(!child.type.name.empty() &&
+     (child.type.basetype != SDBasic::Array || child.data.children.empty()))
+    xml.Attribute("typename", child.type.name.c_str());
 
   if(child.type.basetype == SDBasic::UnsignedInteger ||
      child.type.basetype == SDBasic::SignedInteger || child.type.basetype == SDBasic::Float ||
      child.type.basetype == SDBasic::Resource)
   {
-    obj.append_attribute("width") = child.type.byteSize;
+    xml.Attribute("width", (uint64_t)child.type.byteSize);
   }
 
   if(child.type.flags & SDTypeFlags::Hidden)
-    obj.append_attribute("hidden") = true;
+    xml.Attribute("hidden", true);
 
-  if(child.type.flags & SDTypeFlags::Nullable)
-    obj.append_attribute("nullable") = true;
+  // nullable is redundant on null objects
+  if((child.type.flags & SDTypeFlags::Nullable) && child.type.basetype != SDBasic::Null)
+    xml.Attribute("nullable", true);
 
   if(child.type.flags & SDTypeFlags::NullString)
-    obj.append_attribute("nullstring") = true;
+    xml.Attribute("nullstring", true);
 
   if(child.type.flags & SDTypeFlags::FixedArray)
-    obj.append_attribute("fixedarray") = true;
+    xml.Attribute("fixedarray", true);
 
   if(child.type.flags & SDTypeFlags::Union)
-    obj.append_attribute("union") = true;
+    xml.Attribute("union", true);
 
   if(child.type.basetype == SDBasic::Chunk)
   {
     RDCFATAL("Nested chunks!");
   }
-  else if(child.type.basetype == SDBasic::Null)
-  {
-    // redundant
-    obj.remove_attribute("nullable");
-  }
   else if(child.type.basetype == SDBasic::Struct || child.type.basetype == SDBasic::Array)
   {
-    if(child.type.basetype == SDBasic::Array && !child.data.children.empty())
-      obj.remove_attribute("typename");
-
     for(size_t o = 0; o < child.data.children.size(); o++)
-    {
-      Obj2XML(obj, *child.data.children[o]);
-
-      if(child.type.basetype == SDBasic::Array)
-        obj.last_child().remove_attribute("name");
-    }
+      Obj2XML(xml, *child.data.children[o], child.type.basetype == SDBasic::Array);
   }
   else if(child.type.basetype == SDBasic::Buffer)
   {
-    obj.append_attribute("byteLength") = child.type.byteSize;
-    obj.text() = child.data.basic.u;
+    xml.Attribute("byteLength", (uint64_t)child.type.byteSize);
+    xml.Text((uint64_t)child.data.basic.u);
   }
-  else
+  else if(child.type.basetype != SDBasic::Null)
   {
     if(child.type.flags & SDTypeFlags::HasCustomString)
     {
-      obj.append_attribute("string") = child.data.str.c_str();
+      xml.Attribute("string", child.data.str.c_str());
     }
 
     switch(child.type.basetype)
     {
       case SDBasic::Resource:
       case SDBasic::Enum:
-      case SDBasic::UnsignedInteger: obj.text() = child.data.basic.u; break;
-      case SDBasic::SignedInteger: obj.text() = child.data.basic.i; break;
-      case SDBasic::String: obj.text() = child.data.str.c_str(); break;
-      case SDBasic::Float: obj.text() = child.data.basic.d; break;
-      case SDBasic::Boolean: obj.text() = child.data.basic.b; break;
+      case SDBasic::UnsignedInteger: xml.Text((uint64_t)child.data.basic.u); break;
+      case SDBasic::SignedInteger: xml.Text((int64_t)child.data.basic.i); break;
+      case SDBasic::String: xml.Text(child.data.str.c_str()); break;
+      case SDBasic::Float: xml.Text(child.data.basic.d); break;
+      case SDBasic::Boolean: xml.Text(child.data.basic.b); break;
       case SDBasic::Character:
       {
         char str[2] = {child.data.basic.c, '\0'};
-        obj.text().set(str);
+        xml.Text(str);
         break;
       }
       default: RDCERR("Unexpected case");
     }
   }
+
+  xml.EndElement();
+}
+
+// writes any buffers added to the file since the last call into the zip. Lazily loaded files only
+// need the buffer contents until they're written, so those are released as we go to keep memory
+// bounded by the chunks currently loaded.
+static void Buffers2ZIP(mz_zip_archive &zip, const SDFile &structData, size_t &numWritten)
+{
+  for(; numWritten < structData.buffers.size(); numWritten++)
+  {
+    bytebuf *buf = structData.buffers[numWritten];
+
+    mz_zip_writer_add_mem(&zip, GetBufferName(numWritten).c_str(), buf->data(), buf->size(), 2);
+
+    if(structData.IsLazy())
+    {
+      bytebuf empty;
+      empty.swap(*buf);
+    }
+  }
 }
 
-static ReplayStatus Structured2XML(const char *filename, const RDCFile &file, uint64_t version,
-                                   const StructuredChunkList &chunks,
+static ReplayStatus Structured2XML(const char *filename, const RDCFile &file,
+                                   const SDFile &structData, mz_zip_archive *zip,
                                    RENDERDOC_ProgressCallback progress)
 {
-  pugi::xml_document doc;
+  xml_stream_writer xml(filename);
 
-  pugi::xml_node xRoot = doc.append_child("rdc");
+  xml.BeginElement("rdc");
 
   {
-    pugi::xml_node xHeader = xRoot.append_child("header");
-
-    pugi::xml_node xDriver = xHeader.append_child("driver");
-    xDriver.append_attribute("id") = (uint32_t)file.GetDriver();
-    xDriver.text() = file.GetDriverName().c_str();
+    xml.BeginElement("header");
 
-    pugi::xml_node xIdent = xHeader.append_child("machineIdent");
+    xml.BeginElement("driver");
+    xml.Attribute("id", (uint64_t)file.GetDriver());
+    xml.Text(file.GetDriverName().c_str());
+    xml.EndElement();
 
-    xIdent.text().set(file.GetMachineIdent());
+    xml.BeginElement("machineIdent");
+    xml.Text((uint64_t)file.GetMachineIdent());
+    xml.EndElement();
 
-    pugi::xml_node xThumbnail = xHeader.append_child("thumbnail");
+    xml.BeginElement("thumbnail");
 
     const RDCThumb &th = file.GetThumbnail();
     if(th.pixels && th.len > 0 && th.width > 0 && th.height > 0)
     {
-      xThumbnail.append_attribute("width") = th.width;
-      xThumbnail.append_attribute("height") = th.height;
+      xml.Attribute("width", (uint64_t)th.width);
+      xml.Attribute("height", (uint64_t)th.height);
 
       if(th.format == FileType::JPG)
-        xThumbnail.text() = "thumb.jpg";
+        xml.Text("thumb.jpg");
       else if(th.format == FileType::PNG)
-        xThumbnail.text() = "thumb.png";
+        xml.Text("thumb.png");
       else if(th.format == FileType::Raw)
-        xThumbnail.text() = "thumb.raw";
+        xml.Text("thumb.raw");
       else
         RDCERR("Unexpected thumbnail format %s", ToStr(th.format).c_str());
     }
+
+    xml.EndElement();
+
+    xml.EndElement();
   }
 
   if(progress)
@@ -327,24 +540,26 @@ static ReplayStatus Structured2XML(const char *filename, const RDCFile &file, ui
       ExtThumbnailHeader thumbHeader = {};
       if(reader->Read(thumbHeader))
       {
-        // don't need to read the data, that's handled in Buffers2ZIP
+        // don't need to read the data, that's handled in Thumbnails2ZIP
         bool succeeded = reader->SkipBytes(thumbHeader.len) && !reader->IsErrored();
         if(succeeded && (uint32_t)thumbHeader.format < (uint32_t)FileType::Count)
         {
-          pugi::xml_node xExtThumbnail = xRoot.append_child("extended_thumbnail");
+          xml.BeginElement("extended_thumbnail");
 
-          xExtThumbnail.append_attribute("width") = thumbHeader.width;
-          xExtThumbnail.append_attribute("height") = thumbHeader.height;
-          xExtThumbnail.append_attribute("length") = thumbHeader.len;
+          xml.Attribute("width", (uint64_t)thumbHeader.width);
+          xml.Attribute("height", (uint64_t)thumbHeader.height);
+          xml.Attribute("length", (uint64_t)thumbHeader.len);
 
           if(thumbHeader.format == FileType::JPG)
-            xExtThumbnail.text() = "ext_thumb.jpg";
+            xml.Text("ext_thumb.jpg");
           else if(thumbHeader.format == FileType::PNG)
-            xExtThumbnail.text() = "ext_thumb.png";
+            xml.Text("ext_thumb.png");
           else if(thumbHeader.format == FileType::Raw)
-            xExtThumbnail.text() = "ext_thumb.raw";
+            xml.Text("ext_thumb.raw");
           else
             RDCERR("Unexpected extended thumbnail format %s", ToStr(thumbHeader.format).c_str());
+
+          xml.EndElement();
         }
       }
 
@@ -352,101 +567,135 @@ static ReplayStatus Structured2XML(const char *filename, const RDCFile &file, ui
       continue;
     }
 
-    pugi::xml_node xSection = xRoot.append_child("section");
+    xml.BeginElement("section");
 
     if(props.flags & SectionFlags::ASCIIStored)
-      xSection.append_attribute("ascii");
+      xml.Attribute("ascii", "");
     if(props.flags & SectionFlags::LZ4Compressed)
-      xSection.append_attribute("lz4");
+      xml.Attribute("lz4", "");
+    if(props.flags & SectionFlags::LZ4IndependentBlocks)
+      xml.Attribute("lz4independent", "");
     if(props.flags & SectionFlags::ZstdCompressed)
-      xSection.append_attribute("zstd");
+      xml.Attribute("zstd", "");
 
-    pugi::xml_node name = xSection.append_child("name");
-    name.text() = props.name.c_str();
+    xml.BeginElement("name");
+    xml.Text(props.name.c_str());
+    xml.EndElement();
 
-    pugi::xml_node secVer = xSection.append_child("version");
-    secVer.text() = props.version;
+    xml.BeginElement("version");
+    xml.Text((uint64_t)props.version);
+    xml.EndElement();
 
-    pugi::xml_node type = xSection.append_child("type");
-    type.text() = (uint32_t)props.type;
+    xml.BeginElement("type");
+    xml.Text((uint64_t)props.type);
+    xml.EndElement();
 
-    std::vector<byte> contents;
-    contents.resize((size_t)reader->GetSize());
-    reader->Read(contents.data(), reader->GetSize());
-
-    pugi::xml_node data = xSection.append_child("data");
+    xml.BeginElement("data");
 
     if(props.flags & SectionFlags::ASCIIStored)
     {
-      // insert the contents literally
-      data.text().set((char *)contents.data());
+      // insert the contents literally, up to any NUL terminator
+      char block[4096];
+      uint64_t remaining = reader->GetSize();
+
+      // always emit text, even if empty
+      xml.Text("");
+
+      while(remaining > 0 && !reader->IsErrored())
+      {
+        size_t blockSize = (size_t)RDCMIN(remaining, (uint64_t)sizeof(block));
+        reader->Read(block, blockSize);
+        remaining -= blockSize;
+
+        if(!xml.Text(block, blockSize))
+          break;
+      }
     }
     else
     {
       // encode to simple hex. Not efficient, but easy.
-      std::string hexdata;
-      hexdata.reserve(contents.size() * 2);
-      HexEncode(contents, hexdata);
-      data.text().set(hexdata.c_str());
+      HexEncode(*reader, xml);
     }
 
+    xml.EndElement();
+
+    xml.EndElement();
+
     delete reader;
   }
 
   if(progress)
     progress(StructuredProgress(0.2f));
 
-  pugi::xml_node xChunks = xRoot.append_child("chunks");
+  size_t numBuffers = 0;
+  if(zip)
+    Buffers2ZIP(*zip, structData, numBuffers);
 
-  xChunks.append_attribute("version") = version;
+  xml.BeginElement("chunks");
 
-  for(size_t c = 0; c < chunks.size(); c++)
+  xml.Attribute("version", (uint64_t)structData.version);
+
+  for(size_t c = 0; c < structData.chunks.size(); c++)
   {
-    pugi::xml_node xChunk = xChunks.append_child("chunk");
-    SDChunk *chunk = chunks[c];
+    SDChunk *chunk = structData.GetChunk(c);
+
+    xml.BeginElement("chunk");
 
-    xChunk.append_attribute("id") = chunk->metadata.chunkID;
-    xChunk.append_attribute("name") = chunk->name.c_str();
-    xChunk.append_attribute("length") = chunk->metadata.length;
+    xml.Attribute("id", (uint64_t)chunk->metadata.chunkID);
+    xml.Attribute("name", chunk->name.c_str());
+    xml.Attribute("length", (uint64_t)chunk->metadata.length);
     if(chunk->metadata.threadID)
-      xChunk.append_attribute("threadID") = chunk->metadata.threadID;
+      xml.Attribute("threadID", (uint64_t)chunk->metadata.threadID);
     if(chunk->metadata.timestampMicro)
-      xChunk.append_attribute("timestamp") = chunk->metadata.timestampMicro;
+      xml.Attribute("timestamp", (uint64_t)chunk->metadata.timestampMicro);
     if(chunk->metadata.durationMicro >= 0)
-      xChunk.append_attribute("duration") = chunk->metadata.durationMicro;
+      xml.Attribute("duration", (int64_t)chunk->metadata.durationMicro);
+    if(chunk->metadata.flags & SDChunkFlags::OpaqueChunk)
+      xml.Attribute("opaque", true);
+
     if(chunk->metadata.flags & SDChunkFlags::HasCallstack)
     {
-      pugi::xml_node stack = xChunk.append_child("callstack");
+      xml.BeginElement("callstack");
 
       for(size_t i = 0; i < chunk->metadata.callstack.size(); i++)
       {
-        stack.append_child("address").text() = chunk->metadata.callstack[i];
+        xml.BeginElement("address");
+        xml.Text((uint64_t)chunk->metadata.callstack[i]);
+        xml.EndElement();
       }
+
+      xml.EndElement();
     }
 
     if(chunk->metadata.flags & SDChunkFlags::OpaqueChunk)
     {
-      xChunk.append_attribute("opaque") = true;
-
       RDCASSERT(!chunk->data.children.empty());
-      pugi::xml_node opaque = xChunk.append_child("buffer");
-      opaque.append_attribute("byteLength") = chunk->data.children[0]->type.byteSize;
-      opaque.text() = chunk->data.children[0]->data.basic.u;
+      xml.BeginElement("buffer");
+      xml.Attribute("byteLength", (uint64_t)chunk->data.children[0]->type.byteSize);
+      xml.Text((uint64_t)chunk->data.children[0]->data.basic.u);
+      xml.EndElement();
     }
     else
     {
       for(size_t o = 0; o < chunk->data.children.size(); o++)
-        Obj2XML(xChunk, *chunk->data.children[o]);
+        Obj2XML(xml, *chunk->data.children[o], false);
     }
 
+    xml.EndElement();
+
+    // flush out the buffers this chunk added, if it was lazily loaded
+    if(zip)
+      Buffers2ZIP(*zip, structData, numBuffers);
+
     if(progress)
-      progress(StructuredProgress(0.2f + 0.8f * (float(c) / float(chunks.size()))));
+      progress(StructuredProgress(0.2f + 0.8f * (float(c) / float(structData.chunks.size()))));
   }
 
-  xml_file_writer writer(filename);
-  doc.save(writer);
+  xml.EndElement();
 
-  return writer.stream.IsErrored() ? ReplayStatus::FileIOFailed : ReplayStatus::Succeeded;
+  xml.EndElement();
+
+  return xml.stream.IsErrored() ? ReplayStatus::FileIOFailed : ReplayStatus::Succeeded;
 }
 
 static SDObject *XML2Obj(pugi::xml_node &obj)
@@ -542,14 +791,246 @@ static SDObject *XML2Obj(pugi::xml_node &obj)
   return ret;
 }
 
-static ReplayStatus XML2Structured(const char *xml, const ThumbTypeAndData &thumb,
-                                   const ThumbTypeAndData &extThumb,
-                                   const StructuredBufferList &buffers, RDCFile *rdc,
+// reads an xml document incrementally from a stream. Everything before the chunks is small and is
+// parsed as one document, then each chunk is parsed on its own as it's reached, so only one chunk's
+// xml is held in memory at a time.
+struct xml_stream_reader
+{
+  xml_stream_reader(StreamReader &stream) : stream(stream) {}
+  // parses everything up to and including the chunks start tag, closing off any open elements.
+  bool ReadPrologue(pugi::xml_document &doc)
+  {
+    size_t start = Find("<chunks", 0);
+    if(start == std::string::npos)
+      return false;
+
+    size_t end = FindTagEnd(start);
+    if(end == std::string::npos)
+      return false;
+
+    std::string prologue = window.substr(0, end + 1);
+
+    if(window[end - 1] == '/')
+    {
+      chunksEnded = true;
+    }
+    else
+    {
+      prologue += "</chunks>";
+    }
+
+    prologue += "</rdc>";
+
+    window.erase(0, end + 1);
+
+    return doc.load_buffer(prologue.data(), prologue.size());
+  }
+
+  // parses the next chunk into doc. Returns false with doc empty when the chunks are finished, or
+  // with errored set if the document is malformed.
+  bool ReadChunk(pugi::xml_document &doc)
+  {
+    doc.reset();
+
+    if(chunksEnded)
+      return false;
+
+    size_t start = SkipWhitespace(0);
+
+    if(start == std::string::npos || !Ensure(start + 9))
+    {
+      errored = true;
+      return false;
+    }
+
+    if(!window.compare(start, 9, "</chunks>"))
+    {
+      chunksEnded = true;
+      return false;
+    }
+
+    char c = window[start + 6];
+    if(window.compare(start, 6, "<chunk") || !(IsSpace(c) || c == '>' || c == '/'))
+    {
+      errored = true;
+      return false;
+    }
+
+    size_t end = FindTagEnd(start);
+
+    // if the chunk isn't self-closing, find its end tag. Element text is escaped and chunks don't
+    // nest, so the first one we see is the matching one.
+    if(end != std::string::npos && window[end - 1] != '/')
+    {
+      const char closeTag[] = "</chunk>";
+      end = Find(closeTag, end);
+      if(end != std::string::npos)
+        end += sizeof(closeTag) - 2;
+    }
+
+    if(end == std::string::npos || !doc.load_buffer(window.data() + start, end + 1 - start))
+    {
+      errored = true;
+      return false;
+    }
+
+    window.erase(0, end + 1);
+
+    return true;
+  }
+
+  bool errored = false;
+
+private:
+  static bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+  static const size_t BlockSize = 1024 * 1024;
+
+  StreamReader &stream;
+  std::string window;
+  bool chunksEnded = false;
+
+  bool Fill()
+  {
+    uint64_t remaining = stream.GetSize() - stream.GetOffset();
+    if(remaining == 0 || stream.IsErrored())
+      return false;
+
+    size_t oldSize = window.size();
+    size_t blockSize = (size_t)RDCMIN(remaining, (uint64_t)BlockSize);
+    window.resize(oldSize + blockSize);
+    return stream.Read(&window[oldSize], blockSize);
+  }
+
+  bool Ensure(size_t size)
+  {
+    while(window.size() < size)
+      if(!Fill())
+        return false;
+    return true;
+  }
+
+  size_t Find(const char *str, size_t from)
+  {
+    size_t len = strlen(str);
+
+    for(;;)
+    {
+      size_t ret = window.find(str, from);
+      if(ret != std::string::npos)
+        return ret;
+
+      // a match could straddle the end of the window, so only skip what can't contain one
+      if(window.size() >= len)
+        from = RDCMAX(from, window.size() - len + 1);
+
+      if(!Fill())
+        return std::string::npos;
+    }
+  }
+
+  size_t SkipWhitespace(size_t from)
+  {
+    for(;;)
+    {
+      while(from < window.size() && IsSpace(window[from]))
+        from++;
+
+      if(from < window.size())
+        return from;
+
+      if(!Fill())
+        return std::string::npos;
+    }
+  }
+
+  // returns the offset of the '>' ending the tag that begins at start, skipping over any in quoted
+  // attribute values
+  size_t FindTagEnd(size_t start)
+  {
+    char quote = 0;
+
+    for(size_t i = start;; i++)
+    {
+      if(i >= window.size() && !Fill())
+        return std::string::npos;
+
+      char c = window[i];
+
+      if(quote)
+      {
+        if(c == quote)
+          quote = 0;
+      }
+      else if(c == '"' || c == '\'')
+      {
+        quote = c;
+      }
+      else if(c == '>')
+      {
+        return i;
+      }
+    }
+  }
+};
+
+static SDChunk *XML2Chunk(pugi::xml_node &xChunk)
+{
+  SDChunk *chunk = new SDChunk(xChunk.attribute("name").as_string());
+
+  chunk->metadata.chunkID = xChunk.attribute("id").as_uint();
+  chunk->metadata.length = xChunk.attribute("length").as_uint();
+  if(xChunk.attribute("threadID"))
+    chunk->metadata.threadID = xChunk.attribute("threadID").as_ullong();
+  if(xChunk.attribute("timestamp"))
+    chunk->metadata.timestampMicro = xChunk.attribute("timestamp").as_ullong();
+  if(xChunk.attribute("duration"))
+    chunk->metadata.durationMicro = xChunk.attribute("duration").as_ullong();
+
+  pugi::xml_node callstack = xChunk.child("callstack");
+  if(callstack)
+  {
+    chunk->metadata.flags |= SDChunkFlags::HasCallstack;
+
+    for(pugi::xml_node address = callstack.first_child(); address; address = address.next_sibling())
+      chunk->metadata.callstack.push_back(address.text().as_ullong());
+  }
+
+  if(xChunk.attribute("opaque"))
+  {
+    pugi::xml_node opaque = xChunk.child("buffer");
+
+    chunk->metadata.flags |= SDChunkFlags::OpaqueChunk;
+
+    chunk->data.children.push_back(new SDObject("Opaque chunk", "Byte Buffer"));
+    chunk->data.children[0]->type.basetype = SDBasic::Buffer;
+    chunk->data.children[0]->type.byteSize = opaque.attribute("byteLength").as_ullong();
+    chunk->data.children[0]->data.basic.u = opaque.text().as_ullong();
+  }
+  else
+  {
+    for(pugi::xml_node child = xChunk.first_child(); child; child = child.next_sibling())
+    {
+      if(child != callstack)
+        chunk->data.children.push_back(XML2Obj(child));
+    }
+  }
+
+  return chunk;
+}
+
+static ReplayStatus XML2Structured(StreamReader &reader, const ThumbTypeAndData &thumb,
+                                   const ThumbTypeAndData &extThumb, RDCFile *rdc,
                                    uint64_t &version, StructuredChunkList &chunks,
                                    RENDERDOC_ProgressCallback progress)
 {
+  xml_stream_reader xml(reader);
+
   pugi::xml_document doc;
-  doc.load_string(xml);
+  if(!xml.ReadPrologue(doc))
+  {
+    RDCERR("Malformed document, expected chunks node");
+    return ReplayStatus::FileCorrupted;
+  }
 
   pugi::xml_node root = doc.child("rdc");
 
@@ -645,6 +1126,8 @@ static ReplayStatus XML2Structured(const char *xml, const ThumbTypeAndData &thum
       props.flags |= SectionFlags::ASCIIStored;
     if(xSection.attribute("lz4"))
       props.flags |= SectionFlags::LZ4Compressed;
+    if(xSection.attribute("lz4independent"))
+      props.flags |= SectionFlags::LZ4IndependentBlocks;
     if(xSection.attribute("zstd"))
       props.flags |= SectionFlags::ZstdCompressed;
 
@@ -724,92 +1207,30 @@ static ReplayStatus XML2Structured(const char *xml, const ThumbTypeAndData &thum
 
   version = xChunks.attribute("version").as_ullong();
 
-  size_t chunkIdx = 0;
-  size_t numChunks = std::distance(xChunks.begin(), xChunks.end());
+  pugi::xml_document chunkDoc;
+  uint64_t size = RDCMAX(reader.GetSize(), (uint64_t)1);
 
-  for(pugi::xml_node xChunk = xChunks.first_child(); xChunk; xChunk = xChunk.next_sibling())
+  while(xml.ReadChunk(chunkDoc))
   {
-    if(strcmp(xChunk.name(), "chunk"))
-      return ReplayStatus::FileCorrupted;
-
-    SDChunk *chunk = new SDChunk(xChunk.attribute("name").as_string());
-
-    chunk->metadata.chunkID = xChunk.attribute("id").as_uint();
-    chunk->metadata.length = xChunk.attribute("length").as_uint();
-    if(xChunk.attribute("threadID"))
-      chunk->metadata.threadID = xChunk.attribute("threadID").as_ullong();
-    if(xChunk.attribute("timestamp"))
-      chunk->metadata.timestampMicro = xChunk.attribute("timestamp").as_ullong();
-    if(xChunk.attribute("duration"))
-      chunk->metadata.durationMicro = xChunk.attribute("duration").as_ullong();
-
-    pugi::xml_node callstack = xChunk.child("callstack");
-    if(callstack)
-    {
-      chunk->metadata.flags |= SDChunkFlags::HasCallstack;
-
-      size_t i = 0;
-      for(pugi::xml_node address = callstack.first_child(); address; address = address.next_sibling())
-      {
-        chunk->metadata.callstack.push_back(address.text().as_ullong());
-        i++;
-      }
-    }
-
-    if(xChunk.attribute("opaque"))
-    {
-      pugi::xml_node opaque = xChunk.child("buffer");
-
-      chunk->metadata.flags |= SDChunkFlags::OpaqueChunk;
+    pugi::xml_node xChunk = chunkDoc.first_child();
 
-      chunk->data.children.push_back(new SDObject("Opaque chunk", "Byte Buffer"));
-      chunk->data.children[0]->type.basetype = SDBasic::Buffer;
-      chunk->data.children[0]->type.byteSize = opaque.attribute("byteLength").as_ullong();
-      chunk->data.children[0]->data.basic.u = opaque.text().as_ullong();
-    }
-    else
-    {
-      for(pugi::xml_node child = xChunk.first_child(); child; child = child.next_sibling())
-        chunk->data.children.push_back(XML2Obj(child));
-    }
-
-    chunks.push_back(chunk);
+    chunks.push_back(XML2Chunk(xChunk));
 
     if(progress)
-      progress(StructuredProgress(0.2f + 0.8f * (float(chunkIdx) / float(numChunks))));
+      progress(StructuredProgress(0.2f + 0.8f * (float(reader.GetOffset()) / float(size))));
+  }
 
-    chunkIdx++;
+  if(xml.errored)
+  {
+    RDCERR("Malformed document, expected chunk node");
+    return ReplayStatus::FileCorrupted;
   }
 
   return ReplayStatus::Succeeded;
 }
 
-static ReplayStatus Buffers2ZIP(const std::string &filename, const RDCFile &file,
-                                const StructuredBufferList &buffers,
-                                RENDERDOC_ProgressCallback progress)
+static void Thumbnails2ZIP(mz_zip_archive &zip, const RDCFile &file)
 {
-  std::string zipFile = filename;
-  zipFile.erase(zipFile.size() - 4);    // remove the .xml, leave only the .zip
-
-  mz_zip_archive zip;
-  memset(&zip, 0, sizeof(zip));
-
-  mz_bool b = mz_zip_writer_init_file(&zip, zipFile.c_str(), 0);
-
-  if(!b)
-  {
-    RDCERR("Failed to open .zip file '%s'", zipFile.c_str());
-    return ReplayStatus::FileIOFailed;
-  }
-
-  for(size_t i = 0; i < buffers.size(); i++)
-  {
-    mz_zip_writer_add_mem(&zip, GetBufferName(i).c_str(), buffers[i]->data(), buffers[i]->size(), 2);
-
-    if(progress)
-      progress(BufferProgress(float(i) / float(buffers.size())));
-  }
-
   const RDCThumb &th = file.GetThumbnail();
   if(th.pixels && th.len > 0 && th.width > 0 && th.height > 0)
   {
@@ -859,11 +1280,6 @@ static ReplayStatus Buffers2ZIP(const std::string &filename, const RDCFile &file
       break;
     }
   }
-
-  mz_zip_writer_finalize_archive(&zip);
-  mz_zip_writer_end(&zip);
-
-  return ReplayStatus::Succeeded;
 }
 
 static bool ZIP2Buffers(const std::string &filename, ThumbTypeAndData &thumb,
@@ -895,9 +1311,10 @@ static bool ZIP2Buffers(const std::string &filename, ThumbTypeAndData &thumb,
       mz_zip_archive_file_stat zstat;
       mz_zip_reader_file_stat(&zip, i, &zstat);
 
-      size_t sz = 0;
+      size_t sz = (size_t)zstat.m_uncomp_size;
 
-      byte *buf = (byte *)mz_zip_reader_extract_to_heap(&zip, i, &sz, 0);
+      // decompress straight into the destination rather than via a temporary heap copy
+      bytebuf *dst = NULL;
 
       // thumbnails are stored separately
       if(strstr(zstat.m_filename, "thumb"))
@@ -911,12 +1328,12 @@ static bool ZIP2Buffers(const std::string &filename, ThumbTypeAndData &thumb,
         if(strstr(zstat.m_filename, "ext_thumb"))
         {
           extThumb.format = type;
-          extThumb.data.assign(buf, sz);
+          dst = &extThumb.data;
         }
         else
         {
           thumb.format = type;
-          thumb.data.assign(buf, sz);
+          dst = &thumb.data;
         }
       }
       else
@@ -926,10 +1343,17 @@ static bool ZIP2Buffers(const std::string &filename, ThumbTypeAndData &thumb,
         if(bufname < (int)buffers.size())
         {
           buffers[bufname] = new bytebuf;
-          buffers[bufname]->assign(buf, sz);
+          dst = buffers[bufname];
         }
       }
 
+      if(dst)
+      {
+        dst->resize(sz);
+        if(sz > 0 && !mz_zip_reader_extract_to_mem(&zip, i, dst->data(), sz, 0))
+          RDCERR("Failed to extract %s from zip", zstat.m_filename);
+      }
+
       if(progress)
         progress(BufferProgress(float(i) / float(numfiles)));
     }
@@ -954,30 +1378,42 @@ ReplayStatus importXMLZ(const char *filename, StreamReader &reader, RDCFile *rdc
     }
   }
 
-  uint64_t len = reader.GetSize();
-  char *buf = new char[(size_t)len + 1];
-  reader.Read(buf, (size_t)len);
-  buf[len] = 0;
-
-  return XML2Structured(buf, thumb, extThumb, structData.buffers, rdc, structData.version,
-                        structData.chunks, progress);
+  return XML2Structured(reader, thumb, extThumb, rdc, structData.version, structData.chunks,
+                        progress);
 }
 
 ReplayStatus exportXMLZ(const char *filename, const RDCFile &rdc, const SDFile &structData,
                         RENDERDOC_ProgressCallback progress)
 {
-  ReplayStatus ret = Buffers2ZIP(filename, rdc, structData.buffers, progress);
+  std::string zipFile = filename;
+  zipFile.erase(zipFile.size() - 4);    // remove the .xml, leave only the .zip
+
+  mz_zip_archive zip;
+  memset(&zip, 0, sizeof(zip));
+
+  mz_bool b = mz_zip_writer_init_file(&zip, zipFile.c_str(), 0);
 
-  if(ret != ReplayStatus::Succeeded)
-    return ret;
+  if(!b)
+  {
+    RDCERR("Failed to open .zip file '%s'", zipFile.c_str());
+    return ReplayStatus::FileIOFailed;
+  }
+
+  // buffers are written to the zip as the chunks referencing them are written
+  ReplayStatus ret = Structured2XML(filename, rdc, structData, &zip, progress);
 
-  return Structured2XML(filename, rdc, structData.version, structData.chunks, progress);
+  Thumbnails2ZIP(zip, rdc);
+
+  mz_zip_writer_finalize_archive(&zip);
+  mz_zip_writer_end(&zip);
+
+  return ret;
 }
 
 ReplayStatus exportXMLOnly(const char *filename, const RDCFile &rdc, const SDFile &structData,
                            RENDERDOC_ProgressCallback progress)
 {
-  return Structured2XML(filename, rdc, structData.version, structData.chunks, progress);
+  return Structured2XML(filename, rdc, structData, NULL, progress);
 }
 
 static ConversionRegistration XMLZIPConversionRegistration(
@@ -996,4 +1432,181 @@ static ConversionRegistration XMLOnlyConversionRegistration(
         R"(Stores the structured data in an xml tree, with large buffer data omitted - that makes it
 easier to work with but it cannot then be imported.)",
         false,
-    });
\ No newline at end of file
+    });
+#if ENABLED(ENABLE_UNIT_TESTS)
+#include "3rdparty/catch/catch.hpp"
+
+TEST_CASE("XML+ZIP export and import round-trip", "[serialiser][xml]")
+{
+  std::string filename = FileIO::GetTempFolderFilename() + "rdoc_xml_codec_test.zip.xml";
+
+  RDCFile rdc;
+  rdc.SetData(RDCDriver::Vulkan, "Vulkan", 0x1234, NULL);
+
+  const char notes[] = "Some <notes> & \"quotes\"\r\nacross lines";
+
+  std::vector<byte> resolveData;
+  resolveData.resize(1000);
+  for(size_t i = 0; i < resolveData.size(); i++)
+    resolveData[i] = byte((i * 13) & 0xff);
+
+  {
+    SectionProperties props;
+    props.type = SectionType::Notes;
+    props.name = ToStr(props.type);
+    props.flags = SectionFlags::ASCIIStored;
+    props.version = 1;
+
+    StreamWriter *w = rdc.WriteSection(props);
+    w->Write(notes, sizeof(notes) - 1);
+    w->Finish();
+    delete w;
+
+    props.type = SectionType::ResolveDatabase;
+    props.name = ToStr(props.type);
+    props.flags = SectionFlags::NoFlags;
+
+    w = rdc.WriteSection(props);
+    w->Write(resolveData.data(), resolveData.size());
+    w->Finish();
+    delete w;
+  }
+
+  // large enough that chunks straddle the reader's blocks
+  std::string longString;
+  longString.resize(1500 * 1024);
+  for(size_t i = 0; i < longString.size(); i++)
+    longString[i] = "ab<>&\"\t\n"[i % 8];
+
+  const char specialString[] = "<chunk> </chunk> </chunks> & \"quoted\"\x01\n";
+
+  SDFile file;
+  file.version = 42;
+
+  for(uint32_t c = 0; c < 8; c++)
+  {
+    SDChunk *chunk = new SDChunk(c == 3 ? "<chunk name=\"quoted\">" : "TestChunk");
+    chunk->metadata.chunkID = 100 + c;
+    chunk->metadata.length = c * 10;
+    chunk->metadata.threadID = c;
+    chunk->metadata.durationMicro = c * 3;
+
+    if(c == 2)
+    {
+      chunk->metadata.flags |= SDChunkFlags::HasCallstack;
+      chunk->metadata.callstack.push_back(0x1000);
+      chunk->metadata.callstack.push_back(0x2000);
+    }
+
+    SDObject *obj = new SDObject("object", "TestStruct");
+    obj->type.basetype = SDBasic::Struct;
+    obj->data.children.push_back(makeSDUInt32("index", c));
+    obj->data.children.push_back(makeSDInt64("negative", -int64_t(c)));
+    obj->data.children.push_back(makeSDFloat("value", 1.5f + c));
+    obj->data.children.push_back(makeSDString("str", c == 5 ? longString.c_str() : specialString));
+
+    SDObject *arr = makeSDArray("array");
+    for(uint32_t i = 0; i < c; i++)
+      arr->data.children.push_back(makeSDUInt32("$el", i * c));
+    obj->data.children.push_back(arr);
+
+    chunk->data.children.push_back(obj);
+
+    SDObject *buf = new SDObject("buffer", "Byte Buffer");
+    buf->type.basetype = SDBasic::Buffer;
+    buf->type.byteSize = 16 + c;
+    buf->data.basic.u = file.buffers.size();
+    chunk->data.children.push_back(buf);
+
+    bytebuf *contents = new bytebuf;
+    contents->resize(16 + c);
+    for(size_t i = 0; i < contents->size(); i++)
+      contents->data()[i] = byte(i + c);
+    file.buffers.push_back(contents);
+
+    file.chunks.push_back(chunk);
+  }
+
+  REQUIRE(exportXMLZ(filename.c_str(), rdc, file, NULL) == ReplayStatus::Succeeded);
+
+  RDCFile imported;
+  SDFile importedFile;
+
+  {
+    StreamReader reader(FileIO::fopen(filename.c_str(), "rb"));
+    REQUIRE(importXMLZ(filename.c_str(), reader, &imported, importedFile, NULL) ==
+            ReplayStatus::Succeeded);
+  }
+
+  CHECK(imported.GetDriver() == RDCDriver::Vulkan);
+  CHECK(imported.GetDriverName() == "Vulkan");
+  CHECK(imported.GetMachineIdent() == 0x1234);
+
+  {
+    int idx = imported.SectionIndex(SectionType::Notes);
+    REQUIRE(idx >= 0);
+
+    StreamReader *reader = imported.ReadSection(idx);
+    std::string contents;
+    contents.resize((size_t)reader->GetSize());
+    reader->Read(&contents[0], contents.size());
+    delete reader;
+
+    // line endings are normalised when the xml is parsed
+    CHECK(contents == "Some <notes> & \"quotes\"\nacross lines");
+
+    idx = imported.SectionIndex(SectionType::ResolveDatabase);
+    REQUIRE(idx >= 0);
+
+    reader = imported.ReadSection(idx);
+    std::vector<byte> data;
+    data.resize((size_t)reader->GetSize());
+    reader->Read(data.data(), data.size());
+    delete reader;
+
+    CHECK(data == resolveData);
+  }
+
+  CHECK(importedFile.version == 42);
+  REQUIRE(importedFile.chunks.size() == file.chunks.size());
+  REQUIRE(importedFile.buffers.size() == file.buffers.size());
+
+  for(size_t c = 0; c < file.chunks.size(); c++)
+  {
+    SDChunk *a = file.chunks[c];
+    SDChunk *b = importedFile.chunks[c];
+
+    CHECK(a->name == b->name);
+    CHECK(a->metadata.chunkID == b->metadata.chunkID);
+    CHECK(a->metadata.length == b->metadata.length);
+    CHECK(a->metadata.threadID == b->metadata.threadID);
+    CHECK(a->metadata.durationMicro == b->metadata.durationMicro);
+    CHECK(a->metadata.callstack == b->metadata.callstack);
+
+    REQUIRE(b->NumChildren() == 2);
+
+    SDObject *obj = b->GetChild(0);
+    REQUIRE(obj->NumChildren() == 5);
+    CHECK(obj->GetChild(0)->AsUInt32() == c);
+    CHECK(obj->GetChild(1)->AsInt64() == -int64_t(c));
+    CHECK(obj->GetChild(2)->AsFloat() == 1.5f + c);
+    CHECK(obj->GetChild(3)->AsString() == a->GetChild(0)->GetChild(3)->AsString());
+    REQUIRE(obj->GetChild(4)->NumChildren() == c);
+    for(size_t i = 0; i < c; i++)
+      CHECK(obj->GetChild(4)->GetChild(i)->AsUInt32() == i * c);
+
+    SDObject *buf = b->GetChild(1);
+    CHECK(buf->type.basetype == SDBasic::Buffer);
+    CHECK(buf->type.byteSize == 16 + c);
+    REQUIRE(buf->data.basic.u < importedFile.buffers.size());
+    CHECK(*importedFile.buffers[(size_t)buf->data.basic.u] == *file.buffers[c]);
+  }
+
+  std::string zipFile = filename;
+  zipFile.erase(zipFile.size() - 4);
+
+  FileIO::Delete(filename.c_str());
+  FileIO::Delete(zipFile.c_str());
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
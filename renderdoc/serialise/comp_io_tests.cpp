@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  ******************************************************************************/
 
+#include "common/timing.h"
 #include "lz4io.h"
 #include "serialiser.h"
 #include "zstdio.h"
@@ -110,6 +111,221 @@ TEST_CASE("Test LZ4 compression/decompression", "[streamio][lz4]")
   delete[] randomData;
 };
 
+TEST_CASE("Test LZ4 independent block compression/decompression", "[streamio][lz4]")
+{
+  const size_t size = 4 * 1024 * 1024 + 1234;
+
+  byte *data = new byte[size];
+
+  // mix of compressible and incompressible regions, with a repeating header every 4kb that the
+  // dictionary can match against
+  for(size_t i = 0; i < size; i++)
+  {
+    if((i % 4096) < 64)
+      data[i] = byte((i % 4096) * 3);
+    else if((i / 65536) % 3 == 0)
+      data[i] = rand() & 0xff;
+    else
+      data[i] = i & 0xff;
+  }
+
+  std::vector<byte> dictionary;
+  for(size_t i = 0; i < 64; i++)
+    dictionary.push_back(byte(i * 3));
+
+  SECTION("Without dictionary")
+  {
+    dictionary.clear();
+  }
+
+  SECTION("With dictionary")
+  {
+  }
+
+  StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+  {
+    StreamWriter writer(new LZ4Compressor(&buf, Ownership::Nothing, 4, dictionary),
+                        Ownership::Stream);
+
+    // write in awkward sizes so that writes span blocks
+    size_t offs = 0;
+    while(offs < size)
+    {
+      size_t chunk = RDCMIN(size - offs, size_t(10000 + (offs % 77777)));
+      writer.Write(data + offs, chunk);
+      offs += chunk;
+    }
+
+    writer.Finish();
+
+    CHECK_FALSE(writer.IsErrored());
+    CHECK(writer.GetOffset() == size);
+  }
+
+  CHECK(buf.GetOffset() < size);
+
+  byte *readData = new byte[size];
+
+  // decompress with the same number of threads
+  {
+    StreamReader reader(new LZ4Decompressor(new StreamReader(buf.GetData(), buf.GetOffset()),
+                                            Ownership::Stream, 4, dictionary),
+                        size, Ownership::Stream);
+
+    memset(readData, 0, size);
+    reader.Read(readData, size);
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+    CHECK_FALSE(memcmp(readData, data, size));
+  }
+
+  // decompress with a different number of threads, in small reads
+  {
+    StreamReader reader(new LZ4Decompressor(new StreamReader(buf.GetData(), buf.GetOffset()),
+                                            Ownership::Stream, 1, dictionary),
+                        size, Ownership::Stream);
+
+    memset(readData, 0, size);
+    for(size_t offs = 0; offs < size; offs += 1000)
+      reader.Read(readData + offs, RDCMIN(size - offs, size_t(1000)));
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+    CHECK_FALSE(memcmp(readData, data, size));
+  }
+
+  // without a dictionary the blocks are plain LZ4 and the default decompressor can read them
+  if(dictionary.empty())
+  {
+    StreamReader reader(
+        new LZ4Decompressor(new StreamReader(buf.GetData(), buf.GetOffset()), Ownership::Stream),
+        size, Ownership::Stream);
+
+    memset(readData, 0, size);
+    reader.Read(readData, size);
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+    CHECK_FALSE(memcmp(readData, data, size));
+  }
+
+  // blocks can be decompressed on their own, so any offset can be sought to in either direction
+  {
+    StreamReader reader(new LZ4Decompressor(new StreamReader(buf.GetData(), buf.GetOffset()),
+                                            Ownership::Stream, 2, dictionary),
+                        size, Ownership::Stream);
+
+    const size_t offsets[] = {
+        3 * 1024 * 1024 + 17, 100, 0, 65536 - 10, size - 1000, 65536 * 5, 2 * 1024 * 1024 - 5,
+    };
+
+    for(size_t offs : offsets)
+    {
+      reader.SetOffset(offs);
+      CHECK(reader.GetOffset() == offs);
+
+      memset(readData, 0, 1000);
+      reader.Read(readData, 1000);
+      CHECK_FALSE(memcmp(readData, data + offs, 1000));
+    }
+
+    CHECK_FALSE(reader.IsErrored());
+
+    reader.SetOffset(size);
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+  }
+
+  // recompressing goes through every block
+  {
+    LZ4Decompressor decomp(new StreamReader(buf.GetData(), buf.GetOffset()), Ownership::Stream, 2,
+                           dictionary);
+
+    StreamWriter recompressed(StreamWriter::DefaultScratchSize);
+
+    {
+      ZSTDCompressor comp(&recompressed, Ownership::Nothing);
+      CHECK(decomp.Recompress(&comp));
+    }
+
+    StreamReader reader(new ZSTDDecompressor(
+                            new StreamReader(recompressed.GetData(), recompressed.GetOffset()),
+                            Ownership::Stream),
+                        size, Ownership::Stream);
+
+    memset(readData, 0, size);
+    reader.Read(readData, size);
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK_FALSE(memcmp(readData, data, size));
+  }
+
+  delete[] readData;
+  delete[] data;
+};
+
+TEST_CASE("Benchmark LZ4 independent block compression", "[.][benchmark][lz4]")
+{
+  const size_t size = 256 * 1024 * 1024;
+
+  byte *data = new byte[size];
+
+  // roughly capture-like data: mostly compressible with some noise
+  for(size_t i = 0; i < size; i++)
+    data[i] = (i & 0x7) ? byte(i >> 6) : byte(rand() & 0xff);
+
+  const double sizeMB = double(size) / (1024.0 * 1024.0);
+
+  uint32_t maxThreads = RDCMAX(8U, Threading::NumberOfCores());
+
+  for(uint32_t threads = 0; threads <= maxThreads; threads = threads ? threads * 2 : 1)
+  {
+    StreamWriter buf(size / 2);
+
+    PerformanceTimer timer;
+
+    {
+      Compressor *comp = threads == 0 ? new LZ4Compressor(&buf, Ownership::Nothing)
+                                      : new LZ4Compressor(&buf, Ownership::Nothing, threads);
+      StreamWriter writer(comp, Ownership::Stream);
+
+      for(size_t offs = 0; offs < size; offs += 1024 * 1024)
+        writer.Write(data + offs, 1024 * 1024);
+
+      writer.Finish();
+    }
+
+    double compressMS = timer.GetMilliseconds();
+
+    timer.Restart();
+
+    {
+      Decompressor *decomp =
+          threads == 0
+              ? new LZ4Decompressor(new StreamReader(buf.GetData(), buf.GetOffset()),
+                                    Ownership::Stream)
+              : new LZ4Decompressor(new StreamReader(buf.GetData(), buf.GetOffset()),
+                                    Ownership::Stream, threads);
+      StreamReader reader(decomp, size, Ownership::Stream);
+
+      for(size_t offs = 0; offs < size; offs += 1024 * 1024)
+        reader.Read(NULL, 1024 * 1024);
+
+      CHECK_FALSE(reader.IsErrored());
+    }
+
+    double decompressMS = timer.GetMilliseconds();
+
+    RDCLOG("LZ4 %s, %u threads: compress %.1f MB/s, decompress %.1f MB/s, ratio %.3f",
+           threads == 0 ? "streaming" : "independent", threads, sizeMB * 1000.0 / compressMS,
+           sizeMB * 1000.0 / decompressMS, double(buf.GetOffset()) / double(size));
+  }
+
+  delete[] data;
+};
+
 TEST_CASE("Test ZSTD compression/decompression", "[streamio][zstd]")
 {
   StreamWriter buf(StreamWriter::DefaultScratchSize);
@@ -190,4 +406,121 @@ TEST_CASE("Test ZSTD compression/decompression", "[streamio][zstd]")
   delete[] randomData;
 };
 
+TEST_CASE("Test ZSTD seeking", "[streamio][zstd]")
+{
+  const uint64_t dataSize = 5 * 1024 * 1024 + 1234;
+
+  byte *data = new byte[(size_t)dataSize];
+
+  for(uint64_t i = 0; i < dataSize; i++)
+    data[i] = byte(((i * 7) ^ (i >> 13)) & 0xff);
+
+  StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+  {
+    StreamWriter writer(new ZSTDCompressor(&buf, Ownership::Nothing), Ownership::Stream);
+
+    writer.Write(data, dataSize);
+    writer.Finish();
+
+    CHECK_FALSE(writer.IsErrored());
+  }
+
+  // a mix of backwards and forwards seeks, within and across frames
+  const uint64_t offsets[] = {
+      3 * 1024 * 1024 + 17, 100, 0, 4 * 1024 * 1024, dataSize - 1000, 64 * 1024,
+      2 * 1024 * 1024 - 5,
+  };
+
+  byte *readData = new byte[1000];
+
+  SECTION("Seeking with the seek table")
+  {
+    StreamReader reader(
+        new ZSTDDecompressor(new StreamReader(buf.GetData(), buf.GetOffset()), Ownership::Stream),
+        dataSize, Ownership::Stream);
+
+    for(uint64_t offs : offsets)
+    {
+      reader.SetOffset(offs);
+      CHECK(reader.GetOffset() == offs);
+
+      reader.Read(readData, 1000);
+      CHECK_FALSE(memcmp(readData, data + offs, 1000));
+    }
+
+    CHECK_FALSE(reader.IsErrored());
+
+    // seeking to the end is valid, and leaves the reader at the end
+    reader.SetOffset(dataSize);
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+  }
+
+  SECTION("Sequential reading skips the seek table")
+  {
+    StreamReader reader(
+        new ZSTDDecompressor(new StreamReader(buf.GetData(), buf.GetOffset()), Ownership::Stream),
+        dataSize, Ownership::Stream);
+
+    byte *allData = new byte[(size_t)dataSize];
+
+    reader.Read(allData, dataSize);
+    CHECK_FALSE(memcmp(allData, data, (size_t)dataSize));
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+
+    delete[] allData;
+  }
+
+  SECTION("Recompressing")
+  {
+    StreamWriter recompressed(StreamWriter::DefaultScratchSize);
+
+    {
+      ZSTDDecompressor decomp(new StreamReader(buf.GetData(), buf.GetOffset()), Ownership::Stream);
+      ZSTDCompressor comp(&recompressed, Ownership::Nothing);
+      CHECK(decomp.Recompress(&comp));
+    }
+
+    StreamReader reader(new ZSTDDecompressor(new StreamReader(recompressed.GetData(),
+                                                              recompressed.GetOffset()),
+                                             Ownership::Stream),
+                        dataSize, Ownership::Stream);
+
+    reader.SetOffset(dataSize - 1000);
+    reader.Read(readData, 1000);
+    CHECK_FALSE(memcmp(readData, data + dataSize - 1000, 1000));
+
+    CHECK_FALSE(reader.IsErrored());
+  }
+
+  SECTION("Forward seeking without a seek table")
+  {
+    // truncate the stream at the start of the seek table. The decompressor has to fall back to
+    // decompressing forward to reach the offset
+    uint64_t footer = 0;
+    memcpy(&footer, buf.GetData() + buf.GetOffset() - 16, sizeof(footer));
+
+    StreamReader reader(
+        new ZSTDDecompressor(new StreamReader(buf.GetData(), buf.GetOffset() - footer),
+                             Ownership::Stream),
+        dataSize, Ownership::Stream);
+
+    reader.SetOffset(2 * 1024 * 1024 + 5);
+    reader.Read(readData, 1000);
+    CHECK_FALSE(memcmp(readData, data + 2 * 1024 * 1024 + 5, 1000));
+
+    reader.SetOffset(dataSize - 1000);
+    reader.Read(readData, 1000);
+    CHECK_FALSE(memcmp(readData, data + dataSize - 1000, 1000));
+
+    CHECK_FALSE(reader.IsErrored());
+  }
+
+  delete[] readData;
+  delete[] data;
+};
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -37,11 +37,69 @@ LZ4Compressor::LZ4Compressor(StreamWriter *write, Ownership own) : Compressor(wr
   LZ4_resetStream(&m_LZ4Comp);
 }
 
+LZ4Compressor::LZ4Compressor(StreamWriter *write, Ownership own, uint32_t numThreads,
+                             const std::vector<byte> &dictionary)
+    : Compressor(write, own)
+{
+  if(numThreads == 0)
+    numThreads = Threading::NumberOfCores();
+
+  m_Pool = new Threading::ThreadPool(numThreads);
+
+  // keep enough blocks that every worker can be busy while we fill the next one and wait on the
+  // oldest to write it out
+  m_Blocks.resize(RDCMAX(2U, numThreads * 2));
+  for(LZ4Block &block : m_Blocks)
+  {
+    block.page = AllocAlignedBuffer(lz4BlockSize);
+    block.compressed = AllocAlignedBuffer(LZ4_COMPRESSBOUND(lz4BlockSize));
+    block.state = new LZ4_stream_t;
+  }
+
+  m_Page[0] = m_Blocks[0].page;
+  m_Page[1] = NULL;
+  m_CompressBuffer = m_Blocks[0].compressed;
+  m_PageOffset = 0;
+
+  // the dictionary is only ever used as the history for each block, so we load it once and copy
+  // the prepared state for each block rather than re-hashing it every time.
+  m_Dictionary = dictionary;
+
+  LZ4_resetStream(&m_LZ4Comp);
+  if(!m_Dictionary.empty())
+    LZ4_loadDict(&m_LZ4Comp, (const char *)m_Dictionary.data(), (int)m_Dictionary.size());
+}
+
 LZ4Compressor::~LZ4Compressor()
 {
-  FreeAlignedBuffer(m_Page[0]);
-  FreeAlignedBuffer(m_Page[1]);
-  FreeAlignedBuffer(m_CompressBuffer);
+  FreeBuffers();
+}
+
+void LZ4Compressor::FreeBuffers()
+{
+  if(m_Pool)
+  {
+    // make sure nothing is still compressing into the blocks before freeing them
+    for(LZ4Block &block : m_Blocks)
+    {
+      m_Pool->WaitForJob(block.job);
+      FreeAlignedBuffer(block.page);
+      FreeAlignedBuffer(block.compressed);
+      delete block.state;
+    }
+    m_Blocks.clear();
+
+    delete m_Pool;
+    m_Pool = NULL;
+  }
+  else
+  {
+    FreeAlignedBuffer(m_Page[0]);
+    FreeAlignedBuffer(m_Page[1]);
+    FreeAlignedBuffer(m_CompressBuffer);
+  }
+
+  m_Page[0] = m_Page[1] = m_CompressBuffer = NULL;
 }
 
 bool LZ4Compressor::Write(const void *data, uint64_t numBytes)
@@ -114,7 +172,17 @@ bool LZ4Compressor::Finish()
   // precisely 64kb in size
   // only the last one can be smaller, so we only write a partial page when finishing.
   // Calling Write() after Finish() is illegal
-  return FlushPage0();
+  bool success = FlushPage0();
+
+  if(m_Pool)
+  {
+    // write out everything still in flight, oldest first. The current block was just written so
+    // it has nothing pending.
+    for(size_t i = 1; success && i < m_Blocks.size(); i++)
+      success &= WriteBlock(m_Blocks[(m_CurBlock + i) % m_Blocks.size()]);
+  }
+
+  return success;
 }
 
 bool LZ4Compressor::FlushPage0()
@@ -123,6 +191,9 @@ bool LZ4Compressor::FlushPage0()
   if(!m_CompressBuffer)
     return false;
 
+  if(m_Pool)
+    return FlushBlock();
+
   // m_PageOffset is the amount written, usually equal to lz4BlockSize except the last block.
   int32_t compSize =
       LZ4_compress_fast_continue(&m_LZ4Comp, (const char *)m_Page[0], (char *)m_CompressBuffer,
@@ -131,10 +202,7 @@ bool LZ4Compressor::FlushPage0()
   if(compSize < 0)
   {
     RDCERR("Error compressing: %i", compSize);
-    FreeAlignedBuffer(m_Page[0]);
-    FreeAlignedBuffer(m_Page[1]);
-    FreeAlignedBuffer(m_CompressBuffer);
-    m_Page[0] = m_Page[1] = m_CompressBuffer = NULL;
+    FreeBuffers();
     return false;
   }
 
@@ -152,6 +220,72 @@ bool LZ4Compressor::FlushPage0()
   return success;
 }
 
+bool LZ4Compressor::FlushBlock()
+{
+  LZ4Block &block = m_Blocks[m_CurBlock];
+
+  const int pageSize = (int)m_PageOffset;
+  const LZ4_stream_t *dictState = m_Dictionary.empty() ? NULL : &m_LZ4Comp;
+
+  block.job = m_Pool->AddJob([&block, pageSize, dictState]() {
+    if(dictState)
+    {
+      memcpy(block.state, dictState, sizeof(LZ4_stream_t));
+      block.outputSize = LZ4_compress_fast_continue(
+          block.state, (const char *)block.page, (char *)block.compressed, pageSize,
+          (int)LZ4_COMPRESSBOUND(lz4BlockSize), 1);
+    }
+    else
+    {
+      block.outputSize = LZ4_compress_fast_extState(block.state, (const char *)block.page,
+                                                    (char *)block.compressed, pageSize,
+                                                    (int)LZ4_COMPRESSBOUND(lz4BlockSize), 1);
+    }
+  });
+
+  // move to the next block. If it's still in flight from the last time around the ring then it's
+  // the oldest pending block, so it's next to be written anyway.
+  m_CurBlock = (m_CurBlock + 1) % m_Blocks.size();
+
+  LZ4Block &next = m_Blocks[m_CurBlock];
+
+  bool success = WriteBlock(next);
+
+  if(!m_CompressBuffer)
+    return false;
+
+  m_Page[0] = next.page;
+  m_CompressBuffer = next.compressed;
+  m_PageOffset = 0;
+
+  return success;
+}
+
+bool LZ4Compressor::WriteBlock(LZ4Block &block)
+{
+  if(!block.job)
+    return true;
+
+  m_Pool->WaitForJob(block.job);
+  block.job = NULL;
+
+  int32_t compSize = block.outputSize;
+
+  if(compSize < 0)
+  {
+    RDCERR("Error compressing: %i", compSize);
+    FreeBuffers();
+    return false;
+  }
+
+  bool success = true;
+
+  success &= m_Write->Write(compSize);
+  success &= m_Write->Write(block.compressed, compSize);
+
+  return success;
+}
+
 LZ4Decompressor::LZ4Decompressor(StreamReader *read, Ownership own) : Decompressor(read, own)
 {
   m_Page[0] = AllocAlignedBuffer(lz4BlockSize);
@@ -164,18 +298,78 @@ LZ4Decompressor::LZ4Decompressor(StreamReader *read, Ownership own) : Decompress
   LZ4_setStreamDecode(&m_LZ4Decomp, NULL, 0);
 }
 
+LZ4Decompressor::LZ4Decompressor(StreamReader *read, Ownership own, uint32_t numThreads,
+                                 const std::vector<byte> &dictionary)
+    : Decompressor(read, own)
+{
+  if(numThreads == 0)
+    numThreads = Threading::NumberOfCores();
+
+  m_Pool = new Threading::ThreadPool(numThreads);
+
+  // one block being read from, and enough to keep every worker busy decompressing ahead
+  m_Blocks.resize(RDCMAX(2U, numThreads * 2));
+  for(LZ4Block &block : m_Blocks)
+  {
+    block.page = AllocAlignedBuffer(lz4BlockSize);
+    block.compressed = AllocAlignedBuffer(LZ4_COMPRESSBOUND(lz4BlockSize));
+  }
+
+  m_Page[0] = m_Blocks[0].page;
+  m_Page[1] = NULL;
+  m_CompressBuffer = m_Blocks[0].compressed;
+
+  m_PageOffset = 0;
+  m_PageLength = 0;
+
+  // the first FillPage0 moves on from the current block, so start 'before' the first block with
+  // nothing pending.
+  m_CurBlock = m_Blocks.size() - 1;
+  m_PendingBlocks = 0;
+
+  m_Dictionary = dictionary;
+
+  LZ4_setStreamDecode(&m_LZ4Decomp, NULL, 0);
+}
+
 LZ4Decompressor::~LZ4Decompressor()
 {
-  FreeAlignedBuffer(m_Page[0]);
-  FreeAlignedBuffer(m_Page[1]);
-  FreeAlignedBuffer(m_CompressBuffer);
+  FreeBuffers();
+}
+
+void LZ4Decompressor::FreeBuffers()
+{
+  if(m_Pool)
+  {
+    // make sure nothing is still decompressing into the blocks before freeing them
+    for(LZ4Block &block : m_Blocks)
+    {
+      m_Pool->WaitForJob(block.job);
+      FreeAlignedBuffer(block.page);
+      FreeAlignedBuffer(block.compressed);
+    }
+    m_Blocks.clear();
+    m_PendingBlocks = 0;
+
+    delete m_Pool;
+    m_Pool = NULL;
+  }
+  else
+  {
+    FreeAlignedBuffer(m_Page[0]);
+    FreeAlignedBuffer(m_Page[1]);
+    FreeAlignedBuffer(m_CompressBuffer);
+  }
+
+  m_Page[0] = m_Page[1] = m_CompressBuffer = NULL;
 }
 
 bool LZ4Decompressor::Recompress(Compressor *comp)
 {
   bool success = true;
 
-  while(success && !m_Read->AtEnd())
+  // in independent-block mode the source can be exhausted while blocks are still pending
+  while(success && (!m_Read->AtEnd() || m_PendingBlocks > 0))
   {
     success &= FillPage0();
     if(success)
@@ -246,8 +440,87 @@ bool LZ4Decompressor::Read(void *data, uint64_t numBytes)
   return success;
 }
 
+void LZ4Decompressor::CancelPendingBlocks()
+{
+  for(size_t i = 1; i <= m_PendingBlocks; i++)
+  {
+    LZ4Block &block = m_Blocks[(m_CurBlock + i) % m_Blocks.size()];
+    m_Pool->WaitForJob(block.job);
+    block.job = NULL;
+  }
+
+  m_PendingBlocks = 0;
+}
+
+bool LZ4Decompressor::Seek(uint64_t offs)
+{
+  // if we encountered a stream error this will be NULL
+  if(!m_CompressBuffer || !m_Pool)
+    return false;
+
+  const uint64_t targetBlock = offs / lz4BlockSize;
+
+  if(m_BlockOffsets.empty())
+    m_BlockOffsets.push_back(0);
+
+  // walk the block headers forward from the last one we know of, without decompressing anything
+  if(m_BlockOffsets.size() <= targetBlock)
+  {
+    m_Read->SetOffset(m_BlockOffsets.back());
+
+    while(m_BlockOffsets.size() <= targetBlock && !m_Read->AtEnd())
+    {
+      int32_t compSize = 0;
+      if(!m_Read->Read(compSize) || compSize < 0 ||
+         compSize > (int)LZ4_COMPRESSBOUND(lz4BlockSize) || !m_Read->SkipBytes(compSize))
+      {
+        RDCERR("Error reading block size: %i", compSize);
+        FreeBuffers();
+        return false;
+      }
+
+      m_BlockOffsets.push_back(m_Read->GetOffset());
+    }
+
+    if(m_BlockOffsets.size() <= targetBlock)
+    {
+      RDCERR("Seeking to %llu past the end of the LZ4 stream", offs);
+      return false;
+    }
+  }
+
+  CancelPendingBlocks();
+
+  m_Read->SetOffset(m_BlockOffsets[(size_t)targetBlock]);
+
+  if(m_Read->IsErrored())
+    return false;
+
+  // seeking to the very end, there's nothing to decompress
+  if(m_Read->AtEnd())
+  {
+    m_PageOffset = m_PageLength = 0;
+    return true;
+  }
+
+  // FillBlock moves on to the next block in the ring before decompressing into it
+  if(!FillBlock())
+    return false;
+
+  m_PageOffset = RDCMIN(m_PageLength, offs - targetBlock * lz4BlockSize);
+
+  return true;
+}
+
 bool LZ4Decompressor::FillPage0()
 {
+  // if we encountered a stream error this will be NULL
+  if(!m_CompressBuffer)
+    return false;
+
+  if(m_Pool)
+    return FillBlock();
+
   // swap pages
   std::swap(m_Page[0], m_Page[1]);
 
@@ -259,10 +532,7 @@ bool LZ4Decompressor::FillPage0()
   if(!success || compSize < 0 || compSize > (int)LZ4_COMPRESSBOUND(lz4BlockSize))
   {
     RDCERR("Error reading size: %i", compSize);
-    FreeAlignedBuffer(m_Page[0]);
-    FreeAlignedBuffer(m_Page[1]);
-    FreeAlignedBuffer(m_CompressBuffer);
-    m_Page[0] = m_Page[1] = m_CompressBuffer = NULL;
+    FreeBuffers();
     return false;
   }
   success &= m_Read->Read(m_CompressBuffer, compSize);
@@ -270,10 +540,7 @@ bool LZ4Decompressor::FillPage0()
   if(!success)
   {
     RDCERR("Error reading block: %i", compSize);
-    FreeAlignedBuffer(m_Page[0]);
-    FreeAlignedBuffer(m_Page[1]);
-    FreeAlignedBuffer(m_CompressBuffer);
-    m_Page[0] = m_Page[1] = m_CompressBuffer = NULL;
+    FreeBuffers();
     return false;
   }
 
@@ -283,10 +550,7 @@ bool LZ4Decompressor::FillPage0()
   if(decompSize < 0)
   {
     RDCERR("Error decompressing: %i", decompSize);
-    FreeAlignedBuffer(m_Page[0]);
-    FreeAlignedBuffer(m_Page[1]);
-    FreeAlignedBuffer(m_CompressBuffer);
-    m_Page[0] = m_Page[1] = m_CompressBuffer = NULL;
+    FreeBuffers();
     return false;
   }
 
@@ -295,3 +559,73 @@ bool LZ4Decompressor::FillPage0()
 
   return success;
 }
+
+bool LZ4Decompressor::FillBlock()
+{
+  // move on to the next block. The one we were reading from is now free to be re-used for reading
+  // ahead.
+  m_CurBlock = (m_CurBlock + 1) % m_Blocks.size();
+
+  // read ahead as many compressed blocks as we have room for, and kick off their decompression.
+  const char *dict = m_Dictionary.empty() ? NULL : (const char *)m_Dictionary.data();
+  const int dictSize = (int)m_Dictionary.size();
+
+  while(m_PendingBlocks < m_Blocks.size() && !m_Read->AtEnd())
+  {
+    LZ4Block &block = m_Blocks[(m_CurBlock + m_PendingBlocks) % m_Blocks.size()];
+
+    int32_t compSize = 0;
+
+    bool success = m_Read->Read(compSize);
+    if(!success || compSize < 0 || compSize > (int)LZ4_COMPRESSBOUND(lz4BlockSize))
+    {
+      RDCERR("Error reading size: %i", compSize);
+      FreeBuffers();
+      return false;
+    }
+
+    success = m_Read->Read(block.compressed, compSize);
+
+    if(!success)
+    {
+      RDCERR("Error reading block: %i", compSize);
+      FreeBuffers();
+      return false;
+    }
+
+    block.job = m_Pool->AddJob([&block, compSize, dict, dictSize]() {
+      block.outputSize =
+          LZ4_decompress_safe_usingDict((const char *)block.compressed, (char *)block.page,
+                                        compSize, lz4BlockSize, dict, dictSize);
+    });
+
+    m_PendingBlocks++;
+  }
+
+  if(m_PendingBlocks == 0)
+  {
+    RDCERR("No more blocks to decompress");
+    FreeBuffers();
+    return false;
+  }
+
+  LZ4Block &block = m_Blocks[m_CurBlock];
+
+  m_Pool->WaitForJob(block.job);
+  block.job = NULL;
+  m_PendingBlocks--;
+
+  if(block.outputSize < 0)
+  {
+    RDCERR("Error decompressing: %i", block.outputSize);
+    FreeBuffers();
+    return false;
+  }
+
+  m_Page[0] = block.page;
+  m_CompressBuffer = block.compressed;
+  m_PageOffset = 0;
+  m_PageLength = block.outputSize;
+
+  return true;
+}
@@ -24,13 +24,35 @@
 
 #pragma once
 
+#include "common/threading.h"
 #include "lz4/lz4.h"
 #include "streamio.h"
 
+// one page in flight in independent-block mode
+struct LZ4Block
+{
+  byte *page = NULL;
+  byte *compressed = NULL;
+  // compression state, only used when compressing
+  LZ4_stream_t *state = NULL;
+  // the size of the output from the job - compressed or decompressed. Negative on error
+  int32_t outputSize = 0;
+  Threading::ThreadPool::Job *job = NULL;
+};
+
+// The default mode compresses each 64kb page using the previous one as history, which gives the
+// best ratio but means every page depends on all the pages before it.
+// The independent-block mode compresses each page on its own (optionally against a shared
+// dictionary) so that pages can be compressed and decompressed in parallel on a pool of worker
+// threads. The stream layout is the same in both modes, so without a dictionary independent
+// output can still be decompressed by the default mode.
 class LZ4Compressor : public Compressor
 {
 public:
   LZ4Compressor(StreamWriter *write, Ownership own);
+  // independent-block mode. numThreads of 0 uses one worker per core
+  LZ4Compressor(StreamWriter *write, Ownership own, uint32_t numThreads,
+                const std::vector<byte> &dictionary = std::vector<byte>());
   ~LZ4Compressor();
 
   bool Write(const void *data, uint64_t numBytes);
@@ -38,25 +60,43 @@ public:
 
 private:
   bool FlushPage0();
+  bool FlushBlock();
+  bool WriteBlock(LZ4Block &block);
+  void FreeBuffers();
 
   byte *m_Page[2];
   byte *m_CompressBuffer;
   uint64_t m_PageOffset;
 
   LZ4_stream_t m_LZ4Comp;
+
+  // independent-block mode state. m_LZ4Comp has the dictionary loaded, if there is one
+  Threading::ThreadPool *m_Pool = NULL;
+  std::vector<LZ4Block> m_Blocks;
+  size_t m_CurBlock = 0;
+  std::vector<byte> m_Dictionary;
 };
 
 class LZ4Decompressor : public Decompressor
 {
 public:
   LZ4Decompressor(StreamReader *read, Ownership own);
+  // independent-block mode, must be given the same dictionary as the compressor
+  LZ4Decompressor(StreamReader *read, Ownership own, uint32_t numThreads,
+                  const std::vector<byte> &dictionary = std::vector<byte>());
   ~LZ4Decompressor();
 
   bool Recompress(Compressor *comp);
   bool Read(void *data, uint64_t numBytes);
 
+  // only supported in independent-block mode, where any block can be decompressed on its own
+  bool Seek(uint64_t offs);
+
 private:
   bool FillPage0();
+  bool FillBlock();
+  void FreeBuffers();
+  void CancelPendingBlocks();
 
   byte *m_Page[2];
   byte *m_CompressBuffer;
@@ -64,4 +104,17 @@ private:
   uint64_t m_PageLength;
 
   LZ4_streamDecode_t m_LZ4Decomp;
+
+  // independent-block mode state. Blocks are decompressed ahead of the reader in a ring. m_CurBlock
+  // is the one in m_Page[0] and m_PendingBlocks are in flight after it
+  Threading::ThreadPool *m_Pool = NULL;
+  std::vector<LZ4Block> m_Blocks;
+  size_t m_CurBlock = 0;
+  size_t m_PendingBlocks = 0;
+  std::vector<byte> m_Dictionary;
+
+  // compressed offset of each block found so far, for seeking. Every block but the last holds
+  // exactly lz4BlockSize bytes, so the block for an offset is known and only the compressed sizes
+  // need to be walked to find where it starts.
+  std::vector<uint64_t> m_BlockOffsets;
 };
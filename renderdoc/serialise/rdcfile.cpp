@@ -117,6 +117,9 @@ bool is_exr_file(FILE *f)
      uint32_t sectionFlags; // section flags - e.g. is compressed or not.
      uint32_t sectionNameLength; // byte length of the string below (minimum 1, for null terminator)
      char sectionName[sectionNameLength]; // UTF-8 string name of section, optional.
+                                          // Uncompressed sections pad the name with extra NULs
+                                          // so that sectiondata starts 64-byte aligned in the
+                                          // file. Readers stop at the first NUL.
 
      byte sectiondata[length]; // actual contents of the section
    }
@@ -551,6 +554,9 @@ void RDCFile::Init(StreamReader &reader)
       if(reader.IsErrored())
         RETURNERROR(ContainerError::Corrupt, "Error reading binary section header");
 
+      // the name may be padded with NULs to align the section data
+      props.name.resize(strlen(props.name.c_str()));
+
       reader.SkipBytes(1);
 
       if(reader.IsErrored())
@@ -635,6 +641,23 @@ bool RDCFile::CopyFileTo(const char *filename)
   return success;
 }
 
+RDCFile *RDCFile::Reopen() const
+{
+  if(!m_File || m_Filename.empty() || m_Driver == RDCDriver::Image)
+    return NULL;
+
+  RDCFile *ret = new RDCFile;
+  ret->Open(m_Filename.c_str());
+
+  if(ret->ErrorCode() != ContainerError::NoError || ret->NumSections() != NumSections())
+  {
+    delete ret;
+    return NULL;
+  }
+
+  return ret;
+}
+
 void RDCFile::SetData(RDCDriver driver, const char *driverName, uint64_t machineIdent,
                       const RDCThumb *thumb)
 {
@@ -780,7 +803,7 @@ int RDCFile::SectionIndex(const char *name) const
   return -1;
 }
 
-StreamReader *RDCFile::ReadSection(int index) const
+StreamReader *RDCFile::ReadSection(int index, uint32_t decompressThreads) const
 {
   if(m_Error != ContainerError::NoError)
     return new StreamReader(StreamReader::InvalidStream);
@@ -798,6 +821,11 @@ StreamReader *RDCFile::ReadSection(int index) const
   SectionLocation offsetSize = m_SectionLocations[index];
   FileIO::fseek64(m_File, offsetSize.dataOffset, SEEK_SET);
 
+  // uncompressed sections are read directly from a memory mapping of the file where possible, so
+  // that large buffers can be used in place without being copied
+  if(!(props.flags & (SectionFlags::LZ4Compressed | SectionFlags::ZstdCompressed)))
+    return new StreamReader(StreamReader::MappedStream, m_File, offsetSize.diskLength);
+
   StreamReader *fileReader = new StreamReader(m_File, offsetSize.diskLength, Ownership::Nothing);
 
   StreamReader *compReader = NULL;
@@ -806,8 +834,13 @@ StreamReader *RDCFile::ReadSection(int index) const
   {
     // the user will delete the compressed reader, and then it will delete the compressor and the
     // file reader
-    compReader = new StreamReader(new LZ4Decompressor(fileReader, Ownership::Stream),
-                                  props.uncompressedSize, Ownership::Stream);
+    if(props.flags & SectionFlags::LZ4IndependentBlocks)
+      compReader =
+          new StreamReader(new LZ4Decompressor(fileReader, Ownership::Stream, decompressThreads),
+                           props.uncompressedSize, Ownership::Stream);
+    else
+      compReader = new StreamReader(new LZ4Decompressor(fileReader, Ownership::Stream),
+                                    props.uncompressedSize, Ownership::Stream);
   }
   else if(props.flags & SectionFlags::ZstdCompressed)
   {
@@ -815,8 +848,7 @@ StreamReader *RDCFile::ReadSection(int index) const
                                   props.uncompressedSize, Ownership::Stream);
   }
 
-  // if we're compressing return that writer, otherwise return the file writer directly
-  return compReader ? compReader : fileReader;
+  return compReader;
 }
 
 StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
@@ -1110,11 +1142,23 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
                                 // sectionNameLength
                                 uint32_t(name.length() + 1)};
 
+  // pad the name with NULs so that uncompressed data starts aligned in the file. That lets
+  // ReadSection hand out buffers directly from a memory mapping without copying them.
+  if(!(props.flags & (SectionFlags::LZ4Compressed | SectionFlags::ZstdCompressed)))
+  {
+    uint64_t nameOffset = headerOffset + offsetof(BinarySectionHeader, name);
+    header.sectionNameLength =
+        uint32_t(AlignUp<uint64_t>(nameOffset + header.sectionNameLength, 64) - nameOffset);
+  }
+
   // write the header then name
   numWritten = FileIO::fwrite(&header, 1, offsetof(BinarySectionHeader, name), m_File);
   numWritten += FileIO::fwrite(name.c_str(), 1, name.size() + 1, m_File);
 
-  if(numWritten != offsetof(BinarySectionHeader, name) + name.size() + 1)
+  const byte padding[64] = {};
+  numWritten += FileIO::fwrite(padding, 1, header.sectionNameLength - (name.size() + 1), m_File);
+
+  if(numWritten != offsetof(BinarySectionHeader, name) + header.sectionNameLength)
   {
     SETERROR(ContainerError::FileIO, "Error seeking to end of file, errno %d", errno);
     return new StreamWriter(StreamWriter::InvalidStream);
@@ -1129,8 +1173,12 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
   {
     // the user will delete the compressed writer, and then it will delete the compressor and the
     // file writer
-    compWriter =
-        new StreamWriter(new LZ4Compressor(fileWriter, Ownership::Stream), Ownership::Stream);
+    if(props.flags & SectionFlags::LZ4IndependentBlocks)
+      compWriter =
+          new StreamWriter(new LZ4Compressor(fileWriter, Ownership::Stream, 0), Ownership::Stream);
+    else
+      compWriter =
+          new StreamWriter(new LZ4Compressor(fileWriter, Ownership::Stream), Ownership::Stream);
   }
   else if(props.flags & SectionFlags::ZstdCompressed)
   {
@@ -75,6 +75,10 @@ public:
 
   bool CopyFileTo(const char *filename);
 
+  // opens an independent handle to the same file on disk, which can read sections concurrently with
+  // this one and outlive it. Returns NULL if this file isn't backed by a file on disk.
+  RDCFile *Reopen() const;
+
   // Sets the parameters of an RDCFile in memory.
   void SetData(RDCDriver driver, const char *driverName, uint64_t machineIdent,
                const RDCThumb *thumb);
@@ -92,7 +96,15 @@ public:
   int SectionIndex(const char *name) const;
   int NumSections() const { return int(m_Sections.size()); }
   const SectionProperties &GetSectionProperties(int index) const { return m_Sections[index]; }
-  StreamReader *ReadSection(int index) const;
+  // the byte range of a section's stored data within the file on disk
+  void GetSectionDiskRange(int index, uint64_t &offset, uint64_t &length) const
+  {
+    offset = m_SectionLocations[index].dataOffset;
+    length = m_SectionLocations[index].diskLength;
+  }
+  // decompressThreads is how many threads may decompress the section ahead of the reader, where
+  // the section's compression supports it. 0 uses one per core.
+  StreamReader *ReadSection(int index, uint32_t decompressThreads = 0) const;
   StreamWriter *WriteSection(const SectionProperties &props);
 
   // Only valid if GetDriver returns RDCDriver::Image, passes over the underlying FILE * for use
@@ -27,6 +27,7 @@
 
 #include "serialiser.h"
 #include "core/core.h"
+#include "serialise/rdcfile.h"
 #include "strings/string_utils.h"
 
 #if !defined(RELEASE)
@@ -36,6 +37,285 @@ int64_t Chunk::m_TotalMem = 0;
 
 #endif
 
+struct ChunkPage
+{
+  int32_t refCount;
+  uint32_t size;
+  uint32_t used;
+};
+
+namespace ChunkAllocator
+{
+static const uint32_t PageSize = 256 * 1024;
+
+// chunks at least this big get a page to themselves, rather than wasting the rest of a shared one
+static const uint32_t DedicatedThreshold = PageSize / 4;
+
+// keep allocations aligned the same as AllocAlignedBuffer, with the header padded to match
+static const uint32_t Alignment = 64;
+static const uint32_t HeaderSize = Alignment;
+
+RDCCOMPILE_ASSERT(sizeof(ChunkPage) <= HeaderSize, "ChunkPage header is too large");
+
+static ChunkPage *NewPage(uint32_t size)
+{
+  ChunkPage *page = (ChunkPage *)AllocAlignedBuffer(HeaderSize + size);
+  page->refCount = 1;
+  page->size = size;
+  page->used = 0;
+  return page;
+}
+
+// when a thread exits, drop its reference to the page it was allocating from
+static void ReleaseThreadPage(void *page)
+{
+  Release((ChunkPage *)page);
+}
+
+static uint64_t CurrentPageSlot()
+{
+  static uint64_t slot = Threading::AllocateTLSSlot(&ReleaseThreadPage);
+  return slot;
+}
+
+bool FrameScoped()
+{
+  return RenderDoc::Inst().IsFrameCapturing();
+}
+
+byte *Alloc(uint32_t length, ChunkPage *&page, bool shared)
+{
+  if(!shared || length >= DedicatedThreshold)
+  {
+    page = NewPage(length);
+    return (byte *)page + HeaderSize;
+  }
+
+  // only this thread allocates from its current page, so the bump itself needs no synchronisation
+  uint64_t slot = CurrentPageSlot();
+  ChunkPage *cur = (ChunkPage *)Threading::GetTLSValue(slot);
+
+  uint32_t offset = cur ? AlignUp(cur->used, Alignment) : 0;
+
+  if(cur == NULL || offset + length > cur->size)
+  {
+    // drop this thread's reference, the page is freed along with the last chunk in it
+    if(cur)
+      Release(cur);
+
+    cur = NewPage(PageSize);
+    Threading::SetTLSValue(slot, cur);
+    offset = 0;
+  }
+
+  cur->used = offset + length;
+
+  AddRef(cur);
+  page = cur;
+  return (byte *)cur + HeaderSize + offset;
+}
+
+void AddRef(ChunkPage *page)
+{
+  Atomic::Inc32(&page->refCount);
+}
+
+void Release(ChunkPage *page)
+{
+  if(Atomic::Dec32(&page->refCount) == 0)
+    FreeAlignedBuffer((byte *)page);
+}
+};
+
+static uint64_t HashCallstack(const uint64_t *addrs, size_t numLevels)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for(size_t i = 0; i < numLevels; i++)
+  {
+    hash = (hash ^ addrs[i]) * 1099511628211ULL;
+    hash ^= hash >> 29;
+  }
+  return hash ^ numLevels;
+}
+
+uint32_t CallstackDictionary::Intern(const uint64_t *addrs, size_t numLevels)
+{
+  uint64_t hash = HashCallstack(addrs, numLevels);
+
+  auto matches = [this, addrs, numLevels](uint32_t index) {
+    const rdcpair<uint32_t, uint32_t> &stack = m_Stacks[index];
+    return stack.second == numLevels &&
+           memcmp(m_Frames.data() + stack.first, addrs, numLevels * sizeof(uint64_t)) == 0;
+  };
+
+  // the same few callstacks are seen over and over, so almost every lookup only needs a read lock
+  {
+    SCOPED_READLOCK(m_Lock);
+    auto it = m_Lookup.find(hash);
+    if(it != m_Lookup.end() && matches(it->second))
+      return it->second;
+  }
+
+  SCOPED_WRITELOCK(m_Lock);
+
+  auto it = m_Lookup.find(hash);
+  if(it != m_Lookup.end() && matches(it->second))
+    return it->second;
+
+  uint32_t index = (uint32_t)m_Stacks.size();
+  m_Stacks.push_back(make_rdcpair((uint32_t)m_Frames.size(), (uint32_t)numLevels));
+  m_Frames.append(addrs, numLevels);
+
+  if(it == m_Lookup.end())
+    m_Lookup[hash] = index;
+
+  return index;
+}
+
+void CallstackDictionary::Lookup(uint32_t index, rdcarray<uint64_t> &callstack) const
+{
+  SCOPED_READLOCK(m_Lock);
+
+  if(index >= m_Stacks.size())
+  {
+    callstack.clear();
+    return;
+  }
+
+  callstack.assign(m_Frames.data() + m_Stacks[index].first, m_Stacks[index].second);
+}
+
+uint32_t CallstackDictionary::Count() const
+{
+  SCOPED_READLOCK(m_Lock);
+  return (uint32_t)m_Stacks.size();
+}
+
+void CallstackDictionary::MarkReferenced(uint32_t index)
+{
+  SCOPED_LOCK(m_ReferencedLock);
+
+  if(index >= m_Referenced.size())
+    m_Referenced.resize(index + 1);
+
+  m_Referenced[index] = true;
+}
+
+void CallstackDictionary::ClearReferenced()
+{
+  SCOPED_LOCK(m_ReferencedLock);
+  m_Referenced.clear();
+}
+
+// Format, from SectionVersion 2:
+//   uint32_t count;
+//   struct { uint32_t index; uint32_t numLevels; uint64_t frames[numLevels]; } stacks[count];
+//
+// Indices are increasing but may have gaps, for callstacks the capture doesn't reference.
+void CallstackDictionary::Write(StreamWriter *writer, bool referencedOnly) const
+{
+  SCOPED_READLOCK(m_Lock);
+  SCOPED_LOCK(m_ReferencedLock);
+
+  auto included = [this, referencedOnly](uint32_t i) {
+    return !referencedOnly || (i < m_Referenced.size() && m_Referenced[i]);
+  };
+
+  uint32_t count = 0;
+  for(uint32_t i = 0; i < m_Stacks.size(); i++)
+    count += included(i) ? 1 : 0;
+
+  writer->Write(count);
+
+  for(uint32_t i = 0; i < m_Stacks.size(); i++)
+  {
+    if(!included(i))
+      continue;
+
+    const rdcpair<uint32_t, uint32_t> &stack = m_Stacks[i];
+
+    writer->Write(i);
+    writer->Write(stack.second);
+    writer->Write(m_Frames.data() + stack.first, stack.second * sizeof(uint64_t));
+  }
+}
+
+bool CallstackDictionary::Read(StreamReader *reader)
+{
+  SCOPED_WRITELOCK(m_Lock);
+
+  m_Frames.clear();
+  m_Stacks.clear();
+  m_Lookup.clear();
+
+  uint32_t count = 0;
+  reader->Read(count);
+
+  uint32_t i = 0;
+  for(; i < count && !reader->IsErrored(); i++)
+  {
+    uint32_t index = 0, numLevels = 0;
+    reader->Read(index);
+    reader->Read(numLevels);
+
+    // each callstack takes at least 8 bytes, so an index past that many callstacks can't be valid
+    if(index < m_Stacks.size() || index > m_Stacks.size() + reader->GetSize() / 8 ||
+       numLevels * sizeof(uint64_t) > reader->GetSize() - reader->GetOffset())
+    {
+      RDCERR("Callstack %u of %u has invalid index %u or length %u", i, count, index, numLevels);
+      break;
+    }
+
+    // callstacks that weren't written are left empty
+    while(m_Stacks.size() < index)
+      m_Stacks.push_back(make_rdcpair(0U, 0U));
+
+    uint32_t offset = (uint32_t)m_Frames.size();
+    m_Frames.resize(offset + numLevels);
+    reader->Read(m_Frames.data() + offset, numLevels * sizeof(uint64_t));
+
+    m_Stacks.push_back(make_rdcpair(offset, numLevels));
+  }
+
+  return !reader->IsErrored() && i == count;
+}
+
+bool CallstackDictionary::Load(RDCFile *rdc)
+{
+  int idx = rdc ? rdc->SectionIndex(SectionType::CallstackDictionary) : -1;
+
+  if(idx < 0)
+    return false;
+
+  if(rdc->GetSectionProperties(idx).version != SectionVersion)
+  {
+    RDCWARN("Unsupported callstack dictionary version %llu",
+            (unsigned long long)rdc->GetSectionProperties(idx).version);
+    return false;
+  }
+
+  StreamReader *reader = rdc->ReadSection(idx);
+  bool success = Read(reader);
+  delete reader;
+
+  if(!success)
+    RDCERR("Failed to read callstack dictionary");
+
+  return success;
+}
+
+void Chunk::MarkCallstackReferenced() const
+{
+  uint32_t header[2] = {};
+  if(m_Length < sizeof(header))
+    return;
+
+  memcpy(header, m_Data, sizeof(header));
+
+  if(header[0] & Serialiser<SerialiserMode::Writing>::ChunkCallstackIndex)
+    RenderDoc::Inst().GetCallstackDictionary().MarkReferenced(header[1]);
+}
+
 /////////////////////////////////////////////////////////////
 // Read Serialiser functions
 
@@ -66,6 +346,8 @@ uint32_t Serialiser<SerialiserMode::Reading>::BeginChunk(uint32_t, uint32_t)
 
   m_ChunkMetadata = SDChunkMetaData();
 
+  uint64_t chunkOffset = m_Read->GetOffset();
+
   {
     uint32_t c = 0;
     bool success = m_Read->Read(c);
@@ -90,6 +372,16 @@ uint32_t Serialiser<SerialiserMode::Reading>::BeginChunk(uint32_t, uint32_t)
       m_ChunkMetadata.callstack.resize((size_t)numFrames);
       m_Read->Read(m_ChunkMetadata.callstack.data(), m_ChunkMetadata.callstack.byteSize());
     }
+    else if(c & ChunkCallstackIndex)
+    {
+      uint32_t callstackIndex = 0;
+      m_Read->Read(callstackIndex);
+
+      m_ChunkMetadata.flags |= SDChunkFlags::HasCallstack;
+
+      if(m_Callstacks)
+        m_Callstacks->Lookup(callstackIndex, m_ChunkMetadata.callstack);
+    }
 
     if(c & ChunkThreadID)
       m_Read->Read(m_ChunkMetadata.threadID);
@@ -112,13 +404,19 @@ uint32_t Serialiser<SerialiserMode::Reading>::BeginChunk(uint32_t, uint32_t)
     if(name.empty())
       name = "<Unknown Chunk>";
 
-    SDChunk *chunk = new SDChunk(name.c_str());
+    SDChunk *chunk =
+        m_LazyExport
+            ? m_StructuredFile->NewLazyChunk(name.c_str(), m_LazyStreamBase + chunkOffset)
+            : m_StructuredFile->NewChunk(name.c_str());
     chunk->metadata = m_ChunkMetadata;
 
     m_StructuredFile->chunks.push_back(chunk);
     m_StructureStack.push_back(chunk);
 
     m_InternalElement = false;
+
+    // nothing inside a lazy chunk is exported until it's loaded
+    m_LazyChunk = m_LazyExport;
   }
 
   return chunkID;
@@ -135,7 +433,7 @@ void Serialiser<SerialiserMode::Reading>::SkipCurrentChunk()
     SDObject &current = *m_StructureStack.back();
 
     current.data.basic.numChildren++;
-    current.data.children.push_back(new SDObject("Opaque chunk", "Byte Buffer"));
+    current.data.children.push_back(m_StructuredFile->NewObject("Opaque chunk", "Byte Buffer"));
 
     SDObject &obj = *current.data.children.back();
     obj.type.basetype = SDBasic::Buffer;
@@ -188,6 +486,8 @@ void Serialiser<SerialiserMode::Reading>::SkipCurrentChunk()
 template <>
 void Serialiser<SerialiserMode::Reading>::EndChunk()
 {
+  m_LazyChunk = false;
+
   if(ExportStructure())
   {
     RDCASSERTMSG("Object Stack is imbalanced!", m_StructureStack.size() <= 1,
@@ -276,10 +576,12 @@ uint32_t Serialiser<SerialiserMode::Writing>::BeginChunk(uint32_t chunkID, uint3
 
       /////////////////
 
-      m_Write->Write(c);
+      uint32_t callstackIndex = ~0U;
 
       if(c & ChunkCallstack)
       {
+        // callstacks we collect ourselves are interned in the capture's dictionary, any that were
+        // provided are written inline as-is.
         if(m_ChunkMetadata.callstack.empty())
         {
           bool collect = RenderDoc::Inst().GetCaptureOptions().captureCallstacks;
@@ -292,7 +594,14 @@ uint32_t Serialiser<SerialiserMode::Writing>::BeginChunk(uint32_t chunkID, uint3
             Callstack::Stackwalk *stack = Callstack::Collect();
             if(stack && stack->NumLevels() > 0)
             {
-              m_ChunkMetadata.callstack.assign(stack->GetAddrs(), stack->NumLevels());
+              CallstackDictionary &dict = RenderDoc::Inst().GetCallstackDictionary();
+              callstackIndex = dict.Intern(stack->GetAddrs(), stack->NumLevels());
+              c = (c & ~ChunkCallstack) | ChunkCallstackIndex;
+
+              // chunks recorded during a capture are nearly all written to it. Those that are kept
+              // in a Chunk are marked again if and when they're written.
+              if(RenderDoc::Inst().IsFrameCapturing())
+                dict.MarkReferenced(callstackIndex);
             }
 
             SAFE_DELETE(stack);
@@ -300,12 +609,21 @@ uint32_t Serialiser<SerialiserMode::Writing>::BeginChunk(uint32_t chunkID, uint3
         }
 
         m_ChunkMetadata.flags |= SDChunkFlags::HasCallstack;
+      }
+
+      m_Write->Write(c);
 
+      if(c & ChunkCallstack)
+      {
         uint32_t numFrames = (uint32_t)m_ChunkMetadata.callstack.size();
         m_Write->Write(numFrames);
 
         m_Write->Write(m_ChunkMetadata.callstack.data(), m_ChunkMetadata.callstack.byteSize());
       }
+      else if(c & ChunkCallstackIndex)
+      {
+        m_Write->Write(callstackIndex);
+      }
 
       if(c & ChunkThreadID)
       {
@@ -431,7 +749,7 @@ void Serialiser<SerialiserMode::Writing>::WriteStructuredFile(const SDFile &file
 
   for(size_t i = 0; i < file.chunks.size(); i++)
   {
-    const SDChunk &chunk = *file.chunks[i];
+    const SDChunk &chunk = *file.GetChunk(i);
 
     m_ChunkMetadata = chunk.metadata;
 
@@ -25,6 +25,7 @@
 #pragma once
 
 #include <list>
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
@@ -57,6 +58,11 @@ enum class SerialiserFlags
 {
   NoFlags = 0x0,
   AllocateMemory = 0x1,
+  // when reading a byte buffer with AllocateMemory from a memory-mapped stream, point the buffer
+  // directly at the mapped data instead of allocating and copying. Such buffers must only be freed
+  // through FreeBuffer, as the scoped deserialise helpers do, so this is opt-in for callers that
+  // never take ownership of the buffer - see SERIALISE_ELEMENT_ARRAY_ZEROCOPY.
+  ZeroCopy = 0x2,
 };
 
 BITMASK_OPERATORS(SerialiserFlags);
@@ -82,6 +88,56 @@ enum class SerialiserMode
 
 struct CompressedFileIO;
 
+class RDCFile;
+
+// callstacks collected at capture time are de-duplicated here and written once, as their own
+// section, so that chunks only need to store a small index into the dictionary.
+//
+// The dictionary lives as long as the application since chunks recorded before a capture, such as
+// resource creation, refer into it. Each capture only writes the callstacks its chunks reference,
+// which keep their indices so the chunks don't need to be rewritten.
+class CallstackDictionary
+{
+public:
+  // the version of the section written by Write()
+  static const uint64_t SectionVersion = 2;
+
+  // returns the index of this callstack, adding it if it hasn't been seen before. Thread-safe.
+  uint32_t Intern(const uint64_t *addrs, size_t numLevels);
+
+  // fetches the callstack at an index, or an empty callstack if the index isn't valid
+  void Lookup(uint32_t index, rdcarray<uint64_t> &callstack) const;
+
+  uint32_t Count() const;
+
+  // marks a callstack as used by the capture being written. Thread-safe.
+  void MarkReferenced(uint32_t index);
+  // forgets all references, when a new capture begins
+  void ClearReferenced();
+
+  // writes the dictionary, or only the callstacks marked as referenced
+  void Write(StreamWriter *writer, bool referencedOnly = false) const;
+  bool Read(StreamReader *reader);
+
+  // reads the dictionary section from a capture, if it has one
+  bool Load(RDCFile *rdc);
+
+private:
+  mutable Threading::RWLock m_Lock;
+
+  // every callstack's frames, back to back
+  rdcarray<uint64_t> m_Frames;
+  // the offset and number of frames in m_Frames for each callstack
+  rdcarray<rdcpair<uint32_t, uint32_t>> m_Stacks;
+  // callstack hash to index. Callstacks that collide with a different one are just not found
+  std::map<uint64_t, uint32_t> m_Lookup;
+
+  // which callstacks the current capture refers to, indexed the same as m_Stacks. Only grown when
+  // marked, so it may be shorter
+  mutable Threading::CriticalSection m_ReferencedLock;
+  std::vector<bool> m_Referenced;
+};
+
 template <SerialiserMode sertype>
 class Serialiser
 {
@@ -90,7 +146,8 @@ public:
   static constexpr bool IsWriting() { return sertype == SerialiserMode::Writing; }
   bool ExportStructure() const
   {
-    return sertype == SerialiserMode::Reading && m_ExportStructured && !m_InternalElement;
+    return sertype == SerialiserMode::Reading && m_ExportStructured && !m_InternalElement &&
+           !m_LazyChunk;
   }
 
   enum ChunkFlags
@@ -100,6 +157,8 @@ public:
     ChunkThreadID = 0x00020000,
     ChunkDuration = 0x00040000,
     ChunkTimestamp = 0x00080000,
+    // the callstack is an index into a CallstackDictionary rather than stored inline
+    ChunkCallstackIndex = 0x00100000,
   };
 
   //////////////////////////////////////////
@@ -112,6 +171,12 @@ public:
   bool IsErrored() { return IsReading() ? m_Read->IsErrored() : m_Write->IsErrored(); }
   StreamWriter *GetWriter() { return m_Write; }
   StreamReader *GetReader() { return m_Read; }
+  // frees a buffer that was read with AllocateMemory, which might point into a mapped stream
+  void FreeBuffer(byte *buf) const
+  {
+    if(m_Read == NULL || !m_Read->IsMappedPointer(buf))
+      FreeAlignedBuffer(buf);
+  }
   uint32_t GetChunkMetadataRecording() { return m_ChunkFlags; }
   void SetChunkMetadataRecording(uint32_t flags);
 
@@ -123,6 +188,9 @@ public:
   void *GetUserData() { return m_pUserData; }
   void SetUserData(void *userData) { m_pUserData = userData; }
   void SetStringDatabase(std::set<std::string> *db) { m_ExtStringDB = db; }
+  // when reading, callstacks stored as an index are looked up in this dictionary. Without one they
+  // are left empty.
+  void SetCallstackDictionary(const CallstackDictionary *dict) { m_Callstacks = dict; }
   // jumps to the byte after the current chunk, can be called any time after BeginChunk
   void SkipCurrentChunk();
 
@@ -156,6 +224,19 @@ public:
     m_ExportStructured = (lookup != NULL);
   }
 
+  // when exporting lazily, only each chunk's metadata is exported along with where it starts in
+  // the stream (plus streamBase, for readers that don't start at the beginning of the section).
+  // The chunk contents can be loaded later with a StructuredChunkLoader.
+  void SetLazyStructuredExport(bool lazy, uint64_t streamBase = 0)
+  {
+    m_LazyExport = lazy;
+    m_LazyStreamBase = streamBase;
+  }
+
+  // true if the current chunk was exported lazily and has a known length, so nothing needs it to
+  // be processed - EndChunk() will skip over its contents.
+  bool CanSkipCurrentChunk() const { return m_LazyChunk && m_ChunkMetadata.length > 0; }
+
   uint32_t BeginChunk(uint32_t chunkID, uint32_t byteLength);
   void EndChunk();
 
@@ -202,7 +283,7 @@ public:
       SDObject &current = *m_StructureStack.back();
 
       current.data.basic.numChildren++;
-      current.data.children.push_back(new SDObject(name, TypeName<T>()));
+      current.data.children.push_back(m_StructuredFile->NewObject(name, TypeName<T>()));
       m_StructureStack.push_back(current.data.children.back());
 
       SDObject &obj = *m_StructureStack.back();
@@ -249,7 +330,7 @@ public:
       SDObject &current = *m_StructureStack.back();
 
       current.data.basic.numChildren++;
-      current.data.children.push_back(new SDObject(name, "Byte Buffer"));
+      current.data.children.push_back(m_StructuredFile->NewObject(name, "Byte Buffer"));
       m_StructureStack.push_back(current.data.children.back());
 
       SDObject &obj = *m_StructureStack.back();
@@ -258,6 +339,7 @@ public:
     }
 
     byte *tempAlloc = NULL;
+    bool mapped = false;
 
     {
       if(IsWriting())
@@ -281,10 +363,16 @@ public:
 #if !defined(__COVERITY__)
         if(flags & SerialiserFlags::AllocateMemory)
         {
-          if(byteSize > 0)
+          el = NULL;
+
+          if((flags & SerialiserFlags::ZeroCopy) && byteSize > 0)
+          {
+            el = m_Read->ReadMapped(byteSize, ChunkAlignment);
+            mapped = (el != NULL);
+          }
+
+          if(el == NULL && byteSize > 0)
             el = AllocAlignedBuffer(byteSize);
-          else
-            el = NULL;
         }
 
         // if we're exporting the buffers, make sure to always alloc space to read the data, so we
@@ -299,7 +387,8 @@ public:
         }
 #endif
 
-        m_Read->Read(el, byteSize);
+        if(!mapped)
+          m_Read->Read(el, byteSize);
       }
     }
 
@@ -360,7 +449,7 @@ public:
       SDObject &current = *m_StructureStack.back();
 
       current.data.basic.numChildren++;
-      current.data.children.push_back(new SDObject(name, "Byte Buffer"));
+      current.data.children.push_back(m_StructuredFile->NewObject(name, "Byte Buffer"));
       m_StructureStack.push_back(current.data.children.back());
 
       SDObject &obj = *m_StructureStack.back();
@@ -380,9 +469,20 @@ public:
         // ensure byte alignment
         m_Read->AlignTo<ChunkAlignment>();
 
-        el.resize((size_t)count);
+        // a bytebuf always owns its storage so it can't point into a mapping like ZeroCopy byte
+        // buffers do, but we can at least copy straight out of the mapping without clearing the
+        // storage first or going through the read window.
+        byte *mapped = m_Read->ReadMapped(count);
+        if(mapped)
+        {
+          el.assign(mapped, (size_t)count);
+        }
+        else
+        {
+          el.resize((size_t)count);
 
-        m_Read->Read(el.data(), count);
+          m_Read->Read(el.data(), count);
+        }
       }
     }
 
@@ -433,7 +533,7 @@ public:
       SDObject &current = *m_StructureStack.back();
 
       current.data.basic.numChildren++;
-      current.data.children.push_back(new SDObject(name, "Byte Buffer"));
+      current.data.children.push_back(m_StructuredFile->NewObject(name, "Byte Buffer"));
       m_StructureStack.push_back(current.data.children.back());
 
       SDObject &obj = *m_StructureStack.back();
@@ -453,9 +553,18 @@ public:
         // ensure byte alignment
         m_Read->AlignTo<ChunkAlignment>();
 
-        el.resize((size_t)count);
+        // as with bytebuf, copy straight out of the mapping when there is one
+        byte *mapped = m_Read->ReadMapped(count);
+        if(mapped)
+        {
+          el.assign(mapped, mapped + count);
+        }
+        else
+        {
+          el.resize((size_t)count);
 
-        m_Read->Read(el.data(), count);
+          m_Read->Read(el.data(), count);
+        }
       }
     }
 
@@ -546,7 +655,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
       parent.data.basic.numChildren++;
-      parent.data.children.push_back(new SDObject(name, TypeName<T>()));
+      parent.data.children.push_back(m_StructuredFile->NewObject(name, TypeName<T>()));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -559,7 +668,7 @@ public:
 
       for(size_t i = 0; i < N; i++)
       {
-        arr.data.children[i] = new SDObject("$el", TypeName<T>());
+        arr.data.children[i] = m_StructuredFile->NewObject("$el", TypeName<T>());
         m_StructureStack.push_back(arr.data.children[i]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -667,7 +776,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
       parent.data.basic.numChildren++;
-      parent.data.children.push_back(new SDObject(name, TypeName<T>()));
+      parent.data.children.push_back(m_StructuredFile->NewObject(name, TypeName<T>()));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -692,7 +801,7 @@ public:
 
       for(uint64_t i = 0; el && i < arrayCount; i++)
       {
-        arr.data.children[(size_t)i] = new SDObject("$el", TypeName<T>());
+        arr.data.children[(size_t)i] = m_StructuredFile->NewObject("$el", TypeName<T>());
         m_StructureStack.push_back(arr.data.children[(size_t)i]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -760,7 +869,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
       parent.data.basic.numChildren++;
-      parent.data.children.push_back(new SDObject(name, TypeName<U>()));
+      parent.data.children.push_back(m_StructuredFile->NewObject(name, TypeName<U>()));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -775,7 +884,7 @@ public:
 
       for(size_t i = 0; i < (size_t)size; i++)
       {
-        arr.data.children[i] = new SDObject("$el", TypeName<U>());
+        arr.data.children[i] = m_StructuredFile->NewObject("$el", TypeName<U>());
         m_StructureStack.push_back(arr.data.children[i]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -830,7 +939,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
       parent.data.basic.numChildren++;
-      parent.data.children.push_back(new SDObject(name, TypeName<U>()));
+      parent.data.children.push_back(m_StructuredFile->NewObject(name, TypeName<U>()));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -847,7 +956,7 @@ public:
 
       for(size_t i = 0; i < (size_t)size; i++)
       {
-        arr.data.children[i] = new SDObject("$el", TypeName<U>());
+        arr.data.children[i] = m_StructuredFile->NewObject("$el", TypeName<U>());
         m_StructureStack.push_back(arr.data.children[i]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -890,7 +999,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
       parent.data.basic.numChildren++;
-      parent.data.children.push_back(new SDObject(name, "pair"));
+      parent.data.children.push_back(m_StructuredFile->NewObject(name, "pair"));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -901,7 +1010,7 @@ public:
       arr.data.children.resize(2);
 
       {
-        arr.data.children[0] = new SDObject("first", TypeName<U>());
+        arr.data.children[0] = m_StructuredFile->NewObject("first", TypeName<U>());
         m_StructureStack.push_back(arr.data.children[0]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -916,7 +1025,7 @@ public:
       }
 
       {
-        arr.data.children[1] = new SDObject("second", TypeName<V>());
+        arr.data.children[1] = m_StructuredFile->NewObject("second", TypeName<V>());
         m_StructureStack.push_back(arr.data.children[1]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -968,7 +1077,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
       parent.data.basic.numChildren++;
-      parent.data.children.push_back(new SDObject(name, TypeName<U>()));
+      parent.data.children.push_back(m_StructuredFile->NewObject(name, TypeName<U>()));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -983,7 +1092,7 @@ public:
 
       for(size_t i = 0; i < (size_t)size; i++)
       {
-        arr.data.children[i] = new SDObject("$el", TypeName<U>());
+        arr.data.children[i] = m_StructuredFile->NewObject("$el", TypeName<U>());
         m_StructureStack.push_back(arr.data.children[i]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -1025,7 +1134,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
       parent.data.basic.numChildren++;
-      parent.data.children.push_back(new SDObject(name, "pair"));
+      parent.data.children.push_back(m_StructuredFile->NewObject(name, "pair"));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -1036,7 +1145,7 @@ public:
       arr.data.children.resize(2);
 
       {
-        arr.data.children[0] = new SDObject("first", TypeName<U>());
+        arr.data.children[0] = m_StructuredFile->NewObject("first", TypeName<U>());
         m_StructureStack.push_back(arr.data.children[0]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -1051,7 +1160,7 @@ public:
       }
 
       {
-        arr.data.children[1] = new SDObject("second", TypeName<V>());
+        arr.data.children[1] = m_StructuredFile->NewObject("second", TypeName<V>());
         m_StructureStack.push_back(arr.data.children[1]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -1143,7 +1252,7 @@ public:
       {
         SDObject &parent = *m_StructureStack.back();
         parent.data.basic.numChildren++;
-        parent.data.children.push_back(new SDObject(name, TypeName<T>()));
+        parent.data.children.push_back(m_StructuredFile->NewObject(name, TypeName<T>()));
 
         SDObject &nullable = *parent.data.children.back();
         nullable.type.basetype = SDBasic::Null;
@@ -1216,8 +1325,6 @@ public:
       m_InternalElement = false;
     }
 
-    size_t byteSize = (size_t)totalSize;
-
     byte *structBuf = NULL;
 
     if(ExportStructure())
@@ -1231,7 +1338,7 @@ public:
       SDObject &current = *m_StructureStack.back();
 
       current.data.basic.numChildren++;
-      current.data.children.push_back(new SDObject(name.c_str(), "Byte Buffer"));
+      current.data.children.push_back(m_StructuredFile->NewObject(name.c_str(), "Byte Buffer"));
       m_StructureStack.push_back(current.data.children.back());
 
       SDObject &obj = *m_StructureStack.back();
@@ -1267,7 +1374,7 @@ public:
       if(totalSize % (uint64_t)bufSize > 0)
         numBufs++;
 
-      byte *buf = new byte[byteSize];
+      byte *buf = new byte[(size_t)bufSize];
 
       if(progress)
         progress(0.0001f);
@@ -1598,6 +1705,9 @@ private:
   bool m_ExportStructured = false;
   bool m_ExportBuffers = false;
   bool m_InternalElement = false;
+  bool m_LazyExport = false;
+  bool m_LazyChunk = false;
+  uint64_t m_LazyStreamBase = 0;
   SDFile m_StructData;
   SDFile *m_StructuredFile = &m_StructData;
   std::vector<SDObject *> m_StructureStack;
@@ -1612,6 +1722,8 @@ private:
   // external storage - so the string storage can persist after the lifetime of the serialiser
   std::set<std::string> *m_ExtStringDB = NULL;
 
+  const CallstackDictionary *m_Callstacks = NULL;
+
   const char *StringDB(const std::string &s)
   {
     if(m_ExtStringDB)
@@ -1647,6 +1759,51 @@ public:
   }
 };
 
+// Loads the contents of chunks that were exported lazily from a capture section, by re-reading each
+// chunk from its recorded offset and exporting it fully. Drivers implement ProcessChunk to
+// deserialise the chunk the same way their structured export does.
+class StructuredChunkLoader : public SDChunkLoader
+{
+public:
+  // captures on disk are read through the loader's own handle to the file, so it doesn't need rdc
+  // to stay alive. Otherwise rdc must outlive the loader.
+  StructuredChunkLoader(RDCFile *rdc, int sectionIndex, ChunkLookup lookup, bool includeBuffers);
+  virtual ~StructuredChunkLoader();
+
+  bool LoadChunk(SDChunk &chunk, uint64_t offset, StructuredBufferList &chunkBuffers);
+
+  // true if the loader has its own handle to the capture, independent of the RDCFile it was given
+  bool OwnsFile() const { return m_OwnedRDC != NULL; }
+
+  // a reasonable bound on how many chunks to keep loaded at once
+  static const size_t DefaultMaxLoaded = 1024;
+
+protected:
+  // ReadChunk() has already been called, the serialiser should be configured as the driver needs
+  // (string database, version, etc) before processing the chunk's contents.
+  virtual bool ProcessChunk(ReadSerialiser &ser, uint32_t chunkID) = 0;
+
+private:
+  RDCFile *m_RDC;
+  RDCFile *m_OwnedRDC = NULL;
+  int m_SectionIndex;
+  ChunkLookup m_Lookup;
+  bool m_IncludeBuffers;
+
+  // kept open between loads, since chunks are usually loaded in ascending order
+  StreamReader *m_Reader = NULL;
+};
+
+// Fully loads a lazily exported file by splitting its chunks into contiguous ranges and loading
+// each range on a separate thread. Loaders aren't thread-safe so makeLoader is called once per
+// range to create an independent one. Afterwards the file is an ordinary fully loaded file.
+//
+// This needs the driver to support lazy structured export, which only Vulkan does so far. Other
+// drivers still export in a single pass. The lazy export that indexes the chunks is itself serial,
+// and reads (and decompresses) the whole section once before the parallel pass reads it again.
+void LoadLazyChunksParallel(SDFile &file, std::function<SDChunkLoader *()> makeLoader,
+                            uint32_t numThreads);
+
 class StructuredSerialiser : public Serialiser<SerialiserMode::Reading>
 {
 public:
@@ -1738,6 +1895,26 @@ DECLARE_STRINGISE_TYPE(SDObject *);
 
 class ScopedChunk;
 
+struct ChunkPage;
+
+// chunk contents are bump-allocated from per-thread pages, so that recording a chunk doesn't go
+// through the general allocator. Each page is refcounted by the chunks allocated from it, plus by
+// its thread while it's still the one being allocated from, and is freed when the last is gone.
+namespace ChunkAllocator
+{
+// if shared is false the chunk gets an allocation to itself, for chunks that may be kept long after
+// the others around them are freed and would otherwise keep a whole page alive.
+byte *Alloc(uint32_t length, ChunkPage *&page, bool shared);
+void AddRef(ChunkPage *page);
+void Release(ChunkPage *page);
+
+// chunks recorded during a frame capture are freed along with the frame, so they can share pages.
+// Outside of a capture most chunks are creation chunks that resource records hold on to for as long
+// as the resource lives. Chunks known to be short-lived either way, like recorded commands that are
+// freed when their command buffer is reset, can pass sharedPage explicitly.
+bool FrameScoped();
+};
+
 // holds the memory, length and type for a given chunk, so that it can be
 // passed around and moved between owners before being serialised out
 class Chunk
@@ -1745,7 +1922,7 @@ class Chunk
 public:
   ~Chunk()
   {
-    FreeAlignedBuffer(m_Data);
+    ChunkAllocator::Release(m_Page);
 
 #if !defined(RELEASE)
     Atomic::Dec64(&m_LiveChunks);
@@ -1768,6 +1945,12 @@ public:
 
   // grab current contents of the serialiser into this chunk
   Chunk(Serialiser<SerialiserMode::Writing> &ser, uint32_t chunkType)
+      : Chunk(ser, chunkType, ChunkAllocator::FrameScoped())
+  {
+  }
+
+  // as above, choosing explicitly whether the chunk is allocated from a shared page
+  Chunk(Serialiser<SerialiserMode::Writing> &ser, uint32_t chunkType, bool sharedPage)
   {
     m_Length = (uint32_t)ser.GetWriter()->GetOffset();
 
@@ -1775,7 +1958,7 @@ public:
 
     m_ChunkType = chunkType;
 
-    m_Data = AllocAlignedBuffer(m_Length);
+    m_Data = ChunkAllocator::Alloc(m_Length, m_Page, sharedPage);
 
     memcpy(m_Data, ser.GetWriter()->GetData(), (size_t)m_Length);
 
@@ -1788,15 +1971,18 @@ public:
   }
 
   byte *GetData() const { return m_Data; }
+  uint32_t GetLength() const { return m_Length; }
   Chunk *Duplicate()
   {
     Chunk *ret = new Chunk();
     ret->m_Length = m_Length;
     ret->m_ChunkType = m_ChunkType;
 
-    ret->m_Data = AllocAlignedBuffer(m_Length);
-
-    memcpy(ret->m_Data, m_Data, (size_t)m_Length);
+    // duplicates share storage rather than copying it. The only chunks modified after being
+    // recorded are those holding a resource record's backing data, and those aren't duplicated.
+    ret->m_Data = m_Data;
+    ret->m_Page = m_Page;
+    ChunkAllocator::AddRef(m_Page);
 
 #if !defined(RELEASE)
     Atomic::Inc64(&m_LiveChunks);
@@ -1808,9 +1994,14 @@ public:
 
   void Write(Serialiser<SerialiserMode::Writing> &ser)
   {
+    MarkCallstackReferenced();
     ser.GetWriter()->Write((const void *)m_Data, (size_t)m_Length);
   }
 
+  // if this chunk's callstack is stored as an index, mark it as referenced by the capture that the
+  // chunk is being written to
+  void MarkCallstackReferenced() const;
+
 private:
   Chunk() = default;
   Chunk(const Chunk &) = delete;
@@ -1822,6 +2013,7 @@ private:
 
   uint32_t m_Length;
   byte *m_Data;
+  ChunkPage *m_Page;
 
 #if !defined(RELEASE)
   static int64_t m_LiveChunks, m_TotalMem;
@@ -1850,6 +2042,12 @@ public:
     return new Chunk(m_Ser, m_Idx);
   }
 
+  Chunk *Get(bool sharedPage)
+  {
+    End();
+    return new Chunk(m_Ser, m_Idx, sharedPage);
+  }
+
 private:
   WriteSerialiser &m_Ser;
   uint32_t m_Idx;
@@ -1919,7 +2117,7 @@ struct ScopedDeserialiseArray<SerialiserType, void *>
   ~ScopedDeserialiseArray()
   {
     if(m_Ser.IsReading())
-      FreeAlignedBuffer((byte *)*m_El);
+      m_Ser.FreeBuffer((byte *)*m_El);
   }
   const SerialiserType &m_Ser;
   void **m_El;
@@ -1932,7 +2130,7 @@ struct ScopedDeserialiseArray<SerialiserType, const void *>
   ~ScopedDeserialiseArray()
   {
     if(m_Ser.IsReading())
-      FreeAlignedBuffer((byte *)*m_El);
+      m_Ser.FreeBuffer((byte *)*m_El);
   }
   const SerialiserType &m_Ser;
   const void **m_El;
@@ -1945,7 +2143,7 @@ struct ScopedDeserialiseArray<SerialiserType, byte *>
   ~ScopedDeserialiseArray()
   {
     if(m_Ser.IsReading())
-      FreeAlignedBuffer(*m_El);
+      m_Ser.FreeBuffer(*m_El);
   }
   const SerialiserType &m_Ser;
   byte **m_El;
@@ -1980,6 +2178,16 @@ struct ScopedDeserialiseArray<SerialiserType, byte *>
       GET_SERIALISER, &obj);                                                                      \
   GET_SERIALISER.Serialise(#obj, obj, count, SerialiserFlags::AllocateMemory)
 
+// as SERIALISE_ELEMENT_ARRAY but byte buffers may point directly into a memory-mapped capture. Only
+// for callers that consume the data during the chunk and never take ownership of the buffer.
+#define SERIALISE_ELEMENT_ARRAY_ZEROCOPY(obj, count)                                              \
+  uint64_t CONCAT(dummy_array_count, __LINE__) = 0;                                               \
+  (void)CONCAT(dummy_array_count, __LINE__);                                                      \
+  ScopedDeserialiseArray<decltype(GET_SERIALISER), decltype(obj)> CONCAT(deserialise_, __LINE__)( \
+      GET_SERIALISER, &obj);                                                                      \
+  GET_SERIALISER.Serialise(#obj, obj, count,                                                       \
+                           SerialiserFlags::AllocateMemory | SerialiserFlags::ZeroCopy)
+
 #define SERIALISE_ELEMENT_OPT(obj)                                           \
   ScopedDeserialiseNullable<decltype(GET_SERIALISER), decltype(obj)> CONCAT( \
       deserialise_, __LINE__)(GET_SERIALISER, &obj);                         \
@@ -23,6 +23,10 @@
  ******************************************************************************/
 
 #include "serialiser.h"
+#include "common/timing.h"
+#include "core/core.h"
+#include "core/resource_manager.h"
+#include "rdcfile.h"
 
 #if ENABLED(ENABLE_UNIT_TESTS)
 
@@ -562,6 +566,157 @@ TEST_CASE("Read/write chunk metadata", "[serialiser]")
   delete buf;
 };
 
+TEST_CASE("Callstacks are stored once in a dictionary", "[serialiser]")
+{
+  SECTION("Interning and lookup")
+  {
+    CallstackDictionary dict;
+
+    uint64_t a[] = {1, 2, 3, 4};
+    uint64_t b[] = {1, 2, 3};
+    uint64_t c[] = {5, 6, 7, 8, 9};
+
+    uint32_t idxA = dict.Intern(a, ARRAY_COUNT(a));
+    uint32_t idxB = dict.Intern(b, ARRAY_COUNT(b));
+    uint32_t idxC = dict.Intern(c, ARRAY_COUNT(c));
+
+    CHECK(idxA != idxB);
+    CHECK(idxA != idxC);
+    CHECK(idxB != idxC);
+    CHECK(dict.Intern(a, ARRAY_COUNT(a)) == idxA);
+    CHECK(dict.Intern(c, ARRAY_COUNT(c)) == idxC);
+    CHECK(dict.Count() == 3);
+
+    StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+    dict.Write(buf);
+
+    CallstackDictionary readDict;
+    StreamReader *reader = new StreamReader(buf->GetData(), buf->GetOffset());
+    CHECK(readDict.Read(reader));
+    CHECK(reader->AtEnd());
+    delete reader;
+    delete buf;
+
+    REQUIRE(readDict.Count() == 3);
+
+    rdcarray<uint64_t> stack;
+    readDict.Lookup(idxA, stack);
+    CHECK(stack == rdcarray<uint64_t>(a, ARRAY_COUNT(a)));
+    readDict.Lookup(idxB, stack);
+    CHECK(stack == rdcarray<uint64_t>(b, ARRAY_COUNT(b)));
+    readDict.Lookup(idxC, stack);
+    CHECK(stack == rdcarray<uint64_t>(c, ARRAY_COUNT(c)));
+
+    readDict.Lookup(99, stack);
+    CHECK(stack.empty());
+
+    // only referenced callstacks are written, at their original indices
+    dict.MarkReferenced(idxC);
+
+    buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+    dict.Write(buf, true);
+
+    reader = new StreamReader(buf->GetData(), buf->GetOffset());
+    CHECK(readDict.Read(reader));
+    CHECK(reader->AtEnd());
+    delete reader;
+    delete buf;
+
+    CHECK(readDict.Count() == idxC + 1);
+
+    readDict.Lookup(idxA, stack);
+    CHECK(stack.empty());
+    readDict.Lookup(idxC, stack);
+    CHECK(stack == rdcarray<uint64_t>(c, ARRAY_COUNT(c)));
+
+    // clearing the references leaves nothing to write
+    dict.ClearReferenced();
+
+    buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+    dict.Write(buf, true);
+
+    reader = new StreamReader(buf->GetData(), buf->GetOffset());
+    CHECK(readDict.Read(reader));
+    delete reader;
+    delete buf;
+
+    CHECK(readDict.Count() == 0);
+  }
+
+  SECTION("Collected callstacks are written as an index")
+  {
+    CaptureOptions prevOpts = RenderDoc::Inst().GetCaptureOptions();
+    CaptureOptions opts = prevOpts;
+    opts.captureCallstacks = true;
+    RenderDoc::Inst().SetCaptureOptions(opts);
+
+    StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+    {
+      WriteSerialiser ser(buf, Ownership::Nothing);
+
+      ser.SetChunkMetadataRecording(WriteSerialiser::ChunkCallstack);
+
+      // the same callsite each time, so the callstacks are identical
+      for(uint32_t i = 0; i < 3; i++)
+      {
+        ser.WriteChunk(1);
+        ser.Serialise("i", i);
+        ser.EndChunk();
+      }
+
+      REQUIRE_FALSE(ser.IsErrored());
+    }
+
+    RenderDoc::Inst().SetCaptureOptions(prevOpts);
+
+    // without the dictionary we know there's a callstack, but not what it is
+    {
+      ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+      ser.ReadChunk<uint32_t>();
+
+      CHECK(bool(ser.ChunkMetadata().flags & SDChunkFlags::HasCallstack));
+      CHECK(ser.ChunkMetadata().callstack.empty());
+
+      ser.SkipCurrentChunk();
+      ser.EndChunk();
+    }
+
+    {
+      ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+      ser.SetCallstackDictionary(&RenderDoc::Inst().GetCallstackDictionary());
+
+      rdcarray<uint64_t> first;
+
+      for(uint32_t i = 0; i < 3; i++)
+      {
+        ser.ReadChunk<uint32_t>();
+
+        uint32_t val = 0;
+        ser.Serialise("i", val);
+        CHECK(val == i);
+
+        CHECK(bool(ser.ChunkMetadata().flags & SDChunkFlags::HasCallstack));
+        CHECK_FALSE(ser.ChunkMetadata().callstack.empty());
+
+        if(i == 0)
+          first = ser.ChunkMetadata().callstack;
+        else
+          CHECK(ser.ChunkMetadata().callstack == first);
+
+        ser.EndChunk();
+      }
+
+      REQUIRE_FALSE(ser.IsErrored());
+      CHECK(ser.GetReader()->AtEnd());
+    }
+
+    delete buf;
+  }
+};
+
 TEST_CASE("Verify multiple chunks can be merged", "[serialiser][chunks]")
 {
   StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
@@ -720,6 +875,265 @@ TEST_CASE("Verify multiple chunks can be merged", "[serialiser][chunks]")
   delete buf;
 };
 
+TEST_CASE("Chunks share pages and storage", "[serialiser][chunks]")
+{
+  WriteSerialiser ser(new StreamWriter(StreamWriter::DefaultScratchSize), Ownership::Stream);
+
+  // odd, so the large chunk after these is one of those kept
+  const uint32_t numChunks = 2001;
+
+  std::vector<Chunk *> chunks;
+  for(uint32_t c = 0; c < numChunks; c++)
+  {
+    SCOPED_SERIALISE_CHUNK(5);
+
+    uint32_t value = c;
+    SERIALISE_ELEMENT(value);
+
+    chunks.push_back(scope.Get(true));
+  }
+
+  std::vector<byte> large;
+  large.resize(1024 * 1024);
+  for(size_t i = 0; i < large.size(); i++)
+    large[i] = byte(i & 0xff);
+
+  {
+    SCOPED_SERIALISE_CHUNK(6);
+
+    byte *data = large.data();
+    uint64_t dataSize = large.size();
+    SERIALISE_ELEMENT(dataSize);
+    SERIALISE_ELEMENT_ARRAY(data, dataSize);
+
+    chunks.push_back(scope.Get(true));
+  }
+
+  for(Chunk *c : chunks)
+    CHECK(((uintptr_t)c->GetData() % 64) == 0);
+
+  // small chunks are packed next to each other, apart from where one page ends and the next begins
+  uint32_t packed = 0;
+  for(size_t i = 1; i < 100; i++)
+    packed += (chunks[i]->GetData() == chunks[i - 1]->GetData() + 64) ? 1 : 0;
+  CHECK(packed >= 98);
+
+  Chunk *dup = chunks[10]->Duplicate();
+  CHECK(dup->GetData() == chunks[10]->GetData());
+  CHECK(dup->GetChunkType<uint32_t>() == 5);
+
+  // free chunks on another thread, out of order, while this thread still allocates from its page
+  Threading::ThreadHandle th = Threading::CreateThread([&chunks]() {
+    for(size_t i = 0; i < chunks.size(); i += 2)
+      delete chunks[i];
+  });
+  Threading::JoinThread(th);
+  Threading::CloseThread(th);
+
+  Chunk *late = NULL;
+  {
+    SCOPED_SERIALISE_CHUNK(7);
+
+    uint32_t value = 0;
+    SERIALISE_ELEMENT(value);
+
+    late = scope.Get(true);
+  }
+
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  {
+    WriteSerialiser out(buf, Ownership::Nothing);
+
+    // the duplicate's storage outlives the original
+    dup->Write(out);
+
+    for(size_t i = 1; i < chunks.size(); i += 2)
+      chunks[i]->Write(out);
+
+    late->Write(out);
+  }
+
+  delete dup;
+  delete late;
+  for(size_t i = 1; i < chunks.size(); i += 2)
+    delete chunks[i];
+
+  {
+    ReadSerialiser in(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+    REQUIRE(in.ReadChunk<uint32_t>() == 5);
+    {
+      uint32_t value = 0;
+      in.Serialise("value", value);
+      CHECK(value == 10);
+    }
+    in.EndChunk();
+
+    for(uint32_t c = 1; c < numChunks; c += 2)
+    {
+      REQUIRE(in.ReadChunk<uint32_t>() == 5);
+      uint32_t value = 0;
+      in.Serialise("value", value);
+      CHECK(value == c);
+      in.EndChunk();
+    }
+
+    REQUIRE(in.ReadChunk<uint32_t>() == 6);
+    {
+      byte *data = NULL;
+      uint64_t dataSize = 0;
+      in.Serialise("dataSize", dataSize);
+      in.Serialise("data", data, dataSize, SerialiserFlags::AllocateMemory);
+      REQUIRE(dataSize == large.size());
+      CHECK_FALSE(memcmp(data, large.data(), large.size()));
+      FreeAlignedBuffer(data);
+    }
+    in.EndChunk();
+
+    REQUIRE(in.ReadChunk<uint32_t>() == 7);
+    {
+      uint32_t value = 1;
+      in.Serialise("value", value);
+      CHECK(value == 0);
+    }
+    in.EndChunk();
+
+    CHECK(in.GetReader()->AtEnd());
+    CHECK_FALSE(in.IsErrored());
+  }
+
+  delete buf;
+};
+
+TEST_CASE("Chunk pages are released by exiting threads", "[serialiser][chunks]")
+{
+  std::vector<Chunk *> chunks;
+
+  // allocate from a thread's page and let the thread exit while the chunks still use it
+  Threading::ThreadHandle th = Threading::CreateThread([&chunks]() {
+    WriteSerialiser ser(new StreamWriter(StreamWriter::DefaultScratchSize), Ownership::Stream);
+
+    for(uint32_t c = 0; c < 4; c++)
+    {
+      SCOPED_SERIALISE_CHUNK(5);
+
+      uint32_t value = c;
+      SERIALISE_ELEMENT(value);
+
+      chunks.push_back(scope.Get(true));
+    }
+
+    // chunks that aren't shared don't pack in with the others
+    {
+      SCOPED_SERIALISE_CHUNK(6);
+
+      uint32_t value = 4;
+      SERIALISE_ELEMENT(value);
+
+      chunks.push_back(scope.Get(false));
+    }
+  });
+  Threading::JoinThread(th);
+  Threading::CloseThread(th);
+
+  REQUIRE(chunks.size() == 5);
+
+  CHECK(chunks[1]->GetData() == chunks[0]->GetData() + 64);
+  CHECK(chunks[4]->GetData() != chunks[3]->GetData() + 64);
+
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  {
+    WriteSerialiser out(buf, Ownership::Nothing);
+
+    for(Chunk *c : chunks)
+      c->Write(out);
+  }
+
+  for(Chunk *c : chunks)
+    delete c;
+
+  ReadSerialiser in(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+  for(uint32_t c = 0; c < 5; c++)
+  {
+    REQUIRE(in.ReadChunk<uint32_t>() == (c < 4 ? 5U : 6U));
+    uint32_t value = ~0U;
+    in.Serialise("value", value);
+    CHECK(value == c);
+    in.EndChunk();
+  }
+
+  delete buf;
+};
+
+TEST_CASE("Appended records keep shared chunks alive", "[serialiser][chunks]")
+{
+  WriteSerialiser ser(new StreamWriter(StreamWriter::DefaultScratchSize), Ownership::Stream);
+
+  // like a command buffer's recorded commands, appended into another record when it's executed
+  ResourceRecord *cmds = new ResourceRecord(ResourceId(), true);
+  ResourceRecord *executed = new ResourceRecord(ResourceId(), true);
+
+  auto record = [&ser](ResourceRecord *r, uint32_t first, uint32_t count) {
+    for(uint32_t c = first; c < first + count; c++)
+    {
+      SCOPED_SERIALISE_CHUNK(5);
+
+      uint32_t value = c;
+      SERIALISE_ELEMENT(value);
+
+      r->AddChunk(scope.Get(true));
+    }
+  };
+
+  record(cmds, 0, 10);
+
+  executed->AppendFrom(cmds);
+  REQUIRE(executed->NumChunks() == 10);
+
+  // re-recording frees the original chunks while the appended duplicates still use their page, and
+  // the new chunks are allocated from the same page after them
+  cmds->DeleteChunks();
+  record(cmds, 100, 10);
+
+  executed->AppendFrom(cmds);
+  cmds->DeleteChunks();
+  delete cmds;
+
+  map<int32_t, Chunk *> recordlist;
+  executed->Insert(recordlist);
+  REQUIRE(recordlist.size() == 20);
+
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  {
+    WriteSerialiser out(buf, Ownership::Nothing);
+
+    for(auto it = recordlist.begin(); it != recordlist.end(); ++it)
+      it->second->Write(out);
+  }
+
+  executed->DeleteChunks();
+  delete executed;
+
+  ReadSerialiser in(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+  for(uint32_t c = 0; c < 20; c++)
+  {
+    REQUIRE(in.ReadChunk<uint32_t>() == 5);
+    uint32_t value = ~0U;
+    in.Serialise("value", value);
+    CHECK(value == (c < 10 ? c : c + 90));
+    in.EndChunk();
+  }
+
+  CHECK(in.GetReader()->AtEnd());
+
+  delete buf;
+};
+
 TEST_CASE("Read/write container types", "[serialiser][structured]")
 {
   StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
@@ -1419,6 +1833,651 @@ std::string DoStringise(const TestBitfield &el)
   END_BITFIELD_STRINGISE();
 }
 
+TEST_CASE("Read buffers in place from mapped streams", "[serialiser]")
+{
+  std::string filename = FileIO::GetTempFolderFilename() + "rdoc_serialiser_mapped.bin";
+
+  std::vector<byte> data;
+  data.resize(16 * 1024);
+  for(size_t i = 0; i < data.size(); i++)
+    data[i] = byte((i * 7) & 0xff);
+
+  uint64_t fileSize = 0;
+
+  {
+    StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+    WriteSerialiser ser(buf, Ownership::Stream);
+
+    {
+      SCOPED_SERIALISE_CHUNK(5);
+
+      byte *buffer = data.data();
+      uint64_t bufferSize = data.size();
+      SERIALISE_ELEMENT(bufferSize);
+      SERIALISE_ELEMENT_ARRAY(buffer, bufferSize);
+      SERIALISE_ELEMENT_ARRAY(buffer, bufferSize);
+    }
+
+    fileSize = buf->GetOffset();
+
+    REQUIRE(FileIO::dump(filename.c_str(), buf->GetData(), (size_t)fileSize));
+  }
+
+  FILE *f = FileIO::fopen(filename.c_str(), "rb");
+  REQUIRE(f);
+
+  {
+    ReadSerialiser ser(new StreamReader(StreamReader::MappedStream, f, fileSize),
+                       Ownership::Stream);
+
+    ser.ReadChunk<uint32_t>();
+
+    {
+      byte *buffer = NULL;
+      uint64_t bufferSize = 0;
+      SERIALISE_ELEMENT(bufferSize);
+      SERIALISE_ELEMENT_ARRAY_ZEROCOPY(buffer, bufferSize);
+
+      REQUIRE(bufferSize == data.size());
+      CHECK(ser.GetReader()->IsMappedPointer(buffer));
+      CHECK_FALSE(memcmp(buffer, data.data(), data.size()));
+
+      // without opting in the buffer is always allocated, since callers may take ownership of it
+      byte *owned = NULL;
+      SERIALISE_ELEMENT_ARRAY(owned, bufferSize);
+
+      CHECK_FALSE(ser.GetReader()->IsMappedPointer(owned));
+      CHECK_FALSE(memcmp(owned, data.data(), data.size()));
+    }
+
+    ser.EndChunk();
+
+    CHECK_FALSE(ser.IsErrored());
+  }
+
+  FileIO::fclose(f);
+  FileIO::Delete(filename.c_str());
+};
+
+TEST_CASE("Structured export stores objects in the file's arena", "[serialiser][structured]")
+{
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  {
+    WriteSerialiser ser(buf, Ownership::Nothing);
+
+    for(uint32_t c = 0; c < 4; c++)
+    {
+      SCOPED_SERIALISE_CHUNK(5 + c);
+
+      std::vector<int> v = {1, 1, 2, 3, 5, 8};
+      std::string name = "chunk";
+      SERIALISE_ELEMENT(v);
+      SERIALISE_ELEMENT(name);
+      SERIALISE_ELEMENT(c);
+    }
+  }
+
+  SDFile file;
+
+  {
+    ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+    ChunkLookup testChunkLoop = [](uint32_t) -> std::string { return "TestChunk"; };
+
+    ser.ConfigureStructuredExport(testChunkLoop, false);
+
+    for(uint32_t c = 0; c < 4; c++)
+    {
+      ser.ReadChunk<uint32_t>();
+
+      std::vector<int> v;
+      std::string name;
+      uint32_t idx;
+      SERIALISE_ELEMENT(v);
+      SERIALISE_ELEMENT(name);
+      SERIALISE_ELEMENT(idx);
+
+      ser.EndChunk();
+    }
+
+    REQUIRE_FALSE(ser.IsErrored());
+
+    file.Swap(ser.GetStructuredFile());
+  }
+
+  REQUIRE(file.chunks.size() == 4);
+
+  SDChunk *chunk = file.chunks[2];
+
+  CHECK(chunk->metadata.chunkID == 7);
+  REQUIRE(chunk->NumChildren() == 3);
+
+  SDObject *v = chunk->FindChild("v");
+  REQUIRE(v);
+  CHECK(v == chunk->GetChild(0));
+  REQUIRE(v->NumChildren() == 6);
+
+  // array elements are created back to back, so they're laid out contiguously
+  for(size_t i = 1; i < v->NumChildren(); i++)
+    CHECK(v->GetChild(i) == v->GetChild(i - 1) + 1);
+
+  CHECK(v->GetChild(5)->AsInt32() == 8);
+  CHECK(chunk->FindChild("name")->AsString() == "chunk");
+  CHECK(chunk->FindChild("idx")->AsUInt32() == 2);
+
+  // duplicates are standalone heap objects that outlive the file
+  SDChunk *dup = chunk->Duplicate();
+
+  // heap objects can be mixed into the arena tree, and are deleted along with it
+  chunk->AddChild(dup->FindChild("name"));
+  CHECK(chunk->NumChildren() == 4);
+  CHECK(chunk->GetChild(3)->AsString() == "chunk");
+
+  {
+    SDFile other;
+    other.Swap(file);
+
+    CHECK(file.chunks.empty());
+    CHECK(other.chunks[2] == chunk);
+  }
+
+  CHECK(dup->metadata.chunkID == 7);
+  CHECK(dup->FindChild("v")->GetChild(3)->AsInt32() == 3);
+
+  delete dup;
+  delete buf;
+};
+
+template <typename SerialiserType>
+static void SerialiseLazyTestChunk(SerialiserType &ser, uint32_t idx)
+{
+  std::vector<uint32_t> values = {idx, idx * 2, idx * 3};
+  std::string name = "chunk";
+
+  byte data[16];
+  memset(data, (int)idx, sizeof(data));
+  byte *buffer = data;
+  uint64_t bufferSize = sizeof(data);
+
+  SERIALISE_ELEMENT(values);
+  SERIALISE_ELEMENT(name);
+  SERIALISE_ELEMENT_ARRAY(buffer, bufferSize);
+}
+
+class TestChunkLoader : public StructuredChunkLoader
+{
+public:
+  TestChunkLoader(RDCFile *rdc, int sectionIndex, ChunkLookup lookup)
+      : StructuredChunkLoader(rdc, sectionIndex, lookup, true)
+  {
+  }
+
+  int loads = 0;
+
+protected:
+  bool ProcessChunk(ReadSerialiser &ser, uint32_t chunkID)
+  {
+    loads++;
+    SerialiseLazyTestChunk(ser, 0);
+    return true;
+  }
+};
+
+static void WriteLazyTestSection(RDCFile &rdc, uint32_t numChunks,
+                                 SectionFlags flags = SectionFlags::NoFlags)
+{
+  rdc.SetData(RDCDriver::Unknown, "Test", 0, NULL);
+
+  // with no file created, the section is stored in memory
+  SectionProperties props;
+  props.type = SectionType::FrameCapture;
+  props.version = 1;
+  props.flags = flags;
+
+  StreamWriter *writer = rdc.WriteSection(props);
+
+  // like the drivers, serialise the chunks in memory where their lengths can be fixed up, then
+  // write them to the section which may be a file or a compressor.
+  {
+    StreamWriter scratch(StreamWriter::DefaultScratchSize);
+
+    {
+      WriteSerialiser ser(&scratch, Ownership::Nothing);
+
+      for(uint32_t c = 0; c < numChunks; c++)
+      {
+        SCOPED_SERIALISE_CHUNK(5 + c);
+        SerialiseLazyTestChunk(ser, c);
+      }
+    }
+
+    writer->Write(scratch.GetData(), scratch.GetOffset());
+  }
+
+  writer->Finish();
+  delete writer;
+}
+
+static void IndexLazyTestSection(RDCFile &rdc, SDFile &file, ChunkLookup lookup)
+{
+  ReadSerialiser ser(rdc.ReadSection(rdc.SectionIndex(SectionType::FrameCapture)),
+                     Ownership::Stream);
+
+  ser.ConfigureStructuredExport(lookup, true);
+  ser.SetLazyStructuredExport(true);
+
+  while(!ser.GetReader()->AtEnd() && !ser.IsErrored())
+  {
+    ser.ReadChunk<uint32_t>();
+    ser.EndChunk();
+  }
+
+  file.Swap(ser.GetStructuredFile());
+}
+
+TEST_CASE("Lazily load structured chunks", "[serialiser][structured]")
+{
+  const uint32_t numChunks = 8;
+
+  RDCFile rdc;
+  WriteLazyTestSection(rdc, numChunks);
+
+  int sectionIdx = rdc.SectionIndex(SectionType::FrameCapture);
+  REQUIRE(sectionIdx >= 0);
+
+  ChunkLookup testChunkLoop = [](uint32_t) -> std::string { return "TestChunk"; };
+
+  SDFile file;
+
+  {
+    ReadSerialiser ser(rdc.ReadSection(sectionIdx), Ownership::Stream);
+
+    ser.ConfigureStructuredExport(testChunkLoop, true);
+    ser.SetLazyStructuredExport(true);
+
+    for(uint32_t c = 0; c < numChunks; c++)
+    {
+      ser.ReadChunk<uint32_t>();
+
+      // nothing needs to read the chunk's contents
+      CHECK(ser.CanSkipCurrentChunk());
+
+      ser.EndChunk();
+    }
+
+    REQUIRE_FALSE(ser.IsErrored());
+    CHECK(ser.GetReader()->AtEnd());
+
+    file.Swap(ser.GetStructuredFile());
+  }
+
+  REQUIRE(file.chunks.size() == numChunks);
+  CHECK(file.buffers.empty());
+
+  for(uint32_t c = 0; c < numChunks; c++)
+  {
+    CHECK(file.chunks[c]->metadata.chunkID == 5 + c);
+    CHECK(file.chunks[c]->NumChildren() == 0);
+  }
+
+  TestChunkLoader *loader = new TestChunkLoader(&rdc, sectionIdx, testChunkLoop);
+  file.SetChunkLoader(loader, 2);
+
+  // load out of order, so the loader has to go backwards through the section as well as forwards
+  for(uint32_t c : {3U, 0U, 7U, 3U})
+  {
+    SDChunk *chunk = file.GetChunk(c);
+
+    REQUIRE(chunk->NumChildren() == 3);
+
+    SDObject *values = chunk->FindChild("values");
+    REQUIRE(values);
+    REQUIRE(values->NumChildren() == 3);
+    CHECK(values->GetChild(1)->AsUInt32() == c * 2);
+    CHECK(values->GetChild(2)->AsUInt32() == c * 3);
+
+    CHECK(chunk->FindChild("name")->AsString() == "chunk");
+
+    SDObject *buffer = chunk->FindChild("buffer");
+    REQUIRE(buffer);
+    CHECK(buffer->type.basetype == SDBasic::Buffer);
+    REQUIRE(buffer->data.basic.u < file.buffers.size());
+
+    bytebuf &buf = *file.buffers[(size_t)buffer->data.basic.u];
+    REQUIRE(buf.size() == 16);
+    CHECK(buf[0] == byte(c));
+    CHECK(buf[15] == byte(c));
+  }
+
+  // only the two most recently used chunks are kept loaded, so chunk 3 was evicted and reloaded
+  CHECK(loader->loads == 4);
+  CHECK(file.chunks[0]->NumChildren() == 0);
+  CHECK(file.chunks[3]->NumChildren() == 3);
+  CHECK(file.chunks[7]->NumChildren() == 3);
+
+  // loaded chunks aren't loaded again
+  CHECK(file.GetChunk(7)->NumChildren() == 3);
+  CHECK(loader->loads == 4);
+
+  // each chunk keeps its own buffer slot. Evicting chunk 0 freed its contents, and reloading chunk
+  // 3 reused its slot
+  CHECK(file.buffers.size() == 3);
+  CHECK(file.buffers[1]->empty());
+
+  // cycling every chunk through the cache repeatedly doesn't grow the file
+  for(int pass = 0; pass < 3; pass++)
+  {
+    for(uint32_t c = 0; c < numChunks; c++)
+    {
+      SDObject *buffer = file.GetChunk(c)->FindChild("buffer");
+      REQUIRE(buffer);
+
+      bytebuf &buf = *file.buffers[(size_t)buffer->data.basic.u];
+      REQUIRE(buf.size() == 16);
+      CHECK(buf[0] == byte(c));
+    }
+  }
+
+  CHECK(file.buffers.size() == numChunks);
+  CHECK(file.chunks[0]->NumChildren() == 0);
+  CHECK(file.chunks[numChunks - 1]->NumChildren() == 3);
+};
+
+TEST_CASE("Load lazy structured chunks in parallel", "[serialiser][structured]")
+{
+  // enough chunks to span several compressed blocks
+  const uint32_t numChunks = 4096;
+
+  RDCFile *rdc = new RDCFile;
+  bool onDisk = true;
+
+  std::string filename = FileIO::GetTempFolderFilename() + "rdoc_serialiser_parallel.rdc";
+  SectionFlags flags = SectionFlags::NoFlags;
+
+  SECTION("In memory")
+  {
+    onDisk = false;
+  }
+  SECTION("Uncompressed file")
+  {
+    flags = SectionFlags::NoFlags;
+  }
+  SECTION("LZ4 file")
+  {
+    flags = SectionFlags::LZ4Compressed | SectionFlags::LZ4IndependentBlocks;
+  }
+  SECTION("zstd file")
+  {
+    flags = SectionFlags::ZstdCompressed;
+  }
+
+  if(onDisk)
+  {
+    rdc->Create(filename.c_str());
+    WriteLazyTestSection(*rdc, numChunks, flags);
+    delete rdc;
+
+    rdc = new RDCFile;
+    rdc->Open(filename.c_str());
+    REQUIRE((rdc->ErrorCode() == ContainerError::NoError));
+  }
+  else
+  {
+    WriteLazyTestSection(*rdc, numChunks);
+  }
+
+  int sectionIdx = rdc->SectionIndex(SectionType::FrameCapture);
+  REQUIRE(sectionIdx >= 0);
+  CHECK((rdc->GetSectionProperties(sectionIdx).flags == flags));
+
+  ChunkLookup testChunkLoop = [](uint32_t) -> std::string { return "TestChunk"; };
+
+  SDFile file;
+  IndexLazyTestSection(*rdc, file, testChunkLoop);
+
+  REQUIRE(file.chunks.size() == numChunks);
+
+  file.SetChunkLoader(new TestChunkLoader(rdc, sectionIdx, testChunkLoop), 0);
+
+  // load one chunk up front, it shouldn't be loaded again and its buffer must stay valid
+  CHECK(file.GetChunk(10)->NumChildren() == 3);
+  CHECK(file.buffers.size() == 1);
+
+  int loads = 0;
+
+  // captures on disk are read concurrently through a separate handle for each loader
+  LoadLazyChunksParallel(file,
+                         [&]() -> SDChunkLoader * {
+                           loads++;
+                           TestChunkLoader *loader =
+                               new TestChunkLoader(rdc, sectionIdx, testChunkLoop);
+                           CHECK(loader->OwnsFile() == onDisk);
+                           return loader;
+                         },
+                         4);
+
+  CHECK(loads == 4);
+  CHECK_FALSE(file.IsLazy());
+  CHECK(file.buffers.size() == numChunks);
+
+  for(uint32_t c = 0; c < numChunks; c++)
+  {
+    SDChunk *chunk = file.chunks[c];
+
+    CHECK(chunk->metadata.chunkID == 5 + c);
+    REQUIRE(chunk->NumChildren() == 3);
+    CHECK(chunk->FindChild("values")->GetChild(2)->AsUInt32() == c * 3);
+
+    SDObject *buffer = chunk->FindChild("buffer");
+    REQUIRE(buffer->data.basic.u < file.buffers.size());
+
+    bytebuf &buf = *file.buffers[(size_t)buffer->data.basic.u];
+    REQUIRE(buf.size() == 16);
+    CHECK(buf[0] == byte(c));
+  }
+
+  delete rdc;
+
+  if(onDisk)
+    FileIO::Delete(filename.c_str());
+};
+
+TEST_CASE("Benchmark parallel structured loading", "[.][benchmark][serialiser]")
+{
+  const uint32_t numChunks = 200000;
+
+  RDCFile rdc;
+  WriteLazyTestSection(rdc, numChunks);
+
+  int sectionIdx = rdc.SectionIndex(SectionType::FrameCapture);
+
+  ChunkLookup testChunkLoop = [](uint32_t) -> std::string { return "TestChunk"; };
+
+  uint32_t maxThreads = RDCMAX(8U, Threading::NumberOfCores());
+
+  for(uint32_t threads = 1; threads <= maxThreads; threads *= 2)
+  {
+    SDFile file;
+
+    PerformanceTimer timer;
+
+    IndexLazyTestSection(rdc, file, testChunkLoop);
+
+    double indexMS = timer.GetMilliseconds();
+
+    LoadLazyChunksParallel(
+        file,
+        [&]() -> SDChunkLoader * { return new TestChunkLoader(&rdc, sectionIdx, testChunkLoop); },
+        threads);
+
+    CHECK(file.chunks.size() == numChunks);
+
+    RDCLOG("Structured load of %u chunks with %u threads: index %.1f ms, total %.1f ms", numChunks,
+           threads, indexMS, timer.GetMilliseconds());
+  }
+};
+
+TEST_CASE("Benchmark structured export", "[.][benchmark][serialiser]")
+{
+  const uint32_t numChunks = 1000000;
+
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  {
+    WriteSerialiser ser(buf, Ownership::Nothing);
+
+    for(uint32_t c = 0; c < numChunks; c++)
+    {
+      SCOPED_SERIALISE_CHUNK(5);
+
+      uint64_t id = c;
+      float pos[4] = {1.0f, 2.0f, 3.0f, 4.0f};
+      std::string name = "object";
+      SERIALISE_ELEMENT(id);
+      SERIALISE_ELEMENT(pos);
+      SERIALISE_ELEMENT(name);
+    }
+  }
+
+  PerformanceTimer timer;
+
+  SDFile file;
+
+  {
+    ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+    ChunkLookup testChunkLoop = [](uint32_t) -> std::string { return "TestChunk"; };
+
+    ser.ConfigureStructuredExport(testChunkLoop, false);
+
+    for(uint32_t c = 0; c < numChunks; c++)
+    {
+      ser.ReadChunk<uint32_t>();
+
+      uint64_t id;
+      float pos[4];
+      std::string name;
+      SERIALISE_ELEMENT(id);
+      SERIALISE_ELEMENT(pos);
+      SERIALISE_ELEMENT(name);
+
+      ser.EndChunk();
+    }
+
+    CHECK_FALSE(ser.IsErrored());
+
+    file.Swap(ser.GetStructuredFile());
+  }
+
+  double exportMS = timer.GetMilliseconds();
+
+  timer.Restart();
+
+  // the same tree allocated object by object on the heap, for comparison
+  std::vector<SDChunk *> heapChunks;
+  heapChunks.reserve(numChunks);
+  for(SDChunk *chunk : file.chunks)
+    heapChunks.push_back(chunk->Duplicate());
+
+  double heapMS = timer.GetMilliseconds();
+
+  timer.Restart();
+
+  {
+    SDFile destroy;
+    destroy.Swap(file);
+  }
+
+  double arenaFreeMS = timer.GetMilliseconds();
+
+  timer.Restart();
+
+  for(SDChunk *chunk : heapChunks)
+    delete chunk;
+
+  double heapFreeMS = timer.GetMilliseconds();
+
+  // 8 objects per chunk: the chunk, 3 members and 4 array elements
+  RDCLOG("Structured export of %u chunks (%llu bytes of objects): %.1f ms", numChunks,
+         uint64_t(numChunks) * (sizeof(SDChunk) + 7 * sizeof(SDObject)), exportMS);
+  RDCLOG("Arena free %.1f ms. Heap duplicate %.1f ms, heap free %.1f ms", arenaFreeMS, heapMS,
+         heapFreeMS);
+
+  delete buf;
+};
+
+TEST_CASE("Benchmark chunk creation", "[.][benchmark][serialiser][chunks]")
+{
+  const uint32_t numChunks = 1000000;
+
+  WriteSerialiser ser(new StreamWriter(StreamWriter::DefaultScratchSize), Ownership::Stream);
+
+  std::vector<Chunk *> chunks;
+  chunks.reserve(numChunks);
+
+  std::vector<byte *> heapChunks;
+  heapChunks.reserve(numChunks);
+
+  double arenaMS = 0.0, heapMS = 0.0, dupMS = 0.0;
+
+  PerformanceTimer timer;
+
+  // a typical small API call
+  for(uint32_t c = 0; c < numChunks; c++)
+  {
+    SCOPED_SERIALISE_CHUNK(5);
+
+    uint64_t id = c;
+    float pos[4] = {1.0f, 2.0f, 3.0f, 4.0f};
+    SERIALISE_ELEMENT(id);
+    SERIALISE_ELEMENT(pos);
+
+    chunks.push_back(scope.Get());
+  }
+
+  arenaMS = timer.GetMilliseconds();
+
+  // the same number of individually allocated copies, as chunks used to be. These chunks are
+  // under 64 bytes
+  timer.Restart();
+
+  for(uint32_t c = 0; c < numChunks; c++)
+  {
+    byte *data = AllocAlignedBuffer(64);
+    memcpy(data, chunks[c]->GetData(), 64);
+    heapChunks.push_back(data);
+  }
+
+  heapMS = timer.GetMilliseconds();
+
+  timer.Restart();
+
+  for(uint32_t c = 0; c < numChunks; c++)
+    delete chunks[c]->Duplicate();
+
+  dupMS = timer.GetMilliseconds();
+
+  timer.Restart();
+
+  for(Chunk *c : chunks)
+    delete c;
+
+  double arenaFreeMS = timer.GetMilliseconds();
+
+  timer.Restart();
+
+  for(byte *data : heapChunks)
+    FreeAlignedBuffer(data);
+
+  double heapFreeMS = timer.GetMilliseconds();
+
+  RDCLOG("Created %u chunks in %.1f ms (%.1f M/s), duplicated in %.1f ms, freed in %.1f ms",
+         numChunks, arenaMS, numChunks / (arenaMS * 1000.0), dupMS, arenaFreeMS);
+  RDCLOG("Individual heap allocate+copy %.1f ms, free %.1f ms", heapMS, heapFreeMS);
+};
+
 TEST_CASE("Test stringification works as expected", "[tostr]")
 {
   SECTION("Enum classes")
@@ -114,6 +114,7 @@ StreamReader::StreamReader(FILE *file, uint64_t fileSize, Ownership own)
 
   m_File = file;
   m_InputSize = fileSize;
+  m_FileBaseOffset = FileIO::ftell64(file);
 
   m_BufferSize = initialBufferSize;
   m_BufferHead = m_BufferBase = AllocAlignedBuffer(m_BufferSize);
@@ -150,6 +151,32 @@ StreamReader::StreamReader(FILE *file)
   m_Ownership = Ownership::Stream;
 }
 
+StreamReader::StreamReader(StreamMappedType, FILE *file, uint64_t fileSize)
+{
+  m_Ownership = Ownership::Nothing;
+
+  m_InputSize = m_BufferSize = fileSize;
+  m_BufferHead = m_BufferBase = NULL;
+
+  if(file == NULL)
+    return;
+
+  m_BufferHead = m_BufferBase =
+      FileIO::MapFileView(file, FileIO::ftell64(file), fileSize, m_Mapping);
+
+  // if the file couldn't be mapped, fall back to reading it through a window
+  if(m_Mapping == NULL)
+  {
+    m_File = file;
+    m_FileBaseOffset = FileIO::ftell64(file);
+
+    m_BufferSize = initialBufferSize;
+    m_BufferHead = m_BufferBase = AllocAlignedBuffer(m_BufferSize);
+
+    ReadFromExternal(0, RDCMIN(m_InputSize, m_BufferSize));
+  }
+}
+
 StreamReader::StreamReader(StreamReader *reader, uint64_t bufferSize)
 {
   m_InputSize = m_BufferSize = bufferSize;
@@ -178,7 +205,10 @@ StreamReader::~StreamReader()
   for(StreamCloseCallback cb : m_Callbacks)
     cb();
 
-  FreeAlignedBuffer(m_BufferBase);
+  if(m_Mapping)
+    FileIO::UnmapFileView(m_Mapping);
+  else
+    FreeAlignedBuffer(m_BufferBase);
 
   if(m_Ownership == Ownership::Stream)
   {
@@ -192,9 +222,59 @@ StreamReader::~StreamReader()
 
 void StreamReader::SetOffset(uint64_t offs)
 {
+  if(m_Sock)
+  {
+    RDCERR("Socket stream readers do not support seeking");
+    return;
+  }
+
   if(m_File || m_Decompressor)
   {
-    RDCERR("File and decompress stream readers do not support seeking");
+    if(offs > m_InputSize)
+    {
+      RDCERR("Seeking to %llu past the end of the stream (%llu bytes)", offs, m_InputSize);
+      return;
+    }
+
+    // if the offset is still within the window we have buffered, just move the head
+    if(offs >= m_ReadOffset && offs - m_ReadOffset < m_BufferSize)
+    {
+      m_BufferHead = m_BufferBase + (offs - m_ReadOffset);
+      return;
+    }
+
+    if(m_File)
+    {
+      FileIO::fseek64(m_File, m_FileBaseOffset + offs, SEEK_SET);
+    }
+    else if(!m_Decompressor->Seek(offs))
+    {
+      // the decompressor doesn't support random access, all we can do is decompress forwards
+      uint64_t cur = GetOffset();
+
+      if(offs < cur)
+      {
+        RDCERR("Decompressor doesn't support seeking backwards from %llu to %llu", cur, offs);
+        return;
+      }
+
+      // skip in window-sized steps so we don't allocate a buffer for the whole skip
+      while(cur < offs && !m_HasError)
+      {
+        uint64_t skip = RDCMIN(offs - cur, RDCMAX(Available(), initialBufferSize));
+        Read(NULL, skip);
+        cur += skip;
+      }
+
+      return;
+    }
+
+    // refill the buffer from the new position
+    m_ReadOffset = offs;
+    m_BufferHead = m_BufferBase;
+
+    ReadFromExternal(0, RDCMIN(m_BufferSize, m_InputSize - offs));
+
     return;
   }
 
@@ -416,6 +496,59 @@ StreamWriter::~StreamWriter()
   }
 }
 
+bool StreamWriter::WriteFromFile(FILE *file, uint64_t offset, uint64_t length)
+{
+  if(length == 0)
+    return true;
+
+  if(m_Sock)
+  {
+    // anything we've buffered must go out first to keep the stream in order
+    if(!FlushSocketData())
+      return false;
+
+    m_WriteSize += length;
+
+    bool success = m_Sock->SendFileBlocking(file, offset, length);
+    if(!success)
+    {
+      HandleError();
+      return false;
+    }
+
+    return true;
+  }
+
+  FileIO::fseek64(file, offset, SEEK_SET);
+
+  const uint64_t bufSize = RDCMIN(length, (uint64_t)1024 * 1024);
+  byte *buf = new byte[(size_t)bufSize];
+
+  bool success = true;
+
+  while(length > 0)
+  {
+    uint64_t count = RDCMIN(length, bufSize);
+
+    if(FileIO::fread(buf, 1, (size_t)count, file) != count)
+    {
+      RDCERR("Unexpected end of file writing %llu bytes from file", length);
+      success = false;
+      break;
+    }
+
+    success = Write(buf, count);
+    if(!success)
+      break;
+
+    length -= count;
+  }
+
+  delete[] buf;
+
+  return success;
+}
+
 bool StreamWriter::SendSocketData(const void *data, uint64_t numBytes)
 {
   // try to coalesce small writes without doing blocking sends, at least until we're flushed.
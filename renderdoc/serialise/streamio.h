@@ -61,6 +61,10 @@ public:
   virtual bool Recompress(Compressor *comp) = 0;
   virtual bool Read(void *data, uint64_t numBytes) = 0;
 
+  // positions the decompressor so that the next Read() returns data from the given uncompressed
+  // offset. Returns false if the compressed stream doesn't support random access.
+  virtual bool Seek(uint64_t offs) { return false; }
+
 protected:
   StreamReader *m_Read;
   Ownership m_Ownership;
@@ -77,6 +81,11 @@ public:
   {
     DummyStream
   };
+  // read the file through a memory mapping where possible, instead of copying it into a window
+  enum StreamMappedType
+  {
+    MappedStream
+  };
 
   StreamReader(StreamInvalidType);
   StreamReader(StreamDummyType);
@@ -86,6 +95,7 @@ public:
   StreamReader(Network::Socket *sock, Ownership own);
   StreamReader(FILE *file, uint64_t fileSize, Ownership own);
   StreamReader(FILE *file);
+  StreamReader(StreamMappedType, FILE *file, uint64_t fileSize);
   StreamReader(StreamReader *reader, uint64_t bufferSize);
   StreamReader(Decompressor *decompressor, uint64_t uncompressedSize, Ownership own);
 
@@ -196,6 +206,26 @@ public:
     return Read(&data, sizeof(T));
   }
 
+  // for memory-mapped streams, returns a pointer to the next numBytes directly in the mapping and
+  // skips past them, so the data can be used without copying. The pointer is valid until the
+  // stream is destroyed. Returns NULL and reads nothing for any other type of stream, or if the
+  // data in the mapping isn't aligned to the given alignment.
+  byte *ReadMapped(uint64_t numBytes, uint64_t alignment = 1)
+  {
+    if(m_Mapping == NULL || numBytes > Available() || ((uintptr_t)m_BufferHead % alignment) != 0)
+      return NULL;
+
+    byte *ret = m_BufferHead;
+    m_BufferHead += numBytes;
+    return ret;
+  }
+
+  // returns true if ptr points into this stream's memory mapping, e.g. was returned by ReadMapped
+  bool IsMappedPointer(const void *ptr) const
+  {
+    return m_Mapping && ptr >= m_BufferBase && ptr < m_BufferBase + m_BufferSize;
+  }
+
   void AddCloseCallback(StreamCloseCallback callback) { m_Callbacks.push_back(callback); }
 private:
   inline uint64_t Available()
@@ -230,9 +260,15 @@ private:
   // the decompressor, if reading from it
   Decompressor *m_Decompressor = NULL;
 
+  // the handle for the file mapping, if the whole input is mapped in m_BufferBase
+  void *m_Mapping = NULL;
+
   // the offset in the file/decompressor that corresponds to the start of m_BufferBase
   uint64_t m_ReadOffset = 0;
 
+  // the absolute position in the file where this stream starts, used for seeking
+  uint64_t m_FileBaseOffset = 0;
+
   // flag indicating if an error has been encountered and the stream is now invalid
   bool m_HasError = false;
 
@@ -382,6 +418,10 @@ public:
     }
   }
 
+  // write a range of a file. When writing to a socket this goes straight from the file to the
+  // socket without passing through our buffers, where the OS supports it.
+  bool WriteFromFile(FILE *file, uint64_t offset, uint64_t length);
+
   // write a particular value at an offset (not necessarily just append).
   template <typename T>
   bool WriteAt(uint64_t offs, const T &data)
@@ -94,6 +94,70 @@ TEST_CASE("Test basic stream I/O operations", "[streamio]")
   CHECK(reader.IsErrored());
 };
 
+TEST_CASE("Test memory mapped file stream reading", "[streamio]")
+{
+  std::string filename = FileIO::GetTempFolderFilename() + "rdoc_streamio_mapped.bin";
+
+  std::vector<byte> data;
+  data.resize(256 * 1024);
+  for(size_t i = 0; i < data.size(); i++)
+    data[i] = byte((i * 13) & 0xff);
+
+  REQUIRE(FileIO::dump(filename.c_str(), data.data(), data.size()));
+
+  FILE *f = FileIO::fopen(filename.c_str(), "rb");
+  REQUIRE(f);
+
+  // start part way into the file, as sections do
+  const uint64_t start = 1000;
+  FileIO::fseek64(f, start, SEEK_SET);
+
+  {
+    StreamReader reader(StreamReader::MappedStream, f, data.size() - start);
+
+    CHECK(reader.GetSize() == data.size() - start);
+
+    uint32_t test = 0;
+    reader.Read(test);
+    CHECK_FALSE(memcmp(&test, &data[start], sizeof(test)));
+
+    byte *mapped = reader.ReadMapped(64 * 1024);
+
+    REQUIRE(mapped);
+    CHECK(reader.IsMappedPointer(mapped));
+    CHECK(reader.GetOffset() == 4 + 64 * 1024);
+    CHECK_FALSE(memcmp(mapped, &data[start + 4], 64 * 1024));
+
+    // writes to the mapping are private, they don't change the file
+    mapped[0] ^= 0xff;
+
+    reader.SetOffset(100 * 1024);
+
+    byte readData[128];
+    reader.Read(readData, sizeof(readData));
+    CHECK_FALSE(memcmp(readData, &data[start + 100 * 1024], sizeof(readData)));
+
+    CHECK_FALSE(reader.IsMappedPointer(readData));
+
+    // reading off the end doesn't return a pointer
+    CHECK(reader.ReadMapped(data.size()) == NULL);
+
+    CHECK_FALSE(reader.IsErrored());
+  }
+
+  FileIO::fclose(f);
+
+  std::vector<byte> readback;
+  REQUIRE(FileIO::slurp(filename.c_str(), readback));
+  CHECK(readback == data);
+
+  // non-mapped streams never return pointers
+  StreamReader memReader(data);
+  CHECK(memReader.ReadMapped(16) == NULL);
+
+  FileIO::Delete(filename.c_str());
+};
+
 TEST_CASE("Test stream I/O operations over the network", "[streamio][network]")
 {
   uint16_t port = 8235;
@@ -23,11 +23,23 @@
  ******************************************************************************/
 
 #define ZSTD_STATIC_LINKING_ONLY
+#include <algorithm>
 #include "zstdio.h"
 
 static const uint64_t zstdBlockSize = 128 * 1024;
 static const uint64_t compressBlockSize = ZSTD_compressBound(zstdBlockSize);
 
+// identifies the seek table footer, the same value as used by zstd's seekable format
+static const uint32_t seekTableMagic = 0x8F92EAB1;
+
+// the footer is the last frame in the stream, and contains the total length of the seek table
+// (including the footer), the number of frames, and the magic number.
+static const uint32_t seekTableFooterPayload = sizeof(uint64_t) + sizeof(uint32_t) * 2;
+static const uint64_t seekTableFooterSize = sizeof(uint32_t) * 3 + seekTableFooterPayload;
+
+// the table is split into frames no larger than a normal frame, so that older readers can skip it
+static const size_t seekEntriesPerFrame = zstdBlockSize / sizeof(ZSTDSeekEntry);
+
 ZSTDCompressor::ZSTDCompressor(StreamWriter *write, Ownership own) : Compressor(write, own)
 {
   m_Page = AllocAlignedBuffer(zstdBlockSize);
@@ -112,7 +124,12 @@ bool ZSTDCompressor::Finish()
   // only the last one can be smaller, so we only write a partial page when finishing.
   // Calling Write() after Finish() is illegal
 
-  return FlushPage();
+  bool success = FlushPage();
+
+  if(success)
+    success &= WriteSeekTable();
+
+  return success;
 }
 
 bool ZSTDCompressor::FlushPage()
@@ -137,12 +154,48 @@ bool ZSTDCompressor::FlushPage()
   success &= m_Write->Write((uint32_t)out.pos);
   success &= m_Write->Write(m_CompressBuffer, out.pos);
 
+  m_SeekTable.push_back({uint32_t(sizeof(uint32_t) + out.pos), (uint32_t)m_PageOffset});
+
   // start writing to the start of the page again
   m_PageOffset = 0;
 
   return success;
 }
 
+bool ZSTDCompressor::WriteSeekTable()
+{
+  bool success = true;
+
+  uint64_t tableLength = 0;
+
+  // each frame is written with the same size prefix as a compressed frame
+  for(size_t i = 0; i < m_SeekTable.size(); i += seekEntriesPerFrame)
+  {
+    uint32_t payloadSize =
+        uint32_t(RDCMIN(seekEntriesPerFrame, m_SeekTable.size() - i) * sizeof(ZSTDSeekEntry));
+
+    success &= m_Write->Write(uint32_t(sizeof(uint32_t) * 2 + payloadSize));
+    success &= m_Write->Write(ZSTD_MAGIC_SKIPPABLE_START);
+    success &= m_Write->Write(payloadSize);
+    success &= m_Write->Write(m_SeekTable.data() + i, payloadSize);
+
+    tableLength += sizeof(uint32_t) * 3 + payloadSize;
+  }
+
+  tableLength += seekTableFooterSize;
+
+  success &= m_Write->Write(uint32_t(sizeof(uint32_t) * 2 + seekTableFooterPayload));
+  success &= m_Write->Write(ZSTD_MAGIC_SKIPPABLE_START);
+  success &= m_Write->Write(seekTableFooterPayload);
+  success &= m_Write->Write(tableLength);
+  success &= m_Write->Write((uint32_t)m_SeekTable.size());
+  success &= m_Write->Write(seekTableMagic);
+
+  m_SeekTable.clear();
+
+  return success;
+}
+
 bool ZSTDCompressor::CompressZSTDFrame(ZSTD_inBuffer &in, ZSTD_outBuffer &out)
 {
   size_t err = ZSTD_initCStream(m_Stream, 7);
@@ -286,6 +339,123 @@ bool ZSTDDecompressor::Read(void *data, uint64_t numBytes)
   return success;
 }
 
+bool ZSTDDecompressor::Seek(uint64_t offs)
+{
+  // if we encountered a stream error this will be NULL
+  if(!m_CompressBuffer)
+    return false;
+
+  if(!m_SeekTableLoaded)
+    LoadSeekTable();
+
+  if(m_FrameOffsets.empty())
+    return false;
+
+  // find the last frame starting at or before offs. The final entry is the end of the stream so
+  // offsets past the last frame will land on it.
+  auto it = std::upper_bound(
+      m_FrameOffsets.begin(), m_FrameOffsets.end(), offs,
+      [](uint64_t o, const FrameOffset &frameOffs) { return o < frameOffs.decompressed; });
+  size_t frame = size_t(it - m_FrameOffsets.begin()) - 1;
+
+  m_Read->SetOffset(m_FrameOffsets[frame].compressed);
+
+  if(m_Read->IsErrored())
+    return false;
+
+  // seeking to the very end, there's nothing to decompress
+  if(frame == m_FrameOffsets.size() - 1)
+  {
+    m_PageOffset = m_PageLength = 0;
+    return true;
+  }
+
+  if(!FillPage())
+    return false;
+
+  m_PageOffset = RDCMIN(m_PageLength, offs - m_FrameOffsets[frame].decompressed);
+
+  return true;
+}
+
+void ZSTDDecompressor::LoadSeekTable()
+{
+  m_SeekTableLoaded = true;
+
+  const uint64_t size = m_Read->GetSize();
+
+  if(size < seekTableFooterSize)
+    return;
+
+  uint64_t prevOffset = m_Read->GetOffset();
+
+  uint32_t prefix = 0, skippableMagic = 0, payloadSize = 0, numFrames = 0, magic = 0;
+  uint64_t tableLength = 0;
+
+  m_Read->SetOffset(size - seekTableFooterSize);
+  m_Read->Read(prefix);
+  m_Read->Read(skippableMagic);
+  m_Read->Read(payloadSize);
+  m_Read->Read(tableLength);
+  m_Read->Read(numFrames);
+  m_Read->Read(magic);
+
+  if(m_Read->IsErrored() || magic != seekTableMagic ||
+     skippableMagic != ZSTD_MAGIC_SKIPPABLE_START || payloadSize != seekTableFooterPayload ||
+     tableLength > size)
+  {
+    // no seek table, this stream was written before they were added
+    m_Read->SetOffset(prevOffset);
+    return;
+  }
+
+  std::vector<ZSTDSeekEntry> entries;
+  entries.reserve(numFrames);
+
+  m_Read->SetOffset(size - tableLength);
+
+  while(entries.size() < numFrames && !m_Read->IsErrored())
+  {
+    m_Read->Read(prefix);
+    m_Read->Read(skippableMagic);
+    m_Read->Read(payloadSize);
+
+    if(skippableMagic != ZSTD_MAGIC_SKIPPABLE_START || payloadSize % sizeof(ZSTDSeekEntry) != 0 ||
+       payloadSize / sizeof(ZSTDSeekEntry) > numFrames - entries.size())
+    {
+      RDCERR("Corrupt zstd seek table");
+      m_Read->SetOffset(prevOffset);
+      return;
+    }
+
+    size_t base = entries.size();
+    entries.resize(base + payloadSize / sizeof(ZSTDSeekEntry));
+    m_Read->Read(entries.data() + base, payloadSize);
+  }
+
+  if(m_Read->IsErrored())
+    return;
+
+  m_FrameOffsets.resize(entries.size() + 1);
+
+  FrameOffset cur = {0, 0};
+  for(size_t i = 0; i < entries.size(); i++)
+  {
+    m_FrameOffsets[i] = cur;
+    cur.compressed += entries[i].compressedSize;
+    cur.decompressed += entries[i].decompressedSize;
+  }
+  m_FrameOffsets.back() = cur;
+
+  if(cur.compressed != size - tableLength)
+  {
+    RDCERR("zstd seek table doesn't match stream size");
+    m_FrameOffsets.clear();
+  }
+
+  m_Read->SetOffset(prevOffset);
+}
+
 bool ZSTDDecompressor::FillPage()
 {
   uint32_t compSize = 0;
@@ -293,6 +463,16 @@ bool ZSTDDecompressor::FillPage()
   bool success = true;
 
   success &= m_Read->Read(compSize);
+
+  if(!success || compSize > compressBlockSize)
+  {
+    RDCERR("Error reading size: %u", compSize);
+    FreeAlignedBuffer(m_Page);
+    FreeAlignedBuffer(m_CompressBuffer);
+    m_Page = m_CompressBuffer = NULL;
+    return false;
+  }
+
   success &= m_Read->Read(m_CompressBuffer, compSize);
 
   if(!success)
@@ -27,6 +27,17 @@
 #include "zstd/zstd.h"
 #include "streamio.h"
 
+// Each page is compressed as a separate zstd frame. After the last frame a seek table is written,
+// listing the size of every frame, in zstd skippable frames so that readers which don't know
+// about it will decompress it as empty. The table lets the decompressor seek to any offset by
+// only decompressing the frame that contains it.
+struct ZSTDSeekEntry
+{
+  // size of the frame on disk including its size prefix
+  uint32_t compressedSize;
+  uint32_t decompressedSize;
+};
+
 class ZSTDCompressor : public Compressor
 {
 public:
@@ -38,6 +49,7 @@ public:
 
 private:
   bool FlushPage();
+  bool WriteSeekTable();
 
   bool CompressZSTDFrame(ZSTD_inBuffer &in, ZSTD_outBuffer &out);
 
@@ -45,6 +57,8 @@ private:
   byte *m_CompressBuffer;
   uint64_t m_PageOffset;
 
+  std::vector<ZSTDSeekEntry> m_SeekTable;
+
   ZSTD_CStream *m_Stream;
 };
 
@@ -56,14 +70,26 @@ public:
 
   bool Recompress(Compressor *comp);
   bool Read(void *data, uint64_t numBytes);
+  bool Seek(uint64_t offs);
 
 private:
   bool FillPage();
+  void LoadSeekTable();
 
   byte *m_Page;
   byte *m_CompressBuffer;
   uint64_t m_PageOffset;
   uint64_t m_PageLength;
 
+  // the start of each frame, compressed and decompressed, loaded on the first seek. There is one
+  // extra entry at the end with the total sizes. Empty if the stream has no seek table
+  struct FrameOffset
+  {
+    uint64_t compressed;
+    uint64_t decompressed;
+  };
+  std::vector<FrameOffset> m_FrameOffsets;
+  bool m_SeekTableLoaded = false;
+
   ZSTD_DStream *m_Stream;
 };